@@ -21,6 +21,9 @@
 // Keep this after all headers
 #include "compat.h"
 
+static const INT64 TICK_PERIOD_NS = 10000000;       // Nanoseconds per tick
+static const INT64 MIN_TIMEOUT_NS = 2 * TICK_PERIOD_NS; // Never resend sooner than this
+
 // table of starting ip addresses for each NSP (128 channels)
 //	indexed by NSP number:
 #define RANGESIZE 16
@@ -41,6 +44,8 @@ Instrument::Instrument() :
     m_nInPort(NSP_IN_PORT), m_nOutPort(NSP_OUT_PORT),
     m_szInIP(NSP_IN_ADDRESS), m_szOutIP(NSP_OUT_ADDRESS)
 {
+    m_nWindow = XMT_WINDOW;
+    Reset();
 }
 
 Instrument::~Instrument()
@@ -126,47 +131,212 @@ int Instrument::Send(void *ppkt)
     UINT32 quadlettotal = (((cbPKT_GENERIC*)ppkt)->dlen) + cbPKT_HEADER_32SIZE;
     UINT32 cbSize = quadlettotal << 2;      // number of bytes
 
+    if (!OkToSend())
+        return -1;
+    AddPacket(ppkt, cbSize, UDPSocket::MonotonicTime());
+    return m_icUDP.Send(ppkt, cbSize);
+}
 
-    CachedPacket * pEnd = ARRAY_END(m_aicCache);
-    CachedPacket * pCache;
-    // Find the first location that is open
-    for (pCache = m_aicCache; pCache != pEnd; pCache++) {
-        if (pCache->OkToSend())
-            break;
+// Purpose: Send packets out back to back, as many as the window allows
+// Inputs:
+//  ppkts  - the packets to send
+//  nCount - number of packets to send
+// Outputs:
+//  the number of packets sent from the start of the list
+int Instrument::SendBatch(void * const * ppkts, int nCount)
+{
+    int anSizes[UDPSocket::MAX_SEND_BATCH];
+    CachedPacket * apCache[UDPSocket::MAX_SEND_BATCH];
+    if (nCount > UDPSocket::MAX_SEND_BATCH)
+        nCount = UDPSocket::MAX_SEND_BATCH;
+
+    INT64 nNow = UDPSocket::MonotonicTime();
+    int nPackets;
+    for (nPackets = 0; nPackets < nCount && OkToSend(); ++nPackets)
+    {
+        UINT32 quadlettotal = (((cbPKT_GENERIC*)ppkts[nPackets])->dlen) + cbPKT_HEADER_32SIZE;
+        anSizes[nPackets] = quadlettotal << 2;
+        apCache[nPackets] = AddPacket(ppkts[nPackets], anSizes[nPackets], nNow);
     }
 
-    if (pCache == pEnd)
-        return -1;
-    pCache->AddPacket(ppkt, cbSize);
-    return m_icUDP.Send(ppkt, cbSize);
+    int nSent = m_icUDP.SendBatch(ppkts, anSizes, nPackets);
+    // Whatever did not go out is not waiting for a reply
+    for (int i = nSent; i < nPackets; ++i)
+        RemovePacket(apCache[i]);
+    return nSent;
+}
+
+int Instrument::Recv(void * packet, INT64 * pStamp)
+{
+    return m_icUDP.Recv(packet, pStamp);
 }
 
-int Instrument::Recv(void * packet)
+// Purpose: Receive a batch of datagrams, each in its own slot of cbCER_UDP_SIZE_MAX bytes
+// Inputs:
+//  buffer - Where to stuff the datagrams
+//  nCount - maximum number of datagrams to receive
+// Outputs:
+//  pSizes  - the size of each datagram
+//  pStamps - (optional) host time in nanoseconds each datagram was received
+//  the number of datagrams read, or 0 if no data was found
+int Instrument::RecvBatch(void * buffer, int nCount, int * pSizes, INT64 * pStamps)
+{
+    return m_icUDP.RecvBatch(buffer, cbCER_UDP_SIZE_MAX, nCount, pSizes, pStamps);
+}
+
+// Purpose: Wait for incoming data
+// Inputs:
+//  nTimeout - maximum time to wait in milliseconds
+// Outputs:
+//  TRUE if data is ready to be received; FALSE on timeout
+bool Instrument::WaitForRecv(int nTimeout)
 {
-    return m_icUDP.Recv(packet);
+    return m_icUDP.Wait(nTimeout);
 }
 
 
 // What is our current send mode?
 Instrument::ModeType Instrument::GetSendMode()
 {
-    ModeType ret = static_cast<ModeType>(0);
-    for (CachedPacket * pCache = m_aicCache; pCache != ARRAY_END(m_aicCache); ++pCache)
-    {
-        ret = max(ret, pCache->GetMode());
-    }
-    return ret;
+    return m_nOutstanding ? MT_WAITING_FOR_REPLY : MT_OK_TO_SEND;
+}
+
+
+// Purpose: The key a packet and its response are both found by
+// Inputs:
+//  type  - the response packet type (high bit of the sent packet type masked off)
+//  chid  - the packet channel id
+//  pData - the packet data
+//  bChan - if channel in the first data word is part of the key
+// Outputs:
+//  the key
+UINT64 Instrument::ReplyKey(UINT8 type, UINT16 chid, const UINT32 * pData, bool bChan)
+{
+    UINT64 nKey = ((UINT64)type << 48) | ((UINT64)chid << 32);
+    if (bChan)
+        nKey |= ((UINT64)1 << 56) | pData[0];
+    return nKey;
 }
 
 
 // A packet has come in...
 void Instrument::TestForReply(void * pPacket)
 {
-    // Give everyone a chance to see if this is an important packet
-    for (CachedPacket * pCache = m_aicCache; pCache != ARRAY_END(m_aicCache); ++pCache)
+    if (m_nOutstanding == 0)
+        return;
+    cbPKT_GENERIC * pIn = static_cast<cbPKT_GENERIC *>(pPacket);
+
+    // If this is a "configuration type packet" the channel must match too
+    // The logic works because Chanset is 0xC0 and all config packets are 0xC?
+    // It will also work out because the 0xD0 family of packets will come in here
+    // and their 1st value is channel.
+    if ((((pIn->type | 0x80) & cbPKTTYPE_CHANSET) == cbPKTTYPE_CHANSET) && pIn->dlen)
     {
-        pCache->CheckForReply(pPacket);
+        if (MatchReply(ReplyKey(pIn->type, pIn->chid, pIn->data, true)))
+            return;
     }
+    MatchReply(ReplyKey(pIn->type, pIn->chid, pIn->data, false));
+}
+
+
+// Purpose: Save a packet that was sent, to wait for its response
+// Inputs:
+//  pPacket - the packet
+//  cbBytes - the size of the packet
+//  nNow    - host time in nanoseconds the packet is sent
+// Outputs:
+//  the location the packet is saved in
+Instrument::CachedPacket * Instrument::AddPacket(void * pPacket, int cbBytes, INT64 nNow)
+{
+    // Find the first location that is open (there is one if window allowed sending)
+    CachedPacket * pCache = m_aicCache;
+    while (!pCache->OkToSend())
+        pCache++;
+
+    ASSERT((unsigned int)cbBytes <= sizeof(pCache->m_abyPacket));
+    memcpy(pCache->m_abyPacket, pPacket, cbBytes);
+    pCache->m_cbPacketBytes = cbBytes;
+
+    cbPKT_GENERIC * pOut = static_cast<cbPKT_GENERIC *>(pPacket);
+    bool bChan = ((pOut->type & cbPKTTYPE_CHANSET) == cbPKTTYPE_CHANSET) && pOut->dlen;
+    pCache->m_nKey = ReplyKey(pOut->type & ~0x80, pOut->chid, pOut->data, bChan); // mask off the highest bit
+    pCache->m_enSendMode = MT_WAITING_FOR_REPLY;
+    pCache->m_nSentTime = nNow;
+    pCache->m_nTimeout = m_nRto;
+    pCache->m_nDeadline = nNow + m_nMaxTickCount * m_nMaxRetryCount * TICK_PERIOD_NS;
+    pCache->m_nRetryCount = 0;
+    pCache->m_nNext = -1;
+
+    // Responses come in the order packets are sent, so wait after the packets already in the bucket
+    int * pLink = &m_anReplyBucket[ReplyBucket(pCache->m_nKey)];
+    while (*pLink >= 0)
+        pLink = &m_aicCache[*pLink].m_nNext;
+    *pLink = (int)(pCache - m_aicCache);
+    m_nOutstanding++;
+
+//    TRACE("Outgoing Pkt Type: 0x%2X\n", pOut->type);
+    return pCache;
+}
+
+
+// Purpose: Stop waiting for the response of a packet
+// Inputs:
+//  pCache - the location the packet is saved in
+void Instrument::RemovePacket(CachedPacket * pCache)
+{
+    int nIdx = (int)(pCache - m_aicCache);
+    int * pLink = &m_anReplyBucket[ReplyBucket(pCache->m_nKey)];
+    while (*pLink != nIdx)
+        pLink = &m_aicCache[*pLink].m_nNext;
+    *pLink = pCache->m_nNext;
+    pCache->m_nNext = -1;
+    pCache->m_enSendMode = MT_OK_TO_SEND;
+    m_nOutstanding--;
+}
+
+
+// Purpose: Match a response to the oldest packet waiting for it,
+//           and use the time it took to adapt how long to wait for the next responses
+// Inputs:
+//  nKey - the response key
+// Outputs:
+//  TRUE if a packet was waiting for this response; FALSE otherwise
+bool Instrument::MatchReply(UINT64 nKey)
+{
+    int nIdx = m_anReplyBucket[ReplyBucket(nKey)];
+    while (nIdx >= 0 && m_aicCache[nIdx].m_nKey != nKey)
+        nIdx = m_aicCache[nIdx].m_nNext;
+    if (nIdx < 0)
+        return false;
+
+    CachedPacket * pCache = &m_aicCache[nIdx];
+    // Only time packets that were not resent, the response could be for any of the copies
+    INT64 nRtt = UDPSocket::MonotonicTime() - pCache->m_nSentTime;
+    if (pCache->m_nRetryCount == 0 && nRtt >= 0)
+    {
+        if (m_nSmoothRtt == 0)
+        {
+            m_nSmoothRtt = nRtt;
+            m_nRttVar = nRtt / 2;
+        } else {
+            INT64 nErr = m_nSmoothRtt - nRtt;
+            if (nErr < 0)
+                nErr = -nErr;
+            m_nRttVar = (3 * m_nRttVar + nErr) / 4;
+            m_nSmoothRtt = (7 * m_nSmoothRtt + nRtt) / 8;
+        }
+        INT64 nVar = 4 * m_nRttVar;
+        if (nVar < TICK_PERIOD_NS)
+            nVar = TICK_PERIOD_NS; // Resending is only checked every tick
+        m_nRto = m_nSmoothRtt + nVar;
+        // Never wait longer than the configured number of ticks
+        if (m_nRto > m_nMaxTickCount * TICK_PERIOD_NS)
+            m_nRto = m_nMaxTickCount * TICK_PERIOD_NS;
+        if (m_nRto < MIN_TIMEOUT_NS)
+            m_nRto = MIN_TIMEOUT_NS;
+    }
+    RemovePacket(pCache);
+    return true;
 }
 
 
@@ -241,28 +411,62 @@ int Instrument::LoopbackRecvLow(void * pBuffer, void * pPacketData, UINT32 nInst
 //  TRUE if any instrument error has happened; FALSE otherwise
 bool Instrument::Tick()
 {
-    // What is the end?
-    CachedPacket * pEnd = ARRAY_END(m_aicCache);
-    CachedPacket * pFound;
-    // Find the first case where        {item}.Tick(m_icUDP) == true
-    for (pFound = m_aicCache; pFound != pEnd; pFound++)
+    if (m_nOutstanding == 0)
+        return false;
+    INT64 nNow = UDPSocket::MonotonicTime();
+    for (CachedPacket * pCache = m_aicCache; pCache != ARRAY_END(m_aicCache); pCache++)
     {
-        if (pFound->Tick(m_icUDP))
-            break;
+        if (pCache->OkToSend())
+            continue;
+        if (nNow - pCache->m_nSentTime < pCache->m_nTimeout)
+            continue;
+        // true means that we have an error here
+        if (nNow >= pCache->m_nDeadline)
+            return true;
+        TRACE("********************Resending packet******************* type: 0x%02X\n", ((cbPKT_GENERIC *)pCache->m_abyPacket)->type );
+        m_icUDP.Send(pCache->m_abyPacket, pCache->m_cbPacketBytes);
+        pCache->m_nSentTime = nNow;
+        pCache->m_nRetryCount++;
+        // Back off, but never wait longer than the configured number of ticks
+        pCache->m_nTimeout *= 2;
+        if (pCache->m_nTimeout > m_nMaxTickCount * TICK_PERIOD_NS)
+            pCache->m_nTimeout = m_nMaxTickCount * TICK_PERIOD_NS;
     }
-
-   // If I've reached the end, then none are true
-    return pFound != pEnd;
+    return false;
 }
 
+// Stop trying to send packets and restart
+// Inputs:
+//  nMaxTickCount  - How many ticks to wait for a response ( 10ms per tick), before response time is measured
+//  nMaxRetryCount - How many times to "resend" a packet before erroring out, packets are given up on
+//                    after nMaxTickCount * nMaxRetryCount ticks no matter how many times they are resent
 void Instrument::Reset(int nMaxTickCount, int nMaxRetryCount)
 {
-    // Call everybody's reset member function
-    CachedPacket * pCache;
-    for (pCache = m_aicCache; pCache != ARRAY_END(m_aicCache); pCache++)
+    m_nMaxTickCount = nMaxTickCount;
+    m_nMaxRetryCount = nMaxRetryCount;
+    for (CachedPacket * pCache = m_aicCache; pCache != ARRAY_END(m_aicCache); pCache++)
     {
-        pCache->Reset(nMaxTickCount, nMaxRetryCount);
+        pCache->m_enSendMode = MT_OK_TO_SEND;
+        pCache->m_nNext = -1;
     }
+    for (int i = 0; i < REPLY_BUCKETS; ++i)
+        m_anReplyBucket[i] = -1;
+    m_nOutstanding = 0;
+    m_nSmoothRtt = 0;
+    m_nRttVar = 0;
+    m_nRto = nMaxTickCount * TICK_PERIOD_NS;
+}
+
+// Purpose: Set how many packets may wait for a response at once
+// Inputs:
+//  nWindow - number of packets (1 to MAX_XMT_WINDOW)
+void Instrument::SetWindow(int nWindow)
+{
+    if (nWindow < 1)
+        nWindow = 1;
+    if (nWindow > MAX_XMT_WINDOW)
+        nWindow = MAX_XMT_WINDOW;
+    m_nWindow = nWindow;
 }
 
 
@@ -272,120 +476,5 @@ void Instrument::Reset(int nMaxTickCount, int nMaxRetryCount)
 //  TRUE if it is OK to send; FALSE if not
 bool Instrument::OkToSend()
 {
-    CachedPacket * pEnd = ARRAY_END(m_aicCache);
-    CachedPacket * pFound;
-    // Find the first location that is open
-    for (pFound = m_aicCache; pFound != pEnd; pFound++)
-    {
-        if (pFound->OkToSend())
-            break;
-    }
-
-    return (pFound != pEnd);
-}
-
-
-Instrument::CachedPacket::CachedPacket()
-{
-    Reset();
-}
-
-// Stop trying to send packets and restart
-void Instrument::CachedPacket::Reset(int nMaxTickCount, int nMaxRetryCount)
-{
-    m_enSendMode = MT_OK_TO_SEND;   // What is our current send mode?
-    m_nTickCount = m_nMaxTickCount = nMaxTickCount;    // How many ticks have passed since we sent?
-    m_nRetryCount = m_nMaxRetryCount = nMaxRetryCount; // How many times have we re-sent this packet?
-}
-
-// Save this packet
-bool Instrument::CachedPacket::AddPacket(void * pPacket, int cbBytes)
-{
-    ASSERT((unsigned int)cbBytes <= sizeof(m_abyPacket));
-    memcpy(m_abyPacket, pPacket, cbBytes);
-    m_cbPacketBytes = cbBytes;
-
-
-    m_enSendMode = MT_WAITING_FOR_REPLY;
-    m_nTickCount = m_nMaxTickCount;              // How many ticks have passed since we sent?
-    m_nRetryCount = m_nMaxRetryCount;           // How many times have we re-sent this packet?
-
-//    TRACE("Outgoing Pkt Type: 0x%2X\n", ((cbPKT_GENERIC*)pPacket)->type);
-    return true;
-}
-
-// A packet came in, compare to see if necessary
-void Instrument::CachedPacket::CheckForReply(void * pPacket)
-{
-    if (m_enSendMode == MT_WAITING_FOR_REPLY)
-    {
-        cbPKT_GENERIC * pIn = static_cast<cbPKT_GENERIC *>(pPacket);
-        cbPKT_GENERIC * pOut = reinterpret_cast<cbPKT_GENERIC *>(m_abyPacket);
-
-/*
-        DEBUG_CODE
-            (
-            // If it is a "hearbeat" packet, then just don't look at it
-            if (pIn->chid == 0x8000 && pIn->type == 0)
-                return;
-
-            TRACE("Incoming Pkt chid: 0x%04X type:  0x%02X,   SENT chid: 0x%04X, type: 0x%02X,  chan: %d\n",
-                     pIn->chid, pIn->type,
-                     pOut->chid, pOut->type,
-                     ((cbPKT_CHANINFO *)(pOut))->chan  );
-
-            );
-*/
-
-        if (pIn->type != (pOut->type & ~0x80))    // mask off the highest bit
-            return;
-
-        if (pIn->chid != pOut->chid)
-            return;
-
-        // If this is a "configuration type packet"
-        // The logic works because Chanset is 0xC0 and all config packets are 0xC?
-        // It will also work out because the 0xD0 family of packets will come in here
-        // and their 1st value is channel.
-        if ((pOut->type & cbPKTTYPE_CHANSET) == cbPKTTYPE_CHANSET)
-        {
-            if (pOut->dlen)
-            {
-                cbPKT_CHANINFO * pChanIn = static_cast<cbPKT_CHANINFO *>(pPacket);
-                cbPKT_CHANINFO * pChanOut = reinterpret_cast<cbPKT_CHANINFO *>(m_abyPacket);
-
-                if (pChanIn->chan != pChanOut->chan)
-                    return;
-            }
-        }
-
-        // If we get this far, then we must have a match
-        m_enSendMode = MT_OK_TO_SEND;
-    }
-}
-
-
-// Called every 10 ms...use for "resending"
-// Outputs:
-//  TRUE if any instrument error has happened; FALSE otherwise
-bool Instrument::CachedPacket::Tick(const UDPSocket & rcUDP)
-{
-    if (m_enSendMode == MT_WAITING_FOR_REPLY)
-    {
-        if (--m_nTickCount <= 0)            // If time to resend
-        {
-            if (--m_nRetryCount > 0)        // If not too many retries
-            {
-                TRACE("********************Resending packet******************* type: 0x%02X\n", ((cbPKT_GENERIC *)m_abyPacket)->type );
-                rcUDP.Send(m_abyPacket, m_cbPacketBytes);
-                m_nTickCount = m_nMaxTickCount;
-            }
-            else
-            {
-                // true means that we have an error here
-                return true;
-            }
-        }
-    }
-    return false;
+    return m_nOutstanding < m_nWindow;
 }
@@ -29,6 +29,9 @@
 #define NSP_IN_PORT         cbNET_UDP_PORT_BCAST // Neuroflow Data Port
 #define NSP_OUT_PORT        cbNET_UDP_PORT_CNT   // Neuroflow Control Port
 #define NSP_REC_BUF_SIZE (4096 * 2048)  // Receiving system buffer size (multiple of 4096)
+#define NSP_REC_BATCH_SIZE  16           // Maximum number of datagrams to receive in one call
+#define NSP_XMT_RATE        400          // Packets per second sent to the instrument
+#define NSP_XMT_BURST       4            // Maximum number of packets sent back to back
 
 class Instrument
 {
@@ -49,7 +52,11 @@ public:
 
     enum { TICK_COUNT = 15 };        // Default number of ticks to wait for a response ( 10ms per tick)
     enum { RESEND_COUNT = 10 };     // Default number of times to "resend" a packet before erroring out.
+    enum { XMT_WINDOW = 6 };        // Default number of packets waiting for a response at once
+    enum { MAX_XMT_WINDOW = 64 };   // Maximum number of packets waiting for a response at once
     void Reset(int nMaxTickCount = TICK_COUNT, int nMaxRetryCount = RESEND_COUNT);
+    void SetWindow(int nWindow);    // How many packets may wait for a response at once
+    INT64 GetRoundTrip() { return m_nSmoothRtt; } // Smoothed response time in nanoseconds (0 if not measured)
 
 
     // Called every 10 ms...use for "resending"
@@ -67,9 +74,13 @@ public:
 
 
 
-    int Recv(void * packet);
+    int Recv(void * packet, INT64 * pStamp = NULL);
+    int RecvBatch(void * buffer, int nCount, int * pSizes, INT64 * pStamps = NULL); // Receive datagrams in slots of cbCER_UDP_SIZE_MAX
+    bool WaitForRecv(int nTimeout); // Wait up to nTimeout milliseconds for incoming data
+    bool SetBusyPoll(int nBusyPoll) {return m_icUDP.SetBusyPoll(nBusyPoll);} // Busy poll the device on receive
 
     int Send(void *ppkt);       // Send this packet out
+    int SendBatch(void * const * ppkts, int nCount); // Send these packets out back to back
 
     // Is it OK to send a new packet out?
     bool OkToSend();
@@ -113,41 +124,44 @@ protected:
     int LoopbackRecvLow(void * pBuffer, void * pPacketData, UINT32 nInstance = 0);
 
 
+    // A packet that was sent out and is waiting for its response
     class CachedPacket
     {
     public:
-        CachedPacket();
-        ModeType GetMode() { return m_enSendMode; }
-
-        void Reset(int nMaxTickCount = TICK_COUNT, int nMaxRetryCount = RESEND_COUNT); // Stop trying to send packets and restart
-        bool AddPacket(void * pPacket, int cbBytes);         // Save this packet, of this size
-        void CheckForReply(void * pPacket);     // A packet came in, compare to see if necessary
+        CachedPacket() : m_enSendMode(MT_OK_TO_SEND), m_nNext(-1) {;}
         bool OkToSend() { return m_enSendMode == MT_OK_TO_SEND; }
 
-
-        // Called every 10 ms...use for "resending"
-        // Outputs:
-        //  TRUE if any instrument error has happened; FALSE otherwise
-        bool Tick(const UDPSocket & rcUDP);
-
-    protected:
-
         ModeType m_enSendMode;          // What is our current send mode?
-
-        int m_nTickCount;               // How many ticks have passed since we sent?
+        UINT64 m_nKey;                  // The response this packet is waiting for
+        INT64 m_nSentTime;              // Monotonic time in nanoseconds the packet was last sent
+        INT64 m_nDeadline;              // Monotonic time in nanoseconds to give up waiting for a response
+        INT64 m_nTimeout;               // How long to wait for a response before resending
         int m_nRetryCount;              // How many times have we re-sent this packet?
-        int m_nMaxTickCount;            // How many ticks to wait for a response ( 10ms per tick)
-        int m_nMaxRetryCount;           // How many times to "resend" a packet before erroring out.
+        int m_nNext;                    // Next packet waiting in the same reply bucket (-1 for none)
 
         // This array MUST be larger than the largest data packet
         char m_abyPacket[2048];         // This is the packet that was sent out.
         int m_cbPacketBytes;            // The size of the most recent packet addition
-
     };
 
-
-    enum { NUM_OF_PACKETS_CACHED = 6 };
-    CachedPacket m_aicCache[NUM_OF_PACKETS_CACHED];
+    // Outstanding packets are found by their response in a hash of buckets,
+    //  packets waiting for the same response are kept in the order they were sent
+    enum { REPLY_BUCKETS = 256 };       // Must be a power of 2, larger than MAX_XMT_WINDOW
+    static UINT64 ReplyKey(UINT8 type, UINT16 chid, const UINT32 * pData, bool bChan);
+    static UINT32 ReplyBucket(UINT64 nKey) { return (UINT32)((nKey * 0x9E3779B97F4A7C15ULL) >> 32) & (REPLY_BUCKETS - 1); }
+    CachedPacket * AddPacket(void * pPacket, int cbBytes, INT64 nNow); // Save this packet, of this size
+    void RemovePacket(CachedPacket * pCache); // Forget about this packet, it is not waiting anymore
+    bool MatchReply(UINT64 nKey); // Match a response to the oldest packet waiting for it
+
+    CachedPacket m_aicCache[MAX_XMT_WINDOW];
+    int m_anReplyBucket[REPLY_BUCKETS]; // First packet waiting in each bucket (-1 for none)
+    int m_nWindow;                  // How many packets may wait for a response at once
+    int m_nOutstanding;             // How many packets are waiting for a response
+    int m_nMaxTickCount;            // How many ticks to wait for a response ( 10ms per tick)
+    int m_nMaxRetryCount;           // How many times to "resend" a packet before erroring out.
+    INT64 m_nSmoothRtt;             // Smoothed response time in nanoseconds (0 if not measured)
+    INT64 m_nRttVar;                // Response time variation in nanoseconds
+    INT64 m_nRto;                   // Current time to wait for a response before resending
 
 private:
     int m_nInPort;
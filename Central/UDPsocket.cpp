@@ -23,6 +23,15 @@ typedef int socklen_t;
 #include <fcntl.h>
 #include <errno.h>
 #include <unistd.h>
+#include <poll.h>
+#include <sys/time.h>
+#ifdef __linux__
+#include <sys/uio.h>
+#include <time.h>
+#endif
+#ifdef __APPLE__
+#include <mach/mach_time.h>
+#endif
 typedef struct sockaddr SOCKADDR;
 #define INVALID_SOCKET -1
 #define SOCKET_ERROR -1
@@ -36,7 +45,7 @@ typedef struct sockaddr SOCKADDR;
 //////////////////////////////////////////////////////////////////////
 
 UDPSocket::UDPSocket() :
-    m_nStartupOptionsFlags(OPT_NONE), m_bVerbose(false)
+    m_nStartupOptionsFlags(OPT_NONE), m_bVerbose(false), m_bTimestamps(false)
 {
     inst_sock = INVALID_SOCKET;
 }
@@ -69,6 +78,7 @@ cbRESULT UDPSocket::Open(STARTUP_OPTIONS nStartupOptionsFlags, int nRange, bool
           int nRecBufSize, int nInPort, int nOutPort, int nPacketSize)
 {
     m_bVerbose = bVerbose;
+    m_bTimestamps = false;
     m_nPacketSize = nPacketSize;
     m_nStartupOptionsFlags = nStartupOptionsFlags;
 
@@ -162,6 +172,17 @@ cbRESULT UDPSocket::Open(STARTUP_OPTIONS nStartupOptionsFlags, int nRange, bool
         }
     }
 
+#ifdef SO_TIMESTAMPNS
+    // Ask the kernel to timestamp datagrams as they arrive,
+    //  if not supported the time they are read is used instead
+    opt_len = sizeof(int);
+    int timestamp_val = 1;
+    if (setsockopt(inst_sock, SOL_SOCKET, SO_TIMESTAMPNS, (char*)&timestamp_val, opt_len) == 0)
+        m_bTimestamps = true;
+    else if (m_bVerbose)
+        _cprintf("Warning: kernel receive timestamps are not available\n");
+#endif
+
     // Attempt to bind Data Stream Socket to lowest address in range 192.168.137.1 to XXX.16
     BOOL socketbound = FALSE;
     SOCKADDR_IN inst_sockaddr;
@@ -267,6 +288,23 @@ void UDPSocket::OutPort(int nOutPort)
     dest_sockaddr.sin_port        = htons(nOutPort);
 }
 
+// Purpose: Ask the kernel to busy poll the network device when receiving, for lower latency
+//           at the cost of CPU time
+// Inputs:
+//   nBusyPoll - microseconds to busy poll for (0 to disable)
+// Outputs:
+//   Returns true if successful, false if not supported or not permitted
+bool UDPSocket::SetBusyPoll(int nBusyPoll)
+{
+#ifdef SO_BUSY_POLL
+    socklen_t opt_len = sizeof(int);
+    if (setsockopt(inst_sock, SOL_SOCKET, SO_BUSY_POLL, (char*)&nBusyPoll, opt_len) == 0)
+        return true;
+    TRACE("Socket busy poll error was %i\n", errno);
+#endif
+    return false;
+}
+
 void UDPSocket::Close()
 {
     shutdown(inst_sock, SD_BOTH); // shutdown communication
@@ -279,12 +317,113 @@ void UDPSocket::Close()
     inst_sock = INVALID_SOCKET;
 }
 
-int UDPSocket::Recv(void * packet) const
+// Purpose: Get the current host time, on the same clock as datagram receive times
+// Outputs:
+//   Returns the time in nanoseconds since epoch
+INT64 UDPSocket::HostTime()
+{
+#ifdef WIN32
+    FILETIME ft;
+    GetSystemTimeAsFileTime(&ft);
+    INT64 t = ((INT64)ft.dwHighDateTime << 32) | ft.dwLowDateTime;
+    // FILETIME counts 100ns intervals since 1601
+    return (t - 116444736000000000LL) * 100;
+#elif defined(__linux__)
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (INT64)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+#else
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (INT64)tv.tv_sec * 1000000000LL + (INT64)tv.tv_usec * 1000;
+#endif
+}
+
+// Purpose: Get the time on a clock that only moves forward, for measuring intervals
+//           (unlike the host time it does not step when the wall clock is set)
+// Outputs:
+//   Returns the time in nanoseconds since an arbitrary start
+INT64 UDPSocket::MonotonicTime()
 {
-    int ret = recv(inst_sock, (char*)packet, m_nPacketSize, 0);
+#ifdef WIN32
+    LARGE_INTEGER freq, count;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&count);
+    // Split the conversion so that it does not overflow
+    return (count.QuadPart / freq.QuadPart) * 1000000000LL + ((count.QuadPart % freq.QuadPart) * 1000000000LL) / freq.QuadPart;
+#elif defined(__APPLE__)
+    static mach_timebase_info_data_t timebase;
+    if (timebase.denom == 0)
+        mach_timebase_info(&timebase);
+    return (INT64)(mach_absolute_time() * timebase.numer / timebase.denom);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (INT64)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+#endif
+}
+
+#ifdef SO_TIMESTAMPNS
+// Size of control message buffer to hold a datagram timestamp
+#define TIMESTAMP_CMSG_SIZE CMSG_SPACE(sizeof(struct timespec))
+
+// Purpose: Find the kernel receive timestamp of a datagram
+// Inputs:
+//   pMsg - the message header the datagram is received with
+// Outputs:
+//   Returns the time in nanoseconds since epoch, 0 if not found
+static INT64 GetKernelStamp(struct msghdr * pMsg)
+{
+    for (struct cmsghdr * pCmsg = CMSG_FIRSTHDR(pMsg); pCmsg != NULL; pCmsg = CMSG_NXTHDR(pMsg, pCmsg))
+    {
+        if (pCmsg->cmsg_level == SOL_SOCKET && pCmsg->cmsg_type == SCM_TIMESTAMPNS)
+        {
+            struct timespec ts;
+            memcpy(&ts, CMSG_DATA(pCmsg), sizeof(ts));
+            return (INT64)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+        }
+    }
+    return 0;
+}
+#endif
+
+// Purpose: Receive one queued datagram
+// Inputs:
+//   packet - where to store the datagram
+// Outputs:
+//   pStamp - (optional) host time in nanoseconds the datagram was received
+//   Returns the size of the datagram (0 if none is queued)
+int UDPSocket::Recv(void * packet, INT64 * pStamp) const
+{
+    int ret;
+#ifdef SO_TIMESTAMPNS
+    if (pStamp && m_bTimestamps)
+    {
+        struct iovec iov;
+        iov.iov_base = packet;
+        iov.iov_len = m_nPacketSize;
+        char control[TIMESTAMP_CMSG_SIZE];
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        ret = recvmsg(inst_sock, &msg, 0);
+        if (ret > 0)
+            *pStamp = GetKernelStamp(&msg);
+    }
+    else
+#endif
+        ret = recv(inst_sock, (char*)packet, m_nPacketSize, 0);
 
     if (ret != SOCKET_ERROR)
+    {
+        // If not stamped by kernel, use the time it is read
+        if (pStamp && ret > 0 && (!m_bTimestamps || *pStamp == 0))
+            *pStamp = HostTime();
         return ret; // This is actual size returned
+    }
     else
     {
         int err = 0;
@@ -303,6 +442,102 @@ int UDPSocket::Recv(void * packet) const
     }
 }
 
+// Purpose: Receive a batch of queued datagrams with as few system calls as possible
+//           Datagram i is stored at buffer + i * nStride, nStride must not be less than packet size
+// Inputs:
+//   buffer  - where to store the datagrams
+//   nStride - the distance in bytes between consecutive datagram slots
+//   nCount  - maximum number of datagrams to receive (up to MAX_RECV_BATCH)
+// Outputs:
+//   pSizes  - the size of each received datagram
+//   pStamps - (optional) host time in nanoseconds each datagram was received
+//   Returns the number of datagrams received (0 if none is queued)
+int UDPSocket::RecvBatch(void * buffer, int nStride, int nCount, int * pSizes, INT64 * pStamps) const
+{
+    if (nCount > MAX_RECV_BATCH)
+        nCount = MAX_RECV_BATCH;
+    if (nCount <= 0)
+        return 0;
+#ifdef __linux__
+    struct mmsghdr msgs[MAX_RECV_BATCH];
+    struct iovec iovecs[MAX_RECV_BATCH];
+    char controls[MAX_RECV_BATCH][TIMESTAMP_CMSG_SIZE];
+    bool bKernelStamps = (pStamps && m_bTimestamps);
+    memset(msgs, 0, nCount * sizeof(msgs[0]));
+    for (int i = 0; i < nCount; ++i)
+    {
+        iovecs[i].iov_base = (char *)buffer + i * nStride;
+        iovecs[i].iov_len = m_nPacketSize;
+        msgs[i].msg_hdr.msg_iov = &iovecs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        if (bKernelStamps)
+        {
+            msgs[i].msg_hdr.msg_control = controls[i];
+            msgs[i].msg_hdr.msg_controllen = TIMESTAMP_CMSG_SIZE;
+        }
+    }
+    // Do not block for more once the first datagram is in
+    int ret = recvmmsg(inst_sock, msgs, nCount, MSG_WAITFORONE, NULL);
+    if (ret == SOCKET_ERROR)
+    {
+        int err = errno;
+        if (err != EAGAIN)
+        {
+            TRACE("Socket Recv error was %i\n", err);
+        }
+        return 0;
+    }
+    INT64 nReadTime = pStamps ? HostTime() : 0;
+    for (int i = 0; i < ret; ++i)
+    {
+        pSizes[i] = msgs[i].msg_len;
+        if (pStamps)
+        {
+            pStamps[i] = bKernelStamps ? GetKernelStamp(&msgs[i].msg_hdr) : 0;
+            // If not stamped by kernel, use the time it is read
+            if (pStamps[i] == 0)
+                pStamps[i] = nReadTime;
+        }
+    }
+    return ret;
+#else
+    // No batched receive on this platform, one packet at a time
+    int nPackets = 0;
+    while (nPackets < nCount)
+    {
+        int ret = Recv((char *)buffer + nPackets * nStride, pStamps ? &pStamps[nPackets] : NULL);
+        if (ret <= 0)
+            break;
+        pSizes[nPackets++] = ret;
+    }
+    return nPackets;
+#endif
+}
+
+// Purpose: Block until a packet is queued to be received
+// Inputs:
+//   nTimeout - maximum time to wait in milliseconds
+// Outputs:
+//   Returns true if a packet is ready to be received, false on timeout or error
+bool UDPSocket::Wait(int nTimeout) const
+{
+#ifdef WIN32
+    fd_set readfds;
+    FD_ZERO(&readfds);
+    FD_SET(inst_sock, &readfds);
+    timeval tv;
+    tv.tv_sec = nTimeout / 1000;
+    tv.tv_usec = (nTimeout % 1000) * 1000;
+    return (select(0, &readfds, NULL, NULL, &tv) > 0);
+#else
+    struct pollfd pfd;
+    pfd.fd = inst_sock;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    return (poll(&pfd, 1, nTimeout) > 0);
+#endif
+}
+
 int UDPSocket::Send(void *ppkt, int cbBytes) const
 {
     int sendRet = sendto(inst_sock, (const char *)ppkt, cbBytes, 0,
@@ -326,3 +561,49 @@ int UDPSocket::Send(void *ppkt, int cbBytes) const
     return sendRet;
 
 }
+
+// Purpose: Send a batch of datagrams in as few system calls as possible
+// Inputs:
+//   ppkts  - the datagrams to send
+//   pSizes - the size of each datagram in bytes
+//   nCount - number of datagrams to send (up to MAX_SEND_BATCH)
+// Outputs:
+//   Returns the number of datagrams sent from the start of the batch
+int UDPSocket::SendBatch(void * const * ppkts, const int * pSizes, int nCount) const
+{
+    if (nCount > MAX_SEND_BATCH)
+        nCount = MAX_SEND_BATCH;
+    if (nCount <= 0)
+        return 0;
+#ifdef __linux__
+    struct mmsghdr msgs[MAX_SEND_BATCH];
+    struct iovec iovecs[MAX_SEND_BATCH];
+    memset(msgs, 0, nCount * sizeof(msgs[0]));
+    for (int i = 0; i < nCount; ++i)
+    {
+        iovecs[i].iov_base = ppkts[i];
+        iovecs[i].iov_len = pSizes[i];
+        msgs[i].msg_hdr.msg_name = (void *)&dest_sockaddr;
+        msgs[i].msg_hdr.msg_namelen = sizeof(dest_sockaddr);
+        msgs[i].msg_hdr.msg_iov = &iovecs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    int ret = sendmmsg(inst_sock, msgs, nCount, 0);
+    if (ret == SOCKET_ERROR)
+    {
+        TRACE("Socket Send error was %i\n", errno);
+        return 0;
+    }
+    return ret;
+#else
+    // No batched send on this platform, one packet at a time
+    int nPackets = 0;
+    while (nPackets < nCount)
+    {
+        if (Send(ppkts[nPackets], pSizes[nPackets]) == SOCKET_ERROR)
+            break;
+        nPackets++;
+    }
+    return nPackets;
+#endif
+}
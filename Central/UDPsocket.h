@@ -57,18 +57,41 @@ public:
 
     SOCKET GetSocket() {return inst_sock;}
 
-    // Receive one packet if queued
-    int Recv(void * packet) const;
+    // Poll the device for nBusyPoll microseconds before giving up on a receive
+    bool SetBusyPoll(int nBusyPoll);
+
+    // Receive one packet if queued, optionally with the time it was received
+    int Recv(void * packet, INT64 * pStamp = NULL) const;
+
+    enum { MAX_RECV_BATCH = 64 }; // Maximum number of datagrams received in one batch
+
+    // Receive up to nCount queued packets, each into its own slot of nStride bytes
+    int RecvBatch(void * buffer, int nStride, int nCount, int * pSizes, INT64 * pStamps = NULL) const;
+
+    // Current host time in nanoseconds since epoch (the clock receive times are based on)
+    static INT64 HostTime();
+
+    // Current time in nanoseconds on a monotonic clock (for timeouts and rates)
+    static INT64 MonotonicTime();
+
+    // Wait up to nTimeout milliseconds for a packet to be queued
+    bool Wait(int nTimeout) const;
 
     // Send this packet, it has cbBytes of length
     int Send(void *ppkt, int cbBytes) const;
 
+    enum { MAX_SEND_BATCH = 64 }; // Maximum number of datagrams sent in one batch
+
+    // Send nCount packets back to back, each with its own length
+    int SendBatch(void * const * ppkts, const int * pSizes, int nCount) const;
+
 protected:
     SOCKET      inst_sock;     // instrument socket for input
     SOCKADDR_IN dest_sockaddr;
     STARTUP_OPTIONS m_nStartupOptionsFlags;
     int m_nPacketSize; // packet size
     bool m_bVerbose;   // verbose output
+    bool m_bTimestamps; // if kernel timestamps datagrams as they arrive
 };
 
 #endif // include guard
@@ -19,9 +19,15 @@
 //
 #include "StdAfx.h"
 #include "InstNetwork.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
 #ifndef WIN32
     #include <semaphore.h>
 #endif
+#ifdef __linux__
+    #include <pthread.h>
+    #include <sched.h>
+#endif
 
 // Keep this after all headers
 #include "compat.h"
@@ -32,19 +38,42 @@ InstNetwork::InstNetwork(STARTUP_OPTIONS startupOption) :
     QThread(), m_nStartupOptionsFlags(startupOption), m_enLOC(LOC_LOW), m_bStandAlone(true),
             m_timerTicks(0), m_timerId(0), m_bDone(false),
             m_nRecentPacketCount(0), m_dataCounter(0), m_nLastNumberOfPacketsReceived(0),
-            m_runlevel(cbRUNLEVEL_SHUTDOWN), m_nIdx(0), m_instInfo(0),
+            m_runlevel(cbRUNLEVEL_SHUTDOWN), m_processor(this),
+            m_nRecvPos(0), m_nProcPos(0), m_nProcIndex(0), m_bProcResync(false), m_bProcParked(false), m_bProcDone(true),
+            m_nProcOverruns(0), m_nRecvDepth(0), m_nRecvStamps(0), m_nProcStamp(0), m_nPacketStamp(0),
+            m_nProcLatencyStamp(0), m_nLatencyCount(0), m_nLatencyMax(0), m_bLatencyReset(false),
+            m_dXmtTokens(0), m_nXmtStamp(0),
+            m_nIdx(0), m_instInfo(0),
             m_nInstance(0), m_nInPort(NSP_IN_PORT), m_nOutPort(NSP_OUT_PORT),
             m_bBroadcast(false), m_bDontRoute(true), m_bNonBlocking(true),
-            m_nRecBufSize(NSP_REC_BUF_SIZE),
+            m_nRecBufSize(NSP_REC_BUF_SIZE), m_nRecBatchSize(NSP_REC_BATCH_SIZE), m_nNetLoop(NET_LOOP_TIMER), m_nBusyPoll(0),
+            m_nXmtRate(NSP_XMT_RATE), m_nXmtBurst(NSP_XMT_BURST),
+            m_nXmtWindow(Instrument::XMT_WINDOW), m_nRecRingLen(0), m_nShmFlags(0), m_nSpkCacheDepth(0), m_bRecvThread(false),
+            m_nNetPriority(QThread::HighPriority), m_nNetAffinity(0),
             m_strInIP(NSP_IN_ADDRESS), m_strOutIP(NSP_OUT_ADDRESS)
 {
 
+    memset(m_nStreamTime, 0, sizeof(m_nStreamTime));
+    memset(m_nLostPackets, 0, sizeof(m_nLostPackets));
+    memset(&m_lastGap, 0, sizeof(m_lastGap));
+    memset(m_nLatencyHist, 0, sizeof(m_nLatencyHist));
     qRegisterMetaType<NetEventType>("NetEventType"); // For QT connect to recognize this type
     qRegisterMetaType<NetCommandType>("NetCommandType"); // For QT connect to recognize this type
     // This should be the last
     moveToThread(this); // The object could not be moved if it had a parent
 }
 
+// Purpose: Make sure shared buffers are written before the position that publishes them is,
+//           and read after
+static inline void MemoryFence()
+{
+#ifdef WIN32
+    MemoryBarrier();
+#else
+    __sync_synchronize();
+#endif
+}
+
 // Author & Date: Ehsan Azar       15 March 2010
 // Purpose: Open the instrument network
 // Inputs:
@@ -99,7 +128,7 @@ void InstNetwork::OnNetCommand(NetCommandType cmd, unsigned int /*code*/)
         // Do nothing
         break;
     case NET_COMMAND_OPEN:
-        start(QThread::HighPriority);
+        start(m_nNetPriority);
         break;
     case NET_COMMAND_CLOSE:
         Close();
@@ -121,6 +150,20 @@ void InstNetwork::OnNetCommand(NetCommandType cmd, unsigned int /*code*/)
 //  pPkt      - pointer to the packet
 void InstNetwork::ProcessIncomingPacket(const cbPKT_GENERIC * const pPkt)
 {
+    // Look for silent drops in the periodic streams (nPlay may jump in time)
+    if (!(m_instInfo & cbINSTINFO_NPLAY))
+    {
+        if (pPkt->chid == 0)
+        {
+            if (pPkt->type > 0 && pPkt->type <= cbMAXGROUPS)
+                CheckForGap(pPkt->type, pPkt->time, cb_cfg_buffer_ptr[m_nIdx]->groupinfo[0][pPkt->type - 1].period);
+        }
+        else if (pPkt->chid == 0x8000 && pPkt->type == cbPKTTYPE_SYSHEARTBEAT)
+        {
+            CheckForGap(0, pPkt->time, cb_cfg_buffer_ptr[m_nIdx]->sysinfo.sysfreq / HEARTBEAT_RATE);
+        }
+    }
+
     // -------- Process some incoming packet here -----------
     // check for configuration class packets
     if (pPkt->chid & 0x8000)
@@ -137,11 +180,19 @@ void InstNetwork::ProcessIncomingPacket(const cbPKT_GENERIC * const pPkt)
                     if (chan > 0 && chan <= cbMAXCHANS)
                     {
                         memcpy(&(cb_cfg_buffer_ptr[m_nIdx]->chaninfo[chan - 1]), pPkt, sizeof(cbPKT_CHANINFO));
+                        ConfigChanged(cbCFGSECT_CHANINFO, &cb_cfg_buffer_ptr[m_nIdx]->generation.chaninfo[chan - 1]);
                         if (pPkt->type == cbPKTTYPE_CHANREP)
                         {
                             // Invalidate the cache
-                            if (chan <= cbNUM_ANALOG_CHANS)
-                                cb_spk_buffer_ptr[m_nIdx]->cache[chan - 1].valid = 0;
+                            cbSPKCACHE * pCache;
+                            if (chan <= cbNUM_ANALOG_CHANS && cbGetSpkCache(chan, &pCache, m_nInstance) == cbRESULT_OK)
+                            {
+                                pCache->seq++;
+                                MemoryFence();
+                                pCache->valid = 0;
+                                MemoryFence();
+                                pCache->seq++;
+                            }
                         }
                     }
                 }
@@ -154,6 +205,7 @@ void InstNetwork::ProcessIncomingPacket(const cbPKT_GENERIC * const pPkt)
                     cbPKT_SYSINFO & rOld = cb_cfg_buffer_ptr[m_nIdx]->sysinfo;
                     // replace our copy with this one
                     rOld = *pNew;
+                    ConfigChanged(cbCFGSECT_SYSINFO);
                 }
                 // Rely on the fact that sysrep must be the last config packet sent via NSP6.04 and upwards
                 if (pPkt->type == cbPKTTYPE_SYSREP)
@@ -188,33 +240,56 @@ void InstNetwork::ProcessIncomingPacket(const cbPKT_GENERIC * const pPkt)
             }
             else if (pPkt->type == cbPKTTYPE_GROUPREP)
             {
-                if (m_bStandAlone)
-                    memcpy(&(cb_cfg_buffer_ptr[m_nIdx]->groupinfo[0][((cbPKT_GROUPINFO*)pPkt)->group-1]), pPkt, sizeof(cbPKT_GROUPINFO));
+                // Group period may have changed, start over
+                UINT32 group = ((cbPKT_GROUPINFO*)pPkt)->group;
+                if (group > 0 && group <= cbMAXGROUPS)
+                    m_nStreamTime[group] = 0;
+                if (m_bStandAlone && group > 0 && group <= cbMAXGROUPS)
+                {
+                    memcpy(&(cb_cfg_buffer_ptr[m_nIdx]->groupinfo[0][group - 1]), pPkt, sizeof(cbPKT_GROUPINFO));
+                    ConfigChanged(cbCFGSECT_GROUPINFO, &cb_cfg_buffer_ptr[m_nIdx]->generation.groupinfo[group - 1]);
+                }
             }
             else if (pPkt->type == cbPKTTYPE_FILTREP)
             {
-                if (m_bStandAlone)
-                    memcpy(&(cb_cfg_buffer_ptr[m_nIdx]->filtinfo[0][((cbPKT_FILTINFO*)pPkt)->filt-1]), pPkt, sizeof(cbPKT_FILTINFO));
+                UINT32 filt = ((cbPKT_FILTINFO*)pPkt)->filt;
+                if (m_bStandAlone && filt > 0 && filt <= cbMAXFILTS)
+                {
+                    memcpy(&(cb_cfg_buffer_ptr[m_nIdx]->filtinfo[0][filt - 1]), pPkt, sizeof(cbPKT_FILTINFO));
+                    ConfigChanged(cbCFGSECT_FILTINFO, &cb_cfg_buffer_ptr[m_nIdx]->generation.filtinfo[filt - 1]);
+                }
             }
             else if (pPkt->type == cbPKTTYPE_PROCREP)
             {
                 if (m_bStandAlone)
+                {
                     memcpy(&(cb_cfg_buffer_ptr[m_nIdx]->procinfo[0]), pPkt, sizeof(cbPKT_PROCINFO));
+                    ConfigChanged(cbCFGSECT_PROCINFO);
+                }
             }
             else if (pPkt->type == cbPKTTYPE_BANKREP)
             {
                 if (m_bStandAlone)
+                {
                     memcpy(&(cb_cfg_buffer_ptr[m_nIdx]->bankinfo[0][((cbPKT_BANKINFO*)pPkt)->bank-1]), pPkt, sizeof(cbPKT_BANKINFO));
+                    ConfigChanged(cbCFGSECT_BANKINFO);
+                }
             }
             else if (pPkt->type == cbPKTTYPE_ADAPTFILTREP)
             {
                 if (m_bStandAlone)
+                {
                     cb_cfg_buffer_ptr[m_nIdx]->adaptinfo = *reinterpret_cast<const cbPKT_ADAPTFILTINFO *>(pPkt);
+                    ConfigChanged(cbCFGSECT_ADAPTINFO);
+                }
             }
             else if (pPkt->type == cbPKTTYPE_REFELECFILTREP)
             {
                 if (m_bStandAlone)
+                {
                     cb_cfg_buffer_ptr[m_nIdx]->refelecinfo = *reinterpret_cast<const cbPKT_REFELECFILTINFO *>(pPkt);
+                    ConfigChanged(cbCFGSECT_REFELECINFO);
+                }
             }
             else if (pPkt->type == cbPKTTYPE_SS_MODELREP)
             {
@@ -222,6 +297,7 @@ void InstNetwork::ProcessIncomingPacket(const cbPKT_GENERIC * const pPkt)
                 {
                     cbPKT_SS_MODELSET rNew = *reinterpret_cast<const cbPKT_SS_MODELSET*>(pPkt);
                     UpdateSortModel(rNew);
+                    ConfigChanged(cbCFGSECT_SORTING);
                 }
             }
             else if (pPkt->type == cbPKTTYPE_SS_STATUSREP)
@@ -231,6 +307,7 @@ void InstNetwork::ProcessIncomingPacket(const cbPKT_GENERIC * const pPkt)
                     cbPKT_SS_STATUS rNew = *reinterpret_cast<const cbPKT_SS_STATUS*>(pPkt);
                     cbPKT_SS_STATUS & rOld = cb_cfg_buffer_ptr[m_nIdx]->isSortingOptions.pktStatus;
                     rOld = rNew;
+                    ConfigChanged(cbCFGSECT_SORTING);
                 }
             }
             else if (pPkt->type == cbPKTTYPE_SS_DETECTREP)
@@ -241,6 +318,7 @@ void InstNetwork::ProcessIncomingPacket(const cbPKT_GENERIC * const pPkt)
                     cbPKT_SS_DETECT rNew = *reinterpret_cast<const cbPKT_SS_DETECT*>(pPkt);
                     cbPKT_SS_DETECT & rOld = cb_cfg_buffer_ptr[m_nIdx]->isSortingOptions.pktDetect;
                     rOld = rNew;
+                    ConfigChanged(cbCFGSECT_SORTING);
                 }
             }
             else if (pPkt->type == cbPKTTYPE_SS_ARTIF_REJECTREP)
@@ -251,6 +329,7 @@ void InstNetwork::ProcessIncomingPacket(const cbPKT_GENERIC * const pPkt)
                     cbPKT_SS_ARTIF_REJECT rNew = *reinterpret_cast<const cbPKT_SS_ARTIF_REJECT*>(pPkt);
                     cbPKT_SS_ARTIF_REJECT & rOld = cb_cfg_buffer_ptr[m_nIdx]->isSortingOptions.pktArtifReject;
                     rOld = rNew;
+                    ConfigChanged(cbCFGSECT_SORTING);
                 }
             }
             else if (pPkt->type == cbPKTTYPE_SS_NOISE_BOUNDARYREP)
@@ -261,6 +340,7 @@ void InstNetwork::ProcessIncomingPacket(const cbPKT_GENERIC * const pPkt)
                     cbPKT_SS_NOISE_BOUNDARY rNew = *reinterpret_cast<const cbPKT_SS_NOISE_BOUNDARY*>(pPkt);
                     cbPKT_SS_NOISE_BOUNDARY & rOld = cb_cfg_buffer_ptr[m_nIdx]->isSortingOptions.pktNoiseBoundary[rNew.chan - 1];
                     rOld = rNew;
+                    ConfigChanged(cbCFGSECT_SORTING);
                 }
             }
             else if (pPkt->type == cbPKTTYPE_SS_STATISTICSREP)
@@ -271,6 +351,7 @@ void InstNetwork::ProcessIncomingPacket(const cbPKT_GENERIC * const pPkt)
                     cbPKT_SS_STATISTICS rNew = *reinterpret_cast<const cbPKT_SS_STATISTICS*>(pPkt);
                     cbPKT_SS_STATISTICS & rOld = cb_cfg_buffer_ptr[m_nIdx]->isSortingOptions.pktStatistics;
                     rOld = rNew;
+                    ConfigChanged(cbCFGSECT_SORTING);
                 }
             }
             else if (pPkt->type == cbPKTTYPE_FS_BASISREP)
@@ -279,12 +360,16 @@ void InstNetwork::ProcessIncomingPacket(const cbPKT_GENERIC * const pPkt)
                 {
                     cbPKT_FS_BASIS rPkt = *reinterpret_cast<const cbPKT_FS_BASIS*>(pPkt);
                     UpdateBasisModel(rPkt);
+                    ConfigChanged(cbCFGSECT_SORTING);
                 }
             }
             else if (pPkt->type == cbPKTTYPE_LNCREP)
             {
                 if (m_bStandAlone)
+                {
                     memcpy(&(cb_cfg_buffer_ptr[m_nIdx]->isLnc), pPkt, sizeof(cbPKT_LNC));
+                    ConfigChanged(cbCFGSECT_LNC);
+                }
                 // For 6.03 and before, use this packet instead of sysrep for instinfo event
             }
             else if (pPkt->type == cbPKTTYPE_REPFILECFG)
@@ -295,13 +380,17 @@ void InstNetwork::ProcessIncomingPacket(const cbPKT_GENERIC * const pPkt)
                     if (pPktFileCfg->options == cbFILECFG_OPT_REC || pPktFileCfg->options == cbFILECFG_OPT_STOP)
                     {
                         cb_cfg_buffer_ptr[m_nIdx]->fileinfo = * reinterpret_cast<const cbPKT_FILECFG *>(pPkt);
+                        ConfigChanged(cbCFGSECT_FILECFG);
                     }
                 }
             }
             else if (pPkt->type == cbPKTTYPE_REPNTRODEINFO)
             {
                 if (m_bStandAlone)
+                {
                     memcpy(&(cb_cfg_buffer_ptr[m_nIdx]->isLnc), pPkt, sizeof(cbPKT_LNC));
+                    ConfigChanged(cbCFGSECT_LNC);
+                }
             }
             else if (pPkt->type == cbPKTTYPE_NMREP)
             {
@@ -316,6 +405,7 @@ void InstNetwork::ProcessIncomingPacket(const cbPKT_GENERIC * const pPkt)
                             memcpy(cb_cfg_buffer_ptr[m_nIdx]->isVideoSource[pPktNm->flags - 1].name, pPktNm->name, cbLEN_STR_LABEL);
                             cb_cfg_buffer_ptr[m_nIdx]->isVideoSource[pPktNm->flags - 1].fps = ((float)pPktNm->value) / 1000;
                             // fps>0 means valid video source
+                            ConfigChanged(cbCFGSECT_NM);
                         }
                     }
                     // trackable object to go to the file header
@@ -327,6 +417,7 @@ void InstNetwork::ProcessIncomingPacket(const cbPKT_GENERIC * const pPkt)
                             cb_cfg_buffer_ptr[m_nIdx]->isTrackObj[pPktNm->flags - 1].type = (UINT16)(pPktNm->value & 0xff);
                             cb_cfg_buffer_ptr[m_nIdx]->isTrackObj[pPktNm->flags - 1].pointCount = (UINT16)((pPktNm->value >> 16) & 0xff);
                             // type>0 means valid trackable
+                            ConfigChanged(cbCFGSECT_NM);
                         }
                     }
                     // nullify all tracking upon NM exit
@@ -334,6 +425,7 @@ void InstNetwork::ProcessIncomingPacket(const cbPKT_GENERIC * const pPkt)
                     {
                         memset(cb_cfg_buffer_ptr[m_nIdx]->isTrackObj, 0, sizeof(cb_cfg_buffer_ptr[m_nIdx]->isTrackObj));
                         memset(cb_cfg_buffer_ptr[m_nIdx]->isVideoSource, 0, sizeof(cb_cfg_buffer_ptr[m_nIdx]->isVideoSource));
+                        ConfigChanged(cbCFGSECT_NM);
                     }
                 }
             }
@@ -350,7 +442,10 @@ void InstNetwork::ProcessIncomingPacket(const cbPKT_GENERIC * const pPkt)
                         {
                             UINT8 trigNum = pPktAoutWave->trigNum;
                             if (trigNum < cbMAX_AOUT_TRIGGER)
+                            {
                                 cb_cfg_buffer_ptr[m_nIdx]->isWaveform[nChan][trigNum] = *pPktAoutWave;
+                                ConfigChanged(cbCFGSECT_WAVEFORM);
+                            }
                         }
                     }
                 }
@@ -366,6 +461,7 @@ void InstNetwork::ProcessIncomingPacket(const cbPKT_GENERIC * const pPkt)
                         cbPKT_NPLAY & rOld = cb_cfg_buffer_ptr[m_nIdx]->isNPlay;
                         // replace our copy with this one
                         rOld = *pNew;
+                        ConfigChanged(cbCFGSECT_NPLAY);
                     }
                 }
             }
@@ -375,18 +471,26 @@ void InstNetwork::ProcessIncomingPacket(const cbPKT_GENERIC * const pPkt)
     {
         if (m_bStandAlone)
         {
+            cbSPKCACHE * pCache;
+            cbGetSpkCache(pPkt->chid, &pCache, m_nInstance);
+            // readers see the line is changing until seq is even again
+            pCache->seq++;
+            MemoryFence();
+
             // post the packet to the cache buffer
-            memcpy( &(cb_spk_buffer_ptr[m_nIdx]->cache[pPkt->chid - 1].spkpkt[cb_spk_buffer_ptr[m_nIdx]->cache[pPkt->chid - 1].head]),
-                pPkt, (pPkt->dlen + cbPKT_HEADER_32SIZE) * 4);
+            memcpy(&(pCache->spkpkt[pCache->head]), pPkt, (pPkt->dlen + cbPKT_HEADER_32SIZE) * 4);
 
             // increment the valid pointer
-            cb_spk_buffer_ptr[m_nIdx]->cache[pPkt->chid - 1].valid++;
+            pCache->valid++;
 
             // increment the head pointer of the packet and check for wraparound
-            UINT32 head = cb_spk_buffer_ptr[m_nIdx]->cache[(pPkt->chid)-1].head + 1;
-            if (head >= cbPKT_SPKCACHEPKTCNT)
+            UINT32 head = pCache->head + 1;
+            if (head >= pCache->pktcnt)
                 head = 0;
-            cb_spk_buffer_ptr[m_nIdx]->cache[pPkt->chid - 1].head = head;
+            pCache->head = head;
+
+            MemoryFence();
+            pCache->seq++;
         }
     }
 
@@ -427,6 +531,23 @@ inline void InstNetwork::UpdateBasisModel(const cbPKT_FS_BASIS & rBasisModel)
         cb_cfg_buffer_ptr[m_nIdx]->isSortingOptions.asBasis[nChan] = rBasisModel;
 }
 
+// Purpose: Count a change to the configuration buffer, after the change is made
+// Inputs:
+//  nSection - the section that changed (cbCFGSECT_*)
+//  pEntry   - generation counter of the channel, group or filter that changed (NULL if none)
+inline void InstNetwork::ConfigChanged(UINT32 nSection, UINT32 * pEntry)
+{
+    cbCFGGENERATION & rGen = cb_cfg_buffer_ptr[m_nIdx]->generation;
+    UINT32 nGeneration = rGen.generation + 1;
+    // The change and the entries are visible before the generation, so readers may see a change twice but never miss it
+    MemoryFence();
+    rGen.section[nSection] = nGeneration;
+    if (pEntry)
+        *pEntry = nGeneration;
+    MemoryFence();
+    rGen.generation = nGeneration;
+}
+
 /////////////////////////////////////////////////////////////////////////////
 // Author & Date:   Kirk Korver     07 Jan 2003
 // Purpose: do any processing necessary to test for link failure (i.e. wire disconnected)
@@ -449,6 +570,389 @@ inline void InstNetwork::CheckForLinkFailure(UINT32 nTicks, UINT32 nCurrentPacke
     }
 }
 
+// Purpose: Check a periodic stream for missing packets, and report any gap found
+// Inputs:
+//  nStream - the stream (0 for heartbeats, otherwise the sample group)
+//  nTime   - the time of the packet just received in the stream
+//  nPeriod - the expected time between packets of the stream (0 if unknown)
+inline void InstNetwork::CheckForGap(UINT32 nStream, UINT32 nTime, UINT32 nPeriod)
+{
+    UINT32 nLastTime = m_nStreamTime[nStream];
+    m_nStreamTime[nStream] = nTime;
+    // If first packet or instrument is reset
+    if (nLastTime == 0 || nPeriod == 0 || (INT32)(nTime - nLastTime) <= 0)
+        return;
+    // Allow for half a period of jitter
+    UINT32 nLost = (nTime - nLastTime + nPeriod / 2) / nPeriod;
+    if (nLost < 2)
+        return;
+    nLost--;
+    m_nLostPackets[nStream] += nLost;
+    m_gapMutex.lock();
+    m_lastGap.nStream = nStream;
+    m_lastGap.nLost = nLost;
+    m_lastGap.nTime = nLastTime;
+    m_lastGap.nNextTime = nTime;
+    m_gapMutex.unlock();
+    InstNetworkEvent(NET_EVENT_PKTGAP, nLost);
+}
+
+// Purpose: Get the last gap found in a periodic stream
+// Outputs:
+//   Returns a copy of the gap, it may be found by the processing thread while read
+InstNetwork::PacketGap InstNetwork::getLastGap()
+{
+    m_gapMutex.lock();
+    PacketGap gap = m_lastGap;
+    m_gapMutex.unlock();
+    return gap;
+}
+
+// Purpose: Record how long after it was received a datagram is processed
+// Inputs:
+//  nStamp - host time in nanoseconds the datagram was received
+inline void InstNetwork::RecordLatency(INT64 nStamp)
+{
+    if (m_bLatencyReset)
+    {
+        memset(m_nLatencyHist, 0, sizeof(m_nLatencyHist));
+        m_nLatencyCount = 0;
+        m_nLatencyMax = 0;
+        m_bLatencyReset = false;
+    }
+    INT64 nLatency = (UDPSocket::HostTime() - nStamp) / 1000;
+    if (nLatency < 0)
+        nLatency = 0;
+    UINT32 nBucket;
+    if (nLatency < LATENCY_FINE_BUCKETS)
+        nBucket = (UINT32)nLatency;
+    else
+        nBucket = (UINT32)min((INT64)(LATENCY_FINE_BUCKETS + LATENCY_COARSE_BUCKETS - 1),
+                              LATENCY_FINE_BUCKETS + nLatency / 1000 - 1);
+    m_nLatencyHist[nBucket]++;
+    m_nLatencyCount++;
+    if (nLatency > m_nLatencyMax)
+        m_nLatencyMax = (UINT32)min(nLatency, (INT64)0xFFFFFFFF);
+}
+
+// Purpose: Get a percentile of the receive to process latency
+// Inputs:
+//  dPercent - the percentile (0 to 100)
+// Outputs:
+//  Returns the upper bound of the latency bucket in microseconds, 0 if nothing is recorded yet
+UINT32 InstNetwork::getLatencyPercentile(double dPercent)
+{
+    UINT32 nCount = m_nLatencyCount;
+    if (nCount == 0)
+        return 0;
+    UINT32 nTarget = (UINT32)(nCount * dPercent / 100.0 + 0.5);
+    if (nTarget == 0)
+        nTarget = 1;
+    UINT32 nSum = 0;
+    for (UINT32 i = 0; i < LATENCY_FINE_BUCKETS + LATENCY_COARSE_BUCKETS; ++i)
+    {
+        nSum += m_nLatencyHist[i];
+        if (nSum >= nTarget)
+        {
+            if (i < LATENCY_FINE_BUCKETS)
+                return i + 1;
+            return (i - LATENCY_FINE_BUCKETS + 2) * 1000;
+        }
+    }
+    return m_nLatencyMax;
+}
+
+// Purpose: Keep the position of the packet at the head of the receive buffer in the ring of its channel or group
+// Inputs:
+//   pPkt - the packet
+inline void InstNetwork::IndexPacket(const cbPKT_GENERIC * pPkt)
+{
+    UINT32 nRing;
+    if (pPkt->chid & cbPKTCHAN_CONFIGURATION)
+        nRing = cbINDEX_CONFIG;
+    else if (pPkt->chid == 0)
+    {
+        // Sample group packets
+        if (pPkt->type == 0 || pPkt->type >= cbMAXGROUPS)
+            return;
+        nRing = cbINDEX_GROUP(pPkt->type);
+    }
+    else if (pPkt->chid <= cbMAXCHANS)
+        nRing = cbINDEX_CHAN(pPkt->chid);
+    else
+        return;
+    cbINDEXRING & rRing = cb_index_buffer_ptr[m_nIdx]->ring[nRing];
+    cbINDEXENTRY & rEntry = rRing.entry[rRing.count & (cbINDEXLEN - 1)];
+    rEntry.wrap  = cb_rec_buffer_ptr[m_nIdx]->headwrap;
+    rEntry.index = cb_rec_buffer_ptr[m_nIdx]->headindex;
+    MemoryFence();
+    rRing.count++;
+}
+
+// Purpose: Process the packets of a datagram just received at the head of the receive buffer
+//           and advance the head index past them
+// Inputs:
+//  nBytes          - the datagram size in bytes
+//  bLoopbackPacket - if the datagram was not received from the instrument
+//  nStamp          - host time in nanoseconds the datagram was received
+void InstNetwork::ProcessDatagram(UINT32 nBytes, bool bLoopbackPacket, INT64 nStamp)
+{
+    // get pointer to the first packet in received data block
+    cbPKT_GENERIC *pktptr = (cbPKT_GENERIC*) &(cb_rec_buffer_ptr[m_nIdx]->buffer[cb_rec_buffer_ptr[m_nIdx]->headindex]);
+    UINT32 nRecvPos = m_nRecvPos;
+
+    // keep the receive time for the thread that processes the packets
+    if (m_bRecvThread)
+    {
+        RecvStamp & rStamp = m_recvStamps[m_nRecvStamps % RECV_STAMP_COUNT];
+        rStamp.nPos = nRecvPos;
+        rStamp.nStamp = nStamp;
+    } else {
+        m_nPacketStamp = nStamp;
+        if (!bLoopbackPacket)
+            RecordLatency(nStamp);
+    }
+
+    UINT32 bytes_to_process = nBytes;
+    do {
+        if (bLoopbackPacket)
+        {
+            // Put fake packets in-order
+            pktptr->time = cb_rec_buffer_ptr[m_nIdx]->lasttime;
+        } else {
+            ++m_nRecentPacketCount; // only count the "real" packets, not loopback ones
+            m_icInstrument.TestForReply(pktptr); // loopbacks won't need a "reply"...they are never sent
+        }
+
+        // make sure that the next packet in the data block that we are processing fits.
+        UINT32 quadlettotal = (pktptr->dlen) + 2;
+        UINT32 packetsize = quadlettotal << 2;
+        if (packetsize > bytes_to_process)
+        {
+            // TODO: complain about bad packet
+            break;
+        }
+        // update time index
+        cb_rec_buffer_ptr[m_nIdx]->lasttime = pktptr->time;
+        // let the readers interested in only some channels find the packet
+        if (cb_index_buffer_ptr[m_nIdx])
+            IndexPacket(pktptr);
+        // Do incoming packet process, unless the processing thread does it
+        if (!m_bRecvThread)
+            ProcessIncomingPacket(pktptr);
+
+        // increment packet pointer and subract out the packetsize from the processing counter
+        pktptr = (cbPKT_GENERIC*) (((BYTE*) pktptr) + packetsize);
+        bytes_to_process -= packetsize;
+
+        // Increment head index and check for buffer wraparound.
+        // If the currently processed packet extends at all within the last 1k of the circular
+        // recording buffer, wrap the head pointer around to zero.  This is the same mechanism
+        // that the client applications that read the buffer use to update their tail pointers.
+        cb_rec_buffer_ptr[m_nIdx]->headindex += quadlettotal;
+        nRecvPos += quadlettotal;
+        if (cb_rec_buffer_mirrored[m_nIdx])
+        {
+            // The rest of the datagram is already at the start of the buffer through the mirror
+            if (cb_rec_buffer_ptr[m_nIdx]->headindex >= cb_rec_buffer_ptr[m_nIdx]->bufferlen)
+            {
+                cb_rec_buffer_ptr[m_nIdx]->headwrap++;
+                cb_rec_buffer_ptr[m_nIdx]->headindex -= cb_rec_buffer_ptr[m_nIdx]->bufferlen;
+            }
+        }
+        else if ((cb_rec_buffer_ptr[m_nIdx]->headindex) > (cb_rec_buffer_ptr[m_nIdx]->bufferlen - (cbCER_UDP_SIZE_MAX / 4)))
+        {
+            // the skipped end of the buffer counts toward the position
+            nRecvPos += cb_rec_buffer_ptr[m_nIdx]->bufferlen - cb_rec_buffer_ptr[m_nIdx]->headindex;
+            // rewind the circular buffer head pointer and increment the headwrap count
+            cb_rec_buffer_ptr[m_nIdx]->headwrap++;
+            cb_rec_buffer_ptr[m_nIdx]->headindex = 0;
+
+            // Since multiple Cerebus packets can be contained within a single UDP packet,
+            // a few Cerebus packets may be extended beyond the bound of the currently
+            // processed packet.  These need to be copied (wrapped) around to the beginning
+            // of the circular buffer so that they are not dropped.
+            if (bytes_to_process > 0)
+            {
+                // copy the remaining packet bytes
+                memcpy(&(cb_rec_buffer_ptr[m_nIdx]->buffer[0]), pktptr,
+                        bytes_to_process);
+
+                // wrap the internal packet pointer
+                pktptr = (cbPKT_GENERIC*) &(cb_rec_buffer_ptr[m_nIdx]->buffer[0]);
+            }
+        }
+
+        // increment the packets received and data exchanged counters
+        cb_rec_buffer_ptr[m_nIdx]->received++;
+        m_dataCounter += quadlettotal;
+
+    } while (bytes_to_process); // end do
+
+    // publish the datagram to the processing thread
+    if (m_bRecvThread)
+    {
+        MemoryFence();
+        m_nRecvStamps++;
+    }
+    MemoryFence();
+    m_nRecvPos = nRecvPos;
+}
+
+// Purpose: Process the packets the receive thread has published since last call
+// Outputs:
+//   Returns the number of packets processed
+int InstNetwork::ProcessPackets()
+{
+    // Wait for the receive thread to move the cursor to the head
+    if (m_bProcResync)
+    {
+        MemoryFence();
+        m_bProcParked = true;
+        return 0;
+    }
+    UINT32 nRecvPos = m_nRecvPos;
+    MemoryFence();
+    UINT32 nRecvStamps = m_nRecvStamps;
+    UINT32 nPos = m_nProcPos;
+    // If the receive thread may already be writing over what is not processed yet
+    //  (the batch size is clamped to a quarter of the buffer, so this does not underflow)
+    if (nRecvPos - nPos > cb_rec_buffer_ptr[m_nIdx]->bufferlen - (m_nRecBatchSize + 1) * (cbCER_UDP_SIZE_MAX / 4))
+    {
+        m_bProcResync = true;
+        MemoryFence();
+        m_bProcParked = true;
+        return 0;
+    }
+    int nPackets = 0;
+    while ((INT32)(nRecvPos - nPos) > 0)
+    {
+        // The receive thread found it is overwriting what is not processed yet
+        if (m_bProcResync)
+            break;
+        const cbPKT_GENERIC * pPkt = (const cbPKT_GENERIC *) &(cb_rec_buffer_ptr[m_nIdx]->buffer[m_nProcIndex]);
+        UINT32 quadlettotal = (pPkt->dlen) + 2;
+        // A packet longer than what is left is corrupt, and so is the position of those after it
+        if (quadlettotal > nRecvPos - nPos)
+        {
+            m_bProcResync = true;
+            break;
+        }
+
+        // Find the receive time of the datagram this packet came in
+        if (nRecvStamps - m_nProcStamp > RECV_STAMP_COUNT)
+            m_nProcStamp = nRecvStamps - RECV_STAMP_COUNT;
+        while (nRecvStamps - m_nProcStamp > 1
+               && (INT32)(nPos - m_recvStamps[(m_nProcStamp + 1) % RECV_STAMP_COUNT].nPos) >= 0)
+        {
+            m_nProcStamp++;
+        }
+        m_nPacketStamp = m_recvStamps[m_nProcStamp % RECV_STAMP_COUNT].nStamp;
+        // First packet of a datagram
+        if ((INT32)(m_nProcStamp - m_nProcLatencyStamp) >= 0)
+        {
+            RecordLatency(m_nPacketStamp);
+            m_nProcLatencyStamp = m_nProcStamp + 1;
+        }
+
+        ProcessIncomingPacket(pPkt);
+        nPackets++;
+
+        // Wrap around exactly as the receive thread does
+        m_nProcIndex += quadlettotal;
+        nPos += quadlettotal;
+        if (cb_rec_buffer_mirrored[m_nIdx])
+        {
+            if (m_nProcIndex >= cb_rec_buffer_ptr[m_nIdx]->bufferlen)
+                m_nProcIndex -= cb_rec_buffer_ptr[m_nIdx]->bufferlen;
+        }
+        else if (m_nProcIndex > (cb_rec_buffer_ptr[m_nIdx]->bufferlen - (cbCER_UDP_SIZE_MAX / 4)))
+        {
+            nPos += cb_rec_buffer_ptr[m_nIdx]->bufferlen - m_nProcIndex;
+            m_nProcIndex = 0;
+        }
+        // Every now and then release the processed part of the buffer
+        if ((nPackets % 1024) == 0)
+        {
+            MemoryFence();
+            m_nProcPos = nPos;
+        }
+    }
+    MemoryFence();
+    m_nProcPos = nPos;
+    // Stop here until the receive thread moves the cursor to the head
+    if (m_bProcResync)
+    {
+        MemoryFence();
+        m_bProcParked = true;
+    }
+    return nPackets;
+}
+
+// Purpose: Packet processing thread function,
+//           process packets as the receive thread publishes them
+void InstNetwork::RunProcessLoop()
+{
+    SetThreadAffinity();
+    while (!m_bProcDone)
+    {
+        if (ProcessPackets())
+            continue;
+        m_procMutex.lock();
+        // Check again with the lock held so that no wake up is missed
+        if ((m_nRecvPos == m_nProcPos || m_bProcResync) && !m_bProcDone)
+            m_procWait.wait(&m_procMutex, NET_TICK_PERIOD);
+        m_procMutex.unlock();
+    }
+    // Process what is left over
+    ProcessPackets();
+}
+
+// Purpose: Start the packet processing thread at the head of the receive buffer
+void InstNetwork::StartProcessor()
+{
+    m_nRecvPos = 0;
+    m_nProcPos = 0;
+    m_nProcIndex = cb_rec_buffer_ptr[m_nIdx]->headindex;
+    m_nRecvStamps = 0;
+    m_nProcStamp = 0;
+    m_nProcLatencyStamp = 0;
+    m_nProcOverruns = 0;
+    m_bProcResync = false;
+    m_bProcParked = false;
+    m_bProcDone = false;
+    m_processor.start(m_nNetPriority);
+}
+
+// Purpose: Pin the calling thread to the configured CPUs
+void InstNetwork::SetThreadAffinity()
+{
+    if (m_nNetAffinity == 0)
+        return;
+#ifdef WIN32
+    SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)m_nNetAffinity);
+#elif defined(__linux__)
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    for (int i = 0; i < 64 && i < CPU_SETSIZE; ++i)
+    {
+        if (m_nNetAffinity & ((UINT64)1 << i))
+            CPU_SET(i, &cpuset);
+    }
+    pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset);
+#endif
+}
+
+// Purpose: Stop the packet processing thread and wait for it to finish
+void InstNetwork::StopProcessor()
+{
+    m_bProcDone = true;
+    m_procMutex.lock();
+    m_procWait.wakeAll();
+    m_procMutex.unlock();
+    m_processor.wait();
+}
+
 // Author & Date: Ehsan Azar       15 March 2010
 // Purpose: Networking timer timeout function
 // Inputs:
@@ -456,8 +960,6 @@ inline void InstNetwork::CheckForLinkFailure(UINT32 nTicks, UINT32 nCurrentPacke
 void InstNetwork::timerEvent(QTimerEvent * /*event*/)
 {
     m_timerTicks++; // number of intervals
-    int burstcount = 0;
-    int recv_returned = 0;
     if (m_bDone)
     {
         if (m_timerId)
@@ -468,6 +970,16 @@ void InstNetwork::timerEvent(QTimerEvent * /*event*/)
         quit();
         return;
     }
+    OnHousekeeping();
+    RecvPackets();
+    XmtPackets();
+    SignalReaders();
+}
+
+// Purpose: Periodic stand-alone network work, called every tick
+//           startup sequence, instrument resend and link failure check
+void InstNetwork::OnHousekeeping()
+{
     /////////////////////////////////////////
     // below 5 seconds, call startup routines
     if (m_timerTicks < 500)
@@ -521,141 +1033,217 @@ void InstNetwork::timerEvent(QTimerEvent * /*event*/)
     // Check for link failure because we always have heartbeat packets
     if (!(m_instInfo & cbINSTINFO_NPLAY))
         CheckForLinkFailure(m_timerTicks, cb_rec_buffer_ptr[m_nIdx]->received);
+}
+
+// Purpose: Receive and process the queued datagrams
+// Outputs:
+//   Returns the number of datagrams received
+int InstNetwork::RecvPackets()
+{
+    int burstcount = 0;
+    int recv_returned = 0;
 
     // Process 1024 remaining packets
+    int recv_sizes[UDPSocket::MAX_RECV_BATCH];
+    INT64 recv_stamps[UDPSocket::MAX_RECV_BATCH];
     while (burstcount < 1024)
     {
+        // If processing thread was overrun, once it stopped move it to the head and skip what it missed
+        if (m_bProcResync && m_bProcParked)
+        {
+            MemoryFence();
+            m_nProcIndex = cb_rec_buffer_ptr[m_nIdx]->headindex;
+            m_nProcPos = m_nRecvPos;
+            m_nProcStamp = m_nRecvStamps;
+            m_nProcLatencyStamp = m_nRecvStamps;
+            m_nProcOverruns++;
+            MemoryFence();
+            m_bProcParked = false;
+            m_bProcResync = false;
+            InstNetworkEvent(NET_EVENT_PROCLOST, m_nProcOverruns);
+        }
+
         bool bLoopbackPacket = false;
-        burstcount++;
-        recv_returned = m_icInstrument.Recv(&(cb_rec_buffer_ptr[m_nIdx]->buffer[cb_rec_buffer_ptr[m_nIdx]->headindex]));
-        if (recv_returned <= 0)
+        UINT32 * pHead = &(cb_rec_buffer_ptr[m_nIdx]->buffer[cb_rec_buffer_ptr[m_nIdx]->headindex]);
+        // Datagrams are received in slots of maximum size, so only as many as fit before the ring end
+        //  unless the ring is mirrored
+        int nSlots = m_nRecBatchSize;
+        if (!cb_rec_buffer_mirrored[m_nIdx])
+            nSlots = min(nSlots, (int)((cb_rec_buffer_ptr[m_nIdx]->bufferlen - cb_rec_buffer_ptr[m_nIdx]->headindex) / (cbCER_UDP_SIZE_MAX / 4)));
+        nSlots = min(nSlots, 1024 - burstcount);
+        // Do not write over what the processing thread is yet to process
+        if (m_bRecvThread && !m_bProcResync
+            && m_nRecvPos - m_nProcPos > cb_rec_buffer_ptr[m_nIdx]->bufferlen - (nSlots + 1) * (cbCER_UDP_SIZE_MAX / 4))
         {
-            // If the real instrument doesn't work, then try the fake one
-            recv_returned = m_icInstrument.Recv(&(cb_rec_buffer_ptr[m_nIdx]->buffer[cb_rec_buffer_ptr[m_nIdx]->headindex]));
+            m_bProcResync = true;
+        }
+        // Until the processing thread has stopped it may still be reading the ring (or a listener may hold
+        //  a packet of it), so drain the socket into the scratch slot and drop what comes in instead
+        if (m_bProcResync)
+        {
+            recv_returned = m_icInstrument.Recv(m_recvScratch, recv_stamps);
             if (recv_returned <= 0)
                 break; // No data returned
-            bLoopbackPacket = true;
+            ++m_nRecentPacketCount; // the link is alive, even if the datagram is dropped
+            burstcount++;
+            continue;
         }
-
-        // get pointer to the first packet in received data block
-        cbPKT_GENERIC *pktptr = (cbPKT_GENERIC*) &(cb_rec_buffer_ptr[m_nIdx]->buffer[cb_rec_buffer_ptr[m_nIdx]->headindex]);
-
-        UINT32 bytes_to_process = recv_returned;
-        do {
-            if (bLoopbackPacket)
-            {
-                // Put fake packets in-order
-                pktptr->time = cb_rec_buffer_ptr[m_nIdx]->lasttime;
-            } else {
-                ++m_nRecentPacketCount; // only count the "real" packets, not loopback ones
-                m_icInstrument.TestForReply(pktptr); // loopbacks won't need a "reply"...they are never sent
-            }
-
-            // make sure that the next packet in the data block that we are processing fits.
-            UINT32 quadlettotal = (pktptr->dlen) + 2;
-            UINT32 packetsize = quadlettotal << 2;
-            if (packetsize > bytes_to_process)
-            {
-                // TODO: complain about bad packet
-                break;
-            }
-            // update time index
-            cb_rec_buffer_ptr[m_nIdx]->lasttime = pktptr->time;
-            // Do incoming packet process
-            ProcessIncomingPacket(pktptr);
-
-            // increment packet pointer and subract out the packetsize from the processing counter
-            pktptr = (cbPKT_GENERIC*) (((BYTE*) pktptr) + packetsize);
-            bytes_to_process -= packetsize;
-
-            // Increment head index and check for buffer wraparound.
-            // If the currently processed packet extends at all within the last 1k of the circular
-            // recording buffer, wrap the head pointer around to zero.  This is the same mechanism
-            // that the client applications that read the buffer use to update their tail pointers.
-            cb_rec_buffer_ptr[m_nIdx]->headindex += quadlettotal;
-            if ((cb_rec_buffer_ptr[m_nIdx]->headindex) > (cbRECBUFFLEN - (cbCER_UDP_SIZE_MAX / 4)))
+        int nBatch = 0;
+        if (nSlots > 1)
+        {
+            nBatch = m_icInstrument.RecvBatch(pHead, nSlots, recv_sizes, recv_stamps);
+        } else {
+            recv_returned = m_icInstrument.Recv(pHead, recv_stamps);
+            if (recv_returned > 0)
             {
-                // rewind the circular buffer head pointer and increment the headwrap count
-                cb_rec_buffer_ptr[m_nIdx]->headwrap++;
-                cb_rec_buffer_ptr[m_nIdx]->headindex = 0;
-
-                // Since multiple Cerebus packets can be contained within a single UDP packet,
-                // a few Cerebus packets may be extended beyond the bound of the currently
-                // processed packet.  These need to be copied (wrapped) around to the beginning
-                // of the circular buffer so that they are not dropped.
-                if (bytes_to_process > 0)
-                {
-                    // copy the remaining packet bytes
-                    memcpy(&(cb_rec_buffer_ptr[m_nIdx]->buffer[0]), pktptr,
-                            bytes_to_process);
-
-                    // wrap the internal packet pointer
-                    pktptr = (cbPKT_GENERIC*) &(cb_rec_buffer_ptr[m_nIdx]->buffer[0]);
-                }
+                recv_sizes[0] = recv_returned;
+                nBatch = 1;
             }
+        }
+        if (nBatch <= 0)
+        {
+            // If the real instrument doesn't work, then try the fake one
+            recv_returned = m_icInstrument.Recv(pHead, recv_stamps);
+            if (recv_returned <= 0)
+                break; // No data returned
+            recv_sizes[0] = recv_returned;
+            nBatch = 1;
+            bLoopbackPacket = true;
+        }
+        burstcount += nBatch;
 
-            // increment the packets received and data exchanged counters
-            cb_rec_buffer_ptr[m_nIdx]->received++;
-            m_dataCounter += quadlettotal;
-
-        } while (bytes_to_process); // end do
+        for (int i = 0; i < nBatch; ++i)
+        {
+            // Move each datagram from its slot to right after the previous one
+            UINT32 * pDst = &(cb_rec_buffer_ptr[m_nIdx]->buffer[cb_rec_buffer_ptr[m_nIdx]->headindex]);
+            UINT32 * pSrc = pHead + i * (cbCER_UDP_SIZE_MAX / 4);
+            if (pDst != pSrc)
+                memmove(pDst, pSrc, recv_sizes[i]);
+            ProcessDatagram(recv_sizes[i], bLoopbackPacket, recv_stamps[i]);
+        }
     } // end while (burstcount
     // check for receive errors
     if (recv_returned < 0)
     {
         // Complain
     }
+    m_nRecvDepth = burstcount;
+    // Wake up the processing thread
+    if (m_bRecvThread && burstcount)
+    {
+        m_procMutex.lock();
+        m_procWait.wakeAll();
+        m_procMutex.unlock();
+    }
+    return burstcount;
+}
 
+// Purpose: Send the outgoing packets queued in the global transmit buffer
+void InstNetwork::XmtPackets()
+{
     //////////////////////////////////////////////////////////////////////////////////////////////////////
     // Check for and process outgoing packets
     //
-    // This routine roughly executes every 10ms.  In order to prevent the NSP from being overloaded by
-    // floods of configuration packets, throttle the configuration packets bursts per 10ms.
+    // In order to prevent the NSP from being overloaded by floods of configuration packets, outgoing
+    // packets are paced by a token bucket: tokens accumulate at m_nXmtRate per second up to m_nXmtBurst,
+    // and each packet sent takes one. It appears that sometimes a packet from the PC->NSP will be dropped
+    // if too many are sent at a time, the default (4 packets every 10ms) is known to be safe.
+    // The bucket is refilled on the monotonic clock, so that setting the wall clock does not stall it.
+    INT64 nNow = UDPSocket::MonotonicTime();
+    if (m_nXmtStamp)
     {
-        // UINT nPacketsLeftInBurst = 16;
-        //
-        // The line above was in use for a while. It appears that sometimes a packet from the PC->NSP
-        // will be dropped. By reducing the possible number of packets that can be sent at a time, we
-        // appear to not have this problem any more. The real solution is to ensure that packets are sent
-        UINT nPacketsLeftInBurst = 4;
-
-        cbPKT_GENERIC
-                *xmtpacket =
-                        (cbPKT_GENERIC*) &(cb_xmt_global_buffer_ptr[m_nIdx]->buffer[cb_xmt_global_buffer_ptr[m_nIdx]->tailindex]);
+        m_dXmtTokens += (double)(nNow - m_nXmtStamp) * m_nXmtRate / 1000000000.0;
+        if (m_dXmtTokens > m_nXmtBurst)
+            m_dXmtTokens = m_nXmtBurst;
+    } else {
+        m_dXmtTokens = m_nXmtBurst;
+    }
+    m_nXmtStamp = nNow;
 
-        while ((xmtpacket->time) && (nPacketsLeftInBurst--))
+    cbXMTQUEUE * pXmt = cb_xmt_global_buffer_ptr[m_nIdx];
+    const UINT32 nSlotMask = pXmt->slotcount - 1;
+    while (m_dXmtTokens >= 1.0)
+    {
+        // Gather the queued packets the bucket allows for, in order up to the first slot not handed over yet
+        void * xmtpackets[UDPSocket::MAX_SEND_BATCH];
+        int nPackets = 0;
+        int nTokens = min((int)m_dXmtTokens, (int)UDPSocket::MAX_SEND_BATCH);
+        const UINT32 tailindex = pXmt->tailindex;
+        while (nPackets < nTokens)
         {
-            // find the length of the packet
-            UINT32 quadlettotal = (xmtpacket->dlen) + 2;
+            UINT32 nPos = tailindex + nPackets;
+            cbXMTSLOT * pSlot = &pXmt->slot[nPos & nSlotMask];
+            if (*(volatile UINT32 *)&pSlot->seq != nPos + 1)
+                break;
+            MemoryFence();
+            xmtpackets[nPackets++] = pSlot->packet;
+        }
+        if (nPackets == 0)
+            break;
 
-            if (m_icInstrument.OkToSend() == false)
-                continue;
+        // transmit the packets together, as many as the instrument can wait replies for
+        //  (Instrument::XMT_WINDOW, as many as it always had cache locations for, unless set otherwise)
+        int nSent = m_icInstrument.SendBatch(xmtpackets, nPackets);
+        m_dXmtTokens -= nSent;
 
-            // transmit the packet
-            m_icInstrument.Send(xmtpacket);
+        // complete the packet processing by freeing the slots for the next round
+        for (int i = 0; i < nSent; ++i)
+        {
+            cbPKT_GENERIC * xmtpacket = (cbPKT_GENERIC*) xmtpackets[i];
+            m_dataCounter += (xmtpacket->dlen) + 2;
+            pXmt->slot[(tailindex + i) & nSlotMask].seq = tailindex + i + pXmt->slotcount;
+        }
+        // the writers may take the slots as soon as the tail moves past them
+        MemoryFence();
+        pXmt->transmitted += nSent;
+        pXmt->tailindex = tailindex + nSent;
+        if (nSent < nPackets)
+            break; // Wait for replies (or the socket) before sending more
+    }
+}
 
-            // complete the packet processing by clearing the packet from the xmt buffer
-            memset(xmtpacket, 0, quadlettotal << 2);
-            cb_xmt_global_buffer_ptr[m_nIdx]->transmitted++;
-            cb_xmt_global_buffer_ptr[m_nIdx]->tailindex += quadlettotal;
-            m_dataCounter += quadlettotal;
+// Purpose: Signal the other apps that new data is available
+void InstNetwork::SignalReaders()
+{
+    cbSignalData(m_nInstance);
+}
 
-            if (cb_xmt_global_buffer_ptr[m_nIdx]->tailindex
-                    > cb_xmt_global_buffer_ptr[m_nIdx]->last_valid_index)
+// Purpose: Stand-alone network loop that wakes up as soon as data arrives (or never sleeps if spinning),
+//           while housekeeping still runs on its own periodic deadline
+void InstNetwork::RunEventLoop()
+{
+    QElapsedTimer clock;
+    clock.start();
+    qint64 nextTick = NET_TICK_PERIOD;
+    while (true)
+    {
+        qint64 nWait = nextTick - clock.elapsed();
+        if (nWait > 0)
+        {
+            // Process incoming data as soon as it arrives, spin on the socket if asked to
+            if (m_nNetLoop == NET_LOOP_SPIN || m_icInstrument.WaitForRecv((int)nWait))
             {
-                cb_xmt_global_buffer_ptr[m_nIdx]->tailindex = 0;
+                if (RecvPackets())
+                    SignalReaders();
+                // Replies may have come in, do not wait for the tick to send more
+                XmtPackets();
             }
-
-            // update the local reference pointer
-            xmtpacket = (cbPKT_GENERIC*) &(cb_xmt_global_buffer_ptr[m_nIdx]->buffer[cb_xmt_global_buffer_ptr[m_nIdx]->tailindex]);
+            continue;
         }
+        m_timerTicks++; // number of intervals
+        if (m_bDone)
+            break;
+        OnHousekeeping();
+        RecvPackets();
+        XmtPackets();
+        SignalReaders();
+        // Deliver queued slots, there is no message loop
+        QCoreApplication::processEvents();
+        nextTick += NET_TICK_PERIOD;
+        // If fallen behind do not try to catch up the missed ticks
+        if (nextTick < clock.elapsed())
+            nextTick = clock.elapsed() + NET_TICK_PERIOD;
     }
-    // Signal the other apps that new data is available
-#ifdef WIN32
-    PulseEvent(cb_sig_event_hnd[m_nIdx]);
-#else
-    sem_post((sem_t *)cb_sig_event_hnd[m_nIdx]);
-#endif
 }
 
 // Author & Date: Ehsan Azar       15 March 2010
@@ -664,6 +1252,8 @@ void InstNetwork::run()
 {
     // No instrument yet
     m_instInfo = 0;
+    // Each instance runs on its own CPUs if asked to
+    SetThreadAffinity();
     // Start initializing instrument network
     InstNetworkEvent(NET_EVENT_INIT);
 
@@ -676,23 +1266,35 @@ void InstNetwork::run()
 
     m_nIdx = cb_library_index[m_nInstance];
 
-    if (cbOpen(FALSE, m_nInstance) == cbRESULT_OK)
+    cbRESULT cbClientRet = cbOpen(FALSE, m_nInstance, 0, m_nShmFlags);
+    if (cbClientRet == cbRESULT_OK)
     {
         m_nIdx = cb_library_index[m_nInstance];
         m_bStandAlone = false;
         InstNetworkEvent(NET_EVENT_NETCLIENT); // Client to the Central application
+    } else if (cbClientRet == cbRESULT_BUFVERSIONERR) {
+        // Central is running, but with shared buffers this library cannot read
+        InstNetworkEvent(NET_EVENT_CBERR, cbClientRet); // report cbRESULT
+        return;
     } else { // If Central is not running run as stand alone
         m_bStandAlone = true; // Run stand alone without Central
         // Open the cbhwlib library and create the shared objects
         cbRESULT cbRet;
         // Run as stand-alone application
-        cbRet = cbOpen(TRUE, m_nInstance);
+        cbRet = cbOpen(TRUE, m_nInstance, m_nRecRingLen, m_nShmFlags, m_nSpkCacheDepth);
         if (cbRet)
         {
             InstNetworkEvent(NET_EVENT_CBERR, cbRet); // report cbRESULT
             return;
         }
         m_nIdx = cb_library_index[m_nInstance];
+        // Receive no more datagrams at once than a small part of the ring takes,
+        //  and let the readers know how far past the head index they are written
+        int nRingSlots = (int)(cb_rec_buffer_ptr[m_nIdx]->bufferlen / (cbCER_UDP_SIZE_MAX / 4)) / 4;
+        m_nRecBatchSize = min(m_nRecBatchSize, min(nRingSlots, (int)UDPSocket::MAX_RECV_BATCH));
+        if (m_nRecBatchSize < 1)
+            m_nRecBatchSize = 1;
+        cb_rec_buffer_ptr[m_nIdx]->writeahead = m_nRecBatchSize * (cbCER_UDP_SIZE_MAX / 4);
         InstNetworkEvent(NET_EVENT_NETSTANDALONE); // Stand-alone application
     }
 
@@ -711,6 +1313,7 @@ void InstNetwork::run()
         // Give nPlay and Cereplex more time
         bool bHighLatency = (m_instInfo & (cbINSTINFO_NPLAY | cbINSTINFO_CEREPLEX));
         m_icInstrument.Reset(bHighLatency ? (int)INST_TICK_COUNT : (int)Instrument::TICK_COUNT);
+        m_icInstrument.SetWindow(m_nXmtWindow);
         // Set network connection details
         const QByteArray inIP = m_strInIP.toAscii();
         const QByteArray outIP = m_strOutIP.toAscii();
@@ -724,6 +1327,9 @@ void InstNetwork::run()
             cbClose(m_bStandAlone, m_nInstance); // Close library
             return;
         }
+        // Busy polling is an optimization, go on without it if not permitted
+        if (m_nBusyPoll > 0)
+            m_icInstrument.SetBusyPoll(m_nBusyPoll);
     }
 
     // Reset counters and initial state
@@ -733,6 +1339,9 @@ void InstNetwork::run()
     m_nLastNumberOfPacketsReceived = 0;
     m_runlevel = cbRUNLEVEL_SHUTDOWN;
     m_bDone = false;
+    memset(m_nStreamTime, 0, sizeof(m_nStreamTime));
+    memset(m_nLostPackets, 0, sizeof(m_nLostPackets));
+    m_nXmtStamp = 0; // Transmit pacer starts full
 
     // If stand-alone setup network packet handling timer
     if (m_bStandAlone)
@@ -741,9 +1350,20 @@ void InstNetwork::run()
 #ifdef WIN32
         timeBeginPeriod(1);
 #endif
-        m_timerId = startTimer(10);
-        // Start the message loop
-        exec();
+        // Listeners run in their own thread if asked to
+        if (m_bRecvThread)
+            StartProcessor();
+        if (m_nNetLoop == NET_LOOP_EVENT || m_nNetLoop == NET_LOOP_SPIN)
+        {
+            // Wait (or spin) on the socket instead of the timer
+            RunEventLoop();
+        } else {
+            m_timerId = startTimer(NET_TICK_PERIOD);
+            // Start the message loop
+            exec();
+        }
+        if (m_bRecvThread)
+            StopProcessor();
     } else { // else wait for central application data
         // Instrument info for non-stand-alone
         InstNetworkEvent(NET_EVENT_INSTINFO, m_instInfo);
@@ -788,8 +1408,7 @@ void InstNetwork::run()
 void InstNetwork::OnWaitEvent()
 {
     // Look to see how much there is to process
-    UINT32 pktstogo;
-    cbCheckforData(m_enLOC, &pktstogo, m_nInstance);
+    cbCheckforData(m_enLOC, NULL, m_nInstance);
 
     if (m_enLOC == LOC_CRITICAL)
     {
@@ -797,20 +1416,12 @@ void InstNetwork::OnWaitEvent()
         InstNetworkEvent(NET_EVENT_CRITICAL);
         return;
     }
-    // Limit how many we can look at
-    pktstogo = min(pktstogo, MAX_NUM_OF_PACKETS_TO_PROCESS_PER_PASS);
-
-    // process any available packets
-    for(UINT p = 0; p < pktstogo; ++p)
-    {
-        cbPKT_GENERIC *pktptr = cbGetNextPacketPtr(m_nInstance);
-        if (pktptr == NULL)
-        {
-            cbMakePacketReadingBeginNow(m_nInstance);
-            InstNetworkEvent(NET_EVENT_CRITICAL);
-            break;
-        } else {
-            ProcessIncomingPacket(pktptr);
-        }
-    }
+    // process any available packets, up to how many we can look at
+    cbPacketSpan span;
+    if (cbGetPacketSpan(&span, m_nInstance) != cbRESULT_OK)
+        return;
+    cbPKT_GENERIC *pktptr;
+    while (span.read() < MAX_NUM_OF_PACKETS_TO_PROCESS_PER_PASS && (pktptr = span.next()) != NULL)
+        ProcessIncomingPacket(pktptr);
+    cbCommitPacketSpan(&span, m_nInstance);
 }
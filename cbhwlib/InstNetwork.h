@@ -27,6 +27,8 @@
 #include "cki_common.h"
 #include <QThread>
 #include <QTimer>
+#include <QMutex>
+#include <QWaitCondition>
 #include <QMetaType>
 #include <QVector>
 #include <QString>
@@ -60,6 +62,15 @@ enum NetEventType
     NET_EVENT_CLOSE,            // Instrument closed
     NET_EVENT_RESET,            // Instrument got reset
     NET_EVENT_LOCKEDRESET,      // Locked reset (for recording)
+    NET_EVENT_PKTGAP,           // Packets missing from a periodic stream
+    NET_EVENT_PROCLOST,         // Packets dropped because processing fell behind receiving
+};
+// Stand-alone network loop
+enum NetLoopType
+{
+    NET_LOOP_TIMER = 0,     // Process the network on a periodic timer
+    NET_LOOP_EVENT,         // Wake up as soon as data arrives, housekeeping on its own deadline
+    NET_LOOP_SPIN,          // Spin on the socket without sleeping, housekeeping on its own deadline
 };
 
 // Author & Date: Ehsan Azar       15 March 2010
@@ -77,6 +88,28 @@ public:
         // Callback function to process packets, must be implemented in target class
         virtual void ProcessIncomingPacket(const cbPKT_GENERIC * const pPkt) = 0;
     };
+    // Packets found missing from a periodic stream
+    struct PacketGap
+    {
+        UINT32 nStream;   // 0 for system heartbeats, otherwise the sample group
+        UINT32 nLost;     // number of packets missing
+        UINT32 nTime;     // time of the last packet before the gap
+        UINT32 nNextTime; // time of the first packet after the gap
+    };
+    enum { GAP_STREAM_COUNT = cbMAXGROUPS + 1 }; // Heartbeats and sample groups
+    // Receive to process latency histogram
+    enum { LATENCY_FINE_BUCKETS = 1000 };  // 1 microsecond buckets up to 1 millisecond
+    enum { LATENCY_COARSE_BUCKETS = 100 }; // 1 millisecond buckets after that (last one holds the rest)
+    // Packet processing thread, used when receive thread only fills the receive buffer
+    class Processor : public QThread
+    {
+    public:
+        Processor(InstNetwork * pNetwork) : m_pNetwork(pNetwork) {;}
+    protected:
+        void run() {m_pNetwork->RunProcessLoop();}
+    private:
+        InstNetwork * m_pNetwork;
+    };
 
 public:
     InstNetwork(STARTUP_OPTIONS startupOption = OPT_NONE);
@@ -86,16 +119,43 @@ public:
     bool IsStandAlone() {return m_bStandAlone;} // If running in stand-alone
     UINT32 getPacketCounter() {return m_nRecentPacketCount;}
     UINT32 getDataCounter() {return m_dataCounter;}
+    UINT32 getRecvQueueDepth() {return m_nRecvDepth;} // Datagrams drained from the socket in the last burst
+    UINT32 getProcQueueDepth() {return m_bRecvThread ? m_nRecvPos - m_nProcPos : 0;} // Quadlets received but not yet processed
+    UINT32 getProcOverruns() {return m_nProcOverruns;} // Number of times packets were dropped before processing
+    INT64 getPacketStamp() {return m_nPacketStamp;} // Host time in nanoseconds the packet being processed was received
+    PacketGap getLastGap(); // Last gap found in a periodic stream
+    UINT32 getLostPackets(UINT32 nStream) {return nStream < GAP_STREAM_COUNT ? m_nLostPackets[nStream] : 0;}
+    UINT32 getLatencyCount() {return m_nLatencyCount;} // Number of datagrams latency is measured for
+    UINT32 getLatencyMax() {return m_nLatencyMax;} // Maximum latency in microseconds
+    UINT32 getLatencyPercentile(double dPercent); // Latency percentile in microseconds
+    void resetLatency() {m_bLatencyReset = true;} // Start latency measurement over
 protected:
     enum { INST_TICK_COUNT = 10 };
+    enum { NET_TICK_PERIOD = 10 }; // Stand-alone network tick in milliseconds
+    enum { HEARTBEAT_RATE = 100 }; // System heartbeats per second
     void run();
     void ProcessIncomingPacket(const cbPKT_GENERIC * const pPkt); // Process incoming packets in stand-alone mode
     void timerEvent(QTimerEvent *event); // the QT timer event for stand-alone networking
     void OnWaitEvent(); // Non-stand-alone networking
+    void RunEventLoop(); // Stand-alone networking that waits on the socket
+    void OnHousekeeping(); // Periodic stand-alone network work
+    int RecvPackets(); // Receive and process queued datagrams
+    void XmtPackets(); // Send queued outgoing packets
+    void SignalReaders(); // Signal the other apps that new data is available
     inline void CheckForLinkFailure(UINT32 nTicks, UINT32 nCurrentPacketCount); // Check link failure
+    inline void CheckForGap(UINT32 nStream, UINT32 nTime, UINT32 nPeriod); // Check for packets missing in a stream
+    inline void RecordLatency(INT64 nStamp); // Record latency of a datagram received at given time
+    void ProcessDatagram(UINT32 nBytes, bool bLoopbackPacket, INT64 nStamp); // Process a datagram received at the head of the ring
+    inline void IndexPacket(const cbPKT_GENERIC * pPkt); // Keep the position of the packet at the head of the ring in its index
+    void RunProcessLoop(); // Packet processing thread function
+    int ProcessPackets(); // Process the packets the receive thread has published
+    void StartProcessor(); // Start the packet processing thread
+    void StopProcessor();  // Stop the packet processing thread
+    void SetThreadAffinity(); // Pin the calling thread to the configured CPUs
 private:
     void UpdateSortModel(const cbPKT_SS_MODELSET & rUnitModel);
     void UpdateBasisModel(const cbPKT_FS_BASIS & rBasisModel);
+    inline void ConfigChanged(UINT32 nSection, UINT32 * pEntry = NULL); // Count a change to the configuration
 private:
     static const UINT32 MAX_NUM_OF_PACKETS_TO_PROCESS_PER_PASS = 5000;
     cbLevelOfConcern m_enLOC; // level of concern
@@ -108,6 +168,43 @@ private:
     UINT32 m_dataCounter;        // data counter
     UINT32 m_nLastNumberOfPacketsReceived;
     UINT32 m_runlevel; // Last runlevel
+    UINT32 m_nStreamTime[GAP_STREAM_COUNT];  // time of the last packet in each periodic stream (0 if none)
+    UINT32 m_nLostPackets[GAP_STREAM_COUNT]; // number of packets missing from each periodic stream
+    QMutex m_gapMutex;   // only used to copy the last gap
+    PacketGap m_lastGap; // last gap found
+    // Receive and processing stages share the receive buffer, with the receive thread as the only producer
+    //  and the processing thread as the only consumer. Positions count quadlets (and skipped buffer ends)
+    //  so that their difference is the queue depth regardless of wraparound.
+    Processor m_processor;  // packet processing thread
+    QMutex m_procMutex;     // only used to sleep the processing thread
+    QWaitCondition m_procWait; // wakes up the processing thread
+    volatile UINT32 m_nRecvPos;  // receive stage position (published by receive thread)
+    volatile UINT32 m_nProcPos;  // processing stage position (published by processing thread)
+    UINT32 m_nProcIndex;         // processing stage index in the receive buffer
+    volatile bool m_bProcResync; // processing thread cursor must be moved to the head
+    volatile bool m_bProcParked; // processing thread stopped for its cursor to be moved
+    volatile bool m_bProcDone;   // flag to finish processing thread
+    UINT32 m_nProcOverruns;      // times packets were dropped before the processing stage
+    UINT32 m_nRecvDepth;         // datagrams received in last burst
+    UINT32 m_recvScratch[cbCER_UDP_SIZE_MAX / 4]; // datagrams dropped while the processing thread is moved to the head
+    // Receive time of the datagrams published to the processing thread
+    struct RecvStamp
+    {
+        UINT32 nPos;  // receive stage position of the first packet in the datagram
+        INT64 nStamp; // host time in nanoseconds the datagram was received
+    };
+    enum { RECV_STAMP_COUNT = 16384 };
+    RecvStamp m_recvStamps[RECV_STAMP_COUNT];
+    volatile UINT32 m_nRecvStamps; // number of datagram receive times published
+    UINT32 m_nProcStamp;           // receive time the processing stage is at
+    INT64 m_nPacketStamp;          // receive time of the packet being processed
+    UINT32 m_nProcLatencyStamp;    // next receive time the processing stage records latency for
+    UINT32 m_nLatencyHist[LATENCY_FINE_BUCKETS + LATENCY_COARSE_BUCKETS]; // latency histogram
+    UINT32 m_nLatencyCount;        // number of latencies recorded
+    UINT32 m_nLatencyMax;          // maximum latency in microseconds
+    volatile bool m_bLatencyReset; // latency measurement should start over
+    double m_dXmtTokens; // packets the transmit pacer allows to send now
+    INT64 m_nXmtStamp;   // host time in nanoseconds the transmit pacer was last refilled (0 to start full)
 protected:
     bool m_bStandAlone;  // If it is stand-alone
     Instrument m_icInstrument;   // The instrument
@@ -120,6 +217,18 @@ protected:
     bool m_bDontRoute;
     bool m_bNonBlocking;
     int m_nRecBufSize;
+    int m_nRecBatchSize; // Maximum number of datagrams to receive in one call
+    NetLoopType m_nNetLoop; // Stand-alone network loop
+    int m_nBusyPoll; // Microseconds to busy poll the device on receive (0 to disable)
+    int m_nXmtRate;  // Packets per second sent to the instrument
+    int m_nXmtBurst; // Maximum number of packets sent back to back
+    int m_nXmtWindow; // Maximum number of packets waiting for a response at once
+    UINT32 m_nRecRingLen; // Receive buffer length if stand-alone (units of UINT32, 0 for the default)
+    UINT32 m_nShmFlags; // Shared memory options (cbSHMEM_*)
+    UINT32 m_nSpkCacheDepth; // Spikes cached per channel if stand-alone (0 for the default)
+    bool m_bRecvThread; // If packets are processed in a thread separate from the receive thread
+    QThread::Priority m_nNetPriority; // Network threads priority
+    UINT64 m_nNetAffinity; // Network threads CPU affinity mask (0 for any CPU)
     QString m_strInIP;  // Client IPv4 address
     QString m_strOutIP; // Instrument IPv4 address
 
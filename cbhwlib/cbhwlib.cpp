@@ -33,6 +33,18 @@
     #include <sys/file.h>
     #include <sys/types.h>
     #include <unistd.h>
+    #include <signal.h>
+    #include <errno.h>
+    #include <sys/mman.h>
+#ifdef __linux__
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <stddef.h>
+    #include <sys/vfs.h>
+    #include <sys/socket.h>
+    #include <sys/un.h>
+    #include <poll.h>
+#endif
 #endif
 #endif
 #ifndef _MSC_VER
@@ -45,7 +57,7 @@
 
 
 // forward reference
-cbRESULT CreateSharedObjects(UINT32 nInstance);
+cbRESULT CreateSharedObjects(UINT32 nInstance, UINT32 nRecBufLen, UINT32 nShmFlags, UINT32 nSpkCacheDepth);
 
 
 
@@ -58,7 +70,7 @@ cbRESULT CreateSharedObjects(UINT32 nInstance);
 
 // buffer handles
 HANDLE      cb_xmt_global_buffer_hnd[cbMAXOPEN] = {NULL};       // Transmit queues to send out of this PC
-cbXMTBUFF*  cb_xmt_global_buffer_ptr[cbMAXOPEN] = {NULL};
+cbXMTQUEUE* cb_xmt_global_buffer_ptr[cbMAXOPEN] = {NULL};
 LPCSTR GLOBAL_XMT_NAME = "XmtGlobal";
 HANDLE      cb_xmt_local_buffer_hnd[cbMAXOPEN] = {NULL};        // Transmit queues only for local (this PC) use
 cbXMTBUFF*  cb_xmt_local_buffer_ptr[cbMAXOPEN] = {NULL};
@@ -67,6 +79,7 @@ LPCSTR LOCAL_XMT_NAME = "XmtLocal";
 LPCSTR REC_BUF_NAME = "cbRECbuffer";
 HANDLE      cb_rec_buffer_hnd[cbMAXOPEN] = {NULL};
 cbRECBUFF*  cb_rec_buffer_ptr[cbMAXOPEN] = {NULL};
+UINT32      cb_rec_buffer_mirrored[cbMAXOPEN] = {FALSE};
 LPCSTR CFG_BUF_NAME = "cbCFGbuffer";
 HANDLE      cb_cfg_buffer_hnd[cbMAXOPEN] = {NULL};
 cbCFGBUFF*  cb_cfg_buffer_ptr[cbMAXOPEN] = {NULL};
@@ -76,12 +89,26 @@ cbPcStatus* cb_pc_status_buffer_ptr[cbMAXOPEN] = {NULL};
 LPCSTR SPK_BUF_NAME = "cbSPKbuffer";
 HANDLE      cb_spk_buffer_hnd[cbMAXOPEN] = {NULL};
 cbSPKBUFF*  cb_spk_buffer_ptr[cbMAXOPEN] = {NULL};
+LPCSTR READER_BUF_NAME = "cbREADERbuffer";
+HANDLE      cb_reader_buffer_hnd[cbMAXOPEN] = {NULL};
+cbREADERBUFF* cb_reader_buffer_ptr[cbMAXOPEN] = {NULL};
+static cbREADERCURSOR * cb_reader_cursor[cbMAXOPEN] = {NULL}; // Where this process publishes its read position
+#if defined(QT_APP) && defined(__linux__)
+static int  cb_sig_sock[cbMAXOPEN] = {0};           // Socket to send wakeups from, or to receive them on if a reader
+static bool cb_sig_sock_open[cbMAXOPEN] = {false};  // If there is a wakeup socket
+#endif
+LPCSTR INDEX_BUF_NAME = "cbINDEXbuffer";
+HANDLE      cb_index_buffer_hnd[cbMAXOPEN] = {NULL};
+cbINDEXBUFF* cb_index_buffer_ptr[cbMAXOPEN] = {NULL};
+static UINT32 cb_index_tail[cbMAXOPEN][cbINDEXRINGS];   // Next packet to read of each index ring
 LPCSTR SIG_EVT_NAME = "cbSIGNALevent";
 HANDLE      cb_sig_event_hnd[cbMAXOPEN] = {NULL};
 
 //
 UINT32      cb_library_index[cbMAXOPEN] = {0};
 UINT32      cb_library_initialized[cbMAXOPEN] = {FALSE};
+static LONG cb_library_owner[cbMAXOPEN] = {0};      // instance (plus one) that claimed each slot (0 if free)
+static UINT32 cb_shmem_flags[cbMAXOPEN] = {0};      // shared memory options (cbSHMEM_*) the slot was opened with
 UINT32      cb_recbuff_tailwrap[cbMAXOPEN]  = {0};
 UINT32      cb_recbuff_tailindex[cbMAXOPEN] = {0};
 UINT32      cb_recbuff_processed[cbMAXOPEN] = {0};
@@ -137,6 +164,341 @@ void DestroySharedObject(HANDLE & hMem, void ** ppMem)
     *ppMem = 0;
 }
 
+#if defined(QT_APP) && defined(__linux__)
+// Receive buffer mapped with a mirror of its data right after it
+struct MirrorMap
+{
+    int fd;         // shared memory file descriptor
+    char * base;    // start of the whole mapping (NULL if not mapped)
+    size_t len;     // length of the whole mapping
+    bool bOwner;    // if this process created the shared memory
+    bool bHugeTlb;  // if the shared memory is a file on hugetlbfs, otherwise it is a POSIX shared memory object
+    char szName[64];
+};
+static MirrorMap cb_rec_buffer_mirror[cbMAXOPEN];
+
+#define HUGETLBFS_PATH      "/dev/hugepages"    // where hugetlbfs is normally mounted
+#define HUGETLBFS_MAGIC     0x958458f6          // file system type of hugetlbfs
+#define HUGE_PAGE_ALIGN     (2 * 1024 * 1024)   // alignment that lets transparent huge pages back the data
+
+// Purpose: Map the receive buffer so that its data is mapped twice in a row,
+//           buffer[bufferlen + i] is then buffer[i] and packets running past the end are contiguous
+// Inputs:
+//   fd         - shared memory file descriptor
+//   nPage      - page size of the shared memory
+//   bCreate    - if creating the buffer, otherwise the existing one is opened for read-only operation
+//   nRecBufLen - buffer length to create (units of UINT32), when opening it is found from the buffer size
+//   rMap       - where to keep the mapping
+// Outputs:
+//   Returns the receive buffer, or NULL if it could not be mapped this way
+static cbRECBUFF * MapMirroredRecBuffer(int fd, size_t nPage, bool bCreate, UINT32 nRecBufLen, MirrorMap & rMap)
+{
+    // The header goes at the end of the first page, so that the data starts on a page
+    const size_t nHead = nPage;
+    if (offsetof(cbRECBUFF, buffer) > nHead)
+        return NULL;
+
+    size_t nData = sizeof(UINT32) * nRecBufLen;
+    bool bSized;
+    if (bCreate)
+    {
+        bSized = (nData % nPage) == 0 && (ftruncate(fd, nHead + nData) == 0);
+    } else {
+        struct stat st;
+        bSized = (fstat(fd, &st) == 0 && (size_t)st.st_size > nHead);
+        if (bSized)
+        {
+            nData = st.st_size - nHead;
+            bSized = (nData % nPage) == 0;
+        }
+    }
+    if (!bSized)
+        return NULL;
+
+    // Reserve the address space for both views, then map the data again right after itself.
+    //  The start is aligned so that the data can be backed by huge pages.
+    const size_t nAlign = nPage > HUGE_PAGE_ALIGN ? nPage : HUGE_PAGE_ALIGN;
+    const size_t nLen = nHead + 2 * nData + nAlign;
+    int prot = bCreate ? (PROT_READ | PROT_WRITE) : PROT_READ;
+    char * reserved = (char *)mmap(NULL, nLen, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (reserved == MAP_FAILED)
+        return NULL;
+    char * base = reserved + (nAlign - ((size_t)reserved % nAlign)) % nAlign;
+    if (mmap(base, nHead + nData, prot, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED
+        || mmap(base + nHead + nData, nData, prot, MAP_SHARED | MAP_FIXED, fd, nHead) == MAP_FAILED)
+    {
+        munmap(reserved, nLen);
+        return NULL;
+    }
+    cbRECBUFF * pRecBuff = (cbRECBUFF *)(base + nHead - offsetof(cbRECBUFF, buffer));
+    // The length in the header must be what is mirrored
+    if (!bCreate && sizeof(UINT32) * pRecBuff->bufferlen != nData)
+    {
+        munmap(reserved, nLen);
+        return NULL;
+    }
+    rMap.base = reserved;
+    rMap.len = nLen;
+    return pRecBuff;
+}
+
+// Purpose: Create or open the mirrored receive buffer, on huge pages if asked for and available
+// Inputs:
+//   szName     - buffer name
+//   bCreate    - if should create the buffer, otherwise open the existing one for read-only operation
+//   nRecBufLen - buffer length to create (units of UINT32)
+//   nShmFlags  - shared memory options (cbSHMEM_*)
+//   rMap       - where to keep the mapping
+// Outputs:
+//   Returns the receive buffer, or NULL if it could not be mapped this way
+static cbRECBUFF * OpenMirroredRecBuffer(LPCSTR szName, bool bCreate, UINT32 nRecBufLen, UINT32 nShmFlags, MirrorMap & rMap)
+{
+    char szHuge[64] = {0};
+    char szShm[64] = {0};
+    _snprintf(szHuge, sizeof(szHuge), "%s/%s", HUGETLBFS_PATH, szName);
+    _snprintf(szShm, sizeof(szShm), "/%s", szName);
+    cbRECBUFF * pRecBuff = NULL;
+
+    // Readers always look on hugetlbfs first, because that is where the buffer is if it has huge pages
+    if (!bCreate || (nShmFlags & cbSHMEM_HUGEPAGES))
+    {
+        int fd = open(szHuge, bCreate ? (O_RDWR | O_CREAT) : O_RDONLY, 0666);
+        if (fd >= 0)
+        {
+            struct statfs sfs;
+            if (fstatfs(fd, &sfs) == 0 && (UINT32)sfs.f_type == HUGETLBFS_MAGIC)
+                pRecBuff = MapMirroredRecBuffer(fd, sfs.f_bsize, bCreate, nRecBufLen, rMap);
+            if (pRecBuff == NULL)
+            {
+                // Not enough huge pages reserved (or a length that is not a multiple of them)
+                close(fd);
+                if (bCreate)
+                    unlink(szHuge);
+            } else {
+                rMap.fd = fd;
+                rMap.bHugeTlb = true;
+                strncpy(rMap.szName, szHuge, sizeof(rMap.szName));
+            }
+        }
+    } else {
+        // A stale buffer left on hugetlbfs would be found by the readers first
+        unlink(szHuge);
+    }
+
+    if (pRecBuff == NULL)
+    {
+        int fd = shm_open(szShm, bCreate ? (O_RDWR | O_CREAT) : O_RDONLY, 0666);
+        if (fd < 0)
+            return NULL;
+        pRecBuff = MapMirroredRecBuffer(fd, sysconf(_SC_PAGESIZE), bCreate, nRecBufLen, rMap);
+        if (pRecBuff == NULL)
+        {
+            close(fd);
+            if (bCreate)
+                shm_unlink(szShm);
+            return NULL;
+        }
+        rMap.fd = fd;
+        rMap.bHugeTlb = false;
+        strncpy(rMap.szName, szShm, sizeof(rMap.szName));
+    }
+    else if (bCreate)
+    {
+        shm_unlink(szShm);
+    }
+    rMap.bOwner = bCreate;
+    return pRecBuff;
+}
+
+// Purpose: Remove a mirrored receive buffer that may be left over,
+//           so that readers do not find it when the buffer is not mirrored
+// Inputs:
+//   szName - buffer name
+static void RemoveMirroredRecBuffer(LPCSTR szName)
+{
+    char szPath[64] = {0};
+    _snprintf(szPath, sizeof(szPath), "%s/%s", HUGETLBFS_PATH, szName);
+    unlink(szPath);
+    _snprintf(szPath, sizeof(szPath), "/%s", szName);
+    shm_unlink(szPath);
+}
+
+// Purpose: Release the mirrored receive buffer mapping
+// Inputs:
+//   rMap - the mapping
+static void CloseMirroredRecBuffer(MirrorMap & rMap)
+{
+    if (rMap.base == NULL)
+        return;
+    munmap(rMap.base, rMap.len);
+    close(rMap.fd);
+    if (rMap.bOwner)
+    {
+        if (rMap.bHugeTlb)
+            unlink(rMap.szName);
+        else
+            shm_unlink(rMap.szName);
+    }
+    rMap.base = NULL;
+}
+#endif
+
+// Purpose: Atomically replace a value in shared memory if it has not changed
+// Inputs:
+//   pVal - the value
+//   nOld - what the value is expected to be
+//   nNew - what to replace it with
+// Outputs:
+//   Returns true if the value was replaced
+static bool CompareAndSwap(UINT32 * pVal, UINT32 nOld, UINT32 nNew)
+{
+#ifdef WIN32
+    return InterlockedCompareExchange((LONG volatile *)pVal, (LONG)nNew, (LONG)nOld) == (LONG)nOld;
+#else
+    return __sync_bool_compare_and_swap(pVal, nOld, nNew);
+#endif
+}
+
+// Purpose: Find if a process is still running
+// Inputs:
+//   pid - the process id
+static bool ProcessExists(UINT32 pid)
+{
+#ifdef WIN32
+    HANDLE hProcess = OpenProcess(SYNCHRONIZE, FALSE, pid);
+    if (hProcess == NULL)
+        return false;
+    bool bRunning = (WaitForSingleObject(hProcess, 0) == WAIT_TIMEOUT);
+    CloseHandle(hProcess);
+    return bRunning;
+#else
+    return (kill((pid_t)pid, 0) == 0 || errno != ESRCH);
+#endif
+}
+
+// Purpose: Get the id of this process
+static UINT32 CurrentProcessId()
+{
+#ifdef WIN32
+    return GetCurrentProcessId();
+#else
+    return getpid();
+#endif
+}
+
+// Purpose: Claim a slot to publish the read position of this process in
+//           first try free slots, then the slots of readers that are gone without releasing them
+// Inputs:
+//   nIdx - library instance index
+static void ClaimReaderSlot(UINT32 nIdx)
+{
+    cb_reader_cursor[nIdx] = NULL;
+    if (cb_reader_buffer_ptr[nIdx] == NULL)
+        return;
+    UINT32 nPid = CurrentProcessId();
+    for (int nPass = 0; nPass < 2; ++nPass)
+    {
+        for (UINT32 i = 0; i < cbMAXREADERS; ++i)
+        {
+            cbREADERCURSOR * pCursor = &cb_reader_buffer_ptr[nIdx]->reader[i];
+            UINT32 nOwner = pCursor->pid;
+            if (nPass == 0 ? (nOwner != 0) : (nOwner == 0 || ProcessExists(nOwner)))
+                continue;
+            if (CompareAndSwap(&pCursor->pid, nOwner, nPid))
+            {
+                pCursor->overruns = 0;
+                cb_reader_cursor[nIdx] = pCursor;
+                return;
+            }
+        }
+    }
+}
+
+// Purpose: Release the slot this process published its read position in
+// Inputs:
+//   nIdx - library instance index
+static void ReleaseReaderSlot(UINT32 nIdx)
+{
+    cbREADERCURSOR * pCursor = cb_reader_cursor[nIdx];
+    if (pCursor == NULL)
+        return;
+    // Unless it was taken over meanwhile
+    CompareAndSwap(&pCursor->pid, CurrentProcessId(), 0);
+    cb_reader_cursor[nIdx] = NULL;
+}
+
+// Purpose: Publish the read position of this process for the process filling the receive buffer
+// Inputs:
+//   nIdx - library instance index
+static inline void PublishReadPosition(UINT32 nIdx)
+{
+    cbREADERCURSOR * pCursor = cb_reader_cursor[nIdx];
+    if (pCursor == NULL)
+        return;
+    pCursor->tailwrap  = cb_recbuff_tailwrap[nIdx];
+    pCursor->tailindex = cb_recbuff_tailindex[nIdx];
+    pCursor->processed = cb_recbuff_processed[nIdx];
+}
+
+#if defined(QT_APP) && defined(__linux__)
+// Purpose: Get the address of the wakeup socket of a reader slot
+//           The address is in the abstract namespace, so nothing is left behind by a crashed reader
+// Inputs:
+//   nInstance - integer index identifier of library instance
+//   nReader   - reader slot
+//   addr      - where to put the address
+// Outputs:
+//   Returns the address length
+static socklen_t SignalAddress(UINT32 nInstance, UINT32 nReader, sockaddr_un & addr)
+{
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    int len = _snprintf(addr.sun_path + 1, sizeof(addr.sun_path) - 1, "%s%u.%u", SIG_EVT_NAME, nInstance, nReader);
+    return offsetof(sockaddr_un, sun_path) + 1 + len;
+}
+
+// Purpose: Open the wakeup socket of this process
+//           A reader receives its own wakeups on it, so each reader wakes up on every signal,
+//           the process filling the buffers sends them from it
+// Inputs:
+//   nIdx      - library instance index
+//   nInstance - integer index identifier of library instance
+//   bReader   - if opening a reader socket, otherwise the one to send wakeups from
+static void OpenSignalSocket(UINT32 nIdx, UINT32 nInstance, bool bReader)
+{
+    cb_sig_sock_open[nIdx] = false;
+    // Readers without a slot fall back to the shared semaphore
+    if (bReader && cb_reader_cursor[nIdx] == NULL)
+        return;
+    int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return;
+    if (bReader)
+    {
+        sockaddr_un addr;
+        socklen_t len = SignalAddress(nInstance, cb_reader_cursor[nIdx] - cb_reader_buffer_ptr[nIdx]->reader, addr);
+        if (bind(fd, (sockaddr *)&addr, len) != 0)
+        {
+            close(fd);
+            return;
+        }
+    }
+    cb_sig_sock[nIdx] = fd;
+    cb_sig_sock_open[nIdx] = true;
+}
+
+// Purpose: Close the wakeup socket of this process
+// Inputs:
+//   nIdx - library instance index
+static void CloseSignalSocket(UINT32 nIdx)
+{
+    if (!cb_sig_sock_open[nIdx])
+        return;
+    close(cb_sig_sock[nIdx]);
+    cb_sig_sock_open[nIdx] = false;
+}
+#endif
+
 // Author & Date:       Almut Branner         28 Mar 2006
 // Purpose: Release and clear the shared memory objects
 // Inputs:
@@ -170,6 +532,9 @@ void DestroySharedObjects(BOOL bStandAlone, UINT32 nInstance)
             sem_unlink(buf);
         }
     }
+#if defined(QT_APP) && defined(__linux__)
+    CloseSignalSocket(nIdx);
+#endif
 #endif
 
     // release the shared pc status memory space
@@ -187,7 +552,22 @@ void DestroySharedObjects(BOOL bStandAlone, UINT32 nInstance)
     // release the shared local transmit memory space
     DestroySharedObject(cb_xmt_local_buffer_hnd[nIdx], (void **)&cb_xmt_local_buffer_ptr[nIdx]);
 
+    // release the reader positions
+    ReleaseReaderSlot(nIdx);
+    DestroySharedObject(cb_reader_buffer_hnd[nIdx], (void **)&cb_reader_buffer_ptr[nIdx]);
+
+    // release the packet index
+    DestroySharedObject(cb_index_buffer_hnd[nIdx], (void **)&cb_index_buffer_ptr[nIdx]);
+
     // release the shared receive memory space
+#if defined(QT_APP) && defined(__linux__)
+    if (cb_rec_buffer_mirrored[nIdx])
+    {
+        CloseMirroredRecBuffer(cb_rec_buffer_mirror[nIdx]);
+        cb_rec_buffer_ptr[nIdx] = NULL;
+        cb_rec_buffer_mirrored[nIdx] = FALSE;
+    }
+#endif
     DestroySharedObject(cb_rec_buffer_hnd[nIdx], (void **)&cb_rec_buffer_ptr[nIdx]);
 }
 
@@ -244,12 +624,49 @@ HANDLE CreateSharedBuffer(LPCSTR szName, UINT32 size)
     return hnd;
 }
 
+// Purpose: Apply the shared memory options to a mapped shared memory section
+//           Each option is only a request, memory stays as it is if the option is not available
+// Inputs:
+//   pMem      - start of the memory
+//   nSize     - size of the memory
+//   nShmFlags - shared memory options (cbSHMEM_*)
+static void PrepareSharedBuffer(void * pMem, size_t nSize, UINT32 nShmFlags)
+{
+    if (pMem == NULL || nSize == 0 || nShmFlags == 0)
+        return;
+    // Work on whole pages
+    const size_t nPage = 4096;
+    char * pStart = (char *)((size_t)pMem & ~(nPage - 1));
+    nSize += (char *)pMem - pStart;
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    // Transparent huge pages for shared memory, if the kernel is set to honour the advice
+    if (nShmFlags & cbSHMEM_HUGEPAGES)
+        madvise(pStart, nSize, MADV_HUGEPAGE);
+#endif
+    if (nShmFlags & cbSHMEM_PREFAULT)
+    {
+        // Touch every page so that nothing faults later on while packets are handled
+        volatile const char * p = pStart;
+        for (size_t i = 0; i < nSize; i += nPage)
+            (void)p[i];
+    }
+    if (nShmFlags & cbSHMEM_LOCK)
+    {
+#ifdef WIN32
+        VirtualLock(pStart, nSize);
+#else
+        mlock(pStart, nSize);
+#endif
+    }
+}
+
 // Author & Date:   Ehsan Azar     29 April 2012
 // Purpose: Get access to shared memory section data
 // Inputs:
 //   hnd       - shared memory handle
 //   bReadOnly - if should open memory for read-only operation
-void * GetSharedBuffer(HANDLE hnd, bool bReadOnly)
+//   nShmFlags - shared memory options (cbSHMEM_*)
+void * GetSharedBuffer(HANDLE hnd, bool bReadOnly, UINT32 nShmFlags)
 {
     void * ret = NULL;
     if (hnd == NULL)
@@ -257,20 +674,63 @@ void * GetSharedBuffer(HANDLE hnd, bool bReadOnly)
 #ifdef WIN32
     // Keep windows version unchanged
     ret = MapViewOfFile(hnd, bReadOnly ? FILE_MAP_READ : FILE_MAP_ALL_ACCESS, 0, 0, 0);
+    MEMORY_BASIC_INFORMATION mbi;
+    if (ret && nShmFlags && VirtualQuery(ret, &mbi, sizeof(mbi)))
+        PrepareSharedBuffer(ret, mbi.RegionSize, nShmFlags);
 #else
     QSharedMemory * pHnd = static_cast<QSharedMemory *>(hnd);
     if (pHnd)
+    {
         ret = pHnd->data();
+        PrepareSharedBuffer(ret, pHnd->size(), nShmFlags);
+    }
 #endif
     return ret;
 }
 
+// Purpose: Atomically claim a free library slot for an instance, so that instances
+//           opened at the same time from different threads never share a slot
+// Inputs:
+//   nInstance - integer index identifier of library instance
+// Outputs:
+//   Returns the slot index, or cbMAXOPEN if all are taken
+static UINT32 ClaimLibrarySlot(UINT32 nInstance)
+{
+    for (UINT32 i = 0; i < cbMAXOPEN; ++i)
+    {
+#ifdef WIN32
+        if (InterlockedCompareExchange(&cb_library_owner[i], (LONG)(nInstance + 1), 0) == 0)
+            return i;
+#else
+        if (__sync_bool_compare_and_swap(&cb_library_owner[i], 0, (LONG)(nInstance + 1)))
+            return i;
+#endif
+    }
+    return cbMAXOPEN;
+}
+
+// Purpose: Release the library slot claimed by an instance
+// Inputs:
+//   nIdx      - the slot index
+//   nInstance - integer index identifier of library instance
+static void ReleaseLibrarySlot(UINT32 nIdx, UINT32 nInstance)
+{
+#ifdef WIN32
+    InterlockedCompareExchange(&cb_library_owner[nIdx], 0, (LONG)(nInstance + 1));
+#else
+    __sync_bool_compare_and_swap(&cb_library_owner[nIdx], (LONG)(nInstance + 1), 0);
+#endif
+}
+
 // Purpose: Open library as stand-alone or under given application with thread
 //    identifier for multiple threads each with its own IP
 // Inputs:
 //   bStandAlone - if should open library as stand-alone
 //   nInstance     - integer index identifier of library instance (0-based up to cbMAXOPEN-1)
-cbRESULT cbOpen(BOOL bStandAlone, UINT32 nInstance)
+//   nRecBufLen    - receive buffer length if stand-alone (units of UINT32), 0 for the default
+//   nShmFlags     - shared memory options (cbSHMEM_*)
+//   nSpkCacheDepth - spikes cached per channel if stand-alone, 0 for the default
+cbRESULT cbOpen(BOOL bStandAlone, UINT32 nInstance, UINT32 nRecBufLen, UINT32 nShmFlags, UINT32 nSpkCacheDepth)
 {
     char buf[64] = {0};
     cbRESULT cbRet;
@@ -279,17 +739,13 @@ cbRESULT cbOpen(BOOL bStandAlone, UINT32 nInstance)
         return cbRESULT_INSTINVALID;
 
     // Find an empty stub
-    UINT32 nIdx = cbMAXOPEN;
-    for (int i = 0; i < cbMAXOPEN; ++i)
-    {
-        if (!cb_library_initialized[i])
-        {
-            nIdx = i;
-            break;
-        }
-    }
+    UINT32 nIdx = ClaimLibrarySlot(nInstance);
     if (nIdx >= cbMAXOPEN)
         return cbRESULT_LIBINITERROR;
+    // cbClose must find the slot if anything fails from here on
+    cb_library_index[nInstance] = nIdx;
+    // Only the application creating the buffers decides about huge pages
+    cb_shmem_flags[nIdx] = bStandAlone ? nShmFlags : (nShmFlags & ~cbSHMEM_HUGEPAGES);
 
     char szLockName[64] = {0};
     if (nInstance == 0)
@@ -303,23 +759,48 @@ cbRESULT cbOpen(BOOL bStandAlone, UINT32 nInstance)
         // Aquire lock
         cbRet = cbAquireSystemLock(szLockName, cb_sys_lock_hnd[nInstance]);
         if (cbRet)
+        {
+            ReleaseLibrarySlot(nIdx, nInstance);
             return cbRet;
-        cb_library_index[nInstance] = nIdx;
+        }
         // Create the shared memory and synchronization objects
-        cbRet = CreateSharedObjects(nInstance);
+        cbRet = CreateSharedObjects(nInstance, nRecBufLen, nShmFlags, nSpkCacheDepth);
         // Library initialized if the objects are created
         if (cbRet == cbRESULT_OK)
         {
             cb_library_initialized[nIdx] = TRUE;      // We are in the library, so it is initialized
         } else {
             cbReleaseSystemLock(szLockName, cb_sys_lock_hnd[nInstance]);
+            ReleaseLibrarySlot(nIdx, nInstance);
         }
         return cbRet;
     } else {
         // Check if mutex is locked
         cbRet = cbCheckApp(szLockName);
         if (cbRet == cbRESULT_NOCENTRALAPP)
+        {
+            ReleaseLibrarySlot(nIdx, nInstance);
             return cbRet;
+        }
+    }
+
+    if (nInstance == 0)
+        _snprintf(buf, sizeof(buf), "%s", CFG_BUF_NAME);
+    else
+        _snprintf(buf, sizeof(buf), "%s%d", CFG_BUF_NAME, nInstance);
+    // Create the shared neuromatic configuration buffer; if unsuccessful, return FALSE
+    cb_cfg_buffer_hnd[nIdx] = OpenSharedBuffer(buf, true);
+    cb_cfg_buffer_ptr[nIdx] = (cbCFGBUFF*)GetSharedBuffer(cb_cfg_buffer_hnd[nIdx], true, cb_shmem_flags[nIdx]);
+    if (cb_cfg_buffer_ptr[nIdx] == NULL) {  cbClose(false, nInstance);  return cbRESULT_LIBINITERROR; }
+
+    // The layout of all the shared buffers goes with the configuration buffer version,
+    //  none of the others is looked at unless the application that created them has this one
+    if (cb_cfg_buffer_ptr[nIdx]->version != cbCFGBUFF_VERSION)
+    {
+        // No version yet if the application is still creating the buffers (or is gone)
+        cbRet = cb_cfg_buffer_ptr[nIdx]->version ? cbRESULT_BUFVERSIONERR : cbRESULT_NOCENTRALAPP;
+        cbClose(false, nInstance);
+        return cbRet;
     }
 
     if (nInstance == 0)
@@ -327,9 +808,35 @@ cbRESULT cbOpen(BOOL bStandAlone, UINT32 nInstance)
     else
         _snprintf(buf, sizeof(buf), "%s%d", REC_BUF_NAME, nInstance);
     // Create the shared neuromatic receive buffer, if unsuccessful, return FALSE
-    cb_rec_buffer_hnd[nIdx] = OpenSharedBuffer(buf, true);
-    cb_rec_buffer_ptr[nIdx] = (cbRECBUFF*)GetSharedBuffer(cb_rec_buffer_hnd[nIdx], true);
+#if defined(QT_APP) && defined(__linux__)
+    // Use the mirrored receive buffer if that is what the stand-alone application created,
+    //  one left over by an application that is gone is not
+    cb_rec_buffer_ptr[nIdx] = OpenMirroredRecBuffer(buf, false, 0, 0, cb_rec_buffer_mirror[nIdx]);
+    if (cb_rec_buffer_ptr[nIdx] && (cb_rec_buffer_ptr[nIdx]->owner == 0 || !ProcessExists(cb_rec_buffer_ptr[nIdx]->owner)))
+    {
+        CloseMirroredRecBuffer(cb_rec_buffer_mirror[nIdx]);
+        cb_rec_buffer_ptr[nIdx] = NULL;
+    }
+    cb_rec_buffer_mirrored[nIdx] = (cb_rec_buffer_ptr[nIdx] != NULL);
+    if (cb_rec_buffer_ptr[nIdx])
+    {
+        // Both views of the data
+        PrepareSharedBuffer(cb_rec_buffer_ptr[nIdx],
+            sizeof(cbRECBUFF) + 2 * sizeof(UINT32) * cb_rec_buffer_ptr[nIdx]->bufferlen, cb_shmem_flags[nIdx]);
+    }
+    if (cb_rec_buffer_ptr[nIdx] == NULL)
+#endif
+    {
+        cb_rec_buffer_hnd[nIdx] = OpenSharedBuffer(buf, true);
+        cb_rec_buffer_ptr[nIdx] = (cbRECBUFF*)GetSharedBuffer(cb_rec_buffer_hnd[nIdx], true, cb_shmem_flags[nIdx]);
+    }
     if (cb_rec_buffer_ptr[nIdx] == NULL) {  cbClose(false, nInstance);  return cbRESULT_LIBINITERROR; }
+    // The application filling the buffer decides its length
+    if (cb_rec_buffer_ptr[nIdx]->bufferlen < cbRECBUFFLEN_MIN || cb_rec_buffer_ptr[nIdx]->bufferlen > cbRECBUFFLEN_MAX)
+    {
+        cbClose(false, nInstance);
+        return cbRESULT_LIBINITERROR;
+    }
 
 
     if (nInstance == 0)
@@ -338,7 +845,7 @@ cbRESULT cbOpen(BOOL bStandAlone, UINT32 nInstance)
         _snprintf(buf, sizeof(buf), "%s%d", GLOBAL_XMT_NAME, nInstance);
     // Create the shared global transmit buffer; if unsuccessful, release rec buffer and return FALSE
     cb_xmt_global_buffer_hnd[nIdx] = OpenSharedBuffer(buf, false);
-    cb_xmt_global_buffer_ptr[nIdx] = (cbXMTBUFF*)GetSharedBuffer(cb_xmt_global_buffer_hnd[nIdx], false);
+    cb_xmt_global_buffer_ptr[nIdx] = (cbXMTQUEUE*)GetSharedBuffer(cb_xmt_global_buffer_hnd[nIdx], false, cb_shmem_flags[nIdx]);
     if (cb_xmt_global_buffer_ptr[nIdx] == NULL) {  cbClose(false, nInstance);  return cbRESULT_LIBINITERROR; }
 
     if (nInstance == 0)
@@ -347,25 +854,16 @@ cbRESULT cbOpen(BOOL bStandAlone, UINT32 nInstance)
         _snprintf(buf, sizeof(buf), "%s%d", LOCAL_XMT_NAME, nInstance);
     // Create the shared local transmit buffer; if unsuccessful, release rec buffer and return FALSE
     cb_xmt_local_buffer_hnd[nIdx] = OpenSharedBuffer(buf, false);;
-    cb_xmt_local_buffer_ptr[nIdx] = (cbXMTBUFF*)GetSharedBuffer(cb_xmt_local_buffer_hnd[nIdx], false);
+    cb_xmt_local_buffer_ptr[nIdx] = (cbXMTBUFF*)GetSharedBuffer(cb_xmt_local_buffer_hnd[nIdx], false, cb_shmem_flags[nIdx]);
     if (cb_xmt_local_buffer_ptr[nIdx] == NULL) {  cbClose(false, nInstance);  return cbRESULT_LIBINITERROR; }
 
-    if (nInstance == 0)
-        _snprintf(buf, sizeof(buf), "%s", CFG_BUF_NAME);
-    else
-        _snprintf(buf, sizeof(buf), "%s%d", CFG_BUF_NAME, nInstance);
-    // Create the shared neuromatic configuration buffer; if unsuccessful, release rec buffer and return FALSE
-    cb_cfg_buffer_hnd[nIdx] = OpenSharedBuffer(buf, true);
-    cb_cfg_buffer_ptr[nIdx] = (cbCFGBUFF*)GetSharedBuffer(cb_cfg_buffer_hnd[nIdx], true);
-    if (cb_cfg_buffer_ptr[nIdx] == NULL) {  cbClose(false, nInstance);  return cbRESULT_LIBINITERROR; }
-
     if (nInstance == 0)
         _snprintf(buf, sizeof(buf), "%s", STATUS_BUF_NAME);
     else
         _snprintf(buf, sizeof(buf), "%s%d", STATUS_BUF_NAME, nInstance);
     // Create the shared pc status buffer; if unsuccessful, release rec buffer and return FALSE
     cb_pc_status_buffer_hnd[nIdx] = OpenSharedBuffer(buf, false);;
-    cb_pc_status_buffer_ptr[nIdx] = (cbPcStatus*)GetSharedBuffer(cb_pc_status_buffer_hnd[nIdx], false);
+    cb_pc_status_buffer_ptr[nIdx] = (cbPcStatus*)GetSharedBuffer(cb_pc_status_buffer_hnd[nIdx], false, cb_shmem_flags[nIdx]);
     if (cb_pc_status_buffer_ptr[nIdx] == NULL) {  cbClose(false, nInstance);  return cbRESULT_LIBINITERROR; }
 
     // Create the shared spike buffer
@@ -374,9 +872,31 @@ cbRESULT cbOpen(BOOL bStandAlone, UINT32 nInstance)
     else
         _snprintf(buf, sizeof(buf), "%s%d", SPK_BUF_NAME, nInstance);
     cb_spk_buffer_hnd[nIdx] = OpenSharedBuffer(buf, false);;
-    cb_spk_buffer_ptr[nIdx] = (cbSPKBUFF*)GetSharedBuffer(cb_spk_buffer_hnd[nIdx], false);
+    cb_spk_buffer_ptr[nIdx] = (cbSPKBUFF*)GetSharedBuffer(cb_spk_buffer_hnd[nIdx], false, cb_shmem_flags[nIdx]);
     if (cb_spk_buffer_ptr[nIdx] == NULL) {  cbClose(false, nInstance);  return cbRESULT_LIBINITERROR; }
 
+    // Open the reader positions, if the application filling the buffers keeps them
+    if (nInstance == 0)
+        _snprintf(buf, sizeof(buf), "%s", READER_BUF_NAME);
+    else
+        _snprintf(buf, sizeof(buf), "%s%d", READER_BUF_NAME, nInstance);
+    cb_reader_buffer_hnd[nIdx] = OpenSharedBuffer(buf, false);
+    cb_reader_buffer_ptr[nIdx] = (cbREADERBUFF*)GetSharedBuffer(cb_reader_buffer_hnd[nIdx], false, cb_shmem_flags[nIdx]);
+    ClaimReaderSlot(nIdx);
+
+    // Open the packet index, if the application filling the buffers keeps it, and read what arrives from now on
+    if (nInstance == 0)
+        _snprintf(buf, sizeof(buf), "%s", INDEX_BUF_NAME);
+    else
+        _snprintf(buf, sizeof(buf), "%s%d", INDEX_BUF_NAME, nInstance);
+    cb_index_buffer_hnd[nIdx] = OpenSharedBuffer(buf, true);
+    cb_index_buffer_ptr[nIdx] = (cbINDEXBUFF*)GetSharedBuffer(cb_index_buffer_hnd[nIdx], true, cb_shmem_flags[nIdx]);
+    if (cb_index_buffer_ptr[nIdx])
+    {
+        for (UINT32 i = 0; i < cbINDEXRINGS; ++i)
+            cb_index_tail[nIdx][i] = cb_index_buffer_ptr[nIdx]->ring[i].count;
+    }
+
     // open the data availability signals
     if (nInstance == 0)
         _snprintf(buf, sizeof(buf), "%s", SIG_EVT_NAME);
@@ -389,9 +909,12 @@ cbRESULT cbOpen(BOOL bStandAlone, UINT32 nInstance)
     sem_t *sem = sem_open(buf, 0);
     if (sem == SEM_FAILED) {  cbClose(false, nInstance);  return cbRESULT_LIBINITERROR; }
     cb_sig_event_hnd[nIdx] = sem;
+#if defined(QT_APP) && defined(__linux__)
+    // Wake up on our own socket, rather than compete with other readers for the semaphore
+    OpenSignalSocket(nIdx, nInstance, true);
+#endif
 #endif
 
-    cb_library_index[nInstance] = nIdx;
     cb_library_initialized[nIdx] = TRUE;
 
     // Initialize read indices to the current head position
@@ -583,6 +1106,7 @@ cbRESULT cbMakePacketReadingBeginNow(UINT32 nInstance)
     cb_recbuff_tailindex[nIdx] = cb_rec_buffer_ptr[nIdx]->headindex;
     cb_recbuff_processed[nIdx] = cb_rec_buffer_ptr[nIdx]->received;
     cb_recbuff_lasttime[nIdx]  = cb_rec_buffer_ptr[nIdx]->lasttime;
+    PublishReadPosition(nIdx);
 
     return cbRESULT_OK;
 }
@@ -608,8 +1132,9 @@ cbRESULT cbClose(BOOL bStandAlone, UINT32 nInstance)
             _snprintf(buf, sizeof(buf), "cbSharedDataMutex%d", nInstance);
         if (cb_sys_lock_hnd[nInstance])
             cbReleaseSystemLock(buf, cb_sys_lock_hnd[nInstance]);
-        return cbRESULT_OK;
     }
+    // Slot can now be reused by any instance
+    ReleaseLibrarySlot(nIdx, nInstance);
 
     return cbRESULT_OK;
 }
@@ -681,114 +1206,112 @@ cbRESULT cbGetChanCount(UINT32 *count, UINT32 nInstance)
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 
 
-cbRESULT cbSendPacket(void * pPacket, UINT32 nInstance)
+// Purpose: Hand a filled transmit queue slot over to the Central App
+// Inputs:
+//   pSlot - the slot
+//   nSeq  - its new sequence number
+static inline void PublishXmtSlot(cbXMTSLOT * pSlot, UINT32 nSeq)
+{
+#ifdef WIN32
+    InterlockedExchange((LONG volatile *)&pSlot->seq, (LONG)nSeq);
+#else
+    __sync_synchronize();
+    *(volatile UINT32 *)&pSlot->seq = nSeq;
+#endif
+}
+
+// Purpose: Send packets via the Central Application Queue
+// Inputs:
+//   ppPackets - the packets
+//   nCount    - number of packets
+//   nInstance - integer index identifier of library instance
+cbRESULT cbSendPackets(void * const * ppPackets, UINT32 nCount, UINT32 nInstance)
 {
     UINT32 nIdx = cb_library_index[nInstance];
 
     // Test for prior library initialization
     if (!cb_library_initialized[nIdx]) return cbRESULT_NOLIBRARY;
 
-    cbPKT_GENERIC * pPkt = static_cast<cbPKT_GENERIC*>(pPacket);
-
-    // The logic here is quite complicated. Data is filled in from other processes
-    // in a 2 pass mode. First they fill all except they skip the first 4 bytes.
-    // The final step in the process is to convert the 1st dword from "0" to some other number.
-    // This step is done in a thread-safe manner
-    // Consequently, all packets can not have "0" as the first DWORD. At the time of writing,
-    // We were looking at the "time" value of a packet.
-
-    pPkt->time = cb_rec_buffer_ptr[nIdx]->lasttime;
-
-    // Time cannot be equal to 0
-    if (pPkt->time == 0)
-        pPkt->time = 1;
-
-    ASSERT( *(static_cast<DWORD const *>(pPacket)) != 0);
-
-
-    UINT32 quadletcount = pPkt->dlen + cbPKT_HEADER_32SIZE;
-    UINT32 orig_headindex;
-
-    // give 3 attempts to claim a spot in the circular xmt buffer for the packet
-    int insertionattempts = 0;
-    static const int NUM_INSERTION_ATTEMPTS = 3;
-    while (TRUE)
+    cbXMTQUEUE * pXmt = cb_xmt_global_buffer_ptr[nIdx];
+    if (nCount == 0)
+        return cbRESULT_OK;
+    if (nCount > pXmt->slotcount)
+        return cbRESULT_MEMORYUNAVAIL;
+    for (UINT32 i = 0; i < nCount; ++i)
     {
-        bool bTryToFill = false;        // Should I try to stuff data into the queue, or is it filled
-                                        // TRUE = go ahead a try; FALSE = wait a bit
-
-        // Copy the current buffer indices
-        // NOTE: may want to use a 64-bit transfer to atomically get indices.  Otherwise, grab
-        // tail index first to get "worst case" scenario;
-        UINT32 orig_tailindex = cb_xmt_global_buffer_ptr[nIdx]->tailindex;
-        orig_headindex = cb_xmt_global_buffer_ptr[nIdx]->headindex;
-
-        // Compute the new head index at after the target packet position.
-        // If the new head index is within (cbCER_UDP_SIZE_MAX / 4) quadlets of the buffer end, wrap it around.
-        // Also, make sure that we are not wrapping around the tail pointer
-        UINT32 mod_headindex = orig_headindex + quadletcount;
-        UINT32 nLastOKPosition = cb_xmt_global_buffer_ptr[nIdx]->last_valid_index;
-        if (mod_headindex > nLastOKPosition)
-        {
-            // time to wrap around in the circular buffer....
-            mod_headindex = 0;
-
-            // Is there room?
-            if (mod_headindex < orig_tailindex)
-                bTryToFill = true;
-        }
-        else if (orig_tailindex > orig_headindex)   // wrapped recently, but not yet caught up?
-        {
-            // Is there room?
-            if (mod_headindex < orig_tailindex)  // Do I have space to continue?
-                bTryToFill = true;
-        }
+        if (static_cast<cbPKT_GENERIC *>(ppPackets[i])->dlen + cbPKT_HEADER_32SIZE > cbPKT_MAX_SIZE / 4)
+            return cbRESULT_INVALIDFUNCTION;
+    }
 
-        else    // no wrapping at all...and plenty of room
-        {
-            bTryToFill = true;
-        }
+    // Reserve the slots for all the packets at once. The compare-and-swap only fails
+    // if another writer reserved meanwhile, and then it is simply tried again.
+    // Grab tail index first to get "worst case" scenario
+    UINT32 nHead;
+    for (;;)
+    {
+        UINT32 nTail = *(volatile UINT32 *)&pXmt->tailindex;
+        nHead = *(volatile UINT32 *)&pXmt->headindex;
+        if (nHead - nTail + nCount > pXmt->slotcount)
+            return cbRESULT_MEMORYUNAVAIL;
+        if (CompareAndSwap(&pXmt->headindex, nHead, nHead + nCount))
+            break;
+    }
 
+    // Fill each slot, the Central App will not transmit a packet before its slot is handed over,
+    // nor any packet after it
+    for (UINT32 i = 0; i < nCount; ++i)
+    {
+        cbPKT_GENERIC * pPkt = static_cast<cbPKT_GENERIC *>(ppPackets[i]);
+        pPkt->time = cb_rec_buffer_ptr[nIdx]->lasttime;
+
+        UINT32 nPos = nHead + i;
+        cbXMTSLOT * pSlot = &pXmt->slot[nPos & (pXmt->slotcount - 1)];
+        ASSERT(pSlot->seq == nPos);
+        memcpy(pSlot->packet, pPkt, (pPkt->dlen + cbPKT_HEADER_32SIZE) << 2);
+        PublishXmtSlot(pSlot, nPos + 1);
+    }
+    return cbRESULT_OK;
+}
 
-        if (bTryToFill)
-        {
-            // attempt to atomically update the head pointer and verify that the head pointer
-            // was not changed since orig_head_index was loaded and calculated upon
-            LONG * pDest = (LONG *) &cb_xmt_global_buffer_ptr[nIdx]->headindex;
-            LONG  dwExch = (LONG) mod_headindex;
-            LONG  dwComp = (LONG) orig_headindex;
-#ifdef WIN32
-            if (InterlockedCompareExchange(pDest, dwExch, dwComp) == dwComp)
-                break;
-#else
-            if (__sync_bool_compare_and_swap(pDest, dwComp, dwExch))
-                break;
-#endif
-                // NORMAL EXIT
-        }
+// Purpose: Wait for room in the Central Application Queue
+// Inputs:
+//   nCount     - number of packets to make room for
+//   nTimeoutMs - milliseconds to wait at most
+//   nInstance  - integer index identifier of library instance
+cbRESULT cbWaitforXmtSpace(UINT32 nCount, UINT32 nTimeoutMs, UINT32 nInstance)
+{
+    UINT32 nIdx = cb_library_index[nInstance];
 
+    // Test for prior library initialization
+    if (!cb_library_initialized[nIdx]) return cbRESULT_NOLIBRARY;
 
-        // check to see if we should give up or not
-        if ((++insertionattempts) >= NUM_INSERTION_ATTEMPTS)
-        {
+    cbXMTQUEUE * pXmt = cb_xmt_global_buffer_ptr[nIdx];
+    if (nCount > pXmt->slotcount)
+        return cbRESULT_MEMORYUNAVAIL;
+    for (UINT32 nWaited = 0; ; ++nWaited)
+    {
+        UINT32 nTail = *(volatile UINT32 *)&pXmt->tailindex;
+        UINT32 nHead = *(volatile UINT32 *)&pXmt->headindex;
+        if (nHead - nTail + nCount <= pXmt->slotcount)
+            return cbRESULT_OK;
+        if (nWaited >= nTimeoutMs)
             return cbRESULT_MEMORYUNAVAIL;
-        }
-
-        // Sleep for a bit to let buffers clear and try again
-        Sleep(10);
+        // The Central App sends at most a few packets every millisecond
+        Sleep(1);
     }
+}
 
-    // Copy all but the first 4 bytes of the packet to the target packet location.
-    // The Central App will not transmit the packet while the first UINT32 is zero.
-    memcpy(&(cb_xmt_global_buffer_ptr[nIdx]->buffer[orig_headindex+1]), ((UINT32*)pPacket)+1, ((quadletcount-1)<<2) );
-
-    // atomically copy the first 4 bytes of the packet
-#ifdef WIN32
-    InterlockedExchange((LPLONG)&(cb_xmt_global_buffer_ptr[nIdx]->buffer[orig_headindex]),*((LONG*)pPacket));
-#else
-    __sync_lock_test_and_set((LPLONG)&(cb_xmt_global_buffer_ptr[nIdx]->buffer[orig_headindex]),*((LONG*)pPacket));
-#endif
-    return cbRESULT_OK;
+// Purpose: Send a packet via the Central Application Queue
+// Inputs:
+//   pPacket   - the packet
+//   nInstance - integer index identifier of library instance
+cbRESULT cbSendPacket(void * pPacket, UINT32 nInstance)
+{
+    cbRESULT res = cbSendPackets(&pPacket, 1, nInstance);
+    // If the queue is full give the Central App a moment to send what is queued
+    if (res == cbRESULT_MEMORYUNAVAIL && cbWaitforXmtSpace(1, 20, nInstance) == cbRESULT_OK)
+        res = cbSendPackets(&pPacket, 1, nInstance);
+    return res;
 }
 
 
@@ -2858,6 +3381,37 @@ cbRESULT cbSSSetStatus(cbAdaptControl cntlUnitStats, cbAdaptControl cntlNumUnits
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 
 
+// Purpose: Find how far past the head index the receive buffer may be being written
+// Inputs:
+//   nIdx - library instance index
+// Outputs:
+//   Returns the distance in UINT32 units, at least the largest datagram
+static inline UINT32 RecWriteAhead(UINT32 nIdx)
+{
+    UINT32 nWriteAhead = cb_rec_buffer_ptr[nIdx]->writeahead;
+    return nWriteAhead > (cbCER_UDP_SIZE_MAX / 4) ? nWriteAhead : (cbCER_UDP_SIZE_MAX / 4);
+}
+
+// Purpose: Find if the packets from a position of the receive buffer on may be written over
+// Inputs:
+//   nIdx   - library instance index
+//   nWrap  - wraparound count of the position
+//   nIndex - index of the position
+// Outputs:
+//   Returns true if what the head may be writing reaches the position
+static inline bool RecPositionLost(UINT32 nIdx, UINT32 nWrap, UINT32 nIndex)
+{
+    UINT32 nHeadWrap  = cb_rec_buffer_ptr[nIdx]->headwrap;
+    UINT32 nHeadIndex = cb_rec_buffer_ptr[nIdx]->headindex;
+    if (nHeadWrap == nWrap)
+    {
+        // Only a mirrored buffer is written past its end, that is over the start of the buffer
+        return cb_rec_buffer_mirrored[nIdx] &&
+            nHeadIndex + RecWriteAhead(nIdx) > cb_rec_buffer_ptr[nIdx]->bufferlen + nIndex;
+    }
+    return nHeadWrap != nWrap + 1 || nHeadIndex + RecWriteAhead(nIdx) >= nIndex;
+}
+
 cbRESULT cbCheckforData(cbLevelOfConcern & nLevelOfConcern, UINT32 *pktstogo /* = NULL */, UINT32 nInstance)
 {
     UINT32 nIdx = cb_library_index[nInstance];
@@ -2866,14 +3420,14 @@ cbRESULT cbCheckforData(cbLevelOfConcern & nLevelOfConcern, UINT32 *pktstogo /*
     if (!cb_library_initialized[nIdx]) return cbRESULT_NOLIBRARY;
 
     // Check for data loss by checking that
-    //    [(head wraparound != Tail wraparound)AND((head index + (max_datagram_size/4)q) >= read index)]
+    //    [(head wraparound != Tail wraparound)AND((head index + write ahead) >= read index)]
     // OR [head wraparound is more than twice ahead of the read pointer set]
-    if (((cb_rec_buffer_ptr[nIdx]->headwrap != cb_recbuff_tailwrap[nIdx]) &&
-        (
-          (cb_rec_buffer_ptr[nIdx]->headindex + (cbCER_UDP_SIZE_MAX / 4)) >= cb_recbuff_tailindex[nIdx])) ||
-          (cb_rec_buffer_ptr[nIdx]->headwrap > (cb_recbuff_tailwrap[nIdx] + 1))
-        )
+    // OR [the mirrored buffer is written past its end up to the read index]
+    if (RecPositionLost(nIdx, cb_recbuff_tailwrap[nIdx], cb_recbuff_tailindex[nIdx]))
     {
+        // Let the application filling the buffer know this reader is too slow
+        if (cb_reader_cursor[nIdx])
+            cb_reader_cursor[nIdx]->overruns++;
         cbMakePacketReadingBeginNow(nInstance);
         nLevelOfConcern = LOC_CRITICAL;
         return cbRESULT_DATALOST;
@@ -2885,9 +3439,9 @@ cbRESULT cbCheckforData(cbLevelOfConcern & nLevelOfConcern, UINT32 *pktstogo /*
     // Level of concern is based on fourths
     int nDiff = cb_rec_buffer_ptr[nIdx]->headindex - cb_recbuff_tailindex[nIdx];
     if (nDiff < 0)
-        nDiff += cbRECBUFFLEN;
+        nDiff += cb_rec_buffer_ptr[nIdx]->bufferlen;
 
-    nLevelOfConcern = static_cast<cbLevelOfConcern>( (nDiff * LOC_COUNT) / cbRECBUFFLEN );
+    nLevelOfConcern = static_cast<cbLevelOfConcern>( ((UINT64)nDiff * LOC_COUNT) / cb_rec_buffer_ptr[nIdx]->bufferlen );
 
     return cbRESULT_OK;
 }
@@ -2915,6 +3469,41 @@ int sem_timedwait(sem_t * sem, int ms)
 }
 #endif
 
+#if !defined(WIN32) && !defined(__APPLE__)
+// Purpose: Wait for a signal from the master application
+// Inputs:
+//   nIdx - library instance index
+//   ms   - milliseconds to wait at most
+// Outputs:
+//   Returns true if signalled
+static bool WaitForSignal(UINT32 nIdx, int ms)
+{
+#if defined(QT_APP) && defined(__linux__)
+    if (cb_sig_sock_open[nIdx])
+    {
+        pollfd pfd;
+        pfd.fd = cb_sig_sock[nIdx];
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        if (poll(&pfd, 1, ms) <= 0)
+            return false;
+        // Any number of wakeups pending count as one
+        char abyDrain[16];
+        while (recv(cb_sig_sock[nIdx], abyDrain, sizeof(abyDrain), MSG_DONTWAIT) > 0)
+            ;
+        return true;
+    }
+#endif
+    timespec ts;
+    long ns = ms * 1000000L;
+    clock_gettime(CLOCK_REALTIME, &ts);
+#define NANOSECONDS_PER_SEC    1000000000L
+    ts.tv_sec += (ts.tv_nsec + ns) / NANOSECONDS_PER_SEC;
+    ts.tv_nsec = (ts.tv_nsec + ns) % NANOSECONDS_PER_SEC;
+    return sem_timedwait((sem_t *)cb_sig_event_hnd[nIdx], &ts) == 0;
+}
+#endif
+
 // Purpose: Wait for master application (usually Central) to fill buffers
 cbRESULT cbWaitforData(UINT32 nInstance)
 {
@@ -2927,13 +3516,7 @@ cbRESULT cbWaitforData(UINT32 nInstance)
     if (sem_timedwait((sem_t *)cb_sig_event_hnd[nIdx], 250) == 0)
         return cbRESULT_OK;
 #else
-    timespec ts;
-    long ns = 250000000;
-    clock_gettime(CLOCK_REALTIME, &ts);
-#define NANOSECONDS_PER_SEC    1000000000L
-    ts.tv_nsec = (ts.tv_nsec + ns) % NANOSECONDS_PER_SEC;
-    ts.tv_sec += (ts.tv_nsec + ns) / NANOSECONDS_PER_SEC;
-    if (sem_timedwait((sem_t *)cb_sig_event_hnd[nIdx], &ts) == 0)
+    if (WaitForSignal(nIdx, 250))
         return cbRESULT_OK;
 #endif
     else if (!(cb_cfg_buffer_ptr[nIdx]->version))
@@ -2945,6 +3528,74 @@ cbRESULT cbWaitforData(UINT32 nInstance)
         return cbRESULT_NONEWDATA;
 }
 
+// Purpose: Signal every process waiting for data that new data is in the buffers
+// Inputs:
+//   nInstance - integer index identifier of library instance
+cbRESULT cbSignalData(UINT32 nInstance)
+{
+    UINT32 nIdx = cb_library_index[nInstance];
+    if (cb_sig_event_hnd[nIdx] == NULL)
+        return cbRESULT_NOLIBRARY;
+
+#ifdef WIN32
+    PulseEvent(cb_sig_event_hnd[nIdx]);
+#else
+    // Readers without a wakeup socket of their own, one wakeup pending is enough for them
+    //  (readers woken up on their socket never take it, so it would count up without end)
+    int nPending = 0;
+    if (sem_getvalue((sem_t *)cb_sig_event_hnd[nIdx], &nPending) != 0 || nPending < 1)
+        sem_post((sem_t *)cb_sig_event_hnd[nIdx]);
+#if defined(QT_APP) && defined(__linux__)
+    if (cb_sig_sock_open[nIdx] && cb_reader_buffer_ptr[nIdx])
+    {
+        // One wakeup to each reader, if one is already pending the reader has not woken up yet anyway
+        const char cWake = 0;
+        for (UINT32 i = 0; i < cbMAXREADERS; ++i)
+        {
+            if (cb_reader_buffer_ptr[nIdx]->reader[i].pid == 0)
+                continue;
+            sockaddr_un addr;
+            socklen_t len = SignalAddress(nInstance, i, addr);
+            sendto(cb_sig_sock[nIdx], &cWake, sizeof(cWake), MSG_DONTWAIT | MSG_NOSIGNAL, (sockaddr *)&addr, len);
+        }
+    }
+#endif
+#endif
+    return cbRESULT_OK;
+}
+
+// Purpose: Get the descriptor this process is woken up on when there is new data,
+//           so that it can be waited on along with others (e.g. with poll or epoll)
+// Inputs:
+//   pFd       - where to put the descriptor
+//   nInstance - integer index identifier of library instance
+cbRESULT cbGetDataSignal(int * pFd, UINT32 nInstance)
+{
+    UINT32 nIdx = cb_library_index[nInstance];
+    if (!cb_library_initialized[nIdx])
+        return cbRESULT_NOLIBRARY;
+
+#if defined(QT_APP) && defined(__linux__)
+    if (cb_sig_sock_open[nIdx] && cb_reader_cursor[nIdx])
+    {
+        if (pFd)
+            *pFd = cb_sig_sock[nIdx];
+        return cbRESULT_OK;
+    }
+#endif
+    return cbRESULT_INVALIDFUNCTION;
+}
+
+
+// Purpose: Make sure what the process filling the buffers published is read in order
+static inline void ReadFence()
+{
+#ifdef WIN32
+    MemoryBarrier();
+#else
+    __sync_synchronize();
+#endif
+}
 
 cbPKT_GENERIC * cbGetNextPacketPtr(UINT32 nInstance)
 {
@@ -2960,7 +3611,16 @@ cbPKT_GENERIC * cbGetNextPacketPtr(UINT32 nInstance)
         cb_recbuff_tailindex[nIdx] += (cbPKT_HEADER_32SIZE + packetptr->dlen);
 
         // check for read buffer wraparound, if so increment relevant variables
-        if (cb_recbuff_tailindex[nIdx] > (cbRECBUFFLEN - (cbCER_UDP_SIZE_MAX / 4)))
+        if (cb_rec_buffer_mirrored[nIdx])
+        {
+            // Packets run past the end into the mirror, the next one is where it wraps to
+            if (cb_recbuff_tailindex[nIdx] >= cb_rec_buffer_ptr[nIdx]->bufferlen)
+            {
+                cb_recbuff_tailindex[nIdx] -= cb_rec_buffer_ptr[nIdx]->bufferlen;
+                cb_recbuff_tailwrap[nIdx]++;
+            }
+        }
+        else if (cb_recbuff_tailindex[nIdx] > (cb_rec_buffer_ptr[nIdx]->bufferlen - (cbCER_UDP_SIZE_MAX / 4)))
         {
             cb_recbuff_tailindex[nIdx] = 0;
             cb_recbuff_tailwrap[nIdx]++;
@@ -2972,6 +3632,8 @@ cbPKT_GENERIC * cbGetNextPacketPtr(UINT32 nInstance)
         // update the timestamp index
         cb_recbuff_lasttime[nIdx] = packetptr->time;
 
+        PublishReadPosition(nIdx);
+
         // return the packet
         return packetptr;
     }
@@ -2979,6 +3641,146 @@ cbPKT_GENERIC * cbGetNextPacketPtr(UINT32 nInstance)
         return NULL;
 }
 
+// Purpose: Get all the packets available in the receive buffer
+// Inputs:
+//   nInstance - library instance
+// Outputs:
+//   span      - the packets, starting at the current read position
+cbRESULT cbGetPacketSpan(cbPacketSpan *span, UINT32 nInstance)
+{
+    UINT32 nIdx = cb_library_index[nInstance];
+
+    // Test for prior library initialization
+    if (!cb_library_initialized[nIdx]) return cbRESULT_NOLIBRARY;
+
+    const UINT32 nBufferLen = cb_rec_buffer_ptr[nIdx]->bufferlen;
+    span->m_pBuffer    = cb_rec_buffer_ptr[nIdx]->buffer;
+    span->m_pLast      = NULL;
+    span->m_nCount     = cb_rec_buffer_ptr[nIdx]->received - cb_recbuff_processed[nIdx];
+    span->m_nRead      = 0;
+    span->m_nProcessed = cb_recbuff_processed[nIdx];
+    span->m_nWrap      = cb_recbuff_tailwrap[nIdx];
+    span->m_nIndex     = cb_recbuff_tailindex[nIdx];
+    span->m_nBufferLen = nBufferLen;
+    span->m_bMirrored  = cb_rec_buffer_mirrored[nIdx];
+    span->m_nWrapAt    = span->m_bMirrored ? nBufferLen - 1 : nBufferLen - (cbCER_UDP_SIZE_MAX / 4);
+    // The packets counted as received are written
+    ReadFence();
+
+    return span->m_nCount ? cbRESULT_OK : cbRESULT_NONEWDATA;
+}
+
+// Purpose: Read the packets of a span returned so far
+// Inputs:
+//   span      - the span
+//   nInstance - library instance
+cbRESULT cbCommitPacketSpan(const cbPacketSpan *span, UINT32 nInstance)
+{
+    UINT32 nIdx = cb_library_index[nInstance];
+
+    // Test for prior library initialization
+    if (!cb_library_initialized[nIdx]) return cbRESULT_NOLIBRARY;
+    if (span->m_nProcessed != cb_recbuff_processed[nIdx]) return cbRESULT_INVALIDADDRESS;
+    if (span->m_nRead == 0)
+        return cbRESULT_OK;
+
+    cb_recbuff_tailwrap[nIdx]  = span->m_nWrap;
+    cb_recbuff_tailindex[nIdx] = span->m_nIndex;
+    cb_recbuff_processed[nIdx] += span->m_nRead;
+    cb_recbuff_lasttime[nIdx]  = span->m_pLast->time;
+    PublishReadPosition(nIdx);
+
+    return cbRESULT_OK;
+}
+
+// Purpose: Get the status of a process reading the receive buffer
+// Inputs:
+//   reader    - reader slot (0 to cbMAXREADERS-1)
+//   nInstance - library instance
+// Outputs:
+//   pid       - reader process id
+//   lag       - number of packets received but not yet read by the reader
+//   overruns  - number of times the reader lost data
+//   Returns cbRESULT_INVALIDADDRESS if the slot is not in use
+cbRESULT cbGetReaderStatus(UINT32 reader, UINT32 *pid, UINT32 *lag, UINT32 *overruns, UINT32 nInstance)
+{
+    UINT32 nIdx = cb_library_index[nInstance];
+
+    // Test for prior library initialization
+    if (!cb_library_initialized[nIdx]) return cbRESULT_NOLIBRARY;
+    if (reader >= cbMAXREADERS || cb_reader_buffer_ptr[nIdx] == NULL) return cbRESULT_INVALIDADDRESS;
+
+    const cbREADERCURSOR & rCursor = cb_reader_buffer_ptr[nIdx]->reader[reader];
+    UINT32 nPid = rCursor.pid;
+    if (nPid == 0) return cbRESULT_INVALIDADDRESS;
+
+    if (pid) *pid = nPid;
+    if (lag) *lag = cb_rec_buffer_ptr[nIdx]->received - rCursor.processed;
+    if (overruns) *overruns = rCursor.overruns;
+    return cbRESULT_OK;
+}
+
+// Purpose: Get the next packet of one channel, sample group or of the configuration packets
+// Inputs:
+//   ring      - index ring (cbINDEX_CHAN(chid), cbINDEX_GROUP(group) or cbINDEX_CONFIG)
+//   nInstance - library instance
+// Outputs:
+//   ppPkt     - the packet in the receive buffer
+//   Returns cbRESULT_NONEWDATA if there is no new packet, cbRESULT_DATALOST if packets were missed
+cbRESULT cbGetNextIndexedPacket(UINT32 ring, cbPKT_GENERIC **ppPkt, UINT32 nInstance)
+{
+    UINT32 nIdx = cb_library_index[nInstance];
+
+    // Test for prior library initialization
+    if (!cb_library_initialized[nIdx]) return cbRESULT_NOLIBRARY;
+    if (cb_index_buffer_ptr[nIdx] == NULL) return cbRESULT_INVALIDFUNCTION;
+    if (ring >= cbINDEXRINGS) return cbRESULT_INVALIDADDRESS;
+
+    const cbINDEXRING & rRing = cb_index_buffer_ptr[nIdx]->ring[ring];
+    const volatile UINT32 & rCount = rRing.count;
+    UINT32 & rTail = cb_index_tail[nIdx][ring];
+    if (rCount == rTail)
+        return cbRESULT_NONEWDATA;
+    ReadFence();
+    cbINDEXENTRY entry = rRing.entry[rTail & (cbINDEXLEN - 1)];
+    ReadFence();
+
+    // The entry is only good if the ring did not go around over it while it was read,
+    //  and the packet only if the receive buffer is not being written over it
+    //  (that includes the datagrams of a batch written ahead of the head)
+    if ((rCount - rTail > cbINDEXLEN) || RecPositionLost(nIdx, entry.wrap, entry.index))
+    {
+        rTail = rCount;
+        return cbRESULT_DATALOST;
+    }
+    rTail++;
+    if (ppPkt)
+        *ppPkt = (cbPKT_GENERIC *)&(cb_rec_buffer_ptr[nIdx]->buffer[entry.index]);
+    return cbRESULT_OK;
+}
+
+
+// Purpose: Copy the generation counters of the configuration
+// Outputs:
+//   generation - the counters
+cbRESULT cbGetCfgGeneration(cbCFGGENERATION *generation, UINT32 nInstance)
+{
+    UINT32 nIdx = cb_library_index[nInstance];
+
+    // Test for prior library initialization
+    if (!cb_library_initialized[nIdx]) return cbRESULT_NOLIBRARY;
+    // Older applications create a shorter buffer without the counters
+    if (cb_cfg_buffer_ptr[nIdx]->version != cbCFGBUFF_VERSION) return cbRESULT_INVALIDFUNCTION;
+
+    // The entries are counted before the generation, so read the generation first
+    const cbCFGGENERATION & rGen = cb_cfg_buffer_ptr[nIdx]->generation;
+    UINT32 nGeneration = *(const volatile UINT32 *)&rGen.generation;
+    ReadFence();
+    *generation = rGen;
+    generation->generation = nGeneration;
+    return cbRESULT_OK;
+}
+
 
 // Purpose: options sharing
 //
@@ -3004,6 +3806,70 @@ cbRESULT cbGetSpkCache(UINT32 chid, cbSPKCACHE **cache, UINT32 nInstance)
     return cbRESULT_OK;
 }
 
+// Purpose: Copy the cached spikes of a channel newer than a cursor
+// Inputs:
+//   chid      - channel ID (1-based)
+//   cursor    - number of spikes of the channel already seen, 0 to start
+//   count     - room in spikes
+//   nInstance - library instance
+// Outputs:
+//   cursor    - number of spikes seen after the copy
+//   spikes    - the spikes, oldest first
+//   count     - number of spikes copied
+cbRESULT cbGetSpkCacheSince(UINT32 chid, UINT32 *cursor, cbPKT_SPK *spikes, UINT32 *count, UINT32 nInstance)
+{
+    UINT32 nIdx = cb_library_index[nInstance];
+
+    if (!cb_library_initialized[nIdx]) return cbRESULT_NOLIBRARY;
+    if (cursor == NULL || count == NULL || (spikes == NULL && *count > 0)) return cbRESULT_INVALIDADDRESS;
+    if (chid == 0 || chid > cb_spk_buffer_ptr[nIdx]->chidmax) return cbRESULT_INVALIDCHANNEL;
+
+    cbSPKCACHE * pCache;
+    cbGetSpkCache(chid, &pCache, nInstance);
+    const volatile UINT32 & rSeq = pCache->seq;
+
+    // The line is changed by one writer, so only a few spikes coming in during the copy can fail it
+    for (int nAttempt = 0; nAttempt < 8; ++nAttempt)
+    {
+        UINT32 nSeq = rSeq;
+        if (nSeq & 1)
+            continue;
+        ReadFence();
+        UINT32 nValid  = pCache->valid;
+        UINT32 nHead   = pCache->head;
+        UINT32 nPktCnt = pCache->pktcnt;
+        UINT32 nFrom = *cursor;
+        cbRESULT res = cbRESULT_OK;
+        // The channel was configured again since the cursor, start over
+        if (nFrom > nValid)
+            nFrom = 0;
+        if (nValid - nFrom > nPktCnt)
+        {
+            nFrom = nValid - nPktCnt;
+            res = cbRESULT_DATALOST;
+        }
+        UINT32 nCopy = nValid - nFrom;
+        if (nCopy > *count)
+            nCopy = *count;
+        // The last spike that came in is right before head
+        UINT32 nSlot = (nHead + nPktCnt - (nValid - nFrom)) % nPktCnt;
+        for (UINT32 i = 0; i < nCopy; ++i)
+        {
+            memcpy(&spikes[i], &pCache->spkpkt[nSlot], sizeof(cbPKT_SPK));
+            if (++nSlot == nPktCnt)
+                nSlot = 0;
+        }
+        ReadFence();
+        if (rSeq != nSeq)
+            continue;
+        *cursor = nFrom + nCopy;
+        *count = nCopy;
+        return res;
+    }
+    *count = 0;
+    return cbRESULT_NONEWDATA;
+}
+
 // Author & Date:   Kirk Korver     29 May 2003
 // Purpose: Get the multiplier to use for autothresholdine when using RMS to guess noise
 // This will adjust fAutoThresholdDistance above, but use the API instead
@@ -3163,33 +4029,66 @@ cbRESULT cbGetChannelSelection(cbPKT_UNIT_SELECTION * pPktUnitSel, UINT32 nInsta
 // Author & Date:       Almut Branner         28 Mar 2006
 // Purpose: Create the shared memory objects
 // Inputs:
-//   nInstance - nsp number to open library for
-cbRESULT CreateSharedObjects(UINT32 nInstance)
+//   nInstance  - nsp number to open library for
+//   nRecBufLen - receive buffer length (units of UINT32), 0 for the default
+//   nShmFlags  - shared memory options (cbSHMEM_*)
+//   nSpkCacheDepth - spikes cached per channel, 0 for the default
+cbRESULT CreateSharedObjects(UINT32 nInstance, UINT32 nRecBufLen, UINT32 nShmFlags, UINT32 nSpkCacheDepth)
 {
     char buf[64] = {0};
     UINT32 nIdx = cb_library_index[nInstance];
 
+    // Keep the receive buffer length in range, and a multiple of 64KB so it can be mirrored
+    if (nRecBufLen == 0)
+        nRecBufLen = cbRECBUFFLEN;
+    if (nRecBufLen < cbRECBUFFLEN_MIN)
+        nRecBufLen = cbRECBUFFLEN_MIN;
+    if (nRecBufLen > cbRECBUFFLEN_MAX)
+        nRecBufLen = cbRECBUFFLEN_MAX;
+    nRecBufLen = ((nRecBufLen + cbRECBUFFLEN_GRAIN - 1) / cbRECBUFFLEN_GRAIN) * cbRECBUFFLEN_GRAIN;
+    // determine the receive buffer structure size (header + data field)
+    const UINT32 cbRECBUFFSTRUCTSIZE = sizeof(cbRECBUFF) + (sizeof(UINT32) * nRecBufLen);
+
     // Create the shared neuromatic receive buffer, if unsuccessful, return the associated error code
     if (nInstance == 0)
         _snprintf(buf, sizeof(buf), "%s", REC_BUF_NAME);
     else
         _snprintf(buf, sizeof(buf), "%s%d", REC_BUF_NAME, nInstance);
-    cb_rec_buffer_hnd[nIdx] = CreateSharedBuffer(buf, sizeof(cbRECBUFF));
-    cb_rec_buffer_ptr[nIdx] = (cbRECBUFF*)GetSharedBuffer(cb_rec_buffer_hnd[nIdx], false);
+#if defined(QT_APP) && defined(__linux__)
+    // Map the receive buffer with a mirror of itself, so that nothing has to be copied on wraparound
+    cb_rec_buffer_ptr[nIdx] = OpenMirroredRecBuffer(buf, true, nRecBufLen, nShmFlags, cb_rec_buffer_mirror[nIdx]);
+    cb_rec_buffer_mirrored[nIdx] = (cb_rec_buffer_ptr[nIdx] != NULL);
+    if (cb_rec_buffer_ptr[nIdx])
+    {
+        // Both views of the data
+        PrepareSharedBuffer(cb_rec_buffer_ptr[nIdx], sizeof(cbRECBUFF) + 2 * sizeof(UINT32) * nRecBufLen, nShmFlags);
+    }
+    if (cb_rec_buffer_ptr[nIdx] == NULL)
+    {
+        // The readers look for a mirrored buffer first
+        RemoveMirroredRecBuffer(buf);
+    }
+    if (cb_rec_buffer_ptr[nIdx] == NULL)
+#endif
+    {
+        cb_rec_buffer_hnd[nIdx] = CreateSharedBuffer(buf, cbRECBUFFSTRUCTSIZE);
+        cb_rec_buffer_ptr[nIdx] = (cbRECBUFF*)GetSharedBuffer(cb_rec_buffer_hnd[nIdx], false, cb_shmem_flags[nIdx]);
+    }
 
     if (cb_rec_buffer_ptr[nIdx] == NULL)
         return cbRESULT_BUFRECALLOCERR;
 
-    memset(cb_rec_buffer_ptr[nIdx], 0, sizeof(cbRECBUFF));
+    memset(cb_rec_buffer_ptr[nIdx], 0, cbRECBUFFSTRUCTSIZE);
+    cb_rec_buffer_ptr[nIdx]->bufferlen = nRecBufLen;
+    cb_rec_buffer_ptr[nIdx]->owner = CurrentProcessId();
 
     // Create the shared transmit buffer; if unsuccessful, release rec buffer and associated error code
     {
         // declare the length of the buffer in UINT32 units
-        const UINT32 cbXMT_GLOBAL_BUFFLEN = (cbCER_UDP_SIZE_MAX / 4) * 500 + 2;    // room for 500 packets
         const UINT32 cbXMT_LOCAL_BUFFLEN  = (cbCER_UDP_SIZE_MAX / 4) * 200 + 2;    // room for 200 packets
 
         // determine the XMT buffer structure size (header + data field)
-        const UINT32 cbXMT_GLOBAL_BUFFSTRUCTSIZE = sizeof(cbXMTBUFF) + (sizeof(UINT32)*cbXMT_GLOBAL_BUFFLEN);
+        const UINT32 cbXMT_GLOBAL_BUFFSTRUCTSIZE = sizeof(cbXMTQUEUE) + (sizeof(cbXMTSLOT)*cbXMTSLOTS);
         const UINT32 cbXMT_LOCAL_BUFFSTRUCTSIZE  = sizeof(cbXMTBUFF) + (sizeof(UINT32)*cbXMT_LOCAL_BUFFLEN);
 
         // create the global transmit buffer space
@@ -3199,7 +4098,7 @@ cbRESULT CreateSharedObjects(UINT32 nInstance)
             _snprintf(buf, sizeof(buf), "%s%d", GLOBAL_XMT_NAME, nInstance);
         cb_xmt_global_buffer_hnd[nIdx] = CreateSharedBuffer(buf, cbXMT_GLOBAL_BUFFSTRUCTSIZE);
         // map the global memory into local ram space and get pointer
-        cb_xmt_global_buffer_ptr[nIdx] = (cbXMTBUFF*)GetSharedBuffer(cb_xmt_global_buffer_hnd[nIdx], false);
+        cb_xmt_global_buffer_ptr[nIdx] = (cbXMTQUEUE*)GetSharedBuffer(cb_xmt_global_buffer_hnd[nIdx], false, cb_shmem_flags[nIdx]);
 
         // clean up if error occurs
         if (cb_xmt_global_buffer_ptr[nIdx] == NULL)
@@ -3212,7 +4111,7 @@ cbRESULT CreateSharedObjects(UINT32 nInstance)
             _snprintf(buf, sizeof(buf), "%s%d", LOCAL_XMT_NAME, nInstance);
         cb_xmt_local_buffer_hnd[nIdx] = CreateSharedBuffer(buf, cbXMT_LOCAL_BUFFSTRUCTSIZE);
         // map the global memory into local ram space and get pointer
-        cb_xmt_local_buffer_ptr[nIdx] = (cbXMTBUFF*)GetSharedBuffer(cb_xmt_local_buffer_hnd[nIdx], false);
+        cb_xmt_local_buffer_ptr[nIdx] = (cbXMTBUFF*)GetSharedBuffer(cb_xmt_local_buffer_hnd[nIdx], false, cb_shmem_flags[nIdx]);
 
         // clean up if error occurs
         if (cb_xmt_local_buffer_ptr[nIdx] == NULL)
@@ -3220,9 +4119,10 @@ cbRESULT CreateSharedObjects(UINT32 nInstance)
 
         // initialize the buffers...they MUST all be initialized to 0 for later logic to work!!
         memset(cb_xmt_global_buffer_ptr[nIdx], 0, cbXMT_GLOBAL_BUFFSTRUCTSIZE);
-        cb_xmt_global_buffer_ptr[nIdx]->bufferlen = cbXMT_GLOBAL_BUFFLEN;
-        cb_xmt_global_buffer_ptr[nIdx]->last_valid_index =
-            cbXMT_GLOBAL_BUFFLEN - (cbCER_UDP_SIZE_MAX / 4) - 1; // assuming largest packet   array is 0 based
+        cb_xmt_global_buffer_ptr[nIdx]->slotcount = cbXMTSLOTS;
+        // every slot is free for the first round
+        for (UINT32 i = 0; i < cbXMTSLOTS; ++i)
+            cb_xmt_global_buffer_ptr[nIdx]->slot[i].seq = i;
 
 
         memset(cb_xmt_local_buffer_ptr[nIdx], 0, cbXMT_LOCAL_BUFFSTRUCTSIZE);
@@ -3238,7 +4138,7 @@ cbRESULT CreateSharedObjects(UINT32 nInstance)
     else
         _snprintf(buf, sizeof(buf), "%s%d", CFG_BUF_NAME, nInstance);
     cb_cfg_buffer_hnd[nIdx] = CreateSharedBuffer(buf, sizeof(cbCFGBUFF));
-    cb_cfg_buffer_ptr[nIdx] = (cbCFGBUFF*)GetSharedBuffer(cb_cfg_buffer_hnd[nIdx], false);
+    cb_cfg_buffer_ptr[nIdx] = (cbCFGBUFF*)GetSharedBuffer(cb_cfg_buffer_hnd[nIdx], false, cb_shmem_flags[nIdx]);
     if (cb_cfg_buffer_ptr[nIdx] == NULL)
         return cbRESULT_BUFCFGALLOCERR;
 
@@ -3250,7 +4150,7 @@ cbRESULT CreateSharedObjects(UINT32 nInstance)
     else
         _snprintf(buf, sizeof(buf), "%s%d", STATUS_BUF_NAME, nInstance);
     cb_pc_status_buffer_hnd[nIdx] = CreateSharedBuffer(buf, sizeof(cbPcStatus));
-    cb_pc_status_buffer_ptr[nIdx] = (cbPcStatus*)GetSharedBuffer(cb_pc_status_buffer_hnd[nIdx], false);
+    cb_pc_status_buffer_ptr[nIdx] = (cbPcStatus*)GetSharedBuffer(cb_pc_status_buffer_hnd[nIdx], false, cb_shmem_flags[nIdx]);
     if (cb_pc_status_buffer_ptr[nIdx] == NULL)
         return cbRESULT_BUFPCSTATALLOCERR;
 
@@ -3261,24 +4161,51 @@ cbRESULT CreateSharedObjects(UINT32 nInstance)
         _snprintf(buf, sizeof(buf), "%s", SPK_BUF_NAME);
     else
         _snprintf(buf, sizeof(buf), "%s%d", SPK_BUF_NAME, nInstance);
-    cb_spk_buffer_hnd[nIdx] = CreateSharedBuffer(buf, sizeof(cbSPKBUFF));
-    cb_spk_buffer_ptr[nIdx] = (cbSPKBUFF*)GetSharedBuffer(cb_spk_buffer_hnd[nIdx], false);
+    if (nSpkCacheDepth == 0)
+        nSpkCacheDepth = cbPKT_SPKCACHEPKTCNT;
+    if (nSpkCacheDepth > cbPKT_SPKCACHEPKTCNT_MAX)
+        nSpkCacheDepth = cbPKT_SPKCACHEPKTCNT_MAX;
+    const UINT32 nLineSize = sizeof(cbSPKCACHE) + sizeof(cbPKT_SPK) * nSpkCacheDepth;
+    const UINT32 cbSPKBUFFSTRUCTSIZE = sizeof(cbSPKBUFF) + nLineSize * cbPKT_SPKCACHELINECNT;
+    cb_spk_buffer_hnd[nIdx] = CreateSharedBuffer(buf, cbSPKBUFFSTRUCTSIZE);
+    cb_spk_buffer_ptr[nIdx] = (cbSPKBUFF*)GetSharedBuffer(cb_spk_buffer_hnd[nIdx], false, cb_shmem_flags[nIdx]);
     if (cb_spk_buffer_ptr[nIdx] == NULL)
         return cbRESULT_BUFSPKALLOCERR;
 
-    memset(cb_spk_buffer_ptr[nIdx], 0, sizeof(cbSPKBUFF));
+    memset(cb_spk_buffer_ptr[nIdx], 0, cbSPKBUFFSTRUCTSIZE);
     cb_spk_buffer_ptr[nIdx]->chidmax  = cbPKT_SPKCACHELINECNT;
-    cb_spk_buffer_ptr[nIdx]->linesize = sizeof(cbSPKCACHE);
-    cb_spk_buffer_ptr[nIdx]->spkcount = cbPKT_SPKCACHEPKTCNT;
+    cb_spk_buffer_ptr[nIdx]->linesize = nLineSize;
+    cb_spk_buffer_ptr[nIdx]->spkcount = nSpkCacheDepth;
     for (int l=0; l<cbPKT_SPKCACHELINECNT; l++)
     {
-        cb_spk_buffer_ptr[nIdx]->cache[l].chid    = l+1;
-        cb_spk_buffer_ptr[nIdx]->cache[l].pktcnt  = cbPKT_SPKCACHEPKTCNT;
-        cb_spk_buffer_ptr[nIdx]->cache[l].pktsize = sizeof(cbPKT_SPK);
+        cbSPKCACHE * pCache = (cbSPKCACHE*)( ((BYTE*)&(cb_spk_buffer_ptr[nIdx]->cache)) + l * nLineSize );
+        pCache->chid    = l+1;
+        pCache->pktcnt  = nSpkCacheDepth;
+        pCache->pktsize = sizeof(cbPKT_SPK);
     }
 
+    // Create the shared reader positions, readers can do without it so it is not an error if unsuccessful
+    if (nInstance == 0)
+        _snprintf(buf, sizeof(buf), "%s", READER_BUF_NAME);
+    else
+        _snprintf(buf, sizeof(buf), "%s%d", READER_BUF_NAME, nInstance);
+    cb_reader_buffer_hnd[nIdx] = CreateSharedBuffer(buf, sizeof(cbREADERBUFF));
+    cb_reader_buffer_ptr[nIdx] = (cbREADERBUFF*)GetSharedBuffer(cb_reader_buffer_hnd[nIdx], false, cb_shmem_flags[nIdx]);
+    if (cb_reader_buffer_ptr[nIdx])
+        memset(cb_reader_buffer_ptr[nIdx], 0, sizeof(cbREADERBUFF));
+
+    // Create the packet index, readers can do without it so it is not an error if unsuccessful
+    if (nInstance == 0)
+        _snprintf(buf, sizeof(buf), "%s", INDEX_BUF_NAME);
+    else
+        _snprintf(buf, sizeof(buf), "%s%d", INDEX_BUF_NAME, nInstance);
+    cb_index_buffer_hnd[nIdx] = CreateSharedBuffer(buf, sizeof(cbINDEXBUFF));
+    cb_index_buffer_ptr[nIdx] = (cbINDEXBUFF*)GetSharedBuffer(cb_index_buffer_hnd[nIdx], false, cb_shmem_flags[nIdx]);
+    if (cb_index_buffer_ptr[nIdx])
+        memset(cb_index_buffer_ptr[nIdx], 0, sizeof(cbINDEXBUFF));
+
     // initialize the configuration fields
-    cb_cfg_buffer_ptr[nIdx]->version = 96;
+    cb_cfg_buffer_ptr[nIdx]->version = cbCFGBUFF_VERSION;
     cb_cfg_buffer_ptr[nIdx]->colortable.dispback     = RGB(  0,  0,  0);
     cb_cfg_buffer_ptr[nIdx]->colortable.dispgridmaj  = RGB( 80, 80, 80);
     cb_cfg_buffer_ptr[nIdx]->colortable.dispgridmin  = RGB( 48, 48, 48);
@@ -3320,6 +4247,10 @@ cbRESULT CreateSharedObjects(UINT32 nInstance)
             return cbRESULT_EVSIGERR;
     }
     cb_sig_event_hnd[nIdx] = sem;
+#if defined(QT_APP) && defined(__linux__)
+    // Where wakeups are sent to the readers from
+    OpenSignalSocket(nIdx, nInstance, false);
+#endif
 #endif
 
     // No erro happned
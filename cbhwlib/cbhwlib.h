@@ -352,6 +352,7 @@ typedef unsigned int cbRESULT;
 #define cbRESULT_INSTINVALID       24   // Invalid range or instrument address
 #define cbRESULT_SOCKBIND          25   // Cannot bind to any address (possibly no Instrument network)
 #define cbRESULT_SYSLOCK           26   // Cannot (un)lock the system resources (possiblly resource busy)
+#define cbRESULT_BUFVERSIONERR     27   // Shared buffers were created by the Central App with another layout
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 //
@@ -378,11 +379,22 @@ UINT32 cbVersion(void);
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 
 #ifdef __cplusplus
+// Shared memory options for cbOpen
+#define cbSHMEM_HUGEPAGES   0x01    // Back the shared buffers with huge pages where available (stand-alone only)
+#define cbSHMEM_PREFAULT    0x02    // Fault all the pages in when the buffers are mapped
+#define cbSHMEM_LOCK        0x04    // Lock the buffers in physical memory (may need privileges or limits raised)
+
 // Open multiple instances of library as stand-alone or under Central application
-cbRESULT cbOpen(BOOL bStandAlone = FALSE, UINT32 nInstance = 0);
+cbRESULT cbOpen(BOOL bStandAlone = FALSE, UINT32 nInstance = 0, UINT32 nRecBufLen = 0, UINT32 nShmFlags = 0,
+                UINT32 nSpkCacheDepth = 0);
 // Initializes the Neuromatic library (and establishes a link to the Central Control Application if bStandAlone is FALSE).
 // This function must be called before any other functions are called from this library.
+// If stand-alone nRecBufLen is the receive buffer length in UINT32 units (0 for cbRECBUFFLEN), otherwise
+//  the receive buffer length is whatever the Central Control Application created it with.
+// nShmFlags is a combination of cbSHMEM_* options, each one silently falls back to normal pages if unavailable.
+// If stand-alone nSpkCacheDepth is the number of spikes cached per channel (0 for cbPKT_SPKCACHEPKTCNT).
 // Returns OK, NOCENTRALAPP, LIBINITERROR, MEMORYUNVAIL, or HARDWAREOFFLINE
+//  or BUFVERSIONERR if the Central Control Application created the buffers with another cbCFGBUFF_VERSION
 
 cbRESULT cbClose(BOOL bStandAlone = FALSE, UINT32 nInstance = 0);
 // Close the library (must match how library is openned)
@@ -497,10 +509,23 @@ cbRESULT cbCheckforData(cbLevelOfConcern & nLevelOfConcern, UINT32 *pktstogo = N
 
 cbRESULT cbWaitforData(UINT32 nInstance = 0);
 // Executes a WaitForSingleObject command to wait for the Central App event signal
+// On Linux each reader waits on a socket of its own, so every reader wakes up on each signal.
 //
 // Returns: cbRESULT_OK    if there is new data in the buffer
 //          cbRESULT_NONEWDATA if the function timed out after 250ms
 //          cbRESULT_DATALOST if the Central App incoming data buffer has wrapped the read buffer
+
+cbRESULT cbSignalData(UINT32 nInstance = 0);
+// Wakes up every process waiting in cbWaitforData, called by the application filling the buffers
+//
+// Returns: cbRESULT_OK if successful, cbRESULT_NOLIBRARY if the library was not initialized
+
+cbRESULT cbGetDataSignal(int *pFd, UINT32 nInstance = 0);
+// Gets the descriptor this process is woken up on, so that it can be added to poll, select or epoll.
+// It becomes readable when there is new data; call cbWaitforData then (it returns at once and clears it).
+//
+// Returns: cbRESULT_OK if successful
+//          cbRESULT_INVALIDFUNCTION if this process has no descriptor of its own (not Linux, or no reader slot)
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 //
 // NEV file definitions
@@ -510,8 +535,111 @@ cbRESULT cbWaitforData(UINT32 nInstance = 0);
 cbPKT_GENERIC *cbGetNextPacketPtr(UINT32 nInstance = 0);
 // Returns pointer to next packet in the shared memory space.  If no packet available, returns NULL
 
+class cbPacketSpan;
+
+cbRESULT cbGetPacketSpan(cbPacketSpan *span, UINT32 nInstance = 0);
+// Get all the packets available in the shared memory space at once, to go through with span->next().
+// Nothing is read until the span is committed, the read position only moves once then.
+//
+// Returns: cbRESULT_OK if there are new packets
+//          cbRESULT_NONEWDATA if there is no new packet (the span is empty)
+//          cbRESULT_NOLIBRARY if the library was not properly initialized
+
+cbRESULT cbCommitPacketSpan(const cbPacketSpan *span, UINT32 nInstance = 0);
+// Read the packets of the span returned by span->next() so far, the rest are returned again by the next span.
+// Check for data loss with cbCheckforData before or after, as with cbGetNextPacketPtr.
+//
+// Returns: cbRESULT_OK if successful
+//          cbRESULT_INVALIDADDRESS if packets were read since the span was taken (no longer the current position)
+//          cbRESULT_NOLIBRARY if the library was not properly initialized
+
+// Packets available in the receive buffer (see cbGetPacketSpan)
+class cbPacketSpan
+{
+public:
+    cbPacketSpan() :
+        m_pBuffer(NULL),
+        m_pLast(NULL),
+        m_nCount(0),
+        m_nRead(0),
+        m_nProcessed(0),
+        m_nWrap(0),
+        m_nIndex(0),
+        m_nWrapAt(0),
+        m_nBufferLen(0),
+        m_bMirrored(false)
+        {
+        }
+    UINT32 count() const { return m_nCount; } // Number of packets in the span
+    UINT32 read() const { return m_nRead; }   // Number of packets returned by next() so far
+    // Returns the next packet of the span, NULL after the last one
+    cbPKT_GENERIC * next()
+    {
+        if (m_nRead == m_nCount)
+            return NULL;
+        m_pLast = (cbPKT_GENERIC *)&m_pBuffer[m_nIndex];
+        m_nIndex += cbPKT_HEADER_32SIZE + m_pLast->dlen;
+        // Packets run into the mirror of a mirrored buffer, otherwise none starts too close to the end
+        if (m_nIndex > m_nWrapAt)
+        {
+            m_nIndex = m_bMirrored ? m_nIndex - m_nBufferLen : 0;
+            m_nWrap++;
+        }
+        m_nRead++;
+        return m_pLast;
+    }
+
+private:
+    friend cbRESULT cbGetPacketSpan(cbPacketSpan *span, UINT32 nInstance);
+    friend cbRESULT cbCommitPacketSpan(const cbPacketSpan *span, UINT32 nInstance);
+    UINT32 * m_pBuffer;         // Receive buffer data
+    cbPKT_GENERIC * m_pLast;    // Last packet returned
+    UINT32 m_nCount;            // Number of packets in the span
+    UINT32 m_nRead;             // Number of packets returned
+    UINT32 m_nProcessed;        // Packets processed when the span was taken
+    UINT32 m_nWrap;             // Wrap count of the next packet
+    UINT32 m_nIndex;            // Index of the next packet
+    UINT32 m_nWrapAt;           // The index wraps around past this
+    UINT32 m_nBufferLen;        // Receive buffer length
+    bool m_bMirrored;           // If the receive buffer is mirrored
+};
+
+cbRESULT cbGetReaderStatus(UINT32 reader, UINT32 *pid, UINT32 *lag, UINT32 *overruns, UINT32 nInstance = 0);
+// Get the status of a process reading the receive buffer (reader is 0 to cbMAXREADERS-1)
+// The lag is the number of packets received but not yet read by that reader.
+//
+// Returns: cbRESULT_OK if the reader slot is in use
+//          cbRESULT_INVALIDADDRESS if there is no such reader
+
+cbRESULT cbGetNextIndexedPacket(UINT32 ring, cbPKT_GENERIC **ppPkt, UINT32 nInstance = 0);
+// Get the next packet of one channel or group (ring is cbINDEX_CHAN(chid), cbINDEX_GROUP(group) or cbINDEX_CONFIG)
+// Each ring is read independently of the others and of cbGetNextPacketPtr, starting with what arrives after cbOpen.
+//
+// Returns: cbRESULT_OK if *ppPkt points to the next packet in the receive buffer
+//          cbRESULT_NONEWDATA if there is no new packet
+//          cbRESULT_DATALOST if packets were missed because the reader fell behind, reading starts over with new ones
+//          cbRESULT_INVALIDFUNCTION if the application filling the buffers does not keep the index
+//          cbRESULT_INVALIDADDRESS if there is no such ring
+
 // Cerebus Library function to send packets via the Central Application Queue
 cbRESULT cbSendPacket(void * pPacket, UINT32 nInstance = 0);
+// If the queue is full, waits a little (up to 20ms) for the Central App to send what is queued.
+//
+// Returns: cbRESULT_OK if the packet is queued
+//          cbRESULT_MEMORYUNAVAIL if the queue stayed full
+
+cbRESULT cbSendPackets(void * const * ppPackets, UINT32 nCount, UINT32 nInstance = 0);
+// Queues nCount packets at once and in order, either all of them or none. Never waits.
+//
+// Returns: cbRESULT_OK if the packets are queued
+//          cbRESULT_MEMORYUNAVAIL if there is not enough room in the queue for all of them (see cbWaitforXmtSpace)
+//          cbRESULT_INVALIDFUNCTION if a packet is larger than cbPKT_MAX_SIZE
+
+cbRESULT cbWaitforXmtSpace(UINT32 nCount, UINT32 nTimeoutMs, UINT32 nInstance = 0);
+// Waits until there is room in the Central Application Queue for nCount packets, or the timeout elapses.
+//
+// Returns: cbRESULT_OK if there is room
+//          cbRESULT_MEMORYUNAVAIL if there was not enough room in time, or never could be
 cbRESULT cbSendLoopbackPacket(void * pPacket, UINT32 nInstance = 0);
 
 #endif
@@ -2946,28 +3074,51 @@ void cbSetRMSAutoThresholdDistance(float fRMSAutoThresholdDistance, UINT32 nInst
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
 
-#define cbPKT_SPKCACHEPKTCNT  400
+#define cbPKT_SPKCACHEPKTCNT      400       // Default number of spikes cached per channel
+#define cbPKT_SPKCACHEPKTCNT_MAX  10000     // Maximum number of spikes cached per channel
 #define cbPKT_SPKCACHELINECNT cbNUM_ANALOG_CHANS
 
+// The number of spikes cached per channel is chosen by the application that creates the cache (see cbOpen),
+//  the pragmas allow a zero-length data field entry in the structures for referencing the data.
+// A cache line changes while its seq is odd, readers that copy from it can check that seq is the same
+//  even number before and after (cbGetSpkCacheSince does).
+#ifdef _MSC_VER
+#pragma warning(push)
+#pragma warning(disable:4200)
+#endif
 typedef struct {
     UINT32 chid;            // ID of the Channel
     UINT32 pktcnt;          // # of packets which can be saved
     UINT32 pktsize;         // Size of an individual packet
     UINT32 head;            // Where (0 based index) in the circular buffer to place the NEXT packet.
     UINT32 valid;           // How many packets have come in since the last configuration
-    cbPKT_SPK spkpkt[cbPKT_SPKCACHEPKTCNT];     // Circular buffer of the cached spikes
+    UINT32 seq;             // Sequence number of the changes to the line (odd while changing)
+    cbPKT_SPK spkpkt[0];    // Circular buffer of the cached spikes...there are actually "pktcnt" of them
 } cbSPKCACHE;
 
 typedef struct {
     UINT32 flags;
     UINT32 chidmax;
-    UINT32 linesize;
-    UINT32 spkcount;
-    cbSPKCACHE cache[cbPKT_SPKCACHELINECNT];
+    UINT32 linesize;        // size of each cache line in bytes <----------------------+
+    UINT32 spkcount;        // number of spikes cached per channel                      |
+    UINT32 cache[0];        // the cache lines (cbSPKCACHE)...there are actually "chidmax"--+ of them
 } cbSPKBUFF;
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif
 
 cbRESULT cbGetSpkCache(UINT32 chid, cbSPKCACHE **cache, UINT32 nInstance = 0);
 
+cbRESULT cbGetSpkCacheSince(UINT32 chid, UINT32 *cursor, cbPKT_SPK *spikes, UINT32 *count, UINT32 nInstance = 0);
+// Copy the cached spikes of a channel that came in after the cursor, oldest first.
+// The cursor counts spikes since the last channel configuration, start with 0 and pass back what is returned.
+// On input count is how many spikes fit in spikes, on output it is how many were copied.
+//
+// Returns: cbRESULT_OK if successful (count may be 0)
+//          cbRESULT_DATALOST if spikes after the cursor were no longer in the cache (the oldest ones still there are copied)
+//          cbRESULT_NONEWDATA if the line kept changing while copied, try again
+//          cbRESULT_INVALIDCHANNEL if there is no cache for the channel
+
 #ifdef WIN32
 enum WM_USER_GLOBAL
 {
@@ -2977,14 +3128,74 @@ enum WM_USER_GLOBAL
 #endif
 
 
-#define cbRECBUFFLEN 4194304
+// Packets are stored back to back in the receive buffer. Unless the buffer is mirrored, a datagram
+//  never runs past the end and the head (and tail) index wraps around to 0 as soon as it gets within
+//  cbCER_UDP_SIZE_MAX of the end. If the buffer is mirrored buffer[bufferlen + i] is buffer[i],
+//  packets simply run past the end and the index wraps around at bufferlen.
+// Datagrams received in a batch are written up to writeahead past the head index before the head
+//  moves past them, readers must stay at least that far ahead of the head on the next wraparound.
+// The length of the buffer is chosen by the application that creates it (see cbOpen),
+//  the pragmas allow a zero-length data field entry in the structure for referencing the data.
+#define cbRECBUFFLEN     4194304    // Default receive buffer length (units of UINT32)
+#define cbRECBUFFLEN_MIN 262144     // Minimum receive buffer length (units of UINT32)
+#define cbRECBUFFLEN_MAX 268435456  // Maximum receive buffer length (units of UINT32)
+#define cbRECBUFFLEN_GRAIN 16384    // Receive buffer length is a multiple of this (64KB, so that it can be mirrored)
+#ifdef _MSC_VER
+#pragma warning(push)
+#pragma warning(disable:4200)
+#endif
 typedef struct {
     UINT32 received;
     UINT32 lasttime;
     UINT32 headwrap;
     UINT32 headindex;
-    UINT32 buffer[cbRECBUFFLEN];
+    UINT32 bufferlen;   // number of indexes in buffer (units of UINT32) <------+
+    UINT32 writeahead;  // how far past the head index may be written (units of UINT32)
+    UINT32 owner;       // process id of the application filling the buffer
+    UINT32 buffer[0];   // big buffer of data...there are actually "bufferlen"--+ indices
 } cbRECBUFF;
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif
+
+// Each process reading the receive buffer publishes its read position in a slot of its own,
+//  so that the process filling the buffer can see how far behind each reader is
+#define cbMAXREADERS 16
+typedef struct {
+    UINT32 pid;         // Process id of the reader (0 if slot is free)
+    UINT32 processed;   // Number of packets read (compare with cbRECBUFF received)
+    UINT32 tailwrap;    // Read position wraparound count
+    UINT32 tailindex;   // Read position index
+    UINT32 overruns;    // Number of times data was lost because the reader fell a whole buffer behind
+    UINT32 reserved[11]; // Readers do not share cache lines
+} cbREADERCURSOR;
+
+typedef struct {
+    cbREADERCURSOR reader[cbMAXREADERS];
+} cbREADERBUFF;
+
+// The process filling the receive buffer also keeps the position of the latest packets of each channel,
+//  sample group and of the configuration packets in a ring of their own, so that a reader interested
+//  in only a few of them can go straight to their packets
+#define cbINDEXLEN          2048                        // Number of packet positions each ring keeps (must be a power of 2)
+#define cbINDEX_CONFIG      0                           // Ring of the configuration packets
+#define cbINDEX_CHAN(ch)    (ch)                        // Ring of the packets of a channel (1-based)
+#define cbINDEX_GROUP(g)    (cbMAXCHANS + (g))          // Ring of the packets of a sample group (1 to cbMAXGROUPS-1)
+#define cbINDEXRINGS        (cbMAXCHANS + cbMAXGROUPS)  // Number of rings
+typedef struct {
+    UINT32 wrap;        // Receive buffer wraparound count of the packet
+    UINT32 index;       // Receive buffer index of the packet
+} cbINDEXENTRY;
+
+typedef struct {
+    UINT32 count;       // Number of packets put in the ring so far, latest one is at (count - 1) % cbINDEXLEN
+    UINT32 reserved;
+    cbINDEXENTRY entry[cbINDEXLEN];
+} cbINDEXRING;
+
+typedef struct {
+    cbINDEXRING ring[cbINDEXRINGS];
+} cbINDEXBUFF;
 
 #ifdef _MSC_VER
 // The following structure is used to hold Cerebus packets queued for transmission to the NSP.
@@ -3008,6 +3219,28 @@ typedef struct {
     UINT32 buffer[0];       // big buffer of data...there are actually "bufferlen"--+ indices
 } cbXMTBUFF;
 
+// The following structure is the queue of Cerebus packets for transmission to the NSP, any process may add to it.
+// Each packet takes a fixed size slot and a queue position that increases forever (wrapping around at 2^32).
+// The slot for position pos is free when its sequence number is pos, and holds the packet once it is pos + 1.
+// Writers reserve any number of slots at once by moving headindex ahead, then fill each one and set its
+// sequence number. The Central App sends the packets in order, sets each slot sequence number to
+// pos + slotcount to free it for the next round and then moves tailindex ahead.
+#define cbXMTSLOTS  512     // Number of packets the transmit queue holds (must be a power of 2)
+typedef struct {
+    UINT32 seq;                         // Sequence number (see above)
+    UINT32 packet[cbPKT_MAX_SIZE / 4];  // The packet
+} cbXMTSLOT;
+
+typedef struct {
+    UINT32 headindex;       // Queue position of the next slot to reserve
+    UINT32 reserved1[15];   // Writers and the Central App do not share cache lines
+    UINT32 tailindex;       // Queue position of the next packet to send
+    UINT32 transmitted;     // How many packets have we sent out?
+    UINT32 reserved2[14];
+    UINT32 slotcount;       // number of slots in the queue <--------------+
+    cbXMTSLOT slot[0];      // the slots...there are actually "slotcount"--+ of them
+} cbXMTQUEUE;
+
 #ifdef _MSC_VER
 #pragma warning(pop)
 #endif
@@ -3048,6 +3281,47 @@ public:
     void SetBlockRecording(bool bBlockRecording) { m_iBlockRecording += bBlockRecording ? 1 : -1; }
 };
 
+// Sections of the configuration buffer that have generation counters
+#define cbCFGSECT_SYSINFO       0   // sysinfo
+#define cbCFGSECT_PROCINFO      1   // procinfo
+#define cbCFGSECT_BANKINFO      2   // bankinfo
+#define cbCFGSECT_GROUPINFO     3   // groupinfo
+#define cbCFGSECT_FILTINFO      4   // filtinfo
+#define cbCFGSECT_ADAPTINFO     5   // adaptinfo
+#define cbCFGSECT_REFELECINFO   6   // refelecinfo
+#define cbCFGSECT_CHANINFO      7   // chaninfo
+#define cbCFGSECT_SORTING       8   // isSortingOptions
+#define cbCFGSECT_WAVEFORM      9   // isWaveform
+#define cbCFGSECT_LNC           10  // isLnc
+#define cbCFGSECT_NPLAY         11  // isNPlay
+#define cbCFGSECT_NM            12  // isVideoSource and isTrackObj
+#define cbCFGSECT_FILECFG       13  // fileinfo
+#define cbCFGSECTIONS           14
+
+// Generation counters of the configuration, the application filling the buffers counts every change
+// and keeps the count of the last change to each section and to each channel, group and filter.
+// An entry changed after a generation if its count is greater than that generation.
+typedef struct {
+    UINT32 generation;                  // Number of changes to the configuration so far
+    UINT32 section[cbCFGSECTIONS];      // Generation of the last change to each section
+    UINT32 chaninfo[cbMAXCHANS];        // Generation of the last change to each channel
+    UINT32 groupinfo[cbMAXGROUPS];      // Generation of the last change to each sample group
+    UINT32 filtinfo[cbMAXFILTS];        // Generation of the last change to each filter
+} cbCFGGENERATION;
+
+cbRESULT cbGetCfgGeneration(cbCFGGENERATION *generation, UINT32 nInstance = 0);
+// Copy the generation counters of the configuration.
+// Entries changing during the copy may have a count greater than the copied generation.
+//
+// Returns: cbRESULT_OK if successful
+//          cbRESULT_NOLIBRARY if the library was not properly initialized
+//          cbRESULT_INVALIDFUNCTION if the buffers were created with a layout that has no counters
+
+// Layout version of cbCFGBUFF and of all the other shared buffers, change it whenever any of them changes
+//  (97 added the generation counters, the receive buffer length and write-ahead, the transmit slot queue
+//  and the spike cache sequence), cbOpen refuses buffers created with another one
+#define cbCFGBUFF_VERSION  97
+
 typedef struct {
     UINT32          version;
     UINT32          sysflags;
@@ -3069,6 +3343,7 @@ typedef struct {
     cbVIDEOSOURCE   isVideoSource[cbMAXVIDEOSOURCE]; // Video source
     cbTRACKOBJ      isTrackObj[cbMAXTRACKOBJ];       // Trackable objects
     cbPKT_FILECFG   fileinfo; // File recording status
+    cbCFGGENERATION generation; // Generation counters of the above
     // This must be at the bottom of this structure because it is variable size 32-bit or 64-bit
     // depending on the compile settings e.g. 64-bit cbmex communicating with 32-bit Central
     HANDLE          hwndCentral;    // Handle to the Window in Central
@@ -3106,13 +3381,18 @@ typedef enum _cbStateCCF
 // External Global Variables
 
 extern HANDLE      cb_xmt_global_buffer_hnd[cbMAXOPEN];       // Transmit queues to send out of this PC
-extern cbXMTBUFF*  cb_xmt_global_buffer_ptr[cbMAXOPEN];
+extern cbXMTQUEUE* cb_xmt_global_buffer_ptr[cbMAXOPEN];
 
 extern HANDLE      cb_xmt_local_buffer_hnd[cbMAXOPEN];        // Transmit queues only for local (this PC) use
 extern cbXMTBUFF*  cb_xmt_local_buffer_ptr[cbMAXOPEN];
 
 extern HANDLE       cb_rec_buffer_hnd[cbMAXOPEN];
 extern cbRECBUFF*   cb_rec_buffer_ptr[cbMAXOPEN];
+extern UINT32       cb_rec_buffer_mirrored[cbMAXOPEN];  // If the receive buffer is followed by a mirror of itself
+extern HANDLE       cb_reader_buffer_hnd[cbMAXOPEN];
+extern cbREADERBUFF* cb_reader_buffer_ptr[cbMAXOPEN];    // Read positions of the processes reading the receive buffer
+extern HANDLE       cb_index_buffer_hnd[cbMAXOPEN];
+extern cbINDEXBUFF*  cb_index_buffer_ptr[cbMAXOPEN];     // Positions of the packets of each channel and group
 extern HANDLE       cb_cfg_buffer_hnd[cbMAXOPEN];
 extern cbCFGBUFF*   cb_cfg_buffer_ptr[cbMAXOPEN];
 extern HANDLE       cb_pc_status_buffer_hnd[cbMAXOPEN];
@@ -21,6 +21,7 @@
 #include "CCFUtils.h"
 #include <QMutex>
 #include <QWaitCondition>
+#include <QAtomicInt>
 
 // Wrapper class for SDK Qt application
 class SdkApp : public InstNetwork, public InstNetwork::Listener
@@ -33,9 +34,22 @@ public:
     UINT32 GetInstInfo() {return m_instInfo;}
     cbRESULT GetLastCbErr() {return m_lastCbErr;}
     void Open(UINT32 id, int nInPort = cbNET_UDP_PORT_BCAST, int nOutPort = cbNET_UDP_PORT_CNT,
-        LPCSTR szInIP = cbNET_UDP_ADDR_INST, LPCSTR szOutIP = cbNET_UDP_ADDR_CNT, int nRecBufSize = NSP_REC_BUF_SIZE);
+        LPCSTR szInIP = cbNET_UDP_ADDR_INST, LPCSTR szOutIP = cbNET_UDP_ADDR_CNT, int nRecBufSize = NSP_REC_BUF_SIZE,
+        int nRecBatchSize = NSP_REC_BATCH_SIZE, NetLoopType nNetLoop = NET_LOOP_TIMER, bool bRecvThread = false,
+        QThread::Priority nNetPriority = QThread::HighPriority, UINT64 nNetAffinity = 0, int nBusyPoll = 0,
+        int nXmtRate = NSP_XMT_RATE, int nXmtBurst = NSP_XMT_BURST, int nXmtWindow = Instrument::XMT_WINDOW,
+        UINT32 nRecRingLen = 0, UINT32 nShmFlags = 0, UINT32 nSpkCacheDepth = 0);
 private:
+    struct ContinuousData;
+    struct ChannelScaling;
     void OnPktGroup(const cbPKT_GROUP * const pkt);
+    ContinuousData * GroupData(int group) const;
+    bool UpdateGroupLayout(int group, ContinuousData * pCD);
+    void InvalidateGroupLayout();
+    void GetScaling(UINT32 chan, ChannelScaling & scaling);
+    UINT32 GroupWidth(int group);
+    bool UpdateGroupScaling(int group);
+    bool ScaleGroup(const cbPKT_GROUP * const pkt, cbSdkScaledGroup * scaled);
     void OnPktEvent(const cbPKT_GENERIC * const pPkt);
     void OnPktComment(const cbPKT_COMMENT * const pPkt);
     void OnPktTrack(const cbPKT_VIDEOTRACK * const pPkt);
@@ -44,6 +58,12 @@ private:
     void LinkFailureEvent(cbSdkPktLostEvent & lost);
     void InstInfoEvent(UINT32 instInfo);
     cbSdkResult unsetTrialConfig(cbSdkTrialType type);
+    struct EventData;
+    void freeEventData(EventData * pED);
+    void WaitTrialReaders();
+    cbSdkResult getTrialCont(ContinuousData * pCD, UINT32 bActive, UINT32 startTime, cbSdkTrialCont * trialcont);
+    cbSdkResult getTrialRows(ContinuousData * pCD, UINT32 bActive, cbSdkTrialCont * trialcont);
+    cbSdkResult initTrialCont(ContinuousData * pCD, cbSdkTrialCont * trialcont);
 
 public:
     // ---------------------------
@@ -56,24 +76,34 @@ public:
     cbSdkResult SdkWriteCCF(cbSdkCCF * pData, const char * szFileName, bool bThreaded);
     cbSdkResult SdkOpen(UINT32 nInstance, cbSdkConnectionType conType, cbSdkConnection con);
     cbSdkResult SdkGetType(cbSdkConnectionType * conType, cbSdkInstrumentType * instType);
+    cbSdkResult SdkGetLostPackets(UINT32 * heartbeats, UINT32 * groups);
+    cbSdkResult SdkGetRecvLatency(cbSdkRecvLatency * latency, bool bReset);
+    cbSdkResult SdkGetReaderStatus(cbSdkReaderStatus * readers, UINT32 * count);
+    cbSdkResult SdkGetConfigChanges(UINT32 generation, cbSdkConfigChanges * changes);
+    cbSdkResult SdkGetQueueDepth(UINT32 * recvDepth, UINT32 * procDepth, UINT32 * procOverruns);
     cbSdkResult SdkUnsetTrialConfig(cbSdkTrialType type);
     cbSdkResult SdkClose();
     cbSdkResult SdkGetTime(UINT32 * cbtime);
+    cbSdkResult SdkGetRecvTime(INT64 * recvtime, INT64 * hosttime);
     cbSdkResult SdkGetSpkCache(UINT16 channel, cbSPKCACHE **cache);
+    cbSdkResult SdkGetSpkCacheSince(UINT16 channel, UINT32 * cursor, cbPKT_SPK * spikes, UINT32 * count);
     cbSdkResult SdkGetTrialConfig(UINT32 * pbActive, UINT16 * pBegchan, UINT32 * pBegmask, UINT32 * pBegval,
                                   UINT16 * pEndchan, UINT32 * pEndmask, UINT32 * pEndval, bool * pbDouble,
                                   UINT32 * puWaveforms, UINT32 * puConts, UINT32 * puEvents,
-                                  UINT32 * puComments, UINT32 * puTrackings, bool * pbAbsolute);
+                                  UINT32 * puComments, UINT32 * puTrackings, bool * pbAbsolute,
+                                  UINT32 * puRaws, bool * pbScaled, bool * pbInterleaved);
     cbSdkResult SdkSetTrialConfig(UINT32 bActive, UINT16 begchan, UINT32 begmask, UINT32 begval,
                                   UINT16 endchan, UINT32 endmask, UINT32 endval, bool bDouble,
                                   UINT32 uWaveforms, UINT32 uConts, UINT32 uEvents, UINT32 uComments, UINT32 uTrackings,
-                                  bool bAbsolute);
+                                  bool bAbsolute, UINT32 uRaws, bool bScaled, bool bInterleaved);
     cbSdkResult SdkGetChannelLabel(UINT16 channel, UINT32 * bValid, char * label, UINT32 * userflags, INT32 * position);
     cbSdkResult SdkSetChannelLabel(UINT16 channel, const char * label, UINT32 userflags, INT32 * position);
     cbSdkResult SdkGetTrialData(UINT32 bActive, cbSdkTrialEvent * trialevent, cbSdkTrialCont * trialcont,
-                                cbSdkTrialComment * trialcomment, cbSdkTrialTracking * trialtracking);
+                                cbSdkTrialComment * trialcomment, cbSdkTrialTracking * trialtracking,
+                                cbSdkTrialCont * trialraw);
     cbSdkResult SdkInitTrialData(cbSdkTrialEvent* trialevent, cbSdkTrialCont * trialcont,
-                                 cbSdkTrialComment * trialcomment, cbSdkTrialTracking * trialtracking);
+                                 cbSdkTrialComment * trialcomment, cbSdkTrialTracking * trialtracking,
+                                 cbSdkTrialCont * trialraw);
     cbSdkResult SdkSetFileConfig(const char * filename, const char * comment, UINT32 bStart, UINT32 options);
     cbSdkResult SdkGetFileConfig(char * filename, char * username, bool * pbRecording);
     cbSdkResult SdkSetPatientInfo(const char * ID, const char * firstname, const char * lastname,
@@ -117,6 +147,7 @@ private:
     bool m_bChannelMask[cbMAXCHANS];
     cbPKT_VIDEOSYNCH m_lastPktVideoSynch; // last video synchronization packet
 
+    QMutex m_lockLost;
     cbSdkPktLostEvent m_lastLost; // Last lost event
     cbSdkInstInfo m_lastInstInfo; // Last instrument info event
 
@@ -132,8 +163,14 @@ private:
     /////////////////////////////////////////////////////////////////////////////
     // Declarations for tracking the beginning and end of trials
 
+    // Continuous and event caches are written and read without these, they are only held by the
+    //  application threads to publish, detach or clear them (allocation and freeing is done outside)
     QMutex m_lockTrial;
     QMutex m_lockTrialEvent;
+    // Threads writing (the network thread) or reading the continuous and event caches without the locks,
+    //  a detached cache is only freed once there is none (see WaitTrialReaders)
+    QAtomicInt m_nTrialReaders;
+    UINT32 m_nTrialGeneration;    // Last continuous (or raw) cache published, guarded by m_lockTrial
     QMutex m_lockTrialComment;
     QMutex m_lockTrialTracking;
 
@@ -145,11 +182,14 @@ private:
     UINT32 m_uTrialEndValue;      // Value the masked data is compared to identify trial end
     bool   m_bTrialDouble;        // If data storage (spike or continuous) is double
     bool   m_bTrialAbsolute;      // Absolute trial timing all events
+    bool   m_bTrialScaled;        // If continuous data is returned in physical units (when double)
+    bool   m_bTrialInterleaved;   // If continuous data is stored in rows of each sample group
     UINT32 m_uTrialWaveforms;     // If spike waveform should be stored and returned
     UINT32 m_uTrialConts;         // Number of continuous data to buffer
     UINT32 m_uTrialEvents;        // Number of events to buffer
     UINT32 m_uTrialComments;      // Number of comments to buffer
     UINT32 m_uTrialTrackings;     // Number of tracking data to buffer
+    UINT32 m_uTrialRaws;          // Number of raw data to buffer
 
     UINT32 m_bWithinTrial;        // True is we are within a trial, False if not within a trial
 
@@ -160,28 +200,161 @@ private:
     /////////////////////////////////////////////////////////////////////////////
     // Declarations for the data caching structures and variables
 
-    // Structure to store all of the variables associated with the continuous data
+    // Scaling of an analog channel to its physical units, as gain * sample + offset
+    struct ChannelScaling
+    {
+        double gain;
+        double offset;
+    };
+
+    // Structure to store all of the variables associated with the continuous (or raw) data
+    //  the samples of all channels are in one slab, with a row per channel padded to a cache line,
+    //  or if interleaved with the rows of each sample group, a row holding a sample of each of its channels
+    //  samples (or rows) are counted from the reset of the cache, the network thread writes them and the
+    //  headers without a lock, the reading thread only frees them by moving its read counts
     struct ContinuousData
     {
-        UINT32 size; // default is cbSdk_CONTINUOUS_DATA_SAMPLES
-        UINT16 current_sample_rates[cbNUM_ANALOG_CHANS];        // The continuous sample rate on each channel, in samples/s
-        INT16 * continuous_channel_data[cbNUM_ANALOG_CHANS];
-        UINT32 write_index[cbNUM_ANALOG_CHANS];                 // next index location to write data
-        UINT32 write_start_index[cbNUM_ANALOG_CHANS];           // index location that writing began
+        enum {CACHE_LINE_SAMPLES = 64 / sizeof(INT16)}; // Samples in a cache line
+        UINT32 size; // default is cbSdk_CONTINUOUS_DATA_SAMPLES (cbSdk_RAW_DATA_SAMPLES suggested for raw data)
+        bool interleaved;   // If the slab has the rows of each sample group rather than a row per channel
+        UINT32 chan_step;   // Distance in the slab from a channel to the next (if not interleaved)
+        size_t slab_len;    // Number of samples in the slab, including padding
+        INT16 * slab;       // Samples of all channels, aligned to a cache line
+        INT16 * slab_alloc; // Allocated memory the slab is in
+        UINT32 generation;  // Which cache this is, the group layouts of another one are not pushed to it
+
+        // Header of a channel (if not interleaved), only the network thread writes it
+        struct ChannelHeader
+        {
+            UINT32 write_index;     // next index location to write data
+            UINT32 write_count;     // number of samples written
+            UINT32 valid_count;     // first sample in the current sample rate
+            UINT32 scale_seq;       // odd while the scaling is changed
+            UINT32 scale_count;     // first sample in the current scaling
+            UINT16 rate;            // The continuous sample rate, in samples/s
+            ChannelScaling scaling; // current scaling
+        } chan_header[cbNUM_ANALOG_CHANS];
+        // Number of samples of each channel read or dropped, only the reading thread writes it
+        //  (apart from the headers, so that it does not share their cache lines)
+        UINT32 read_count[cbNUM_ANALOG_CHANS];
+
+        // Header of the rows of a sample group (if interleaved), only the network thread writes it
+        struct GroupHeader
+        {
+            size_t base;            // Where the rows start in the slab
+            UINT32 row_step;        // Distance from a row to the next, the most channels the rows have room for
+            UINT32 write_index;     // next row to write
+            UINT32 write_count;     // number of rows written
+            UINT32 layout_seq;      // odd while the layout or scaling is changed
+            UINT32 valid_count;     // first row in the current layout
+            UINT32 scale_count;     // first row in the current scaling
+            UINT16 rate;            // The group sample rate, in samples/s
+            UINT16 width;           // Number of channels in a row, 0 if the group has more than there is room for
+            UINT16 chan[cbNUM_ANALOG_CHANS];            // The channel (0-based) of each sample in a row
+            ChannelScaling scaling[cbNUM_ANALOG_CHANS]; // The scaling of each sample in a row
+        } group_header[cbMAXGROUPS]; // Indexed by sample group
+        // Number of rows of each sample group read or dropped, only the reading thread writes it
+        UINT32 group_read_count[cbMAXGROUPS];
+
+        ContinuousData() : size(0), interleaved(false), chan_step(0), slab_len(0), slab(NULL), slab_alloc(NULL), generation(0) {}
+
+        // Samples of a channel (0-based)
+        INT16 * channel_data(UINT32 ch) {return slab + ch * chan_step;}
+
+        // Rows of a sample group
+        INT16 * group_rows(UINT32 group) {return slab + group_header[group].base;}
+
+        void set_rate(UINT32 ch, UINT16 rate);
+        void set_scaling(UINT32 ch, const ChannelScaling & rScaling);
+        void set_rows(UINT32 group, UINT16 rate, UINT32 count, const UINT16 * chan, const ChannelScaling * scaling);
+        UINT32 pending(UINT32 ch, UINT32 & first, ChannelScaling * pScaling) const;
+        UINT32 pending_rows(UINT32 group, UINT32 & first, GroupHeader & rRows, bool bScaled) const;
+        void flush();
+
+        // Allocate the slab for nSize samples of each channel, returns false if out of memory
+        //  if interleaved the rows of each sample group have room for as many channels as given for it
+        bool alloc(UINT32 nSize, bool bInterleaved, const UINT32 * widths)
+        {
+            size = nSize;
+            interleaved = bInterleaved;
+            // Each channel (or group) starts on a cache line of its own
+            chan_step = (size + CACHE_LINE_SAMPLES - 1) & ~(CACHE_LINE_SAMPLES - 1);
+            slab_len = (size_t)chan_step * cbNUM_ANALOG_CHANS;
+            if (interleaved)
+            {
+                chan_step = 0;
+                slab_len = 0;
+            }
+            for (UINT32 group = 0; group < cbMAXGROUPS; ++group)
+            {
+                group_header[group].base = slab_len;
+                group_header[group].row_step = interleaved ? widths[group] : 0;
+                if (interleaved)
+                    slab_len += ((size_t)size * widths[group] + CACHE_LINE_SAMPLES - 1) & ~(size_t)(CACHE_LINE_SAMPLES - 1);
+            }
+            try {
+                slab_alloc = new INT16[slab_len + CACHE_LINE_SAMPLES];
+            } catch (...) {
+                slab_alloc = NULL;
+            }
+            if (slab_alloc == NULL)
+                return false;
+            slab = (INT16 *)(((size_t)slab_alloc + 63) & ~(size_t)63);
+            return true;
+        }
+
+        void release()
+        {
+            delete[] slab_alloc;
+            slab_alloc = slab = NULL;
+            size = 0;
+            slab_len = 0;
+        }
 
         void reset()
         {
             if (size)
+                memset(slab, 0, slab_len * sizeof(INT16));
+            memset(chan_header, 0, sizeof(chan_header));
+            memset(read_count, 0, sizeof(read_count));
+            for (UINT32 ch = 0; ch < cbNUM_ANALOG_CHANS; ++ch)
+                chan_header[ch].scaling.gain = 1.0;
+            // The rows stay where they were allocated
+            for (UINT32 group = 0; group < cbMAXGROUPS; ++group)
             {
-                for (UINT32 i = 0; i < cbNUM_ANALOG_CHANS; ++i)
-                    memset(continuous_channel_data[i], 0, size * sizeof(INT16));
+                GroupHeader & rRows = group_header[group];
+                rRows.write_index = rRows.write_count = 0;
+                rRows.layout_seq = rRows.valid_count = rRows.scale_count = 0;
+                rRows.rate = rRows.width = 0;
             }
-            memset(current_sample_rates, 0, sizeof(current_sample_rates));
-            memset(write_index, 0, sizeof(write_index));
-            memset(write_start_index, 0, sizeof(write_start_index));
+            memset(group_read_count, 0, sizeof(group_read_count));
         }
 
     } * m_CD;
+    ContinuousData * m_RD; // Raw stream data, kept apart because a channel can be both in a sample group and raw
+
+    // Layout of the sample group packets, so that the configuration is not read for each packet
+    //  it is only valid until a group or channel configuration comes in or another cache is published
+    //  (the group scaling below is invalidated with it), only the network thread uses it
+    struct GroupLayout
+    {
+        bool valid;                         // If the layout is up-to-date
+        UINT32 generation;                  // The cache the rates and scaling of the channels were pushed to
+        UINT16 rate;                        // The group sample rate, in samples/s
+        UINT32 count;                       // Number of samples to keep from each packet
+        UINT16 sample[cbNUM_ANALOG_CHANS];  // Where each sample to keep is in the packet data
+        UINT16 chan[cbNUM_ANALOG_CHANS];    // The continuous channel (0-based) each sample goes to
+    } m_groupLayout[cbMAXGROUPS]; // Indexed by sample group
+
+    // Scaling of the samples of a sample group packet in packet order, for the scaled continuous callback
+    struct GroupScaling
+    {
+        bool valid;                         // If the scaling is up-to-date
+        UINT32 length;                      // Number of samples in the group
+        UINT16 chan[cbNUM_ANALOG_CHANS];    // Channel number (1-based) of each sample
+        float gain[cbNUM_ANALOG_CHANS];     // Gain of each sample
+        float offset[cbNUM_ANALOG_CHANS];   // Offset of each sample
+    } m_groupScaling[cbMAXGROUPS + 1]; // Indexed by sample group
 
     // Structure to store all of the variables associated with the event data
     struct EventData
@@ -0,0 +1,112 @@
+//////////////////////////////////////////////////////////////////////
+//
+// (c) Copyright 2013 Blackrock Microsystems
+//
+// $Workfile: SdkConvert.h $
+// $Archive: /Cerebus/Human/WindowsApps/cbmex/SdkConvert.h $
+//
+// $NoKeywords: $
+//
+//////////////////////////////////////////////////////////////////////
+//
+// PURPOSE:
+//
+// Conversion of samples to floating point, shared by the SDK and the unit tests
+//  the vector path is chosen at compile time (AVX2, then SSE2, then scalar)
+//
+
+#ifndef SDKCONVERT_H_INCLUDED
+#define SDKCONVERT_H_INCLUDED
+
+#include "cbhwlib.h"
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define CBSDK_CONVERT_PATH "AVX2"
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CBSDK_SSE2
+#include <emmintrin.h>
+#ifndef CBSDK_CONVERT_PATH
+#define CBSDK_CONVERT_PATH "SSE2"
+#endif
+#endif
+#ifndef CBSDK_CONVERT_PATH
+#define CBSDK_CONVERT_PATH "scalar"
+#endif
+
+// Purpose: Widen samples to double precision, as gain * sample + offset
+//           (vectorized where the compiler targets AVX2 or SSE2)
+// Inputs:
+//   src    - the samples
+//   count  - number of samples
+//   gain   - what each sample is multiplied by
+//   offset - what is added to each scaled sample
+// Outputs:
+//   dst - the converted samples
+static inline void ConvertSamples(double * dst, const INT16 * src, UINT32 count, double gain, double offset)
+{
+    UINT32 i = 0;
+#if defined(__AVX2__)
+    const __m256d vgain = _mm256_set1_pd(gain);
+    const __m256d voffset = _mm256_set1_pd(offset);
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i v = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(src + i)));
+        __m256d lo = _mm256_cvtepi32_pd(_mm256_castsi256_si128(v));
+        __m256d hi = _mm256_cvtepi32_pd(_mm256_extracti128_si256(v, 1));
+        _mm256_storeu_pd(dst + i, _mm256_add_pd(_mm256_mul_pd(lo, vgain), voffset));
+        _mm256_storeu_pd(dst + i + 4, _mm256_add_pd(_mm256_mul_pd(hi, vgain), voffset));
+    }
+#elif defined(CBSDK_SSE2)
+    const __m128d vgain = _mm_set1_pd(gain);
+    const __m128d voffset = _mm_set1_pd(offset);
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        // Sign extend to 32-bit
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        _mm_storeu_pd(dst + i, _mm_add_pd(_mm_mul_pd(_mm_cvtepi32_pd(lo), vgain), voffset));
+        _mm_storeu_pd(dst + i + 2, _mm_add_pd(_mm_mul_pd(_mm_cvtepi32_pd(_mm_unpackhi_epi64(lo, lo)), vgain), voffset));
+        _mm_storeu_pd(dst + i + 4, _mm_add_pd(_mm_mul_pd(_mm_cvtepi32_pd(hi), vgain), voffset));
+        _mm_storeu_pd(dst + i + 6, _mm_add_pd(_mm_mul_pd(_mm_cvtepi32_pd(_mm_unpackhi_epi64(hi, hi)), vgain), voffset));
+    }
+#endif
+    for (; i < count; ++i)
+        dst[i] = src[i] * gain + offset;
+}
+
+// Purpose: Widen samples of different channels to single precision, as gain[i] * sample[i] + offset[i]
+//           (vectorized where the compiler targets AVX2 or SSE2)
+// Inputs:
+//   src    - the samples
+//   gain   - what each sample is multiplied by
+//   offset - what is added to each scaled sample
+//   count  - number of samples
+// Outputs:
+//   dst - the converted samples
+static inline void ScaleSamples(float * dst, const INT16 * src, const float * gain, const float * offset, UINT32 count)
+{
+    UINT32 i = 0;
+#if defined(__AVX2__)
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 v = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(src + i))));
+        _mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_mul_ps(v, _mm256_loadu_ps(gain + i)), _mm256_loadu_ps(offset + i)));
+    }
+#elif defined(CBSDK_SSE2)
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        // Sign extend to 32-bit
+        __m128 lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16));
+        __m128 hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16));
+        _mm_storeu_ps(dst + i, _mm_add_ps(_mm_mul_ps(lo, _mm_loadu_ps(gain + i)), _mm_loadu_ps(offset + i)));
+        _mm_storeu_ps(dst + i + 4, _mm_add_ps(_mm_mul_ps(hi, _mm_loadu_ps(gain + i + 4)), _mm_loadu_ps(offset + i + 4)));
+    }
+#endif
+    for (; i < count; ++i)
+        dst[i] = src[i] * gain[i] + offset[i];
+}
+
+#endif // include guard
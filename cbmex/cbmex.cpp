@@ -64,6 +64,7 @@ namespace
         CBMEX_FUNCTION_SYSTEM,
         CBMEX_FUNCTION_SYNCHOUT,
         CBMEX_FUNCTION_EXT,
+        CBMEX_FUNCTION_SPIKECACHE,
 
         CBMEX_FUNCTION_COUNT,  // This must be the last item
     } MexFxnIndex;
@@ -101,6 +102,7 @@ namespace
         table["system"        ] = NAME_PAIR(&::OnSystem,        CBMEX_FUNCTION_SYSTEM);
         table["synchout"      ] = NAME_PAIR(&::OnSynchOut,      CBMEX_FUNCTION_SYNCHOUT);
         table["ext"           ] = NAME_PAIR(&::OnExtCmd,        CBMEX_FUNCTION_EXT);
+        table["spikecache"    ] = NAME_PAIR(&::OnSpikeCache,    CBMEX_FUNCTION_SPIKECACHE);
         return table;
     };
 };
@@ -138,6 +140,9 @@ void PrintErrorSDK(cbSdkResult res, const char * szCustom = NULL)
 
     switch(res)
     {
+    case CBSDKRESULT_WARNDATALOST:
+        mexWarnMsgTxt("Some data was lost");
+        break;
     case CBSDKRESULT_WARNCONVERT:
         mexErrMsgTxt("File conversion is needed");
         break;
@@ -247,6 +252,9 @@ void PrintErrorSDK(cbSdkResult res, const char * szCustom = NULL)
     case CBSDKRESULT_ERROFFLINE:
         mexErrMsgTxt("Instrument is offline");
         break;
+    case CBSDKRESULT_ERRCENTRALVERSION:
+        mexErrMsgTxt("Central is running with another library version");
+        break;
     default:
         {
             char errstr[128];
@@ -291,6 +299,7 @@ void PrintHelp(MexFxnIndex fxnidx, bool bErr = false, const char * szCustom = NU
         CBMEX_USAGE_SYSTEM,
         CBMEX_USAGE_SYNCHOUT,
         CBMEX_USAGE_EXTENSION,
+        CBMEX_USAGE_SPIKECACHE,
 
         // Keep this in the end
         CBMEX_USAGE_CBMEX
@@ -376,6 +385,18 @@ void OnOpen(
         PARAM_NONE,
         PARAM_INSTANCE,
         PARAM_RECBUFSIZE,
+        PARAM_RECBATCHSIZE,
+        PARAM_NETLOOP,
+        PARAM_RECVTHREAD,
+        PARAM_NETPRIORITY,
+        PARAM_NETAFFINITY,
+        PARAM_BUSYPOLL,
+        PARAM_XMTRATE,
+        PARAM_XMTBURST,
+        PARAM_XMTWINDOW,
+        PARAM_RECVRING,
+        PARAM_SHMEM,
+        PARAM_SPKCACHE,
         PARAM_INST_IP,
         PARAM_INST_PORT,
         PARAM_CENTRAL_IP,
@@ -402,6 +423,54 @@ void OnOpen(
             {
             	param = PARAM_RECBUFSIZE;
             }
+            else if (_strcmpi(cmdstr, "receive-batch-size") == 0)
+            {
+                param = PARAM_RECBATCHSIZE;
+            }
+            else if (_strcmpi(cmdstr, "network-loop") == 0)
+            {
+                param = PARAM_NETLOOP;
+            }
+            else if (_strcmpi(cmdstr, "receive-thread") == 0)
+            {
+                param = PARAM_RECVTHREAD;
+            }
+            else if (_strcmpi(cmdstr, "network-priority") == 0)
+            {
+                param = PARAM_NETPRIORITY;
+            }
+            else if (_strcmpi(cmdstr, "network-affinity") == 0)
+            {
+                param = PARAM_NETAFFINITY;
+            }
+            else if (_strcmpi(cmdstr, "busy-poll") == 0)
+            {
+                param = PARAM_BUSYPOLL;
+            }
+            else if (_strcmpi(cmdstr, "transmit-rate") == 0)
+            {
+                param = PARAM_XMTRATE;
+            }
+            else if (_strcmpi(cmdstr, "transmit-burst") == 0)
+            {
+                param = PARAM_XMTBURST;
+            }
+            else if (_strcmpi(cmdstr, "transmit-window") == 0)
+            {
+                param = PARAM_XMTWINDOW;
+            }
+            else if (_strcmpi(cmdstr, "receive-ring") == 0)
+            {
+                param = PARAM_RECVRING;
+            }
+            else if (_strcmpi(cmdstr, "shared-memory") == 0)
+            {
+                param = PARAM_SHMEM;
+            }
+            else if (_strcmpi(cmdstr, "spike-cache") == 0)
+            {
+                param = PARAM_SPKCACHE;
+            }
             else if (_strcmpi(cmdstr, "inst-addr") == 0)
             {
                 param = PARAM_INST_IP;
@@ -435,6 +504,88 @@ void OnOpen(
                     PrintHelp(CBMEX_FUNCTION_OPEN, true, "Invalid receive buffer size");
                 con.nRecBufSize = (int)mxGetScalar(prhs[i]);
                 break;
+            case PARAM_RECBATCHSIZE:
+                if (!mxIsNumeric(prhs[i]))
+                    PrintHelp(CBMEX_FUNCTION_OPEN, true, "Invalid receive batch size");
+                con.nRecBatchSize = (int)mxGetScalar(prhs[i]);
+                break;
+            case PARAM_NETLOOP:
+                {
+                    char loopstr[16];
+                    if (mxGetString(prhs[i], loopstr, 16))
+                        PrintHelp(CBMEX_FUNCTION_OPEN, true, "Invalid network loop");
+                    if (_strcmpi(loopstr, "timer") == 0)
+                        con.nNetLoop = CBSDKNETLOOP_TIMER;
+                    else if (_strcmpi(loopstr, "event") == 0)
+                        con.nNetLoop = CBSDKNETLOOP_EVENT;
+                    else if (_strcmpi(loopstr, "spin") == 0)
+                        con.nNetLoop = CBSDKNETLOOP_SPIN;
+                    else
+                        PrintHelp(CBMEX_FUNCTION_OPEN, true, "Invalid network loop");
+                }
+                break;
+            case PARAM_RECVTHREAD:
+                if (!mxIsNumeric(prhs[i]))
+                    PrintHelp(CBMEX_FUNCTION_OPEN, true, "Invalid receive thread");
+                con.bRecvThread = (mxGetScalar(prhs[i]) != 0);
+                break;
+            case PARAM_NETPRIORITY:
+                {
+                    char prioritystr[16];
+                    if (mxGetString(prhs[i], prioritystr, 16))
+                        PrintHelp(CBMEX_FUNCTION_OPEN, true, "Invalid network priority");
+                    if (_strcmpi(prioritystr, "high") == 0)
+                        con.nNetPriority = CBSDKPRIORITY_HIGH;
+                    else if (_strcmpi(prioritystr, "normal") == 0)
+                        con.nNetPriority = CBSDKPRIORITY_NORMAL;
+                    else if (_strcmpi(prioritystr, "highest") == 0)
+                        con.nNetPriority = CBSDKPRIORITY_HIGHEST;
+                    else if (_strcmpi(prioritystr, "time-critical") == 0)
+                        con.nNetPriority = CBSDKPRIORITY_TIMECRITICAL;
+                    else
+                        PrintHelp(CBMEX_FUNCTION_OPEN, true, "Invalid network priority");
+                }
+                break;
+            case PARAM_NETAFFINITY:
+                if (!mxIsNumeric(prhs[i]))
+                    PrintHelp(CBMEX_FUNCTION_OPEN, true, "Invalid network affinity");
+                con.nNetAffinity = (UINT64)mxGetScalar(prhs[i]);
+                break;
+            case PARAM_BUSYPOLL:
+                if (!mxIsNumeric(prhs[i]))
+                    PrintHelp(CBMEX_FUNCTION_OPEN, true, "Invalid busy poll");
+                con.nBusyPoll = (int)mxGetScalar(prhs[i]);
+                break;
+            case PARAM_XMTRATE:
+                if (!mxIsNumeric(prhs[i]))
+                    PrintHelp(CBMEX_FUNCTION_OPEN, true, "Invalid transmit rate");
+                con.nXmtRate = (int)mxGetScalar(prhs[i]);
+                break;
+            case PARAM_XMTBURST:
+                if (!mxIsNumeric(prhs[i]))
+                    PrintHelp(CBMEX_FUNCTION_OPEN, true, "Invalid transmit burst");
+                con.nXmtBurst = (int)mxGetScalar(prhs[i]);
+                break;
+            case PARAM_XMTWINDOW:
+                if (!mxIsNumeric(prhs[i]))
+                    PrintHelp(CBMEX_FUNCTION_OPEN, true, "Invalid transmit window");
+                con.nXmtWindow = (int)mxGetScalar(prhs[i]);
+                break;
+            case PARAM_RECVRING:
+                if (!mxIsNumeric(prhs[i]))
+                    PrintHelp(CBMEX_FUNCTION_OPEN, true, "Invalid receive ring length");
+                con.nRecRingLen = (UINT32)mxGetScalar(prhs[i]);
+                break;
+            case PARAM_SHMEM:
+                if (!mxIsNumeric(prhs[i]))
+                    PrintHelp(CBMEX_FUNCTION_OPEN, true, "Invalid shared memory options");
+                con.nShmFlags = (UINT32)mxGetScalar(prhs[i]);
+                break;
+            case PARAM_SPKCACHE:
+                if (!mxIsNumeric(prhs[i]))
+                    PrintHelp(CBMEX_FUNCTION_OPEN, true, "Invalid spike cache depth");
+                con.nSpkCacheDepth = (UINT32)mxGetScalar(prhs[i]);
+                break;
             case PARAM_INST_IP:
                 if (mxGetString(prhs[i], szInstIp, 16))
                     PrintHelp(CBMEX_FUNCTION_OPEN, true, "Invalid instrument ip address");
@@ -834,6 +985,7 @@ void OnChanLabel(
 //    cbmex('trialconfig', bActive, [ begchan begmask begval endchan endmask endval ], 'double')
 //    cbmex('trialconfig', bActive, [ begchan begmask begval endchan endmask endval ], 'double', 'waveform', 400)
 //    cbmex('trialconfig', bActive, [ begchan begmask begval endchan endmask endval ], 'double', 'nocontinuous')
+//    cbmex('trialconfig', bActive, [ begchan begmask begval endchan endmask endval ], 'raw', 307200)
 void OnTrialConfig(
     int nlhs,              // Number of left hand side (output) arguments
     mxArray *plhs[],       // Array of left hand side arguments
@@ -865,10 +1017,12 @@ void OnTrialConfig(
     UINT32 uEvents    = cbSdk_EVENT_DATA_SAMPLES;
     UINT32 uComments  = 0;
     UINT32 uTrackings = 0;
+    UINT32 uRaws      = 0;
+    bool   bScaled    = false;
     UINT32 bWithinTrial = false;
 
     res = cbSdkGetTrialConfig(nInstance, &bWithinTrial, &uBegChan, &uBegMask, &uBegVal, &uEndChan, &uEndMask, &uEndVal,
-            &bDouble, &uWaveforms, &uConts, &uEvents, &uComments, &uTrackings);
+            &bDouble, &uWaveforms, &uConts, &uEvents, &uComments, &uTrackings, NULL, &uRaws, &bScaled);
 
     if (nFirstParam < nrhs)
     {
@@ -899,6 +1053,7 @@ void OnTrialConfig(
         PARAM_EVENT,
         PARAM_COMMENT,
         PARAM_TRACKING,
+        PARAM_RAW,
         PARAM_INSTANCE,
     } param = PARAM_NONE;
 
@@ -922,6 +1077,11 @@ void OnTrialConfig(
             {
                 bAbsolute = true;
             }
+            else if (_strcmpi(cmdstr, "scaled") == 0)
+            {
+                bScaled = true;
+                bDouble = true;
+            }
             else if (_strcmpi(cmdstr, "nocontinuous") == 0)
             {
                 uConts = 0;
@@ -950,6 +1110,10 @@ void OnTrialConfig(
             {
                 param = PARAM_TRACKING;
             }
+            else if (_strcmpi(cmdstr, "raw") == 0)
+            {
+                param = PARAM_RAW;
+            }
             else if (_strcmpi(cmdstr, "instance") == 0)
             {
                 param = PARAM_INSTANCE;
@@ -986,6 +1150,11 @@ void OnTrialConfig(
                     PrintHelp(CBMEX_FUNCTION_TRIALCONFIG, true, "Invalid tracking count");
                 uTrackings = (UINT32)mxGetScalar(prhs[i]);
                 break;
+            case PARAM_RAW:
+                if (!mxIsNumeric(prhs[i]))
+                    PrintHelp(CBMEX_FUNCTION_TRIALCONFIG, true, "Invalid raw count");
+                uRaws = (UINT32)mxGetScalar(prhs[i]);
+                break;
             case PARAM_INSTANCE:
                 if (!mxIsNumeric(prhs[i]))
                     PrintHelp(CBMEX_FUNCTION_TRIALCONFIG, true, "Invalid instance number");
@@ -1004,7 +1173,7 @@ void OnTrialConfig(
     }
 
     res = cbSdkSetTrialConfig(nInstance, bActive, uBegChan, uBegMask, uBegVal, uEndChan, uEndMask, uEndVal,
-            bDouble, uWaveforms, uConts, uEvents, uComments, uTrackings, bAbsolute);
+            bDouble, uWaveforms, uConts, uEvents, uComments, uTrackings, bAbsolute, uRaws, bScaled);
     PrintErrorSDK(res, "cbSdkSetTrialConfig()");
 
     // process first output argument if available
@@ -1014,7 +1183,7 @@ void OnTrialConfig(
     // process second output argument if available
     if (nlhs > 1)
     {
-        plhs[1] = mxCreateDoubleMatrix(12, 1, mxREAL);
+        plhs[1] = mxCreateDoubleMatrix(13, 1, mxREAL);
         double *pcfgvals = mxGetPr(plhs[1]);
         *(pcfgvals+0) = uBegChan;
         *(pcfgvals+1) = uBegMask;
@@ -1028,6 +1197,7 @@ void OnTrialConfig(
         *(pcfgvals+9) = uEvents;
         *(pcfgvals+10) = uComments;
         *(pcfgvals+11) = uTrackings;
+        *(pcfgvals+12) = uRaws;
     }
 }
 
@@ -1040,6 +1210,7 @@ void OnTrialConfig(
 // [timestamps_cell_array, time, continuous_cell_array] = cbmex('trialdata',  1)
 // [time, continuous_cell_array] = cbmex('trialdata')
 // [time, continuous_cell_array] = cbmex('trialdata',  1)
+// [time, raw_cell_array] = cbmex('trialdata',  1, 'raw')
 //
 // Inputs:
 // the 2nd parameter == 0 means to NOT flush the buffer
@@ -1065,6 +1236,7 @@ void OnTrialData(
     UINT32 nInstance = 0;
     int nFirstParam = 1;
     bool bFlushBuffer = false;
+    bool bRaw = false;
     cbSdkResult res;
 
     // make sure there is at least one output argument
@@ -1105,7 +1277,11 @@ void OnTrialData(
                 sprintf(errstr, "Parameter %d is invalid", i);
                 PrintHelp(CBMEX_FUNCTION_TRIALDATA, true, errstr);
             }
-            if (_strcmpi(cmdstr, "instance") == 0)
+            if (_strcmpi(cmdstr, "raw") == 0)
+            {
+                bRaw = true;
+            }
+            else if (_strcmpi(cmdstr, "instance") == 0)
             {
                 param = PARAM_INSTANCE;
             } else {
@@ -1135,10 +1311,13 @@ void OnTrialData(
 
     cbSdkTrialEvent trialevent;
     cbSdkTrialCont trialcont;
+    // The continuous output holds either the continuous or the raw data
+    cbSdkTrialCont * pTrialCont = (nlhs >= 2 && !bRaw) ? &trialcont : NULL;
+    cbSdkTrialCont * pTrialRaw = (nlhs >= 2 && bRaw) ? &trialcont : NULL;
 
     // 1 - Get how many samples are waiting
 
-    res = cbSdkInitTrialData(nInstance, nlhs == 2 ? NULL : &trialevent, nlhs >= 2 ? &trialcont : NULL, NULL, NULL);
+    res = cbSdkInitTrialData(nInstance, nlhs == 2 ? NULL : &trialevent, pTrialCont, NULL, NULL, pTrialRaw);
     PrintErrorSDK(res, "cbSdkInitTrialData()");
 
     bool   bTrialDouble    = false;
@@ -1225,7 +1404,7 @@ void OnTrialData(
 
     // 3 - Now get buffered data
 
-    res = cbSdkGetTrialData(nInstance, bFlushBuffer, nlhs == 2 ? NULL : &trialevent, nlhs >= 2 ? &trialcont : NULL, NULL, NULL);
+    res = cbSdkGetTrialData(nInstance, bFlushBuffer, nlhs == 2 ? NULL : &trialevent, pTrialCont, NULL, NULL, pTrialRaw);
     PrintErrorSDK(res, "cbSdkGetTrialData()");
 
     // Does the user want event data?
@@ -3166,6 +3345,138 @@ void OnExtCmd(
     PrintErrorSDK(res, "cbSdkExtCmd()");
 }
 
+// Purpose: Processing to do with the command "spikecache"
+//           Copy the cached spikes of a channel newer than a cursor
+//  IN MATLAB =>
+//    [timestamps, units, waveforms, cursor] = cbmex('spikecache', channel, [<parameter>[, value]])
+void OnSpikeCache(
+    int nlhs,              // Number of left hand side (output) arguments
+    mxArray *plhs[],       // Array of left hand side arguments
+    int nrhs,              // Number of right hand side (input) arguments
+    const mxArray *prhs[] )// Array of right hand side arguments
+{
+    UINT32 nInstance = 0;
+    UINT32 nCursor = 0;
+    UINT32 nCount = cbPKT_SPKCACHEPKTCNT;
+    bool bSamples = false;
+    int nFirstParam = 2;
+
+    if (nrhs < 2)
+        PrintHelp(CBMEX_FUNCTION_SPIKECACHE, true, "Too few inputs provided");
+    if (nlhs > 4)
+        PrintHelp(CBMEX_FUNCTION_SPIKECACHE, true, "Too many outputs requested");
+    if (!mxIsNumeric(prhs[1]) || mxGetNumberOfElements(prhs[1]) != 1)
+        PrintHelp(CBMEX_FUNCTION_SPIKECACHE, true, "Invalid channel number");
+    UINT16 nChannel = (UINT16)mxGetScalar(prhs[1]);
+
+    enum
+    {
+        PARAM_NONE,
+        PARAM_CURSOR,
+        PARAM_COUNT,
+        PARAM_INSTANCE,
+    } param = PARAM_NONE;
+
+    // Process remaining input arguments if available
+    for (int i = nFirstParam; i < nrhs; ++i)
+    {
+        if (param == PARAM_NONE)
+        {
+            char cmdstr[128];
+            if (mxGetString(prhs[i], cmdstr, 16))
+            {
+                char errstr[128];
+                sprintf(errstr, "Parameter %d is invalid", i);
+                PrintHelp(CBMEX_FUNCTION_SPIKECACHE, true, errstr);
+            }
+            if (_strcmpi(cmdstr, "cursor") == 0)
+            {
+                param = PARAM_CURSOR;
+            }
+            else if (_strcmpi(cmdstr, "count") == 0)
+            {
+                param = PARAM_COUNT;
+            }
+            else if (_strcmpi(cmdstr, "instance") == 0)
+            {
+                param = PARAM_INSTANCE;
+            }
+            else if (_strcmpi(cmdstr, "samples") == 0)
+            {
+                bSamples = true;
+            } else {
+                char errstr[128];
+                sprintf(errstr, "Parameter %d (%s) is invalid", i, cmdstr);
+                PrintHelp(CBMEX_FUNCTION_SPIKECACHE, true, errstr);
+            }
+        } else {
+            switch(param)
+            {
+            case PARAM_CURSOR:
+                if (!mxIsNumeric(prhs[i]))
+                    PrintHelp(CBMEX_FUNCTION_SPIKECACHE, true, "Invalid cursor");
+                nCursor = (UINT32)mxGetScalar(prhs[i]);
+                break;
+            case PARAM_COUNT:
+                if (!mxIsNumeric(prhs[i]))
+                    PrintHelp(CBMEX_FUNCTION_SPIKECACHE, true, "Invalid spike count");
+                nCount = (UINT32)mxGetScalar(prhs[i]);
+                if (nCount == 0 || nCount > cbPKT_SPKCACHEPKTCNT_MAX)
+                    PrintHelp(CBMEX_FUNCTION_SPIKECACHE, true, "Invalid spike count");
+                break;
+            case PARAM_INSTANCE:
+                if (!mxIsNumeric(prhs[i]))
+                    PrintHelp(CBMEX_FUNCTION_SPIKECACHE, true, "Invalid instance number");
+                nInstance = (UINT32)mxGetScalar(prhs[i]);
+                break;
+            default:
+                break;
+            }
+            param = PARAM_NONE;
+        }
+    } // end for (int i = nFirstParam
+    if (param != PARAM_NONE)
+    {
+        // Some parameter did not have a value, and value is non-optional
+        PrintHelp(CBMEX_FUNCTION_SPIKECACHE, true, "Last parameter requires value");
+    }
+
+    UINT32 spklength;
+    cbSdkResult res = cbSdkGetSysConfig(nInstance, &spklength);
+    PrintErrorSDK(res, "cbSdkGetSysConfig()");
+    if (spklength > cbMAX_PNTS)
+        spklength = cbMAX_PNTS;
+
+    std::vector<cbPKT_SPK> spikes(nCount);
+    res = cbSdkGetSpkCacheSince(nInstance, nChannel, &nCursor, &spikes[0], &nCount);
+    PrintErrorSDK(res, "cbSdkGetSpkCacheSince()");
+
+    mxArray * mxa = mxCreateDoubleMatrix(nCount, 1, mxREAL);
+    double * pTime = mxGetPr(mxa);
+    for (UINT32 i = 0; i < nCount; ++i)
+        pTime[i] = bSamples ? spikes[i].time : cbSdk_SECONDS_PER_TICK * spikes[i].time;
+    plhs[0] = mxa;
+    if (nlhs > 1)
+    {
+        mxa = mxCreateNumericMatrix(nCount, 1, mxUINT8_CLASS, mxREAL);
+        UINT8 * pUnit = (UINT8 *)mxGetData(mxa);
+        for (UINT32 i = 0; i < nCount; ++i)
+            pUnit[i] = spikes[i].unit;
+        plhs[1] = mxa;
+    }
+    if (nlhs > 2)
+    {
+        // One waveform per column
+        mxa = mxCreateNumericMatrix(spklength, nCount, mxINT16_CLASS, mxREAL);
+        INT16 * pWave = (INT16 *)mxGetData(mxa);
+        for (UINT32 i = 0; i < nCount; ++i)
+            memcpy(pWave + i * spklength, spikes[i].wave, spklength * sizeof(INT16));
+        plhs[2] = mxa;
+    }
+    if (nlhs > 3)
+        plhs[3] = mxCreateDoubleScalar(nCursor);
+}
+
 #ifdef WIN32
 #define MEX_EXPORT
 #else
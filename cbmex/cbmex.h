@@ -43,6 +43,7 @@ void OnCCF           (int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]
 void OnSystem        (int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[] );
 void OnSynchOut      (int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[] );
 void OnExtCmd        (int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[] );
+void OnSpikeCache    (int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[] );
 ////////////////////// end of Prototypes for all of the Matlab events ////////
 
 #define CBMEX_USAGE_CBMEX \
@@ -52,7 +53,8 @@ void OnExtCmd        (int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]
         "<command> is a string and can be any of:\n" \
         "'help', 'open', 'close', 'time', 'trialconfig', 'chanlabel',\n" \
         "'trialdata', 'fileconfig', 'digitalout', 'mask', 'comment', 'config',\n" \
-        "'analogout', 'trialcomment', 'trialtracking', 'ccf', 'system', 'synchout', 'ext'\n" \
+        "'analogout', 'trialcomment', 'trialtracking', 'ccf', 'system', 'synchout', 'ext',\n" \
+        "'spikecache'\n" \
         "Use cbmex('help', <command>) for each command usage\n" \
 
 #define CBMEX_USAGE_HELP \
@@ -76,6 +78,18 @@ void OnExtCmd        (int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]
         "'central-addr', value: value is string containing central ipv4 address\n" \
         "'central-port', value: value is the central port number\n" \
         "'receive-buffer-size', value: override default network buffer size (low value may result in drops)\n" \
+        "'receive-batch-size', value: maximum number of datagrams to receive at once (1 to disable batching)\n" \
+        "'network-loop', value: 'timer' to process network every 10ms (default), 'event' to process as soon as data arrives, 'spin' to never sleep\n" \
+        "'receive-thread', value: 1 to process packets in a thread separate from the receive thread, 0 otherwise (default)\n" \
+        "'network-priority', value: network thread priority 'normal', 'high' (default), 'highest' or 'time-critical'\n" \
+        "'network-affinity', value: mask of CPUs to run network threads on, 0 for any CPU (default)\n" \
+        "'busy-poll', value: microseconds to busy poll the network device on receive, 0 to disable (default)\n" \
+        "'transmit-rate', value: packets per second sent to the instrument, 400 by default\n" \
+        "'transmit-burst', value: maximum number of packets sent to the instrument back to back, 4 by default\n" \
+        "'transmit-window', value: maximum number of packets waiting for a response from the instrument at once (up to 64), 6 by default\n" \
+        "'receive-ring', value: receive buffer length in 32-bit words if stand-alone, 0 for the default of 4M words\n" \
+        "'shared-memory', value: shared memory options, sum of 1 for huge pages, 2 to prefault and 4 to lock in memory, 0 by default\n" \
+        "'spike-cache', value: spikes cached per channel if stand-alone (up to 10000), 0 for the default of 400\n" \
         "\n" \
         "Outputs:\n" \
         " connection (optional): 1 (Central), 2 (UDP)\n" \
@@ -135,6 +149,7 @@ void OnExtCmd        (int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]
         "<parameter>[, value] can be any of:\n" \
         "'double': if specified, the data is in double precision format (old behaviour)\n" \
         "'absolute': if specified event timing is absolute (active will not reset time for events)\n" \
+        "'scaled': if specified, continuous data is in the physical units of each channel (implies 'double')\n" \
         "'nocontinuous': if specified, continuous data cache is not created nor configured (same as 'continuous',0)\n" \
         "'noevent': if specified, event data cache is not created nor configured (same as 'event',0)\n" \
         "'waveform', value: set the number of waveforms to be cached (internal cache if less than 400)\n" \
@@ -142,12 +157,13 @@ void OnExtCmd        (int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]
         "'event', value: set the number of evnets to be cached\n" \
         "'comment', value: set number of comments to be cached\n" \
         "'tracking', value: set the number of video tracking evnets to be cached" \
+        "'raw', value: set the number of raw (30 kHz) data to be cached, raw data is not cached by default\n" \
         "'instance', value: value is the library instance to use (default is 0)\n" \
         "\n" \
         "Outputs:\n" \
         "active_state: return 1 if data collection is active, 0 otherwise\n" \
         "config_vector_out:\n" \
-        " vector [begchan begmask begval endchan endmask endval double waveform continuous event comment tracking]\n" \
+        " vector [begchan begmask begval endchan endmask endval double waveform continuous event comment tracking raw]\n" \
         "  specifying the configuration state\n" \
 
 #define CBMEX_USAGE_TRIALDATA \
@@ -165,6 +181,7 @@ void OnExtCmd        (int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]
         "<parameter>[, value] pairs are optional, some parameters do not have values.\n" \
         " from left to right parameters will override previous ones or combine with them if possible.\n" \
         "<parameter>[, value] can be any of:\n" \
+        "'raw': if specified, continuous_cell_array holds the raw data cached with 'trialconfig' 'raw'\n" \
         "'instance', value: value is the library instance to use (default is 0)\n" \
         "\n" \
         "Outputs:\n" \
@@ -416,4 +433,23 @@ void OnExtCmd        (int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]
         "'terminate': to signal last running command to terminate (if running)\n" \
         "'instance', value: value is the library instance to use (default is 0)\n" \
 
+#define CBMEX_USAGE_SPIKECACHE \
+        "Get the cached spikes of a channel newer than a cursor\n" \
+        "Format: [timestamps, units, waveforms, cursor] = cbmex('spikecache', channel, [<parameter>[, value]])\n" \
+        "Inputs:\n" \
+        "channel: is the channel number (1-based)\n" \
+        "<parameter>[, value] pairs are optional, some parameters do not have values.\n" \
+        " from left to right parameters will override previous ones or combine with them if possible.\n" \
+        "<parameter>[, value] can be any of:\n" \
+        "'cursor', value: value is the cursor returned by the previous call (default is 0 to start)\n" \
+        "'count', value: value is the maximum number of spikes to return (default is 400)\n" \
+        "'samples': if specified timestamps are sample numbers otherwise seconds\n" \
+        "'instance', value: value is the library instance to use (default is 0)\n" \
+        "\n" \
+        "Outputs:\n" \
+        "timestamps: spike timestamps (oldest first)\n" \
+        "units: spike units\n" \
+        "waveforms: one spike waveform per column\n" \
+        "cursor: pass to the next call to get only newer spikes\n" \
+
 #endif /* CBMEX_H_INCLUDED */
@@ -106,6 +106,18 @@ typedef enum {
     CONNECTION_PARAM_CLIENT_ADDR    = 2,
     CONNECTION_PARAM_CLIENT_PORT    = 3,
     CONNECTION_PARAM_RECBUFSIZE     = 4,
+    CONNECTION_PARAM_RECBATCHSIZE   = 5,
+    CONNECTION_PARAM_NETLOOP        = 6,
+    CONNECTION_PARAM_RECVTHREAD     = 7,
+    CONNECTION_PARAM_NETPRIORITY    = 8,
+    CONNECTION_PARAM_NETAFFINITY    = 9,
+    CONNECTION_PARAM_BUSYPOLL       = 10,
+    CONNECTION_PARAM_XMTRATE        = 11,
+    CONNECTION_PARAM_XMTBURST       = 12,
+    CONNECTION_PARAM_XMTWINDOW      = 13,
+    CONNECTION_PARAM_RECVRING       = 14,
+    CONNECTION_PARAM_SHMEM          = 15,
+    CONNECTION_PARAM_SPKCACHE       = 16,
 } CONNECTION_PARAM;
 typedef std::map<std::string, CONNECTION_PARAM> LUT_CONNECTION_PARAM;
 LUT_CONNECTION_PARAM g_lutConnectionParam;
@@ -139,6 +151,7 @@ static int CreateLUTs()
     g_lutPktType["ccf"          ] = cbSdkPkt_CCF;
     g_lutPktType["impedance"    ] = cbSdkPkt_IMPEDANCE;
     g_lutPktType["heartbeat"    ] = cbSdkPkt_SYSHEARTBEAT;
+    g_lutPktType["scaled"       ] = cbSdkPkt_SCALED;
     // Create ChanLabel outputs LUT
     g_lutChanLabelOutputs["none"         ] = CHANLABEL_OUTPUTS_NONE;
     g_lutChanLabelOutputs["label"        ] = CHANLABEL_OUTPUTS_LABEL;
@@ -191,6 +204,18 @@ static int CreateLUTs()
     g_lutConnectionParam["client-addr"         ] = CONNECTION_PARAM_CLIENT_ADDR;
     g_lutConnectionParam["client-port"         ] = CONNECTION_PARAM_CLIENT_PORT;
     g_lutConnectionParam["receive-buffer-size" ] = CONNECTION_PARAM_RECBUFSIZE;
+    g_lutConnectionParam["receive-batch-size"  ] = CONNECTION_PARAM_RECBATCHSIZE;
+    g_lutConnectionParam["network-loop"        ] = CONNECTION_PARAM_NETLOOP;
+    g_lutConnectionParam["receive-thread"      ] = CONNECTION_PARAM_RECVTHREAD;
+    g_lutConnectionParam["network-priority"    ] = CONNECTION_PARAM_NETPRIORITY;
+    g_lutConnectionParam["network-affinity"    ] = CONNECTION_PARAM_NETAFFINITY;
+    g_lutConnectionParam["busy-poll"           ] = CONNECTION_PARAM_BUSYPOLL;
+    g_lutConnectionParam["transmit-rate"       ] = CONNECTION_PARAM_XMTRATE;
+    g_lutConnectionParam["transmit-burst"      ] = CONNECTION_PARAM_XMTBURST;
+    g_lutConnectionParam["transmit-window"     ] = CONNECTION_PARAM_XMTWINDOW;
+    g_lutConnectionParam["receive-ring"        ] = CONNECTION_PARAM_RECVRING;
+    g_lutConnectionParam["shared-memory"       ] = CONNECTION_PARAM_SHMEM;
+    g_lutConnectionParam["spike-cache"         ] = CONNECTION_PARAM_SPKCACHE;
     return 0;
 }
 
@@ -248,12 +273,23 @@ static PyObject * event_data_convert(UINT32 nInstance, cbSdkPktType type, const
         // data points to cbSdkPktLostEvent
     {
         cbSdkPktLostEvent * pPkt = (cbSdkPktLostEvent *)pEventData;
-        char lost_reason[][15] = {"unknown", "link_failure", "pc_nsp", "network"};
+        char lost_reason[][15] = {"unknown", "link_failure", "pc_nsp", "network", "gap", "processing"};
         unsigned int reason = pPkt->type;
-        if (reason > 3)
+        if (reason > 5)
             reason = 0;
         PyObject * pVal = PyString_FromString(lost_reason[reason]);
         PyDict_SetItemString(res, "reason", pVal);
+        if (pPkt->type == CBSDKPKTLOSTEVENT_GAP)
+        {
+            pVal = PyLong_FromLong(pPkt->stream);
+            PyDict_SetItemString(res, "stream", pVal);
+            pVal = PyLong_FromLong(pPkt->lost);
+            PyDict_SetItemString(res, "lost", pVal);
+            pVal = PyLong_FromUnsignedLong(pPkt->time);
+            PyDict_SetItemString(res, "time", pVal);
+            pVal = PyLong_FromUnsignedLong(pPkt->nexttime);
+            PyDict_SetItemString(res, "nexttime", pVal);
+        }
     }
         break;
     case cbSdkPkt_INSTINFO:
@@ -336,6 +372,27 @@ static PyObject * event_data_convert(UINT32 nInstance, cbSdkPktType type, const
     case cbSdkPkt_SYSHEARTBEAT:
         // data points to cbPKT_SYSHEARTBEAT
         break;
+    case cbSdkPkt_SCALED:
+        // data points to cbSdkScaledGroup
+    {
+        PyArrayObject * pArr;
+        PyObject * pVal;
+        cbSdkScaledGroup * pPkt = (cbSdkScaledGroup *)pEventData;
+        pVal = PyLong_FromLong(pPkt->group);
+        PyDict_SetItemString(res, "group", pVal);
+        pVal = PyLong_FromUnsignedLong(pPkt->time);
+        PyDict_SetItemString(res, "time", pVal);
+        int dims[2] = {pPkt->count, 1};
+        pArr = (PyArrayObject *)PyArray_FromDims(1, dims, NPY_UINT16);
+        for (int i = 0; i < pPkt->count; ++i)
+            *((UINT16 *)(UINT8 *)PyArray_DATA(pArr) + i) = pPkt->chan[i];
+        PyDict_SetItemString(res, "channels", (PyObject *)pArr);
+        pArr = (PyArrayObject *)PyArray_FromDims(1, dims, NPY_FLOAT32);
+        for (int i = 0; i < pPkt->count; ++i)
+            *((float *)(UINT8 *)PyArray_DATA(pArr) + i) = pPkt->data[i];
+        PyDict_SetItemString(res, "data", (PyObject *)pArr);
+    }
+        break;
     }
 
     return res;
@@ -455,6 +512,8 @@ PyDoc_STRVAR(cbpy_register__doc__,
 "           'ccf': CCF saving, loading or converting status\n"
 "           'impedance': impedence data\n"
 "           'heartbeat': system heartbeat\n"
+"           'scaled': continuous packet data in the physical units of each channel\n"
+"               data_item is {'group', group_number, 'time', timestamp, 'channels', channel_array, 'data', data_array}\n"
 "   callback - callable object to be invoked when event of given type happens\n"
 "               function signature of callable(callback_param, data_item_list) is expected\n"
 "           Previously registered callback for given type (if any) will be unregistered.\n"
@@ -528,10 +587,12 @@ static PyObject * cbpy_register(PyObject *self, PyObject *args, PyObject *keywds
     g_callback_param[nInstance][type] = my_callback_param;
     PyGILState_Release(g_gilState);
 
-    cbSdkResult sdkres = cbSdkCallbackStatus(nInstance, CBSDKCALLBACK_ALL);
+    // Scaled data is not sent to the callback of all packets
+    cbSdkCallbackType callbacktype = (type == cbSdkPkt_SCALED) ? CBSDKCALLBACK_SCALED : CBSDKCALLBACK_ALL;
+    cbSdkResult sdkres = cbSdkCallbackStatus(nInstance, callbacktype);
     if (sdkres == CBSDKRESULT_SUCCESS)
     {
-        sdkres = cbSdkRegisterCallback(nInstance, CBSDKCALLBACK_ALL, &sdk_callback, (void *)NULL);
+        sdkres = cbSdkRegisterCallback(nInstance, callbacktype, &sdk_callback, (void *)NULL);
         if (sdkres != CBSDKRESULT_SUCCESS)
             cbPySetErrorFromSdkError(sdkres);
         if (sdkres < CBSDKRESULT_SUCCESS)
@@ -556,6 +617,18 @@ PyDoc_STRVAR(cbpy_open__doc__,
 "           'client-addr': client IPv4 address.\n"
 "           'client-port': client port number.\n"
 "           'receive-buffer-size': override default network buffer size (low value may result in drops).\n"
+"           'receive-batch-size': maximum number of datagrams to receive at once (1 to disable batching).\n"
+"           'network-loop': 'timer' to process network every 10ms (default), 'event' to process as soon as data arrives, 'spin' to never sleep.\n"
+"           'receive-thread': 1 to process packets in a thread separate from the receive thread, 0 otherwise (default).\n"
+"           'network-priority': network thread priority 'normal', 'high' (default), 'highest' or 'time-critical'.\n"
+"           'network-affinity': mask of CPUs to run network threads on, 0 for any CPU (default).\n"
+"           'busy-poll': microseconds to busy poll the network device on receive, 0 to disable (default).\n"
+"           'transmit-rate': packets per second sent to the instrument, 400 by default.\n"
+"           'transmit-burst': maximum number of packets sent to the instrument back to back, 4 by default.\n"
+"           'transmit-window': maximum number of packets waiting for a response from the instrument at once (up to 64), 6 by default.\n"
+"           'receive-ring': receive buffer length in 32-bit words if stand-alone, 0 for the default of 4M words.\n"
+"           'shared-memory': shared memory options, sum of 1 for huge pages, 2 to prefault and 4 to lock in memory, 0 by default.\n"
+"           'spike-cache': spikes cached per channel if stand-alone (up to 10000), 0 for the default of 400.\n"
 "   instance - (optional) library instance number\n"
 "Outputs:\n"
 "   dictionary with following keys\n"
@@ -641,6 +714,104 @@ static PyObject * cbpy_open(PyObject *self, PyObject *args, PyObject *keywds)
                 else
                     return PyErr_Format(PyExc_TypeError, "Invalid receive buffer size number; should be integer");
                 break;
+            case CONNECTION_PARAM_RECBATCHSIZE:
+                if (PyInt_Check(pValue))
+                    con.nRecBatchSize = PyInt_AsLong(pValue);
+                else
+                    return PyErr_Format(PyExc_TypeError, "Invalid receive batch size number; should be integer");
+                break;
+            case CONNECTION_PARAM_NETLOOP:
+                {
+                    if (PyUnicode_Check(pValue))
+                        return PyErr_Format(PyExc_TypeError, "Invalid network loop; unicode not supported yet");
+                    const char * pszLoop = PyString_AsString(pValue);
+                    if (pszLoop == NULL)
+                        return PyErr_Format(PyExc_TypeError, "Invalid network loop; should be string");
+                    if (_strcmpi(pszLoop, "timer") == 0)
+                        con.nNetLoop = CBSDKNETLOOP_TIMER;
+                    else if (_strcmpi(pszLoop, "event") == 0)
+                        con.nNetLoop = CBSDKNETLOOP_EVENT;
+                    else if (_strcmpi(pszLoop, "spin") == 0)
+                        con.nNetLoop = CBSDKNETLOOP_SPIN;
+                    else
+                        return PyErr_Format(PyExc_ValueError, "Invalid network loop (%s); should be: timer, event, spin", pszLoop);
+                }
+                break;
+            case CONNECTION_PARAM_RECVTHREAD:
+                if (PyInt_Check(pValue))
+                    con.bRecvThread = (PyInt_AsLong(pValue) != 0);
+                else
+                    return PyErr_Format(PyExc_TypeError, "Invalid receive thread; should be integer");
+                break;
+            case CONNECTION_PARAM_NETPRIORITY:
+                {
+                    if (PyUnicode_Check(pValue))
+                        return PyErr_Format(PyExc_TypeError, "Invalid network priority; unicode not supported yet");
+                    const char * pszPriority = PyString_AsString(pValue);
+                    if (pszPriority == NULL)
+                        return PyErr_Format(PyExc_TypeError, "Invalid network priority; should be string");
+                    if (_strcmpi(pszPriority, "high") == 0)
+                        con.nNetPriority = CBSDKPRIORITY_HIGH;
+                    else if (_strcmpi(pszPriority, "normal") == 0)
+                        con.nNetPriority = CBSDKPRIORITY_NORMAL;
+                    else if (_strcmpi(pszPriority, "highest") == 0)
+                        con.nNetPriority = CBSDKPRIORITY_HIGHEST;
+                    else if (_strcmpi(pszPriority, "time-critical") == 0)
+                        con.nNetPriority = CBSDKPRIORITY_TIMECRITICAL;
+                    else
+                        return PyErr_Format(PyExc_ValueError, "Invalid network priority (%s); should be: normal, high, highest, time-critical", pszPriority);
+                }
+                break;
+            case CONNECTION_PARAM_NETAFFINITY:
+                if (PyInt_Check(pValue))
+                    con.nNetAffinity = (UINT64)PyInt_AsLong(pValue);
+                else if (PyLong_Check(pValue))
+                    con.nNetAffinity = PyLong_AsUnsignedLongLong(pValue);
+                else
+                    return PyErr_Format(PyExc_TypeError, "Invalid network affinity; should be integer");
+                break;
+            case CONNECTION_PARAM_BUSYPOLL:
+                if (PyInt_Check(pValue))
+                    con.nBusyPoll = PyInt_AsLong(pValue);
+                else
+                    return PyErr_Format(PyExc_TypeError, "Invalid busy poll; should be integer");
+                break;
+            case CONNECTION_PARAM_XMTRATE:
+                if (PyInt_Check(pValue))
+                    con.nXmtRate = PyInt_AsLong(pValue);
+                else
+                    return PyErr_Format(PyExc_TypeError, "Invalid transmit rate; should be integer");
+                break;
+            case CONNECTION_PARAM_XMTBURST:
+                if (PyInt_Check(pValue))
+                    con.nXmtBurst = PyInt_AsLong(pValue);
+                else
+                    return PyErr_Format(PyExc_TypeError, "Invalid transmit burst; should be integer");
+                break;
+            case CONNECTION_PARAM_XMTWINDOW:
+                if (PyInt_Check(pValue))
+                    con.nXmtWindow = PyInt_AsLong(pValue);
+                else
+                    return PyErr_Format(PyExc_TypeError, "Invalid transmit window; should be integer");
+                break;
+            case CONNECTION_PARAM_RECVRING:
+                if (PyInt_Check(pValue))
+                    con.nRecRingLen = PyInt_AsLong(pValue);
+                else
+                    return PyErr_Format(PyExc_TypeError, "Invalid receive ring length; should be integer");
+                break;
+            case CONNECTION_PARAM_SHMEM:
+                if (PyInt_Check(pValue))
+                    con.nShmFlags = PyInt_AsLong(pValue);
+                else
+                    return PyErr_Format(PyExc_TypeError, "Invalid shared memory options; should be integer");
+                break;
+            case CONNECTION_PARAM_SPKCACHE:
+                if (PyInt_Check(pValue))
+                    con.nSpkCacheDepth = PyInt_AsLong(pValue);
+                else
+                    return PyErr_Format(PyExc_TypeError, "Invalid spike cache depth; should be integer");
+                break;
             }
         }
     }
@@ -925,6 +1096,8 @@ PyDoc_STRVAR(cbpy_trial_config__doc__,
 "           'event_length': set the number of events to be cached\n"
 "           'comment_length': set number of comments to be cached\n"
 "           'tracking_length': set the number of video tracking events to be cached\n"
+"           'raw_length': set the number of raw (30 kHz) data to be cached, raw data is not cached by default\n"
+"           'scaled': boolean, if specified, continuous and raw data is in the physical units of each channel (implies 'double')\n"
 "   range_parameter - (optional) dictionary with following keys (all optional)\n"
 "           'begin_channel': integer, channel to start polling if certain value seen\n"
 "           'begin_mask': integer, channel mask to start polling if certain value seen\n"
@@ -954,6 +1127,8 @@ static PyObject * cbpy_trial_config(PyObject *self, PyObject *args, PyObject *ke
     UINT32 uEvents    = cbSdk_EVENT_DATA_SAMPLES;
     UINT32 uComments  = 0;
     UINT32 uTrackings = 0;
+    UINT32 uRaws      = 0;
+    bool   bScaled    = false;
     UINT32 bWithinTrial = 0;
 
     int nInstance = 0;
@@ -973,7 +1148,7 @@ static PyObject * cbpy_trial_config(PyObject *self, PyObject *args, PyObject *ke
         return PyErr_Format(PyExc_TypeError, "Invalid reset parameter; should be boolean");
 
     cbSdkResult sdkres = cbSdkGetTrialConfig(nInstance, &bWithinTrial, &uBegChan, &uBegMask, &uBegVal, &uEndChan, &uEndMask, &uEndVal,
-            &bDouble, &uWaveforms, &uConts, &uEvents, &uComments, &uTrackings, &bAbsolute);
+            &bDouble, &uWaveforms, &uConts, &uEvents, &uComments, &uTrackings, &bAbsolute, &uRaws, &bScaled);
 
     // If any buffer parameter specified
     if (pBufferParam)
@@ -995,6 +1170,17 @@ static PyObject * cbpy_trial_config(PyObject *self, PyObject *args, PyObject *ke
                 return PyErr_Format(PyExc_TypeError, "Invalid absolute parameter; should be boolean");
             bAbsolute = nAbsolute;
         }
+        pParam = PyDict_GetItemString(pBufferParam, "scaled");
+        if (pParam != NULL)
+        {
+            int nScaled = PyObject_IsTrue(pParam);
+            if (nScaled == -1)
+                return PyErr_Format(PyExc_TypeError, "Invalid scaled parameter; should be boolean");
+            bScaled = nScaled;
+            // Physical units are only returned in double precision
+            if (bScaled)
+                bDouble = true;
+        }
         pParam = PyDict_GetItemString(pBufferParam, "continuous_length");
         if (pParam != NULL)
         {
@@ -1023,6 +1209,13 @@ static PyObject * cbpy_trial_config(PyObject *self, PyObject *args, PyObject *ke
                 return PyErr_Format(PyExc_TypeError, "Invalid tracking buffer length; should be integer");
             uTrackings = PyInt_AsLong(pParam);
         }
+        pParam = PyDict_GetItemString(pBufferParam, "raw_length");
+        if (pParam != NULL)
+        {
+            if (!PyInt_Check(pParam))
+                return PyErr_Format(PyExc_TypeError, "Invalid raw buffer length; should be integer");
+            uRaws = PyInt_AsLong(pParam);
+        }
     }
     // If any range parameter specified
     if (pRangeParam)
@@ -1074,7 +1267,7 @@ static PyObject * cbpy_trial_config(PyObject *self, PyObject *args, PyObject *ke
 
     sdkres = cbSdkSetTrialConfig(nInstance,
             bActive, uBegChan, uBegMask, uBegVal, uEndChan, uEndMask, uEndVal,
-            bDouble, uWaveforms, uConts, uEvents, uComments, uTrackings, bAbsolute);
+            bDouble, uWaveforms, uConts, uEvents, uComments, uTrackings, bAbsolute, uRaws, bScaled);
 
     if (sdkres != CBSDKRESULT_SUCCESS)
         cbPySetErrorFromSdkError(sdkres);
@@ -1089,11 +1282,13 @@ PyDoc_STRVAR(cbpy_trial_continuous__doc__,
 "   reset - (optional) boolean \n"
 "           set False (default) to leave buffer intact.\n"
 "           set True to clear all the data and reset the trial time to the current time.\n"
+"   raw - (optional) boolean \n"
+"           set True to get the raw data cached with the 'raw_length' trial buffer parameter.\n"
 "   instance - (optional) library instance number\n"
 "Outputs:\n"
 "   list of tuples (channel, continuous_array)\n"
 "       channel: integer, channel number (1-based)\n"
-"       continuous_array: array, continuous values for channel\n");
+"       continuous_array: array, continuous (or raw) values for channel\n");
 
 // Author & Date: Ehsan Azar       6 May 2012
 // Purpose: Trial continuous data
@@ -1102,13 +1297,15 @@ static PyObject * cbpy_trial_continuous(PyObject *self, PyObject *args, PyObject
     PyObject * res = NULL;
     bool   bDouble = false;
     bool bFlushBuffer = false;
+    bool bRaw = false;
     PyObject * pbActive = NULL;
+    PyObject * pbRaw = NULL;
     int nInstance = 0;
 
-    static char kw[][32] = {"reset", "instance"};
-    static char * kwlist[] = {kw[0], kw[1], NULL};
-    if (!PyArg_ParseTupleAndKeywords(args, keywds, "|O!i", kwlist,
-                                     &PyBool_Type, &pbActive, &nInstance))
+    static char kw[][32] = {"reset", "instance", "raw"};
+    static char * kwlist[] = {kw[0], kw[1], kw[2], NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "|O!iO!", kwlist,
+                                     &PyBool_Type, &pbActive, &nInstance, &PyBool_Type, &pbRaw))
         return NULL;
 
     if (pbActive != NULL)
@@ -1119,15 +1316,25 @@ static PyObject * cbpy_trial_continuous(PyObject *self, PyObject *args, PyObject
             return PyErr_Format(PyExc_TypeError, "Invalid reset parameter; should be boolean");
         bFlushBuffer = (bActive != 0);
     }
+    if (pbRaw != NULL)
+    {
+        // Boolean check
+        int nRaw = PyObject_IsTrue(pbRaw);
+        if (nRaw == -1)
+            return PyErr_Format(PyExc_TypeError, "Invalid raw parameter; should be boolean");
+        bRaw = (nRaw != 0);
+    }
 
     cbSdkResult sdkres = cbSdkGetTrialConfig(nInstance, NULL, NULL, NULL, NULL, NULL, NULL, NULL, &bDouble);
     if (sdkres != CBSDKRESULT_SUCCESS)
         cbPySetErrorFromSdkError(sdkres);
     if (sdkres < CBSDKRESULT_SUCCESS)
         return NULL;
-    // Initialize continuous trial
+    // Initialize continuous (or raw) trial
     cbSdkTrialCont trialcont;
-    sdkres = cbSdkInitTrialData(nInstance, NULL, &trialcont, NULL, NULL);
+    cbSdkTrialCont * pTrialCont = bRaw ? NULL : &trialcont;
+    cbSdkTrialCont * pTrialRaw = bRaw ? &trialcont : NULL;
+    sdkres = cbSdkInitTrialData(nInstance, NULL, pTrialCont, NULL, NULL, pTrialRaw);
     if (sdkres != CBSDKRESULT_SUCCESS)
         cbPySetErrorFromSdkError(sdkres);
     if (sdkres < CBSDKRESULT_SUCCESS)
@@ -1175,7 +1382,7 @@ static PyObject * cbpy_trial_continuous(PyObject *self, PyObject *args, PyObject
         PyList_SET_ITEM(res, channel, pTuple);
     }
     // Now get buffered data
-    sdkres = cbSdkGetTrialData(nInstance, bFlushBuffer, NULL, &trialcont, NULL, NULL);
+    sdkres = cbSdkGetTrialData(nInstance, bFlushBuffer, NULL, pTrialCont, NULL, NULL, pTrialRaw);
     if (sdkres != CBSDKRESULT_SUCCESS)
         cbPySetErrorFromSdkError(sdkres);
     if (sdkres < CBSDKRESULT_SUCCESS)
@@ -2611,6 +2818,75 @@ static PyObject * cbpy_system(PyObject *self, PyObject *args, PyObject *keywds)
     return res;
 }
 
+PyDoc_STRVAR(cbpy_spike_cache__doc__,
+"Cached spikes of a channel newer than a cursor.\n\n"
+"Inputs:\n"
+"   channel - electrode channel number (1-based)\n"
+"   cursor - (optional) number of spikes of the channel already seen, 0 (default) to start\n"
+"   count - (optional) maximum number of spikes to return\n"
+"   instance - (optional) library instance number\n"
+"Outputs:\n"
+"   dictionary with the following keys\n"
+"       'cursor': integer, pass to the next call to get only newer spikes\n"
+"       'timestamps': array, spike timestamps (oldest first)\n"
+"       'units': array, spike units\n"
+"       'waveforms': array, one spike waveform per row\n");
+
+// Purpose: Copy the cached spikes of a channel newer than a cursor
+static PyObject * cbpy_spike_cache(PyObject *self, PyObject *args, PyObject *keywds)
+{
+    PyObject * res = NULL;
+    static char kw[][32] = {"channel", "cursor", "count", "instance"};
+    static char * kwlist[] = {kw[0], kw[1], kw[2], kw[3], NULL};
+    int nChannel = 0;
+    unsigned int nCursor = 0;
+    int nCount = cbPKT_SPKCACHEPKTCNT;
+    int nInstance = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "i|Iii", kwlist, &nChannel, &nCursor, &nCount, &nInstance))
+        return NULL;
+    if (nChannel <= 0 || nChannel > cbMAXCHANS)
+        return PyErr_Format(PyExc_ValueError, "Invalid channel (%d)", nChannel);
+    if (nCount <= 0 || nCount > cbPKT_SPKCACHEPKTCNT_MAX)
+        return PyErr_Format(PyExc_ValueError, "Invalid count (%d); should be 1 to %d", nCount, cbPKT_SPKCACHEPKTCNT_MAX);
+
+    UINT32 spklength;
+    cbSdkResult sdkres = cbSdkGetSysConfig(nInstance, &spklength, NULL, NULL);
+    if (sdkres != CBSDKRESULT_SUCCESS)
+        cbPySetErrorFromSdkError(sdkres, "error cbSdkGetSysConfig");
+    if (sdkres < CBSDKRESULT_SUCCESS)
+        return res;
+    if (spklength > cbMAX_PNTS)
+        spklength = cbMAX_PNTS;
+
+    std::vector<cbPKT_SPK> spikes(nCount);
+    UINT32 count = nCount;
+    UINT32 cursor = nCursor;
+    sdkres = cbSdkGetSpkCacheSince(nInstance, nChannel, &cursor, &spikes[0], &count);
+    if (sdkres != CBSDKRESULT_SUCCESS)
+        cbPySetErrorFromSdkError(sdkres);
+    if (sdkres < CBSDKRESULT_SUCCESS)
+        return res;
+
+    res = PyDict_New();
+    PyObject * pVal = PyLong_FromUnsignedLong(cursor);
+    PyDict_SetItemString(res, "cursor", pVal);
+    int dims[2] = {(int)count, 1};
+    PyArrayObject * pArr = (PyArrayObject *)PyArray_FromDims(1, dims, NPY_UINT32);
+    for (UINT32 i = 0; i < count; ++i)
+        *((UINT32 *)(UINT8 *)PyArray_DATA(pArr) + i) = spikes[i].time;
+    PyDict_SetItemString(res, "timestamps", (PyObject *)pArr);
+    pArr = (PyArrayObject *)PyArray_FromDims(1, dims, NPY_UINT8);
+    for (UINT32 i = 0; i < count; ++i)
+        *((UINT8 *)PyArray_DATA(pArr) + i) = spikes[i].unit;
+    PyDict_SetItemString(res, "units", (PyObject *)pArr);
+    dims[1] = spklength;
+    pArr = (PyArrayObject *)PyArray_FromDims(2, dims, NPY_INT16);
+    for (UINT32 i = 0; i < count; ++i)
+        memcpy((INT16 *)(UINT8 *)PyArray_DATA(pArr) + i * spklength, spikes[i].wave, spklength * sizeof(INT16));
+    PyDict_SetItemString(res, "waveforms", (PyObject *)pArr);
+    return res;
+}
+
 // Author & Date: Ehsan Azar       6 May 2012
 // Purpose: Generate the right exception or warning based on SDK error
 // Inputs:
@@ -2621,6 +2897,9 @@ void cbPySetErrorFromSdkError(cbSdkResult sdkres, const char * szErr)
     int stacklevel = 1;
     switch (sdkres)
     {
+    case CBSDKRESULT_WARNDATALOST:
+        PyErr_WarnEx(PyExc_UserWarning, "Some data was lost", stacklevel);
+        break;
     case CBSDKRESULT_WARNCONVERT:
         PyErr_WarnEx(PyExc_UserWarning, "File conversion is needed", stacklevel);
         break;
@@ -2732,6 +3011,9 @@ void cbPySetErrorFromSdkError(cbSdkResult sdkres, const char * szErr)
     case CBSDKRESULT_ERROFFLINE:
         PyErr_SetString(g_cbpyError, "Instrument is offline");
         break;
+    case CBSDKRESULT_ERRCENTRALVERSION:
+        PyErr_SetString(g_cbpyError, "Central is running with another library version");
+        break;
     default:
         PyErr_SetString(g_cbpyError, "Unhandled SDK error!");
         break;
@@ -2760,6 +3042,7 @@ static PyMethodDef g_cbpyMethods[] =
     {"config",  (PyCFunction)cbpy_config, METH_VARARGS | METH_KEYWORDS, cbpy_config__doc__},
     {"ccf",  (PyCFunction)cbpy_ccf, METH_VARARGS | METH_KEYWORDS, cbpy_ccf__doc__},
     {"system",  (PyCFunction)cbpy_system, METH_VARARGS | METH_KEYWORDS, cbpy_system__doc__},
+    {"spike_cache",  (PyCFunction)cbpy_spike_cache, METH_VARARGS | METH_KEYWORDS, cbpy_spike_cache__doc__},
     {NULL, NULL, 0, NULL} // This has to be the last
 };
 
@@ -29,6 +29,7 @@
 #include "../CentralCommon/BmiVersion.h"
 #include "cbHwlibHi.h"
 #include "debugmacs.h"
+#include "SdkConvert.h"
 #include <math.h>
 #include <QCoreApplication>
 
@@ -44,6 +45,79 @@
 // The sdk instances
 SdkApp * g_app[cbMAXOPEN] = {NULL};
 
+// Purpose: Order the trial cache data and indices shared by the network thread writing the trial
+//           and the thread reading it, without either one waiting for the other
+//           the write index (or count) is only changed by the network thread after the data it covers is written,
+//           the write start index (or read count) only by the reading thread after the data it frees is read
+static inline void TrialFence()
+{
+#ifdef WIN32
+    MemoryBarrier();
+#else
+    __sync_synchronize();
+#endif
+}
+
+// Purpose: Count a thread reading the trial caches without the locks while it is in scope
+class TrialReader
+{
+public:
+    TrialReader(QAtomicInt & nReaders) : m_nReaders(nReaders) {m_nReaders.ref();}
+    ~TrialReader() {m_nReaders.deref();}
+private:
+    QAtomicInt & m_nReaders;
+};
+
+// Purpose: Copy a run of samples of a channel out of the trial cache, that does not wrap around
+// Inputs:
+//   src     - the first sample
+//   count   - number of samples
+//   bDouble - if the output is double precision
+//   gain    - what each sample is multiplied by (if double precision)
+//   offset  - what is added to each scaled sample (if double precision)
+// Outputs:
+//   dst - the copied samples
+static void CopySamples(void * dst, const INT16 * src, UINT32 count, bool bDouble,
+                        double gain = 1.0, double offset = 0.0)
+{
+    if (bDouble)
+        ConvertSamples((double *)dst, src, count, gain, offset);
+    else
+        memcpy(dst, src, count * sizeof(INT16));
+}
+
+// Purpose: Copy a run of rows of a sample group out of the trial cache, that does not wrap around
+// Inputs:
+//   start    - where in the output of each channel the first row goes
+//   src      - the first row
+//   row_step - distance from a row to the next
+//   count    - number of rows
+//   ncols    - number of channels copied
+//   col      - where the sample of each channel copied is in a row
+//   bDouble  - if the output is double precision
+//   gain     - what the samples of each channel copied are multiplied by (if double precision)
+//   offset   - what is added to the scaled samples of each channel copied (if double precision)
+// Outputs:
+//   dst - the copied samples of each channel copied
+static void CopyRows(void * const * dst, UINT32 start, const INT16 * src, UINT32 row_step, UINT32 count,
+                     UINT32 ncols, const UINT16 * col, bool bDouble, const double * gain, const double * offset)
+{
+    if (bDouble)
+    {
+        for (UINT32 r = start; r < start + count; ++r, src += row_step)
+        {
+            for (UINT32 i = 0; i < ncols; ++i)
+                ((double *)dst[i])[r] = src[col[i]] * gain[i] + offset[i];
+        }
+    } else {
+        for (UINT32 r = start; r < start + count; ++r, src += row_step)
+        {
+            for (UINT32 i = 0; i < ncols; ++i)
+                ((INT16 *)dst[i])[r] = src[col[i]];
+        }
+    }
+}
+
 // Private Qt application
 namespace QAppPriv
 {
@@ -51,6 +125,7 @@ namespace QAppPriv
     static char appname[] = "cbsdk.app";
     static char* argv[] = {appname, NULL};
     static QCoreApplication * pApp = NULL;
+    static QMutex lock; // Instances may be opened from different threads
 };
 
 #ifdef WIN32
@@ -89,70 +164,81 @@ BOOL APIENTRY DllMain( HMODULE hModule,
 //  p - the sample group packet
 void SdkApp::OnPktGroup(const cbPKT_GROUP * const pkt)
 {
-    if (!m_bWithinTrial || m_CD == NULL)
-        return;
-
     int group = pkt->type;
 
-    // FIXME: add raw group to cbsdk
-    if (group >= 6)
+    if (!m_bWithinTrial || group > cbRAWGROUP || GroupData(group) == NULL)
         return;
 
-    // Get information about this group...
-    UINT32  period;
-    UINT32  length;
-    UINT32  list[cbNUM_ANALOG_CHANS];
-    if (cbGetSampleGroupInfo(1, group, NULL, &period, &length, m_nInstance) != cbRESULT_OK)
-        return;
-    if (cbGetSampleGroupList(1, group, &length, list, m_nInstance) != cbRESULT_OK)
-        return;
-
-    int rate = (int)(cbSdk_TICKS_PER_SECOND / double(period) );
-
     bool bOverFlow = false;
 
-    m_lockTrial.lock();
-    // double check if buffer is still valid
-    if (m_CD)
+    // The cache is not freed while it is written, load its pointer once after this
+    TrialReader writer(m_nTrialReaders);
+    // double check if buffer is still valid, and that we know where the samples go
+    ContinuousData * const pCD = GroupData(group);
+    const GroupLayout & rLayout = m_groupLayout[group];
+    if (pCD == NULL || !((rLayout.valid && rLayout.generation == pCD->generation) || UpdateGroupLayout(group, pCD)))
+        return;
+    if (pCD->interleaved)
     {
-        // Check whether our information for each channel is up-to-date...
-        for(UINT32 i = 0; i < length; i++)
+        // Add a row with the sample of each channel
+        ContinuousData::GroupHeader & rRows = pCD->group_header[group];
+        const UINT32 write_count = rRows.write_count;
+        // See what the reader has freed before writing over it
+        TrialFence();
+        if (rRows.width && write_count - pCD->group_read_count[group] < pCD->size)
         {
-            if (list[i] == 0 || list[i] > cbNUM_ANALOG_CHANS)
-                continue;
-
-            int ch = list[i] - 1;
-
-            if (m_CD->write_index[ch] == m_CD->write_start_index[ch]) // New continuous channel
-            {
-                // Need to make sure there are no samples here yet...
-                m_CD->current_sample_rates[ch] = rate;
-            }
-
-            // Check for sample size changes...
-            if (m_CD->current_sample_rates[ch] != rate) // New rate for channel
+            INT16 * row = pCD->group_rows(group) + (size_t)rRows.write_index * rRows.row_step;
+            for (UINT32 i = 0; i < rLayout.count; i++)
+                row[i] = pkt->data[rLayout.sample[i]];
+            if (++rRows.write_index >= pCD->size)
+                rRows.write_index = 0;
+            // Publish the row
+            TrialFence();
+            rRows.write_count = write_count + 1;
+        }
+        else
+        {
+            for (UINT32 i = 0; i < rLayout.count; i++)
             {
-                m_CD->current_sample_rates[ch] = rate;
-                m_CD->write_index[ch] = m_CD->write_start_index[ch];        // reset buffer to
+                if (m_bChannelMask[rLayout.chan[i]])
+                    bOverFlow = true;
             }
+        }
+    }
+    else
+    {
+        const UINT32 size = pCD->size;
+        UINT32 new_write_count[cbNUM_ANALOG_CHANS];
+        // See what the reader has freed before writing over it
+        TrialFence();
+        for (UINT32 i = 0; i < rLayout.count; i++)
+        {
+            const UINT16 ch = rLayout.chan[i];
 
             // Add a sample...
             // If there's room for more data...
-            UINT32 new_write_index = m_CD->write_index[ch] + 1;
-            if (new_write_index >= m_CD->size)
-                new_write_index = 0;
-
-            if (new_write_index != m_CD->write_start_index[ch])
+            ContinuousData::ChannelHeader & rChan = pCD->chan_header[ch];
+            const UINT32 write_count = rChan.write_count;
+            if (write_count - pCD->read_count[ch] < size)
             {
                 // Store more data
-                m_CD->continuous_channel_data[ch][m_CD->write_index[ch]] = pkt->data[i];
-                m_CD->write_index[ch] = new_write_index;
+                pCD->channel_data(ch)[rChan.write_index] = pkt->data[rLayout.sample[i]];
+                if (++rChan.write_index >= size)
+                    rChan.write_index = 0;
+                new_write_count[i] = write_count + 1;
+            }
+            else
+            {
+                new_write_count[i] = write_count;
+                if (m_bChannelMask[ch])
+                    bOverFlow = true;
             }
-            else if (m_bChannelMask[ch])
-                bOverFlow = true;
         }
+        // Publish the samples
+        TrialFence();
+        for (UINT32 i = 0; i < rLayout.count; i++)
+            pCD->chan_header[rLayout.chan[i]].write_count = new_write_count[i];
     }
-    m_lockTrial.unlock();
 
     if (bOverFlow)
     {
@@ -160,6 +246,315 @@ void SdkApp::OnPktGroup(const cbPKT_GROUP * const pkt)
     }
 }
 
+// Purpose: Get the cache the samples of a sample group go to
+// Inputs:
+//  group - the sample group
+// Outputs:
+//  Returns the raw data cache for the raw stream, the continuous data cache otherwise
+SdkApp::ContinuousData * SdkApp::GroupData(int group) const
+{
+    return (group == cbRAWGROUP) ? m_RD : m_CD;
+}
+
+// Purpose: Change the sample rate of a channel, the samples in the older rate are dropped
+//           (called by the network thread)
+// Inputs:
+//  ch   - the channel (0-based)
+//  rate - the sample rate, in samples/s
+void SdkApp::ContinuousData::set_rate(UINT32 ch, UINT16 rate)
+{
+    ChannelHeader & rChan = chan_header[ch];
+    if (rChan.rate == rate)
+        return;
+    rChan.rate = rate;
+    TrialFence();
+    rChan.valid_count = rChan.write_count;
+}
+
+// Purpose: Change the scaling of a channel, the samples written so far are in the older one
+//           (called by the network thread, the readers retry while scale_seq is odd or moves)
+// Inputs:
+//  ch       - the channel (0-based)
+//  rScaling - the scaling of the samples written from now on
+void SdkApp::ContinuousData::set_scaling(UINT32 ch, const ChannelScaling & rScaling)
+{
+    ChannelHeader & rChan = chan_header[ch];
+    if (rChan.scaling.gain == rScaling.gain && rChan.scaling.offset == rScaling.offset)
+        return;
+    rChan.scale_seq++;
+    TrialFence();
+    rChan.scaling = rScaling;
+    rChan.scale_count = rChan.write_count;
+    TrialFence();
+    rChan.scale_seq++;
+}
+
+// Purpose: Change the layout of the rows of a sample group, the rows written so far are dropped,
+//           or only its scaling, the rows written so far are in the older one
+//           (called by the network thread, the readers retry while layout_seq is odd or moves)
+// Inputs:
+//  group   - the sample group
+//  rate    - the group sample rate, in samples/s
+//  count   - number of channels in a row
+//  chan    - the channel (0-based) of each sample in a row
+//  scaling - the scaling of each sample in a row
+void SdkApp::ContinuousData::set_rows(UINT32 group, UINT16 rate, UINT32 count, const UINT16 * chan, const ChannelScaling * scaling)
+{
+    GroupHeader & rRows = group_header[group];
+    // The rows only have room for as many channels as the group had when they were allocated
+    const UINT16 width = (count <= rRows.row_step) ? (UINT16)count : 0;
+    const bool bLayout = width != rRows.width || rate != rRows.rate ||
+        memcmp(chan, rRows.chan, width * sizeof(UINT16)) != 0;
+    if (!bLayout && memcmp(scaling, rRows.scaling, width * sizeof(ChannelScaling)) == 0)
+        return;
+    rRows.layout_seq++;
+    TrialFence();
+    rRows.rate = rate;
+    rRows.width = width;
+    memcpy(rRows.chan, chan, width * sizeof(UINT16));
+    memcpy(rRows.scaling, scaling, width * sizeof(ChannelScaling));
+    if (bLayout)
+        rRows.valid_count = rRows.write_count;
+    rRows.scale_count = rRows.write_count;
+    TrialFence();
+    rRows.layout_seq++;
+}
+
+// Purpose: Get the samples of a channel the network thread has published and that are not read yet
+//           (called by the reading thread)
+// Inputs:
+//  ch       - the channel (0-based)
+//  pScaling - where to get the scaling of the samples, NULL to leave them in digital units
+// Outputs:
+//  first    - the count of the first sample, older samples (in another rate or scaling) are skipped
+//  pScaling - the scaling of the samples
+//  Returns the number of samples
+UINT32 SdkApp::ContinuousData::pending(UINT32 ch, UINT32 & first, ChannelScaling * pScaling) const
+{
+    const ChannelHeader & rChan = chan_header[ch];
+    const UINT32 end = rChan.write_count;
+    // Only samples published by the network thread are read
+    TrialFence();
+    first = read_count[ch];
+    UINT32 from = rChan.valid_count;
+    if (pScaling)
+    {
+        // The scaling of older samples is no longer known, drop them as when the sample rate changes
+        UINT32 seq, scale_from;
+        do {
+            seq = rChan.scale_seq;
+            TrialFence();
+            *pScaling = rChan.scaling;
+            scale_from = rChan.scale_count;
+            TrialFence();
+        } while ((seq & 1) || seq != rChan.scale_seq);
+        if ((INT32)(scale_from - from) > 0)
+            from = scale_from;
+    }
+    // The rate or scaling may have changed again after the end was taken
+    if ((INT32)(from - first) > 0)
+        first = ((INT32)(from - end) > 0) ? end : from;
+    return end - first;
+}
+
+// Purpose: Get the rows of a sample group the network thread has published and that are not read yet
+//           (called by the reading thread)
+// Inputs:
+//  group   - the sample group
+//  bScaled - if the rows are read in physical units
+// Outputs:
+//  first   - the count of the first row, older rows (in another layout or scaling) are skipped
+//  rRows   - the layout and scaling of the rows
+//  Returns the number of rows
+UINT32 SdkApp::ContinuousData::pending_rows(UINT32 group, UINT32 & first, GroupHeader & rRows, bool bScaled) const
+{
+    const GroupHeader & rHeader = group_header[group];
+    const UINT32 end = rHeader.write_count;
+    // Only rows published by the network thread are read
+    TrialFence();
+    first = group_read_count[group];
+    UINT32 seq;
+    do {
+        seq = rHeader.layout_seq;
+        TrialFence();
+        rRows = rHeader;
+        TrialFence();
+    } while ((seq & 1) || seq != rHeader.layout_seq);
+    UINT32 from = rRows.valid_count;
+    // The scaling of older rows is no longer known, drop them as when the layout changes
+    if (bScaled && (INT32)(rRows.scale_count - from) > 0)
+        from = rRows.scale_count;
+    // The layout or scaling may have changed again after the end was taken
+    if ((INT32)(from - first) > 0)
+        first = ((INT32)(from - end) > 0) ? end : from;
+    return end - first;
+}
+
+// Purpose: Drop the samples of all channels not read yet
+//           (called by the reading thread)
+void SdkApp::ContinuousData::flush()
+{
+    for (UINT32 ch = 0; ch < cbNUM_ANALOG_CHANS; ++ch)
+        read_count[ch] = chan_header[ch].write_count;
+    for (UINT32 group = 0; group < cbMAXGROUPS; ++group)
+        group_read_count[group] = group_header[group].write_count;
+}
+
+// Purpose: Get the layout of a sample group packet, and push the sample rate and scaling
+//           of its channels (or the layout of its rows if interleaved) to the continuous (or raw) data
+//           (called by the network thread)
+// Inputs:
+//  group - the sample group
+//  pCD   - the continuous or raw data cache
+// Outputs:
+//  Returns true if the layout is valid
+bool SdkApp::UpdateGroupLayout(int group, ContinuousData * pCD)
+{
+    // Get information about this group...
+    UINT32  period;
+    UINT32  length;
+    UINT32  list[cbNUM_ANALOG_CHANS];
+    if (cbGetSampleGroupInfo(1, group, NULL, &period, &length, m_nInstance) != cbRESULT_OK)
+        return false;
+    if (cbGetSampleGroupList(1, group, &length, list, m_nInstance) != cbRESULT_OK)
+        return false;
+
+    GroupLayout & rLayout = m_groupLayout[group];
+    ChannelScaling scaling[cbNUM_ANALOG_CHANS];
+    rLayout.rate = (UINT16)(cbSdk_TICKS_PER_SECOND / double(period) );
+    rLayout.count = 0;
+    for (UINT32 i = 0; i < length; i++)
+    {
+        if (list[i] == 0 || list[i] > cbNUM_ANALOG_CHANS)
+            continue;
+
+        int ch = list[i] - 1;
+
+        // New continuous channel or new rate or scaling for channel
+        GetScaling(list[i], scaling[rLayout.count]);
+        if (!pCD->interleaved)
+        {
+            pCD->set_rate(ch, rLayout.rate);
+            pCD->set_scaling(ch, scaling[rLayout.count]);
+        }
+
+        rLayout.sample[rLayout.count] = (UINT16)i;
+        rLayout.chan[rLayout.count] = (UINT16)ch;
+        rLayout.count++;
+    }
+    if (pCD->interleaved)
+        pCD->set_rows(group, rLayout.rate, rLayout.count, rLayout.chan, scaling);
+    rLayout.generation = pCD->generation;
+    rLayout.valid = true;
+    return true;
+}
+
+// Purpose: Get the number of continuous channels in a sample group
+// Inputs:
+//  group - the sample group
+// Outputs:
+//  Returns the number of channels, 0 if the group is not known
+UINT32 SdkApp::GroupWidth(int group)
+{
+    UINT32  length;
+    UINT32  list[cbNUM_ANALOG_CHANS];
+    if (cbGetSampleGroupList(1, group, &length, list, m_nInstance) != cbRESULT_OK)
+        return 0;
+    UINT32 width = 0;
+    for (UINT32 i = 0; i < length; i++)
+    {
+        if (list[i] != 0 && list[i] <= cbNUM_ANALOG_CHANS)
+            width++;
+    }
+    return width;
+}
+
+// Purpose: Get the sample group layouts (and scaling) again with the next packets
+void SdkApp::InvalidateGroupLayout()
+{
+    for (int group = 0; group < cbMAXGROUPS; ++group)
+        m_groupLayout[group].valid = false;
+    for (int group = 0; group <= cbMAXGROUPS; ++group)
+        m_groupScaling[group].valid = false;
+}
+
+// Purpose: Get the scaling of a channel to its physical units
+// Inputs:
+//  chan - the channel number (1-based)
+// Outputs:
+//  scaling - the scaling, unit gain if the channel has none
+void SdkApp::GetScaling(UINT32 chan, ChannelScaling & scaling)
+{
+    // Leave the samples in digital units if the scaling is not valid
+    scaling.gain = 1.0;
+    scaling.offset = 0.0;
+    cbSCALING scale;
+    if (cbGetAinpScaling(chan, &scale, m_nInstance) == cbRESULT_OK && scale.digmax != scale.digmin)
+    {
+        // The analog range is divided by the gain, as in cbXfmDigToAna (no gain is the same as unit gain)
+        const double anagain = scale.anagain ? scale.anagain : 1;
+        scaling.gain = (scale.anamax - scale.anamin) / anagain / (scale.digmax - scale.digmin);
+        scaling.offset = scale.anamin / anagain - scale.digmin * scaling.gain;
+    }
+}
+
+// Purpose: Get the scaling of the samples of a sample group packet
+// Inputs:
+//  group - the sample group
+// Outputs:
+//  Returns true if the scaling is valid
+bool SdkApp::UpdateGroupScaling(int group)
+{
+    UINT32  length;
+    UINT32  list[cbNUM_ANALOG_CHANS];
+    if (cbGetSampleGroupList(1, group, &length, list, m_nInstance) != cbRESULT_OK)
+        return false;
+
+    GroupScaling & rScaling = m_groupScaling[group];
+    for (UINT32 i = 0; i < length; i++)
+    {
+        rScaling.chan[i] = (UINT16)list[i];
+        if (list[i] == 0 || list[i] > cbNUM_ANALOG_CHANS)
+        {
+            rScaling.gain[i] = 1.0f;
+            rScaling.offset[i] = 0.0f;
+        } else {
+            ChannelScaling scaling;
+            GetScaling(list[i], scaling);
+            rScaling.gain[i] = (float)scaling.gain;
+            rScaling.offset[i] = (float)scaling.offset;
+        }
+    }
+    rScaling.length = length;
+    rScaling.valid = true;
+    return true;
+}
+
+// Purpose: Scale the samples of a sample group packet to the physical units of their channel
+// Inputs:
+//  pkt - the sample group packet
+// Outputs:
+//  scaled - the scaled samples
+//  Returns true if the samples could be scaled
+bool SdkApp::ScaleGroup(const cbPKT_GROUP * const pkt, cbSdkScaledGroup * scaled)
+{
+    int group = pkt->type;
+    if (group <= 0 || group > cbMAXGROUPS)
+        return false;
+    const GroupScaling & rScaling = m_groupScaling[group];
+    if (!rScaling.valid && !UpdateGroupScaling(group))
+        return false;
+
+    // dlen is in 32-bit words, each holds two samples
+    UINT32 count = min(rScaling.length, (UINT32)pkt->dlen * 2);
+    scaled->time = pkt->time;
+    scaled->group = (UINT16)group;
+    scaled->count = (UINT16)count;
+    memcpy(scaled->chan, rScaling.chan, count * sizeof(UINT16));
+    ScaleSamples(scaled->data, pkt->data, rScaling.gain, rScaling.offset, count);
+    return true;
+}
+
 // Author & Date:   Ehsan Azar     24 March 2011
 // Purpose: Called when a spike, digital or serial packet (aka event data) comes in.
 //           Also the trial start and stop are set.
@@ -192,31 +587,36 @@ void SdkApp::OnPktEvent(const cbPKT_GENERIC * const pPkt)
         else if (pPkt->chid == MAX_CHANS_SERIAL)
             ch = cbNUM_ANALOG_CHANS + 1;
 
-        m_lockTrialEvent.lock();
+        // The cache is not freed while it is written, load its pointer once after this
+        TrialReader writer(m_nTrialReaders);
         // double check if buffer is still valid
-        if (m_ED)
+        EventData * const pED = m_ED;
+        if (pED)
         {
             // Add a sample...
-            UINT32 old_write_index = m_ED->write_index[ch];
+            UINT32 old_write_index = pED->write_index[ch];
             // If there's room for more data...
             UINT32 new_write_index = old_write_index + 1;
-            if (new_write_index >= m_ED->size)
+            if (new_write_index >= pED->size)
                 new_write_index = 0;
 
-            if (new_write_index != m_ED->write_start_index[ch])
+            // See what the reader has freed before writing over it
+            TrialFence();
+            if (new_write_index != pED->write_start_index[ch])
             {
                 // Store more data
-                m_ED->timestamps[ch][old_write_index] = pPkt->time;
+                pED->timestamps[ch][old_write_index] = pPkt->time;
                 if (pPkt->chid == MAX_CHANS_DIGITAL_IN || pPkt->chid == MAX_CHANS_SERIAL)
-                    m_ED->units[ch][old_write_index] = (UINT16)(pPkt->data[0] & 0x0000ffff);
+                    pED->units[ch][old_write_index] = (UINT16)(pPkt->data[0] & 0x0000ffff);
                 else
-                    m_ED->units[ch][old_write_index] = pPkt->type;
-                m_ED->write_index[ch] = new_write_index;
+                    pED->units[ch][old_write_index] = pPkt->type;
+                // Publish the sample
+                TrialFence();
+                pED->write_index[ch] = new_write_index;
             }
             else if (m_bChannelMask[pPkt->chid - 1])
                 bOverFlow = true;
         }
-        m_lockTrialEvent.unlock();
 
         if (bOverFlow)
         {
@@ -375,7 +775,10 @@ void SdkApp::LateBindCallback(cbSdkCallbackType callbacktype)
 //           Only the first registered callback receives packet lost events
 void SdkApp::LinkFailureEvent(cbSdkPktLostEvent & lost)
 {
+    // Lost events come from both the receive and the processing threads
+    m_lockLost.lock();
     m_lastLost = lost;
+    m_lockLost.unlock();
     cbSdkCallback pCallback = NULL;
     void * pCallbackParams = NULL;
 
@@ -392,7 +795,7 @@ void SdkApp::LinkFailureEvent(cbSdkPktLostEvent & lost)
     }
 
     if (pCallback)
-        pCallback(m_nInstance, cbSdkPkt_PACKETLOST, &m_lastLost, pCallbackParams);
+        pCallback(m_nInstance, cbSdkPkt_PACKETLOST, &lost, pCallbackParams);
 }
 
 /////////////////////////////////////////////////////////////////////////////
@@ -638,6 +1041,8 @@ cbSdkResult SdkApp::SdkOpen(UINT32 nInstance, cbSdkConnectionType conType, cbSdk
         return CBSDKRESULT_WARNOPEN;
 
     // Some sanity checks
+    if (con.nRecBatchSize < 1 || con.nRecBatchSize > UDPSocket::MAX_RECV_BATCH)
+        return CBSDKRESULT_INVALIDPARAM;
     if (con.szInIP == NULL || con.szInIP[0] == 0)
     {
 #ifdef WIN32
@@ -652,6 +1057,7 @@ cbSdkResult SdkApp::SdkOpen(UINT32 nInstance, cbSdkConnectionType conType, cbSdk
 
     // Null the trial buffers
     m_CD = NULL;
+    m_RD = NULL;
     m_ED = NULL;
 
     // Unregister all callbacks
@@ -699,11 +1105,14 @@ cbSdkResult SdkApp::SdkOpen(UINT32 nInstance, cbSdkConnectionType conType, cbSdk
     m_uTrialEndMask      = 0;
     m_uTrialEndValue     = 0;
     m_bTrialDouble       = false;
+    m_bTrialScaled       = false;
+    m_bTrialInterleaved  = false;
     m_uTrialWaveforms    = 0;
     m_uTrialConts        = cbSdk_CONTINUOUS_DATA_SAMPLES;
     m_uTrialEvents       = cbSdk_EVENT_DATA_SAMPLES;
     m_uTrialComments     = 0;
     m_uTrialTrackings    = 0;
+    m_uTrialRaws         = 0;
 
     // make sure that cache data storage is switched off so that the monitoring thread will
     // not be saving data and then set up the cache control variables
@@ -711,18 +1120,45 @@ cbSdkResult SdkApp::SdkOpen(UINT32 nInstance, cbSdkConnectionType conType, cbSdk
     m_uTrialStartTime = 0;
 
     // If this is not part of another Qt application, and the-only Qt app intance is not present
+    QAppPriv::lock.lock();
     if (QCoreApplication::instance() == NULL && QAppPriv::pApp == NULL)
         QAppPriv::pApp = new QCoreApplication(QAppPriv::argc, QAppPriv::argv);
+    QAppPriv::lock.unlock();
+
+    QThread::Priority nNetPriority = QThread::HighPriority;
+    switch (con.nNetPriority)
+    {
+    case CBSDKPRIORITY_NORMAL:
+        nNetPriority = QThread::NormalPriority;
+        break;
+    case CBSDKPRIORITY_HIGHEST:
+        nNetPriority = QThread::HighestPriority;
+        break;
+    case CBSDKPRIORITY_TIMECRITICAL:
+        nNetPriority = QThread::TimeCriticalPriority;
+        break;
+    default:
+        break;
+    }
+
+    NetLoopType nNetLoop = NET_LOOP_TIMER;
+    if (con.nNetLoop == CBSDKNETLOOP_EVENT)
+        nNetLoop = NET_LOOP_EVENT;
+    else if (con.nNetLoop == CBSDKNETLOOP_SPIN)
+        nNetLoop = NET_LOOP_SPIN;
 
     if (conType == CBSDKCONNECTION_UDP)
     {
         m_connectLock.lock();
-        Open(nInstance, con.nInPort, con.nOutPort, con.szInIP, con.szOutIP, con.nRecBufSize);
+        Open(nInstance, con.nInPort, con.nOutPort, con.szInIP, con.szOutIP, con.nRecBufSize, con.nRecBatchSize,
+             nNetLoop, con.bRecvThread, nNetPriority, con.nNetAffinity, con.nBusyPoll,
+             con.nXmtRate, con.nXmtBurst, con.nXmtWindow, con.nRecRingLen, con.nShmFlags, con.nSpkCacheDepth);
     }
     else if (conType == CBSDKCONNECTION_CENTRAL)
     {
         m_connectLock.lock();
-        Open(nInstance);
+        Open(nInstance, cbNET_UDP_PORT_BCAST, cbNET_UDP_PORT_CNT, cbNET_UDP_ADDR_INST, cbNET_UDP_ADDR_CNT,
+             NSP_REC_BUF_SIZE, NSP_REC_BATCH_SIZE, NET_LOOP_TIMER, false, nNetPriority, con.nNetAffinity);
     }
     else
         return CBSDKRESULT_NOTIMPLEMENTED;
@@ -732,6 +1168,9 @@ cbSdkResult SdkApp::SdkOpen(UINT32 nInstance, cbSdkConnectionType conType, cbSdk
     m_connectLock.unlock();
     if (!bWait)
         return CBSDKRESULT_TIMEOUT;
+    // Central is there but its buffers cannot be read, there is no falling back to stand-alone
+    if (m_instInfo == 0 && GetLastCbErr() == cbRESULT_BUFVERSIONERR)
+        return CBSDKRESULT_ERRCENTRALVERSION;
     if (IsStandAlone())
     {
         if (m_instInfo == 0)
@@ -789,8 +1228,13 @@ CBSDKAPI    cbSdkResult cbSdkOpen(UINT32 nInstance, cbSdkConnectionType conType,
     // check if the library is already open
     if (conType < 0 || conType >= CBSDKCONNECTION_CLOSED)
         return CBSDKRESULT_INVALIDPARAM;
+    if (con.nNetLoop < 0 || con.nNetLoop >= CBSDKNETLOOP_COUNT)
+        return CBSDKRESULT_INVALIDPARAM;
+    if (con.nNetPriority < 0 || con.nNetPriority >= CBSDKPRIORITY_COUNT)
+        return CBSDKRESULT_INVALIDPARAM;
     if (nInstance >= cbMAXOPEN)
         return CBSDKRESULT_INVALIDPARAM;
+    QAppPriv::lock.lock();
     if (g_app[nInstance] == NULL)
     {
         try {
@@ -799,6 +1243,7 @@ CBSDKAPI    cbSdkResult cbSdkOpen(UINT32 nInstance, cbSdkConnectionType conType,
             g_app[nInstance] = NULL;
         }
     }
+    QAppPriv::lock.unlock();
     if (g_app[nInstance] == NULL)
         return CBSDKRESULT_ERRMEMORY;
 
@@ -822,6 +1267,9 @@ cbSdkResult SdkApp::SdkClose()
     if (m_CD != NULL)
         SdkUnsetTrialConfig(CBSDKTRIAL_CONTINUOUS);
 
+    if (m_RD != NULL)
+        SdkUnsetTrialConfig(CBSDKTRIAL_RAW);
+
     if (m_ED != NULL)
         SdkUnsetTrialConfig(CBSDKTRIAL_EVENTS);
 
@@ -940,6 +1388,257 @@ CBSDKAPI    cbSdkResult cbSdkGetType(UINT32 nInstance, cbSdkConnectionType * con
     return g_app[nInstance]->SdkGetType(conType, instType);
 }
 
+// Purpose: Get the number of packets found missing from periodic streams
+// Outputs:
+//   heartbeats - system heartbeats missing
+//   groups     - (optional) packets missing from each sample group (array of cbMAXGROUPS)
+//   returns the error code
+cbSdkResult SdkApp::SdkGetLostPackets(UINT32 * heartbeats, UINT32 * groups)
+{
+    if (m_instInfo == 0)
+        return CBSDKRESULT_CLOSED;
+
+    if (heartbeats)
+        *heartbeats = getLostPackets(0);
+    if (groups)
+    {
+        for (int i = 0; i < cbMAXGROUPS; ++i)
+            groups[i] = getLostPackets(i + 1);
+    }
+
+    return CBSDKRESULT_SUCCESS;
+}
+
+// Purpose: sdk stub for SdkApp::SdkGetLostPackets
+CBSDKAPI    cbSdkResult cbSdkGetLostPackets(UINT32 nInstance, UINT32 * heartbeats, UINT32 * groups)
+{
+    if (heartbeats == NULL && groups == NULL)
+        return CBSDKRESULT_NULLPTR;
+    if (nInstance >= cbMAXOPEN)
+        return CBSDKRESULT_INVALIDPARAM;
+    if (g_app[nInstance] == NULL)
+        return CBSDKRESULT_CLOSED;
+
+    return g_app[nInstance]->SdkGetLostPackets(heartbeats, groups);
+}
+
+// Purpose: Get the latency from receiving a datagram to processing it
+//           run the same load with different network loops to compare them
+// Inputs:
+//   bReset  - if measurement should start over after this
+// Outputs:
+//   latency - latency percentiles
+//   returns the error code
+cbSdkResult SdkApp::SdkGetRecvLatency(cbSdkRecvLatency * latency, bool bReset)
+{
+    if (m_instInfo == 0)
+        return CBSDKRESULT_CLOSED;
+    if (!IsStandAlone())
+        return CBSDKRESULT_NOTIMPLEMENTED;
+
+    latency->count = getLatencyCount();
+    latency->p50 = getLatencyPercentile(50);
+    latency->p90 = getLatencyPercentile(90);
+    latency->p99 = getLatencyPercentile(99);
+    latency->p999 = getLatencyPercentile(99.9);
+    latency->max = getLatencyMax();
+    if (bReset)
+        resetLatency();
+
+    return CBSDKRESULT_SUCCESS;
+}
+
+// Purpose: sdk stub for SdkApp::SdkGetRecvLatency
+CBSDKAPI    cbSdkResult cbSdkGetRecvLatency(UINT32 nInstance, cbSdkRecvLatency * latency, bool bReset)
+{
+    if (latency == NULL)
+        return CBSDKRESULT_NULLPTR;
+    if (nInstance >= cbMAXOPEN)
+        return CBSDKRESULT_INVALIDPARAM;
+    if (g_app[nInstance] == NULL)
+        return CBSDKRESULT_CLOSED;
+
+    return g_app[nInstance]->SdkGetRecvLatency(latency, bReset);
+}
+
+// Purpose: Get the depth of stand-alone network queues
+// Outputs:
+//   recvDepth    - datagrams the receive stage took from the socket in its last burst
+//   procDepth    - quadlets received but not yet processed (0 if packets are processed as received)
+//   procOverruns - times the processing stage fell a whole receive buffer behind
+//   returns the error code
+cbSdkResult SdkApp::SdkGetQueueDepth(UINT32 * recvDepth, UINT32 * procDepth, UINT32 * procOverruns)
+{
+    if (m_instInfo == 0)
+        return CBSDKRESULT_CLOSED;
+    if (!IsStandAlone())
+        return CBSDKRESULT_NOTIMPLEMENTED;
+
+    if (recvDepth)
+        *recvDepth = getRecvQueueDepth();
+    if (procDepth)
+        *procDepth = getProcQueueDepth();
+    if (procOverruns)
+        *procOverruns = getProcOverruns();
+
+    return CBSDKRESULT_SUCCESS;
+}
+
+// Purpose: sdk stub for SdkApp::SdkGetQueueDepth
+CBSDKAPI    cbSdkResult cbSdkGetQueueDepth(UINT32 nInstance, UINT32 * recvDepth, UINT32 * procDepth, UINT32 * procOverruns)
+{
+    if (recvDepth == NULL && procDepth == NULL && procOverruns == NULL)
+        return CBSDKRESULT_NULLPTR;
+    if (nInstance >= cbMAXOPEN)
+        return CBSDKRESULT_INVALIDPARAM;
+    if (g_app[nInstance] == NULL)
+        return CBSDKRESULT_CLOSED;
+
+    return g_app[nInstance]->SdkGetQueueDepth(recvDepth, procDepth, procOverruns);
+}
+
+// Purpose: Get the status of the processes reading the shared receive buffer
+//           to find the one that is falling behind
+// Inputs:
+//   count   - maximum number of readers to get (up to cbMAXREADERS)
+// Outputs:
+//   readers - status of each reader
+//   count   - number of readers
+//   returns the error code
+cbSdkResult SdkApp::SdkGetReaderStatus(cbSdkReaderStatus * readers, UINT32 * count)
+{
+    if (m_instInfo == 0)
+        return CBSDKRESULT_CLOSED;
+
+    UINT32 nCount = 0;
+    for (UINT32 reader = 0; reader < cbMAXREADERS && nCount < *count; ++reader)
+    {
+        cbSdkReaderStatus & rStatus = readers[nCount];
+        if (cbGetReaderStatus(reader, &rStatus.pid, &rStatus.lag, &rStatus.overruns, m_nInstance) == cbRESULT_OK)
+            nCount++;
+    }
+    *count = nCount;
+
+    return CBSDKRESULT_SUCCESS;
+}
+
+// Purpose: sdk stub for SdkApp::SdkGetReaderStatus
+CBSDKAPI    cbSdkResult cbSdkGetReaderStatus(UINT32 nInstance, cbSdkReaderStatus * readers, UINT32 * count)
+{
+    if (readers == NULL || count == NULL)
+        return CBSDKRESULT_NULLPTR;
+    if (nInstance >= cbMAXOPEN)
+        return CBSDKRESULT_INVALIDPARAM;
+    if (g_app[nInstance] == NULL)
+        return CBSDKRESULT_CLOSED;
+
+    return g_app[nInstance]->SdkGetReaderStatus(readers, count);
+}
+
+// Purpose: Get what changed in the configuration since a generation, so that only that is read again
+//           (the counters are only kept when stand-alone, Central does not keep them)
+// Inputs:
+//   generation - generation the caller last saw, 0 for everything that was ever configured
+// Outputs:
+//   changes    - the current generation and the sections, channels, groups and filters changed since
+//   returns the error code
+cbSdkResult SdkApp::SdkGetConfigChanges(UINT32 generation, cbSdkConfigChanges * changes)
+{
+    if (m_instInfo == 0)
+        return CBSDKRESULT_CLOSED;
+
+    if (!IsStandAlone())
+        return CBSDKRESULT_NOTIMPLEMENTED;
+
+    cbCFGGENERATION gen;
+    // Entries changing meanwhile are reported now and again the next time
+    cbRESULT cbres = cbGetCfgGeneration(&gen, m_nInstance);
+    if (cbres == cbRESULT_NOLIBRARY)
+        return CBSDKRESULT_CLOSED;
+    if (cbres != cbRESULT_OK)
+        return CBSDKRESULT_NOTIMPLEMENTED;
+    changes->generation = gen.generation;
+
+    changes->sections = 0;
+    for (UINT32 nSection = 0; nSection < cbCFGSECTIONS; ++nSection)
+    {
+        if (gen.section[nSection] > generation)
+            changes->sections |= (1 << nSection);
+    }
+    changes->chanCount = 0;
+    for (UINT32 nChan = 0; nChan < cbMAXCHANS; ++nChan)
+    {
+        if (gen.chaninfo[nChan] > generation)
+            changes->chans[changes->chanCount++] = (UINT16)(nChan + 1);
+    }
+    changes->groupCount = 0;
+    for (UINT32 nGroup = 0; nGroup < cbMAXGROUPS; ++nGroup)
+    {
+        if (gen.groupinfo[nGroup] > generation)
+            changes->groups[changes->groupCount++] = (UINT16)(nGroup + 1);
+    }
+    changes->filtCount = 0;
+    for (UINT32 nFilt = 0; nFilt < cbMAXFILTS; ++nFilt)
+    {
+        if (gen.filtinfo[nFilt] > generation)
+            changes->filts[changes->filtCount++] = (UINT16)(nFilt + 1);
+    }
+
+    return CBSDKRESULT_SUCCESS;
+}
+
+// Purpose: sdk stub for SdkApp::SdkGetConfigChanges
+CBSDKAPI    cbSdkResult cbSdkGetConfigChanges(UINT32 nInstance, UINT32 generation, cbSdkConfigChanges * changes)
+{
+    if (changes == NULL)
+        return CBSDKRESULT_NULLPTR;
+    if (nInstance >= cbMAXOPEN)
+        return CBSDKRESULT_INVALIDPARAM;
+    if (g_app[nInstance] == NULL)
+        return CBSDKRESULT_CLOSED;
+
+    return g_app[nInstance]->SdkGetConfigChanges(generation, changes);
+}
+
+// Purpose: Internal function to deallocate an event trial construct
+// Inputs:
+//   pED - the event cache, no longer reachable from the network thread or readers
+void SdkApp::freeEventData(EventData * pED)
+{
+    for (UINT32 i = 0; i < cbNUM_ANALOG_CHANS + 2; ++i)
+    {
+        if (pED->timestamps[i])
+        {
+            delete[] pED->timestamps[i];
+            pED->timestamps[i] = NULL;
+        }
+        if (pED->units[i])
+        {
+            delete[] pED->units[i];
+            pED->units[i] = NULL;
+        }
+    }
+    if (pED->waveform_data != NULL)
+    {
+        if (m_uTrialWaveforms > cbPKT_SPKCACHEPKTCNT)
+            delete[] pED->waveform_data;
+        pED->waveform_data = NULL;
+    }
+    pED->size = 0;
+    delete pED;
+}
+
+// Purpose: Wait until no thread writes or reads the continuous and event caches without the locks,
+//           a cache detached before this call is not seen by anyone after it and can be freed
+//           (the network thread counts itself while it writes a packet to them)
+void SdkApp::WaitTrialReaders()
+{
+    // Readers (and the writer) count themselves before they load the cache pointers
+    TrialFence();
+    while (m_nTrialReaders.fetchAndAddOrdered(0) > 0)
+        QThread::yieldCurrentThread();
+}
+
 // Author & Date:   Ehsan Azar     25 Oct 2011
 // Purpose: Internal lock-less function to deallocate given trial construct
 // Outputs:
@@ -949,45 +1648,24 @@ cbSdkResult SdkApp::unsetTrialConfig(cbSdkTrialType type)
     cbSdkResult res = CBSDKRESULT_SUCCESS;
     switch (type)
     {
-    case CBSDKTRIAL_CONTINUOUS:
-        if (m_CD == NULL)
-            return CBSDKRESULT_ERRCONFIG;
-        for (UINT32 i = 0; i < cbNUM_ANALOG_CHANS; ++i)
-        {
-            if (m_CD->continuous_channel_data[i])
-            {
-                delete[] m_CD->continuous_channel_data[i];
-                m_CD->continuous_channel_data[i] = NULL;
-            }
-        }
-        m_CD->size = 0;
+    case CBSDKTRIAL_CONTINUOUS:
+        if (m_CD == NULL)
+            return CBSDKRESULT_ERRCONFIG;
+        m_CD->release();
         delete m_CD;
         m_CD = NULL;
         break;
+    case CBSDKTRIAL_RAW:
+        if (m_RD == NULL)
+            return CBSDKRESULT_ERRCONFIG;
+        m_RD->release();
+        delete m_RD;
+        m_RD = NULL;
+        break;
     case CBSDKTRIAL_EVENTS:
         if (m_ED == NULL)
             return CBSDKRESULT_ERRCONFIG;
-        for (UINT32 i = 0; i < cbNUM_ANALOG_CHANS + 2; ++i)
-        {
-            if (m_ED->timestamps[i])
-            {
-                delete[] m_ED->timestamps[i];
-                m_ED->timestamps[i] = NULL;
-            }
-            if (m_ED->units[i])
-            {
-                delete[] m_ED->units[i];
-                m_ED->units[i] = NULL;
-            }
-        }
-        if (m_ED->waveform_data != NULL)
-        {
-            if (m_uTrialWaveforms > cbPKT_SPKCACHEPKTCNT)
-                delete[] m_ED->waveform_data;
-            m_ED->waveform_data = NULL;
-        }
-        m_ED->size = 0;
-        delete m_ED;
+        freeEventData(m_ED);
         m_ED = NULL;
         break;
     case CBSDKTRIAL_COMMETNS:
@@ -1085,15 +1763,34 @@ cbSdkResult SdkApp::SdkUnsetTrialConfig(cbSdkTrialType type)
     switch (type)
     {
     case CBSDKTRIAL_CONTINUOUS:
+    case CBSDKTRIAL_RAW:
+    {
+        // Detach the cache from the network thread, then free it once no reader can still see it
+        ContinuousData * & rCD = (type == CBSDKTRIAL_RAW) ? m_RD : m_CD;
         m_lockTrial.lock();
-        res = unsetTrialConfig(type);
+        ContinuousData * pCD = rCD;
+        rCD = NULL;
         m_lockTrial.unlock();
+        if (pCD == NULL)
+            return CBSDKRESULT_ERRCONFIG;
+        WaitTrialReaders();
+        pCD->release();
+        delete pCD;
         break;
+    }
     case CBSDKTRIAL_EVENTS:
+    {
+        // Detach the cache from the network thread, then free it once no reader can still see it
         m_lockTrialEvent.lock();
-        res = unsetTrialConfig(type);
+        EventData * pED = m_ED;
+        m_ED = NULL;
         m_lockTrialEvent.unlock();
+        if (pED == NULL)
+            return CBSDKRESULT_ERRCONFIG;
+        WaitTrialReaders();
+        freeEventData(pED);
         break;
+    }
     case CBSDKTRIAL_COMMETNS:
         m_lockTrialComment.lock();
         res = unsetTrialConfig(type);
@@ -1149,6 +1846,38 @@ CBSDKAPI    cbSdkResult cbSdkGetTime(UINT32 nInstance, UINT32 * cbtime)
     return g_app[nInstance]->SdkGetTime(cbtime);
 }
 
+// Purpose: Get the host time the packet being delivered to callback was received,
+//           this is the kernel receive time of its datagram if supported, or else the time it was read
+// Outputs:
+//   recvtime - receive time in nanoseconds since epoch (0 if unknown)
+//   hosttime - current host time in nanoseconds since epoch on the same clock
+//   returns the error code
+cbSdkResult SdkApp::SdkGetRecvTime(INT64 * recvtime, INT64 * hosttime)
+{
+    if (m_instInfo == 0)
+        return CBSDKRESULT_CLOSED;
+
+    if (recvtime)
+        *recvtime = getPacketStamp();
+    if (hosttime)
+        *hosttime = UDPSocket::HostTime();
+
+    return CBSDKRESULT_SUCCESS;
+}
+
+// Purpose: sdk stub for SdkApp::SdkGetRecvTime
+CBSDKAPI    cbSdkResult cbSdkGetRecvTime(UINT32 nInstance, INT64 * recvtime, INT64 * hosttime)
+{
+    if (recvtime == NULL && hosttime == NULL)
+        return CBSDKRESULT_NULLPTR;
+    if (nInstance >= cbMAXOPEN)
+        return CBSDKRESULT_INVALIDPARAM;
+    if (g_app[nInstance] == NULL)
+        return CBSDKRESULT_CLOSED;
+
+    return g_app[nInstance]->SdkGetRecvTime(recvtime, hosttime);
+}
+
 // Author & Date:   Ehsan Azar     29 April 2012
 // Purpose: Get direct access to spike cache shared memory
 // Outputs:
@@ -1180,6 +1909,54 @@ CBSDKAPI    cbSdkResult cbSdkGetSpkCache(UINT32 nInstance, UINT16 channel, cbSPK
     return g_app[nInstance]->SdkGetSpkCache(channel, cache);
 }
 
+// Purpose: Copy the cached spikes of a channel newer than a cursor
+// Inputs:
+//   channel - channel number (1-based)
+//   cursor  - number of spikes of the channel already seen, 0 to start
+//   count   - room in spikes
+// Outputs:
+//   cursor  - number of spikes seen after the copy
+//   spikes  - the spikes, oldest first
+//   count   - number of spikes copied
+//   returns the error code
+cbSdkResult SdkApp::SdkGetSpkCacheSince(UINT16 channel, UINT32 * cursor, cbPKT_SPK * spikes, UINT32 * count)
+{
+    if (m_instInfo == 0)
+        return CBSDKRESULT_CLOSED;
+    cbRESULT res = cbGetSpkCacheSince(channel, cursor, spikes, count, m_nInstance);
+    switch (res)
+    {
+    case cbRESULT_OK:
+        return CBSDKRESULT_SUCCESS;
+    case cbRESULT_DATALOST:
+        return CBSDKRESULT_WARNDATALOST;
+    case cbRESULT_NONEWDATA:
+        // The line kept changing under the copy
+        return CBSDKRESULT_BUSY;
+    case cbRESULT_INVALIDCHANNEL:
+        return CBSDKRESULT_INVALIDCHANNEL;
+    case cbRESULT_INVALIDADDRESS:
+        return CBSDKRESULT_NULLPTR;
+    default:
+        return CBSDKRESULT_CLOSED;
+    }
+}
+
+// Purpose: sdk stub for SdkApp::SdkGetSpkCacheSince
+CBSDKAPI    cbSdkResult cbSdkGetSpkCacheSince(UINT32 nInstance, UINT16 channel, UINT32 * cursor, cbPKT_SPK * spikes, UINT32 * count)
+{
+    if (cursor == NULL || count == NULL)
+        return CBSDKRESULT_NULLPTR;
+    if (spikes == NULL && *count > 0)
+        return CBSDKRESULT_NULLPTR;
+    if (nInstance >= cbMAXOPEN)
+        return CBSDKRESULT_INVALIDPARAM;
+    if (g_app[nInstance] == NULL)
+        return CBSDKRESULT_CLOSED;
+
+    return g_app[nInstance]->SdkGetSpkCacheSince(channel, cursor, spikes, count);
+}
+
 // Author & Date:   Ehsan Azar     25 June 2012
 // Purpose: Get information about configured data collection trial and its active status
 // Inputs:
@@ -1197,12 +1974,16 @@ CBSDKAPI    cbSdkResult cbSdkGetSpkCache(UINT32 nInstance, UINT16 channel, cbSPK
 //   puComments  - pointer (if non-NULL) to get number of comments to buffer
 //   puTrackings - pointer (if non-NULL) to get number of tracking data to buffer
 //   pbAbsolute  - pointer (if non-NULL) to get if timing is absolute
+//   puRaws      - pointer (if non-NULL) to get number of raw data to buffer
+//   pbScaled    - pointer (if non-NULL) to get if continuous data is in physical units
+//   pbInterleaved - pointer (if non-NULL) to get if continuous data is cached in rows of each sample group
 // Outputs:
 //   Returns the error code
 cbSdkResult SdkApp::SdkGetTrialConfig(UINT32 * pbActive, UINT16 * pBegchan, UINT32 * pBegmask, UINT32 * pBegval,
                                       UINT16 * pEndchan, UINT32 * pEndmask, UINT32 * pEndval, bool * pbDouble,
                                       UINT32 * puWaveforms, UINT32 * puConts, UINT32 * puEvents,
-                                      UINT32 * puComments, UINT32 * puTrackings, bool * pbAbsolute)
+                                      UINT32 * puComments, UINT32 * puTrackings, bool * pbAbsolute,
+                                      UINT32 * puRaws, bool * pbScaled, bool * pbInterleaved)
 {
     if (pbActive)
         *pbActive = m_bWithinTrial;
@@ -1232,6 +2013,12 @@ cbSdkResult SdkApp::SdkGetTrialConfig(UINT32 * pbActive, UINT16 * pBegchan, UINT
         *puTrackings = m_uTrialTrackings;
     if (pbAbsolute)
         *pbAbsolute = m_bTrialAbsolute;
+    if (puRaws)
+        *puRaws = m_uTrialRaws;
+    if (pbScaled)
+        *pbScaled = m_bTrialScaled;
+    if (pbInterleaved)
+        *pbInterleaved = m_bTrialInterleaved;
     return CBSDKRESULT_SUCCESS;
 }
 
@@ -1240,7 +2027,8 @@ CBSDKAPI    cbSdkResult cbSdkGetTrialConfig(UINT32 nInstance,
                                             UINT32 * pbActive, UINT16 * pBegchan, UINT32 * pBegmask, UINT32 * pBegval,
                                             UINT16 * pEndchan, UINT32 * pEndmask, UINT32 * pEndval, bool * pbDouble,
                                             UINT32 * puWaveforms, UINT32 * puConts, UINT32 * puEvents,
-                                            UINT32 * puComments, UINT32 * puTrackings, bool * pbAbsolute)
+                                            UINT32 * puComments, UINT32 * puTrackings, bool * pbAbsolute,
+                                            UINT32 * puRaws, bool * pbScaled, bool * pbInterleaved)
 {
     if (nInstance >= cbMAXOPEN)
         return CBSDKRESULT_INVALIDPARAM;
@@ -1250,7 +2038,8 @@ CBSDKAPI    cbSdkResult cbSdkGetTrialConfig(UINT32 nInstance,
     return g_app[nInstance]->SdkGetTrialConfig(pbActive, pBegchan, pBegmask, pBegval,
                                                pEndchan, pEndmask, pEndval, pbDouble,
                                                puWaveforms, puConts, puEvents,
-                                               puComments, puTrackings, pbAbsolute);
+                                               puComments, puTrackings, pbAbsolute,
+                                               puRaws, pbScaled, pbInterleaved);
 }
 
 // Author & Date:   Ehsan Azar     25 Feb 2011
@@ -1270,12 +2059,15 @@ CBSDKAPI    cbSdkResult cbSdkGetTrialConfig(UINT32 nInstance,
 //   uComments  - number of comments to buffer
 //   uTrackings - number of tracking data to buffer
 //   bAbsolute  - if event timing is absolute or relative to trial
+//   uRaws      - number of raw data to buffer
+//   bScaled    - if continuous and raw data is in the physical units of each channel (needs bDouble)
+//   bInterleaved - if continuous and raw data is cached in rows of each sample group
 // Outputs:
 //   Returns the error code
 cbSdkResult SdkApp::SdkSetTrialConfig(UINT32 bActive, UINT16 begchan, UINT32 begmask, UINT32 begval,
                                       UINT16 endchan, UINT32 endmask, UINT32 endval, bool bDouble,
                                       UINT32 uWaveforms, UINT32 uConts, UINT32 uEvents, UINT32 uComments, UINT32 uTrackings,
-                                      bool bAbsolute)
+                                      bool bAbsolute, UINT32 uRaws, bool bScaled, bool bInterleaved)
 {
     if (m_instInfo == 0)
         return CBSDKRESULT_CLOSED;
@@ -1289,65 +2081,102 @@ cbSdkResult SdkApp::SdkSetTrialConfig(UINT32 bActive, UINT16 begchan, UINT32 beg
     m_uTrialEndMask      = endmask;
     m_uTrialEndValue     = endval;
     m_bTrialDouble       = bDouble;
+    m_bTrialScaled       = bScaled;
     m_uTrialWaveforms    = uWaveforms;
     m_bTrialAbsolute     = bAbsolute;
 
+    // Interleaved rows are as wide as the sample groups are now
+    UINT32 widths[cbMAXGROUPS];
+    memset(widths, 0, sizeof(widths));
+    if (bInterleaved)
+    {
+        for (int group = 1; group <= cbRAWGROUP; ++group)
+            widths[group] = GroupWidth(group);
+    }
+
+    // The caches are allocated before taking the locks, the network thread only waits for them to be published
     if (uConts && m_CD == NULL)
     {
-        m_lockTrial.lock();
+        ContinuousData * pCD;
         try {
-            m_CD = new ContinuousData;
+            pCD = new ContinuousData;
         } catch (...) {
-            m_CD = NULL;
+            pCD = NULL;
         }
-        if (m_CD)
+        // Raw data is not in the continuous data cache
+        UINT32 uRawWidth = widths[cbRAWGROUP];
+        widths[cbRAWGROUP] = 0;
+        if (pCD && !pCD->alloc(uConts, bInterleaved, widths))
         {
-            memset(m_CD->continuous_channel_data, 0, sizeof(m_CD->continuous_channel_data));
-            m_CD->size = uConts;
-            bool bErr = false;
-            try {
-                for (UINT32 i = 0; i < cbNUM_ANALOG_CHANS; ++i)
-                {
-                    m_CD->continuous_channel_data[i] = new INT16[m_CD->size];
-                    if (m_CD->continuous_channel_data[i] == NULL)
-                    {
-                        bErr = true;
-                        break;
-                    }
-                }
-            } catch (...) {
-                bErr = true;
-            }
-            if (bErr)
-                unsetTrialConfig(CBSDKTRIAL_CONTINUOUS);
+            pCD->release();
+            delete pCD;
+            pCD = NULL;
         }
-        if (m_CD) m_CD->reset();
-        m_lockTrial.unlock();
-        if (m_CD == NULL)
+        widths[cbRAWGROUP] = uRawWidth;
+        if (pCD == NULL)
             return CBSDKRESULT_ERRMEMORYTRIAL;
+        pCD->reset();
+        m_lockTrial.lock();
+        // The network thread pushes the group layouts to a cache it did not see before
+        pCD->generation = ++m_nTrialGeneration;
+        TrialFence();
+        m_CD = pCD;
+        m_lockTrial.unlock();
         m_uTrialConts = uConts;
+        m_bTrialInterleaved = bInterleaved;
+    }
+
+    if (uRaws && m_RD == NULL)
+    {
+        ContinuousData * pRD;
+        try {
+            pRD = new ContinuousData;
+        } catch (...) {
+            pRD = NULL;
+        }
+        // Only the raw group is in the raw data cache
+        UINT32 raw_widths[cbMAXGROUPS];
+        memset(raw_widths, 0, sizeof(raw_widths));
+        raw_widths[cbRAWGROUP] = widths[cbRAWGROUP];
+        if (pRD && !pRD->alloc(uRaws, bInterleaved, raw_widths))
+        {
+            pRD->release();
+            delete pRD;
+            pRD = NULL;
+        }
+        if (pRD == NULL)
+            return CBSDKRESULT_ERRMEMORYTRIAL;
+        pRD->reset();
+        m_lockTrial.lock();
+        // The network thread pushes the group layouts to a cache it did not see before
+        pRD->generation = ++m_nTrialGeneration;
+        TrialFence();
+        m_RD = pRD;
+        m_lockTrial.unlock();
+        m_uTrialRaws = uRaws;
     }
 
     if (uEvents && m_ED == NULL)
     {
-        m_lockTrialEvent.lock();
+        EventData * pED;
         try {
-            m_ED = new EventData;
+            pED = new EventData;
         } catch (...) {
-            m_ED = NULL;
+            pED = NULL;
         }
-        if (m_ED)
+        if (pED)
         {
-            memset(m_ED->timestamps, 0, sizeof(m_ED->timestamps));
-            memset(m_ED->units, 0, sizeof(m_ED->units));
-            m_ED->size = uEvents;
+            memset(pED->timestamps, 0, sizeof(pED->timestamps));
+            memset(pED->units, 0, sizeof(pED->units));
+            pED->waveform_data = NULL;
+            pED->size = uEvents;
             bool bErr = false;
             try {
                 for (UINT32 i = 0; i < cbNUM_ANALOG_CHANS + 2; ++i)
                 {
-                    m_ED->timestamps[i] = new UINT32[m_ED->size];
-                    m_ED->units[i] = new UINT16[m_ED->size];
-                    if (m_ED->timestamps[i] == NULL || m_ED->units[i] == NULL)
+                    pED->timestamps[i] = new UINT32[pED->size];
+                    pED->units[i] = new UINT16[pED->size];
+                    if (pED->timestamps[i] == NULL || pED->units[i] == NULL)
                     {
                         bErr = true;
                         break;
@@ -1357,12 +2186,18 @@ cbSdkResult SdkApp::SdkSetTrialConfig(UINT32 bActive, UINT16 begchan, UINT32 beg
                 bErr = true;
             }
             if (bErr)
-                unsetTrialConfig(CBSDKTRIAL_EVENTS);
+            {
+                freeEventData(pED);
+                pED = NULL;
+            }
         }
-        if (m_ED) m_ED->reset();
-        m_lockTrialEvent.unlock();
-        if (m_ED == NULL)
+        if (pED == NULL)
             return CBSDKRESULT_ERRMEMORYTRIAL;
+        pED->reset();
+        m_lockTrialEvent.lock();
+        TrialFence();
+        m_ED = pED;
+        m_lockTrialEvent.unlock();
         m_uTrialEvents = uEvents;
     }
 
@@ -1488,23 +2323,30 @@ cbSdkResult SdkApp::SdkSetTrialConfig(UINT32 bActive, UINT16 begchan, UINT32 beg
         {
             cbGetSystemClockTime(&m_uTrialStartTime, m_nInstance);
 
+            // The caches are cleared from the reading side, the network thread keeps writing them
+            //  (the locks only keep them from being detached meanwhile)
+            m_lockTrial.lock();
             if (m_CD)
             {
                 // Clear continuous data array
-                m_lockTrial.lock();
-                memset(m_CD->write_index, 0, sizeof(m_CD->write_index));
-                memset(m_CD->write_start_index, 0, sizeof(m_CD->write_start_index));
-                m_lockTrial.unlock();
+                m_CD->flush();
+            }
+
+            if (m_RD)
+            {
+                // Clear raw data array
+                m_RD->flush();
             }
+            m_lockTrial.unlock();
 
+            m_lockTrialEvent.lock();
             if (m_ED)
             {
                 // Clear event data array
-                m_lockTrialEvent.lock();
-                memset(m_ED->write_index, 0, sizeof(m_ED->write_index));
-                memset(m_ED->write_start_index, 0, sizeof(m_ED->write_start_index));
-                m_lockTrialEvent.unlock();
+                for (UINT32 ch = 0; ch < cbNUM_ANALOG_CHANS + 2; ++ch)
+                    m_ED->write_start_index[ch] = m_ED->write_index[ch];
             }
+            m_lockTrialEvent.unlock();
 
             if (m_CMT)
             {
@@ -1535,8 +2377,11 @@ CBSDKAPI    cbSdkResult cbSdkSetTrialConfig(UINT32 nInstance,
                                             UINT32 bActive, UINT16 begchan, UINT32 begmask, UINT32 begval,
                                             UINT16 endchan, UINT32 endmask, UINT32 endval, bool bDouble,
                                             UINT32 uWaveforms, UINT32 uConts, UINT32 uEvents, UINT32 uComments, UINT32 uTrackings,
-                                            bool bAbsolute)
+                                            bool bAbsolute, UINT32 uRaws, bool bScaled, bool bInterleaved)
 {
+    // Samples in physical units are only returned in double precision
+    if (bScaled && !bDouble)
+        return CBSDKRESULT_INVALIDPARAM;
     if (nInstance >= cbMAXOPEN)
         return CBSDKRESULT_INVALIDPARAM;
     if (g_app[nInstance] == NULL)
@@ -1545,7 +2390,7 @@ CBSDKAPI    cbSdkResult cbSdkSetTrialConfig(UINT32 nInstance,
     return g_app[nInstance]->SdkSetTrialConfig(bActive, begchan, begmask, begval,
                                                endchan, endmask, endval, bDouble,
                                                uWaveforms, uConts, uEvents, uComments, uTrackings,
-                                               bAbsolute);
+                                               bAbsolute, uRaws, bScaled, bInterleaved);
 }
 
 // Author & Date:   Ehsan Azar     25 Feb 2011
@@ -1641,6 +2486,170 @@ CBSDKAPI    cbSdkResult cbSdkSetChannelLabel(UINT32 nInstance,
     return g_app[nInstance]->SdkSetChannelLabel(channel, label, userflags, position);
 }
 
+// Purpose: Internal function to retrieve the continuous (or raw) data of a configured trial
+// Inputs:
+//   pCD     - the continuous or raw data cache
+//   bActive - if should reset buffer
+//   startTime - start time for the retrieved samples
+//   trialcont->num_samples   - requested number of samples
+// Outputs:
+//   trialcont->num_samples   - retrieved number of samples
+//   trialcont->time          - start time for retrieved samples
+//   trialcont->samples       - the samples
+//   returns the error code
+cbSdkResult SdkApp::getTrialCont(ContinuousData * pCD, UINT32 bActive, UINT32 startTime, cbSdkTrialCont * trialcont)
+{
+    if (pCD == NULL)
+        return CBSDKRESULT_ERRCONFIG;
+    trialcont->time = startTime;
+    if (pCD->interleaved)
+        return getTrialRows(pCD, bActive, trialcont);
+    const bool bScaled = m_bTrialScaled;
+
+    const UINT32 size = pCD->size;
+    // copy the data from the "cache" to the allocated memory.
+    for (UINT32 channel = 0; channel < trialcont->count; channel++)
+    {
+        UINT16 ch = trialcont->chan[channel]; // channel number (index + 1 in cache)
+        if (ch == 0 || ch > cbNUM_ANALOG_CHANS)
+            return CBSDKRESULT_INVALIDCHANNEL;
+        // Ignore masked channels
+        if (!m_bChannelMask[ch - 1])
+        {
+            trialcont->num_samples[channel] = 0;
+            continue;
+        }
+
+        // The samples published by the network thread, with the scaling they are in
+        UINT32 read_count;
+        ChannelScaling scaling = {1.0, 0.0};
+        UINT32 num_samples = pCD->pending(ch - 1, read_count, bScaled ? &scaling : NULL);
+        // See which one finishes first
+        num_samples = min(num_samples, trialcont->num_samples[channel]);
+        // retrieved number of samples
+        trialcont->num_samples[channel] = num_samples;
+
+        void * dataptr = trialcont->samples[channel];
+        // Null means ignore
+        if (dataptr)
+        {
+            const INT16 * channel_data = pCD->channel_data(ch - 1);
+            const size_t elemsize = m_bTrialDouble ? sizeof(double) : sizeof(INT16);
+            // Copy in two runs (scaled in the same pass if asked to), the second one
+            //  from the start of the ring if the samples wrap around
+            const UINT32 read_index = read_count % size;
+            UINT32 first = min(num_samples, size - read_index);
+            CopySamples(dataptr, channel_data + read_index, first, m_bTrialDouble, scaling.gain, scaling.offset);
+            CopySamples((char *)dataptr + first * elemsize, channel_data, num_samples - first, m_bTrialDouble, scaling.gain, scaling.offset);
+            read_count += num_samples;
+        }
+        // Flush the buffer and start a new 'trial'...
+        if (bActive)
+        {
+            // The network thread writes over the samples read only after this
+            TrialFence();
+            pCD->read_count[ch - 1] = read_count;
+        }
+    }
+    return CBSDKRESULT_SUCCESS;
+}
+
+// Purpose: Internal function to retrieve the continuous (or raw) data of a configured trial
+//           cached in rows of each sample group, the rows are read whole
+// Inputs:
+//   pCD     - the continuous or raw data cache
+//   bActive - if should reset buffer
+//   trialcont->num_samples   - requested number of samples
+// Outputs:
+//   trialcont->num_samples   - retrieved number of samples, the same for all channels of a group
+//   trialcont->samples       - the samples
+//   returns the error code
+cbSdkResult SdkApp::getTrialRows(ContinuousData * pCD, UINT32 bActive, cbSdkTrialCont * trialcont)
+{
+    const bool bScaled = m_bTrialScaled;
+    const UINT32 size = pCD->size;
+    // Where each channel asked for is in trialcont
+    int index[cbNUM_ANALOG_CHANS];
+    UINT32 requested[cbNUM_ANALOG_CHANS];
+    for (UINT32 ch = 0; ch < cbNUM_ANALOG_CHANS; ch++)
+        index[ch] = -1;
+    for (UINT32 channel = 0; channel < trialcont->count; channel++)
+    {
+        UINT16 ch = trialcont->chan[channel]; // channel number (index + 1 in cache)
+        if (ch == 0 || ch > cbNUM_ANALOG_CHANS)
+            return CBSDKRESULT_INVALIDCHANNEL;
+        requested[channel] = trialcont->num_samples[channel];
+        trialcont->num_samples[channel] = 0;
+        // Ignore masked channels
+        if (m_bChannelMask[ch - 1])
+            index[ch - 1] = channel;
+    }
+
+    for (UINT32 group = 0; group < cbMAXGROUPS; group++)
+    {
+        if (pCD->group_header[group].row_step == 0)
+            continue;
+        // The rows published by the network thread, with the layout and scaling they are in
+        UINT32 read_count;
+        ContinuousData::GroupHeader rows;
+        UINT32 num_rows = pCD->pending_rows(group, read_count, rows, bScaled);
+
+        // The columns asked for, all get as many rows as the one that finishes first
+        void * dst[cbNUM_ANALOG_CHANS];
+        UINT16 col[cbNUM_ANALOG_CHANS];
+        double gain[cbNUM_ANALOG_CHANS];
+        double offset[cbNUM_ANALOG_CHANS];
+        UINT32 ncols = 0;
+        bool bRequested = false;
+        for (UINT32 i = 0; i < rows.width; i++)
+        {
+            int channel = index[rows.chan[i]];
+            if (channel < 0)
+                continue;
+            bRequested = true;
+            num_rows = min(num_rows, requested[channel]);
+        }
+        if (!bRequested)
+            continue;
+        for (UINT32 i = 0; i < rows.width; i++)
+        {
+            int channel = index[rows.chan[i]];
+            if (channel < 0)
+                continue;
+            // retrieved number of samples
+            trialcont->num_samples[channel] = num_rows;
+            // Null means ignore
+            if (trialcont->samples[channel] == NULL)
+                continue;
+            dst[ncols] = trialcont->samples[channel];
+            col[ncols] = (UINT16)i;
+            gain[ncols] = bScaled ? rows.scaling[i].gain : 1.0;
+            offset[ncols] = bScaled ? rows.scaling[i].offset : 0.0;
+            ncols++;
+        }
+        if (ncols)
+        {
+            const INT16 * group_rows = pCD->group_rows(group);
+            // Copy in two runs, the second one from the start of the ring if the rows wrap around
+            const UINT32 read_index = read_count % size;
+            UINT32 first = min(num_rows, size - read_index);
+            CopyRows(dst, 0, group_rows + (size_t)read_index * rows.row_step, rows.row_step, first,
+                     ncols, col, m_bTrialDouble, gain, offset);
+            CopyRows(dst, first, group_rows, rows.row_step, num_rows - first,
+                     ncols, col, m_bTrialDouble, gain, offset);
+            read_count += num_rows;
+        }
+        // Flush the buffer and start a new 'trial'...
+        if (bActive)
+        {
+            // The network thread writes over the rows read only after this
+            TrialFence();
+            pCD->group_read_count[group] = read_count;
+        }
+    }
+    return CBSDKRESULT_SUCCESS;
+}
+
 // Author & Date:   Ehsan Azar     11 March 2011
 // Purpose: Retrieve data of a configured trial.
 // Inputs:
@@ -1649,6 +2658,7 @@ CBSDKAPI    cbSdkResult cbSdkSetChannelLabel(UINT32 nInstance,
 //   trialcont->num_samples   - requested number of continuous samples
 //   trialcomment->num_samples   - requested number of comment samples
 //   trialtracking->num_samples      - requested number of tracking samples
+//   trialraw->num_samples    - requested number of raw samples
 // Outputs: (buffers must be preallocated at least for requested num_samples of appropriate size)
 //   trialevent->num_samples  - retrieved number of events
 //   trialevent->timestamps   - timestamps for events
@@ -1666,12 +2676,18 @@ CBSDKAPI    cbSdkResult cbSdkSetChannelLabel(UINT32 nInstance,
 //   trialtracking->synch_timestamps      - retrieved synchronized timesamps
 //   trialtracking->timestamps      - timestamps for tracking
 //   trialtracking->coords          - tracking coordinates
+//   trialraw->num_samples    - retrieved number of raw samples
+//   trialraw->time           - start time for retrieved raw samples
+//   trialraw->samples        - raw samples
 //   Returns the error code
 cbSdkResult SdkApp::SdkGetTrialData(UINT32 bActive, cbSdkTrialEvent * trialevent, cbSdkTrialCont * trialcont,
-                                      cbSdkTrialComment * trialcomment, cbSdkTrialTracking * trialtracking)
+                                      cbSdkTrialComment * trialcomment, cbSdkTrialTracking * trialtracking,
+                                      cbSdkTrialCont * trialraw)
 {
     if (m_instInfo == 0)
         return CBSDKRESULT_CLOSED;
+    // The caches are not freed while read, load each cache pointer once after this
+    TrialReader reader(m_nTrialReaders);
 
     // This time is used for relative timings,
     //  continuous as well as event relative timings reset any time bActive is set
@@ -1681,78 +2697,30 @@ cbSdkResult SdkApp::SdkGetTrialData(UINT32 bActive, cbSdkTrialEvent * trialevent
 
     if (trialcont)
     {
-        UINT32 read_end_index[cbNUM_ANALOG_CHANS];
-        UINT32 read_start_index[cbNUM_ANALOG_CHANS];
-        if (m_CD == NULL)
-            return CBSDKRESULT_ERRCONFIG;
-        trialcont->time = prevStartTime;
-        // Take a snashot
-        memcpy(read_start_index, m_CD->write_start_index, sizeof(read_start_index));
-        m_lockTrial.lock();
-        memcpy(read_end_index, m_CD->write_index, sizeof(read_end_index));
-        m_lockTrial.unlock();
-
-        // copy the data from the "cache" to the allocated memory.
-        for (UINT32 channel = 0; channel < trialcont->count; channel++)
-        {
-            UINT16 ch = trialcont->chan[channel]; // channel number (index + 1 in cache)
-            if (ch == 0 || ch > cbNUM_ANALOG_CHANS)
-                return CBSDKRESULT_INVALIDCHANNEL;
-            // Ignore masked channels
-            if (!m_bChannelMask[ch - 1])
-            {
-                trialcont->num_samples[channel] = 0;
-                continue;
-            }
-
-            UINT32 read_index = m_CD->write_start_index[ch - 1];
-            int num_samples = read_end_index[ch - 1] - read_index;
-            if (num_samples < 0)
-                num_samples += m_CD->size;
-            // See which one finishes first
-            num_samples = min((UINT32)num_samples, trialcont->num_samples[channel]);
-            // retrieved number of samples
-            trialcont->num_samples[channel] = num_samples;
+        cbSdkResult res = getTrialCont(m_CD, bActive, prevStartTime, trialcont);
+        if (res != CBSDKRESULT_SUCCESS)
+            return res;
+    }
 
-            void * dataptr = trialcont->samples[channel];
-            // Null means ignore
-            if (dataptr)
-            {
-                for (int i = 0; i < num_samples; ++i)
-                {
-                    if (m_bTrialDouble)
-                        *((double *)dataptr + i) = m_CD->continuous_channel_data[ch - 1][read_index];
-                    else
-                        *((INT16 *)dataptr + i) = m_CD->continuous_channel_data[ch - 1][read_index];
-
-                    read_index++;
-                    if (read_index >= m_CD->size)
-                        read_index = 0;
-                }
-            }
-            // Flush the buffer and start a new 'trial'...
-            if (bActive)
-                read_start_index[ch - 1] = read_index;
-        }
-        if (bActive)
-        {
-            m_lockTrial.lock();
-            memcpy(m_CD->write_start_index, read_start_index, sizeof(m_CD->write_start_index));
-            m_lockTrial.unlock();
-        }
+    if (trialraw)
+    {
+        cbSdkResult res = getTrialCont(m_RD, bActive, prevStartTime, trialraw);
+        if (res != CBSDKRESULT_SUCCESS)
+            return res;
     }
 
     if (trialevent)
     {
         UINT32 read_end_index[cbNUM_ANALOG_CHANS + 2];
         UINT32 read_start_index[cbNUM_ANALOG_CHANS + 2];
-        if (m_ED == NULL)
+        EventData * const pED = m_ED;
+        if (pED == NULL)
             return CBSDKRESULT_ERRCONFIG;
         // Take a snashot
-        memcpy(read_start_index, m_ED->write_start_index, sizeof(read_start_index));
-        m_lockTrialEvent.lock();
-        memcpy(read_end_index, m_ED->write_index, sizeof(read_end_index));
-        m_lockTrialEvent.unlock();
+        memcpy(read_start_index, pED->write_start_index, sizeof(read_start_index));
+        memcpy(read_end_index, pED->write_index, sizeof(read_end_index));
+        // Only events published by the network thread are read
+        TrialFence();
 
         // copy the data from the "cache" to the allocated memory.
         for (UINT32 channel = 0; channel < trialevent->count; channel++)
@@ -1771,17 +2739,17 @@ cbSdkResult SdkApp::SdkGetTrialData(UINT32 bActive, cbSdkTrialEvent * trialevent
                 continue;
             }
 
-            UINT32 read_index = m_ED->write_start_index[ch - 1];
+            UINT32 read_index = pED->write_start_index[ch - 1];
             int num_samples = read_end_index[ch - 1] - read_index;
             if (num_samples < 0)
-                num_samples += m_ED->size;
+                num_samples += pED->size;
 
             UINT32 num_samples_unit[cbMAXUNITS + 1];
             memset(num_samples_unit, 0, sizeof(num_samples_unit));
 
             for (int i = 0; i < num_samples; ++i)
             {
-                UINT16 unit = m_ED->units[ch - 1][read_index];
+                UINT16 unit = pED->units[ch - 1][read_index];
                 // Digital or serial data
                 if (ch > cbNUM_ANALOG_CHANS)
                 {
@@ -1806,7 +2774,7 @@ cbSdkResult SdkApp::SdkGetTrialData(UINT32 bActive, cbSdkTrialEvent * trialevent
                     // Null means ignore
                     if (dataptr)
                     {
-                        UINT32 ts = m_ED->timestamps[ch - 1][read_index];
+                        UINT32 ts = pED->timestamps[ch - 1][read_index];
                         // If time wraps or due to reset, time will restart amidst trial
                         if (!m_bTrialAbsolute && ts >= prevStartTime)
                             ts -= prevStartTime;
@@ -1820,7 +2788,7 @@ cbSdkResult SdkApp::SdkGetTrialData(UINT32 bActive, cbSdkTrialEvent * trialevent
                     break;
 
                 read_index++;
-                if (read_index >= m_ED->size)
+                if (read_index >= pED->size)
                     read_index = 0;
             }
             // retrieved number of samples
@@ -1831,9 +2799,9 @@ cbSdkResult SdkApp::SdkGetTrialData(UINT32 bActive, cbSdkTrialEvent * trialevent
         }
         if (bActive)
         {
-            m_lockTrialEvent.lock();
-            memcpy(m_ED->write_start_index, read_start_index, sizeof(m_ED->write_start_index));
-            m_lockTrialEvent.unlock();
+            // The network thread writes over the events read only after this
+            TrialFence();
+            memcpy(pED->write_start_index, read_start_index, sizeof(pED->write_start_index));
         }
     }
 
@@ -2009,14 +2977,76 @@ cbSdkResult SdkApp::SdkGetTrialData(UINT32 bActive, cbSdkTrialEvent * trialevent
 // Purpose: sdk stub for SdkApp::SdkGetTrialData
 CBSDKAPI    cbSdkResult cbSdkGetTrialData(UINT32 nInstance,
                                           UINT32 bActive, cbSdkTrialEvent * trialevent, cbSdkTrialCont * trialcont,
-                                          cbSdkTrialComment * trialcomment, cbSdkTrialTracking * trialtracking)
+                                          cbSdkTrialComment * trialcomment, cbSdkTrialTracking * trialtracking,
+                                          cbSdkTrialCont * trialraw)
 {
     if (nInstance >= cbMAXOPEN)
         return CBSDKRESULT_INVALIDPARAM;
     if (g_app[nInstance] == NULL)
         return CBSDKRESULT_CLOSED;
 
-    return g_app[nInstance]->SdkGetTrialData(bActive, trialevent, trialcont, trialcomment, trialtracking);
+    return g_app[nInstance]->SdkGetTrialData(bActive, trialevent, trialcont, trialcomment, trialtracking, trialraw);
+}
+
+// Purpose: Internal function to initialize the continuous (or raw) data structure
+// Inputs:
+//   pCD - the continuous or raw data cache
+// Outputs:
+//   trialcont - initialize channel count, channels, sample rate and number of buffered samples for each channel
+//   returns the error code
+cbSdkResult SdkApp::initTrialCont(ContinuousData * pCD, cbSdkTrialCont * trialcont)
+{
+    trialcont->count = 0;
+    memset(trialcont->num_samples, 0, sizeof(trialcont->num_samples));
+    if (m_instInfo == 0)
+    {
+        memset(trialcont->chan, 0, sizeof(trialcont->chan));
+        memset(trialcont->sample_rates, 0, sizeof(trialcont->sample_rates));
+        return CBSDKRESULT_WARNCLOSED;
+    }
+    if (pCD == NULL)
+        return CBSDKRESULT_ERRCONFIG;
+    // The samples read next and their rate, the older ones are dropped then
+    UINT32 num[cbNUM_ANALOG_CHANS];
+    UINT16 rate[cbNUM_ANALOG_CHANS];
+    if (pCD->interleaved)
+    {
+        memset(num, 0, sizeof(num));
+        for (UINT32 group = 0; group < cbMAXGROUPS; group++)
+        {
+            if (pCD->group_header[group].row_step == 0)
+                continue;
+            UINT32 read_count;
+            ContinuousData::GroupHeader rows;
+            UINT32 num_rows = pCD->pending_rows(group, read_count, rows, m_bTrialScaled);
+            for (UINT32 i = 0; i < rows.width; i++)
+            {
+                num[rows.chan[i]] = num_rows;
+                rate[rows.chan[i]] = rows.rate;
+            }
+        }
+    } else {
+        for (UINT32 channel = 0; channel < cbNUM_ANALOG_CHANS; channel++)
+        {
+            UINT32 read_count;
+            ChannelScaling scaling;
+            num[channel] = pCD->pending(channel, read_count, m_bTrialScaled ? &scaling : NULL);
+            rate[channel] = pCD->chan_header[channel].rate;
+        }
+    }
+    int count = 0;
+    for (UINT32 channel = 0; channel < cbNUM_ANALOG_CHANS; channel++)
+    {
+        if (num[channel] && m_bChannelMask[channel])
+        {
+            trialcont->chan[count] = channel + 1; // Actual channel number
+            trialcont->num_samples[count] = num[channel];
+            trialcont->sample_rates[count] = rate[channel];
+            count++;
+        }
+    }
+    trialcont->count = count;
+    return CBSDKRESULT_SUCCESS;
 }
 
 // Author & Date:   Ehsan Azar     22 March 2011
@@ -2032,10 +3062,15 @@ CBSDKAPI    cbSdkResult cbSdkGetTrialData(UINT32 nInstance,
 //   trialcomment  - initialize number of buffered comments
 //   trialtracking - initialize trackable count, trackable name, id, type,
 //                    mximum point count and number of buffered samples for each trackable
+//   trialraw      - initialize channel count, channels, sample rate and number of buffered raw samples for each channel
 //   returns the error code
 cbSdkResult SdkApp::SdkInitTrialData(cbSdkTrialEvent * trialevent, cbSdkTrialCont * trialcont,
-                                     cbSdkTrialComment * trialcomment, cbSdkTrialTracking * trialtracking)
+                                     cbSdkTrialComment * trialcomment, cbSdkTrialTracking * trialtracking,
+                                     cbSdkTrialCont * trialraw)
 {
+    // The caches are not freed while read, load each cache pointer once after this
+    TrialReader reader(m_nTrialReaders);
+
     if (trialevent)
     {
         trialevent->count = 0;
@@ -2045,20 +3080,20 @@ cbSdkResult SdkApp::SdkInitTrialData(cbSdkTrialEvent * trialevent, cbSdkTrialCon
             memset(trialevent->chan, 0, sizeof(trialevent->chan));
             return CBSDKRESULT_WARNCLOSED;
         } else {
-            if (m_ED == NULL)
+            EventData * const pED = m_ED;
+            if (pED == NULL)
                 return CBSDKRESULT_ERRCONFIG;
             UINT32 read_end_index[cbNUM_ANALOG_CHANS + 2];
             // Take a snapshot of the current write pointer
-            m_lockTrialEvent.lock();
-            memcpy(read_end_index, m_ED->write_index, sizeof(read_end_index));
-            m_lockTrialEvent.unlock();
+            memcpy(read_end_index, pED->write_index, sizeof(read_end_index));
+            TrialFence();
             int count = 0;
             for (UINT32 channel = 0; channel < cbNUM_ANALOG_CHANS + 2; channel++)
             {
-                UINT32 i = m_ED->write_start_index[channel];
+                UINT32 i = pED->write_start_index[channel];
                 int num_samples = read_end_index[channel] - i;
                 if (num_samples < 0)
-                    num_samples += m_ED->size;
+                    num_samples += pED->size;
                 if (num_samples == 0)
                     continue;
                 UINT16 ch = channel + 1; // Actual channel number
@@ -2070,11 +3105,11 @@ cbSdkResult SdkApp::SdkInitTrialData(cbSdkTrialEvent * trialevent, cbSdkTrialCon
                 // Count sample numbers for each unit seperately
                 while (i != read_end_index[channel])
                 {
-                    UINT16 unit = m_ED->units[channel][i];
+                    UINT16 unit = pED->units[channel][i];
                     if (unit > cbMAXUNITS || channel >= cbNUM_ANALOG_CHANS)
                         unit = 0;
                     trialevent->num_samples[count][unit]++;
-                    if (++i >= m_ED->size)
+                    if (++i >= pED->size)
                         i = 0;
                 }
                 count++;
@@ -2084,37 +3119,15 @@ cbSdkResult SdkApp::SdkInitTrialData(cbSdkTrialEvent * trialevent, cbSdkTrialCon
     }
     if (trialcont)
     {
-        trialcont->count = 0;
-        memset(trialcont->num_samples, 0, sizeof(trialcont->num_samples));
-        if (m_instInfo == 0)
-        {
-            memset(trialcont->chan, 0, sizeof(trialcont->chan));
-            memset(trialcont->sample_rates, 0, sizeof(trialcont->samples));
-            return CBSDKRESULT_WARNCLOSED;
-        } else {
-            if (m_CD == NULL)
-                return CBSDKRESULT_ERRCONFIG;
-            UINT32 read_end_index[cbNUM_ANALOG_CHANS];
-            // Take a snapshot of the current write pointer
-            m_lockTrial.lock();
-            memcpy(read_end_index, m_CD->write_index, sizeof(read_end_index));
-            m_lockTrial.unlock();
-            int count = 0;
-            for (UINT32 channel = 0; channel < cbNUM_ANALOG_CHANS; channel++)
-            {
-                int num_samples = read_end_index[channel] - m_CD->write_start_index[channel];
-                if (num_samples < 0)
-                    num_samples += m_CD->size;
-                if (num_samples && m_bChannelMask[channel])
-                {
-                    trialcont->chan[count] = channel + 1; // Actual channel number
-                    trialcont->num_samples[count] = num_samples;
-                    trialcont->sample_rates[count] = m_CD->current_sample_rates[channel];
-                    count++;
-                }
-            }
-            trialcont->count = count;
-        }
+        cbSdkResult res = initTrialCont(m_CD, trialcont);
+        if (res != CBSDKRESULT_SUCCESS)
+            return res;
+    }
+    if (trialraw)
+    {
+        cbSdkResult res = initTrialCont(m_RD, trialraw);
+        if (res != CBSDKRESULT_SUCCESS)
+            return res;
     }
     if (trialcomment)
     {
@@ -2184,14 +3197,15 @@ cbSdkResult SdkApp::SdkInitTrialData(cbSdkTrialEvent * trialevent, cbSdkTrialCon
 // Purpose: sdk stub for SdkApp::SdkInitTrialData
 CBSDKAPI    cbSdkResult cbSdkInitTrialData(UINT32 nInstance,
                                            cbSdkTrialEvent * trialevent, cbSdkTrialCont * trialcont,
-                                           cbSdkTrialComment * trialcomment, cbSdkTrialTracking * trialtracking)
+                                           cbSdkTrialComment * trialcomment, cbSdkTrialTracking * trialtracking,
+                                           cbSdkTrialCont * trialraw)
 {
     if (nInstance >= cbMAXOPEN)
         return CBSDKRESULT_INVALIDPARAM;
     if (g_app[nInstance] == NULL)
         return CBSDKRESULT_CLOSED;
 
-    return g_app[nInstance]->SdkInitTrialData(trialevent, trialcont, trialcomment, trialtracking);
+    return g_app[nInstance]->SdkInitTrialData(trialevent, trialcont, trialcomment, trialtracking, trialraw);
 }
 
 // Author & Date:   Ehsan Azar     25 Feb 2011
@@ -3584,8 +4598,9 @@ cbSdkResult SdkApp::SdkAnalogToDigital(UINT16 channel, const char * szVoltsUnitS
         chan_factor = 1000;
     else if (strUnit.compare("uV") == 0)
         chan_factor = 1000000;
-    // TODO: see if anagain needs to be used
-    *digital = (INT32)floor(((dValue * scale.digmax) * chan_factor) / ((double)nFactor * scale.anamax));
+    // The analog range is divided by the gain, as in cbXfmAnaToDig (no gain is the same as unit gain)
+    const double anagain = scale.anagain ? scale.anagain : 1;
+    *digital = (INT32)floor(((dValue * scale.digmax) * chan_factor * anagain) / ((double)nFactor * scale.anamax));
     return CBSDKRESULT_SUCCESS;
 }
 
@@ -3607,17 +4622,18 @@ CBSDKAPI    cbSdkResult cbSdkAnalogToDigital(UINT32 nInstance, UINT16 channel, c
 // Author & Date: Ehsan Azar       29 April 2012
 // Purpose: Sdk app base constructor
 SdkApp::SdkApp() :
-    m_bInitialized(false), m_lastCbErr(cbRESULT_OK),
+    m_bInitialized(false), m_lastCbErr(cbRESULT_OK), m_nTrialGeneration(0),
     m_uTrialBeginChannel(0), m_uTrialBeginMask(0), m_uTrialBeginValue(0), m_uTrialEndChannel(0), m_uTrialEndMask(0), m_uTrialEndValue(0),
-    m_bTrialDouble(false), m_bTrialAbsolute(false),
-    m_uTrialWaveforms(0), m_uTrialConts(0), m_uTrialEvents(0), m_uTrialComments(0), m_uTrialTrackings(0),
+    m_bTrialDouble(false), m_bTrialAbsolute(false), m_bTrialScaled(false), m_bTrialInterleaved(false),
+    m_uTrialWaveforms(0), m_uTrialConts(0), m_uTrialEvents(0), m_uTrialComments(0), m_uTrialTrackings(0), m_uTrialRaws(0),
     m_bWithinTrial(FALSE), m_uTrialStartTime(0), m_uCbsdkTime(0),
-    m_CD(NULL), m_ED(NULL), m_CMT(NULL), m_TR(NULL)
+    m_CD(NULL), m_RD(NULL), m_ED(NULL), m_CMT(NULL), m_TR(NULL)
 {
     memset(&m_lastPktVideoSynch, 0, sizeof(m_lastPktVideoSynch));
     memset(&m_bChannelMask, 0, sizeof(m_bChannelMask));
+    memset(&m_groupLayout, 0, sizeof(m_groupLayout));
+    memset(&m_groupScaling, 0, sizeof(m_groupScaling));
     memset(&m_lastPktVideoSynch, 0, sizeof(m_lastPktVideoSynch));
-    memset(&m_lastLost, 0, sizeof(m_lastLost));
     memset(&m_lastInstInfo, 0, sizeof(m_lastInstInfo));
     for (int i = 0; i < CBSDKCALLBACK_COUNT; ++i)
     {
@@ -3644,7 +4660,23 @@ SdkApp::~SdkApp()
 //   nOutPort  - Instrument port number
 //   szInIP;   - Client IPv4 address
 //   szOutIP   - Instrument IPv4 address
-void SdkApp::Open(UINT32 nInstance, int nInPort, int nOutPort, LPCSTR szInIP, LPCSTR szOutIP, int nRecBufSize)
+//   nRecBufSize   - Receive buffer size
+//   nRecBatchSize - Maximum number of datagrams to receive in one call
+//   nNetLoop      - Stand-alone network loop
+//   bRecvThread   - If packets are processed in a thread separate from the receive thread
+//   nNetPriority  - Network threads priority
+//   nNetAffinity  - Network threads CPU affinity mask (0 for any CPU)
+//   nBusyPoll     - Microseconds to busy poll the network device on receive (0 to disable)
+//   nXmtRate      - Packets per second sent to the instrument
+//   nXmtBurst     - Maximum number of packets sent to the instrument back to back
+//   nXmtWindow    - Maximum number of packets waiting for a response from the instrument at once
+//   nRecRingLen   - Receive buffer length if stand-alone (units of UINT32, 0 for the default)
+//   nShmFlags     - Shared memory options (cbSHMEM_*)
+//   nSpkCacheDepth - Spikes cached per channel if stand-alone (0 for the default)
+void SdkApp::Open(UINT32 nInstance, int nInPort, int nOutPort, LPCSTR szInIP, LPCSTR szOutIP, int nRecBufSize, int nRecBatchSize,
+                  NetLoopType nNetLoop, bool bRecvThread, QThread::Priority nNetPriority, UINT64 nNetAffinity, int nBusyPoll,
+                  int nXmtRate, int nXmtBurst, int nXmtWindow, UINT32 nRecRingLen, UINT32 nShmFlags,
+                  UINT32 nSpkCacheDepth)
 {
     // clear las library error
     m_lastCbErr = cbRESULT_OK;
@@ -3665,11 +4697,23 @@ void SdkApp::Open(UINT32 nInstance, int nInPort, int nOutPort, LPCSTR szInIP, LP
     m_nInPort = nInPort;
     m_nOutPort = nOutPort;
     m_nRecBufSize = nRecBufSize;
+    m_nRecBatchSize = nRecBatchSize;
+    m_nNetLoop = nNetLoop;
+    m_bRecvThread = bRecvThread;
+    m_nNetPriority = nNetPriority;
+    m_nNetAffinity = nNetAffinity;
+    m_nBusyPoll = nBusyPoll;
+    m_nXmtRate = nXmtRate > 0 ? nXmtRate : NSP_XMT_RATE;
+    m_nXmtBurst = nXmtBurst > 0 ? nXmtBurst : NSP_XMT_BURST;
+    m_nXmtWindow = nXmtWindow;
+    m_nRecRingLen = nRecRingLen;
+    m_nShmFlags = nShmFlags;
+    m_nSpkCacheDepth = nSpkCacheDepth;
     m_strInIP = szInIP;
     m_strOutIP = szOutIP;
 
     // Restart networking thread
-    start(QThread::HighPriority);
+    start(m_nNetPriority);
 }
 
 // Author & Date: Ehsan Azar       29 April 2012
@@ -3712,6 +4756,8 @@ void SdkApp::ProcessIncomingPacket(const cbPKT_GENERIC * const pPkt)
             }
             else if ((pPkt->type & 0xF0) == cbPKTTYPE_CHANREP)
             {
+                // The channel may have moved to another sample group, or changed its scaling
+                InvalidateGroupLayout();
                 if (m_pLateCallback[CBSDKCALLBACK_ALL])
                     m_pLateCallback[CBSDKCALLBACK_ALL](m_nInstance, cbSdkPkt_CHANINFO, pPkt, m_pLateCallbackParams[CBSDKCALLBACK_ALL]);
                 // Late bind before usage
@@ -3730,6 +4776,8 @@ void SdkApp::ProcessIncomingPacket(const cbPKT_GENERIC * const pPkt)
             }
             else if (pPkt->type == cbPKTTYPE_GROUPREP)
             {
+                // The group period or list may have changed
+                InvalidateGroupLayout();
                 if (m_pLateCallback[CBSDKCALLBACK_ALL])
                     m_pLateCallback[CBSDKCALLBACK_ALL](m_nInstance, cbSdkPkt_GROUPINFO, pPkt, m_pLateCallbackParams[CBSDKCALLBACK_ALL]);
                 // Late bind before usage
@@ -3803,6 +4851,14 @@ void SdkApp::ProcessIncomingPacket(const cbPKT_GENERIC * const pPkt)
             LateBindCallback(CBSDKCALLBACK_CONTINUOUS);
             if (m_pLateCallback[CBSDKCALLBACK_CONTINUOUS])
                 m_pLateCallback[CBSDKCALLBACK_CONTINUOUS](m_nInstance, cbSdkPkt_CONTINUOUS, pPkt, m_pLateCallbackParams[CBSDKCALLBACK_CONTINUOUS]);
+            // Late bind before usage
+            LateBindCallback(CBSDKCALLBACK_SCALED);
+            if (m_pLateCallback[CBSDKCALLBACK_SCALED])
+            {
+                cbSdkScaledGroup scaled;
+                if (ScaleGroup(reinterpret_cast<const cbPKT_GROUP*>(pPkt), &scaled))
+                    m_pLateCallback[CBSDKCALLBACK_SCALED](m_nInstance, cbSdkPkt_SCALED, &scaled, m_pLateCallbackParams[CBSDKCALLBACK_SCALED]);
+            }
         }
     }
     // check for channel event packets cerebus channels 1-144
@@ -3903,6 +4959,21 @@ void SdkApp::OnInstNetworkEvent(NetEventType type, unsigned int code)
         lostEvent.type = CBSDKPKTLOSTEVENT_PC2NSP;
         LinkFailureEvent(lostEvent);
         break;
+    case NET_EVENT_PKTGAP:
+        {
+            PacketGap gap = getLastGap();
+            lostEvent.type = CBSDKPKTLOSTEVENT_GAP;
+            lostEvent.stream = gap.nStream;
+            lostEvent.lost = gap.nLost;
+            lostEvent.time = gap.nTime;
+            lostEvent.nexttime = gap.nNextTime;
+            LinkFailureEvent(lostEvent);
+        }
+        break;
+    case NET_EVENT_PROCLOST:
+        lostEvent.type = CBSDKPKTLOSTEVENT_PROC;
+        LinkFailureEvent(lostEvent);
+        break;
     default:
         // Ignore other events
         break;
@@ -79,6 +79,7 @@ typedef struct _cbSdkVersion
 /* cbSdk return values */
 typedef enum _cbSdkResult
 {
+    CBSDKRESULT_WARNDATALOST           =     4, // Some data was lost, the rest is returned
     CBSDKRESULT_WARNCONVERT            =     3, // If file conversion is needed
     CBSDKRESULT_WARNCLOSED             =     2, // Library is already closed
     CBSDKRESULT_WARNOPEN               =     1, // Library is already opened
@@ -113,6 +114,7 @@ typedef enum _cbSdkResult
     CBSDKRESULT_TIMEOUT                =   -28, // Conection timeout error
     CBSDKRESULT_BUSY                   =   -29, // Resource is busy
     CBSDKRESULT_ERROFFLINE             =   -30, // Instrument is offline
+    CBSDKRESULT_ERRCENTRALVERSION      =   -31, // Central is running with shared memory of another library version
 } cbSdkResult;
 
 typedef enum _cbSdkConnectionType
@@ -124,6 +126,33 @@ typedef enum _cbSdkConnectionType
     CBSDKCONNECTION_COUNT // Allways the last value (Unknown)
 } cbSdkConnectionType;
 
+// Stand-alone (UDP) network loop
+typedef enum _cbSdkNetLoopType
+{
+    CBSDKNETLOOP_TIMER = 0,      // Process network every 10ms
+    CBSDKNETLOOP_EVENT,          // Process network as soon as data arrives
+    CBSDKNETLOOP_SPIN,           // Spin on the network without sleeping (uses a whole CPU)
+    CBSDKNETLOOP_COUNT // Allways the last value (Invalid)
+} cbSdkNetLoopType;
+
+// Network thread priority
+typedef enum _cbSdkThreadPriority
+{
+    CBSDKPRIORITY_HIGH = 0,      // High priority (default)
+    CBSDKPRIORITY_NORMAL,        // Normal priority
+    CBSDKPRIORITY_HIGHEST,       // Highest priority
+    CBSDKPRIORITY_TIMECRITICAL,  // Time critical priority (may need privileges)
+    CBSDKPRIORITY_COUNT // Allways the last value (Invalid)
+} cbSdkThreadPriority;
+
+// Shared memory options (may be combined), each one is ignored where not available
+typedef enum _cbSdkSharedMemoryFlags
+{
+    CBSDKSHMEM_HUGEPAGES = 0x01, // Back the shared buffers with huge pages (stand-alone only)
+    CBSDKSHMEM_PREFAULT  = 0x02, // Fault all the pages in when the buffers are opened
+    CBSDKSHMEM_LOCK      = 0x04  // Lock the buffers in physical memory
+} cbSdkSharedMemoryFlags;
+
 typedef enum _cbSdkInstrumentType
 {
     CBSDKINSTRUMENT_NSP = 0,       // NSP
@@ -148,11 +177,26 @@ typedef enum _cbSdkPktLostEventType
     CBSDKPKTLOSTEVENT_LINKFAILURE,       // Link failure
     CBSDKPKTLOSTEVENT_PC2NSP,            // PC to NSP connection lost
     CBSDKPKTLOSTEVENT_NET,               // Network error
+    CBSDKPKTLOSTEVENT_GAP,               // Packets missing from a periodic stream
+    CBSDKPKTLOSTEVENT_PROC,              // Packets dropped because processing fell behind receiving
 } cbSdkPktLostEventType;
 
 typedef struct _cbSdkPktLostEvent
 {
+    _cbSdkPktLostEvent()
+    {
+        type = CBSDKPKTLOSTEVENT_UNKNOWN;
+        stream = 0;
+        lost = 0;
+        time = 0;
+        nexttime = 0;
+    }
     cbSdkPktLostEventType type;     // packet lost event type
+    // Following are only valid for CBSDKPKTLOSTEVENT_GAP
+    UINT32 stream;   // 0 for system heartbeats, otherwise the sample group
+    UINT32 lost;     // number of packets missing
+    UINT32 time;     // time of the last packet before the gap
+    UINT32 nexttime; // time of the first packet after the gap
 } cbSdkPktLostEvent;
 
 typedef struct _cbSdkInstInfo
@@ -160,6 +204,16 @@ typedef struct _cbSdkInstInfo
     UINT32 instInfo;     // bitfield of cbINSTINFO_* (0 means closed)
 } cbSdkInstInfo;
 
+// Sample group packet with the samples scaled to the physical units of their channel (cbSCALING anaunit)
+typedef struct _cbSdkScaledGroup
+{
+    UINT32 time;  // system clock timestamp
+    UINT16 group; // sample group
+    UINT16 count; // number of samples
+    UINT16 chan[cbNUM_ANALOG_CHANS]; // channel number (1-based) of each sample
+    float data[cbNUM_ANALOG_CHANS];  // the scaled samples
+} cbSdkScaledGroup;
+
 typedef enum _cbSdkPktType
 {
     cbSdkPkt_PACKETLOST = 0, // will be received only by the first registered callback
@@ -180,6 +234,7 @@ typedef enum _cbSdkPktType
     cbSdkPkt_CCF,            // data points to cbSdkCCFEvent
     cbSdkPkt_IMPEDANCE,      // data points to cbPKT_IMPEDANCE
     cbSdkPkt_SYSHEARTBEAT,   // data points to cbPKT_SYSHEARTBEAT
+    cbSdkPkt_SCALED,         // data points to cbSdkScaledGroup
     cbSdkPkt_COUNT // Allways the last value
 } cbSdkPktType;
 
@@ -202,6 +257,7 @@ typedef enum _cbSdkCallbackType
     CBSDKCALLBACK_CCF = cbSdkPkt_CCF,               // Monitor CCF events
     CBSDKCALLBACK_IMPEDENCE = cbSdkPkt_IMPEDANCE,   // Monitor impedence events
     CBSDKCALLBACK_SYSHEARTBEAT = cbSdkPkt_SYSHEARTBEAT, // Monitor system heartbeats (100 times a second)
+    CBSDKCALLBACK_SCALED = cbSdkPkt_SCALED,         // Monitor continuous events scaled to physical units (not sent to CBSDKCALLBACK_ALL)
     CBSDKCALLBACK_COUNT  // Always the last value
 } cbSdkCallbackType;
 
@@ -211,6 +267,7 @@ typedef enum _cbSdkTrialType
     CBSDKTRIAL_EVENTS,
     CBSDKTRIAL_COMMETNS,
     CBSDKTRIAL_TRACKING,
+    CBSDKTRIAL_RAW,
 } cbSdkTrialType;
 
 typedef void (* cbSdkCallback)(UINT32 nInstance, const cbSdkPktType type, const void* pEventData, void* pCallbackData);
@@ -221,6 +278,8 @@ typedef void (* cbSdkCallback)(UINT32 nInstance, const cbSdkPktType type, const
 #define cbSdk_CONTINUOUS_DATA_SAMPLES 102400 // multiple of 4096
 /// The default number of events that will be stored per channel in the trial buffer
 #define cbSdk_EVENT_DATA_SAMPLES (2 * 8192) // multiple of 4096
+/// A suggested number of raw samples to store per channel in the trial buffer (about 10 seconds of raw data)
+#define cbSdk_RAW_DATA_SAMPLES (75 * 4096) // multiple of 4096
 
 // Maximum file size (in bytes) that is allowed to upload to NSP
 #define cbSdk_MAX_UPOLOAD_SIZE (1024 * 1024 * 1024)
@@ -240,6 +299,38 @@ typedef struct _cbSdkTrialEvent
     void * waveforms[cbNUM_ANALOG_CHANS + 2]; // Buffer to hold waveforms or digital values
 } cbSdkTrialEvent;
 
+// Latency from receiving a datagram to processing it
+typedef struct _cbSdkRecvLatency
+{
+    UINT32 count; // number of datagrams measured
+    UINT32 p50;   // median latency in microseconds
+    UINT32 p90;   // 90th percentile latency in microseconds
+    UINT32 p99;   // 99th percentile latency in microseconds
+    UINT32 p999;  // 99.9th percentile latency in microseconds
+    UINT32 max;   // maximum latency in microseconds
+} cbSdkRecvLatency;
+
+// Process reading the shared receive buffer
+typedef struct _cbSdkReaderStatus
+{
+    UINT32 pid;      // reader process id
+    UINT32 lag;      // number of packets received but not yet read by the reader
+    UINT32 overruns; // number of times the reader fell a whole buffer behind and lost data
+} cbSdkReaderStatus;
+
+// Configuration changes since a generation
+typedef struct _cbSdkConfigChanges
+{
+    UINT32 generation; // current configuration generation, pass it back to get the later changes
+    UINT32 sections;   // changed sections, bit (1 << n) is set if section cbCFGSECT_* n changed
+    UINT32 chanCount;  // number of channels that changed
+    UINT16 chans[cbMAXCHANS];   // channels that changed (1-based)
+    UINT32 groupCount; // number of sample groups that changed
+    UINT16 groups[cbMAXGROUPS]; // sample groups that changed (1-based)
+    UINT32 filtCount;  // number of filters that changed
+    UINT16 filts[cbMAXFILTS];   // filters that changed (1-based)
+} cbSdkConfigChanges;
+
 // connection information
 typedef struct _cbSdkConnection
 {
@@ -248,12 +339,36 @@ typedef struct _cbSdkConnection
         nInPort = cbNET_UDP_PORT_BCAST;
         nOutPort = cbNET_UDP_PORT_CNT;
         nRecBufSize = (4096 * 2048); // 8MB default needed for best performance
+        nRecBatchSize = 16;
+        nNetLoop = CBSDKNETLOOP_TIMER;
+        bRecvThread = false;
+        nNetPriority = CBSDKPRIORITY_HIGH;
+        nNetAffinity = 0;
+        nBusyPoll = 0;
+        nXmtRate = 400;
+        nXmtBurst = 4;
+        nXmtWindow = 6;
+        nRecRingLen = 0;
+        nShmFlags = 0;
+        nSpkCacheDepth = 0;
         szInIP = "";
         szOutIP = "";
     }
     int nInPort;  // Client port number
     int nOutPort; // Instrument port number
     int nRecBufSize; // Receive buffer size (0 to ignore altogether)
+    int nRecBatchSize; // Maximum number of datagrams to receive in one call (1 to receive one at a time, up to 64)
+    cbSdkNetLoopType nNetLoop; // Stand-alone network loop
+    bool bRecvThread; // Process packets in a thread separate from the one receiving them
+    cbSdkThreadPriority nNetPriority; // Network threads priority
+    UINT64 nNetAffinity; // Network threads CPU affinity mask (0 for any CPU)
+    int nBusyPoll; // Microseconds to busy poll the network device on receive (0 to disable, where supported)
+    int nXmtRate;  // Packets per second sent to the instrument
+    int nXmtBurst; // Maximum number of packets sent to the instrument back to back
+    int nXmtWindow; // Maximum number of packets waiting for a response from the instrument at once (up to 64, 1 to wait for each)
+    UINT32 nRecRingLen; // Receive buffer length in 32-bit words if stand-alone (0 for the default of 4M words)
+    UINT32 nShmFlags; // Shared memory options (combination of cbSdkSharedMemoryFlags)
+    UINT32 nSpkCacheDepth; // Spikes cached per channel if stand-alone (0 for the default of 400, up to 10000)
     LPCSTR szInIP;  // Client IPv4 address
     LPCSTR szOutIP; // Instrument IPv4 address
 } cbSdkConnection;
@@ -385,27 +500,59 @@ CBSDKAPI    cbSdkResult cbSdkOpen(UINT32 nInstance,
 
 CBSDKAPI    cbSdkResult cbSdkGetType(UINT32 nInstance, cbSdkConnectionType * conType, cbSdkInstrumentType * instType); // Get connection and instrument type
 
+CBSDKAPI    cbSdkResult cbSdkGetLostPackets(UINT32 nInstance, UINT32 * heartbeats, UINT32 * groups = NULL); // Get number of packets missing from periodic streams
+
+CBSDKAPI    cbSdkResult cbSdkGetRecvLatency(UINT32 nInstance, cbSdkRecvLatency * latency, bool bReset = false); // Get receive to process latency percentiles
+
+CBSDKAPI    cbSdkResult cbSdkGetReaderStatus(UINT32 nInstance, cbSdkReaderStatus * readers, UINT32 * count); // Get status of the processes reading the shared buffers
+
+CBSDKAPI    cbSdkResult cbSdkGetConfigChanges(UINT32 nInstance, UINT32 generation, cbSdkConfigChanges * changes); // Get what changed in the configuration since a generation (0 for all)
+// Only the stand-alone library keeps the counters, CBSDKRESULT_NOTIMPLEMENTED is returned otherwise
+
+CBSDKAPI    cbSdkResult cbSdkGetQueueDepth(UINT32 nInstance, UINT32 * recvDepth, UINT32 * procDepth, UINT32 * procOverruns = NULL); // Get network queue depths
+
 CBSDKAPI    cbSdkResult cbSdkClose(UINT32 nInstance); // Close the library
 
 CBSDKAPI    cbSdkResult cbSdkGetTime(UINT32 nInstance, UINT32 * cbtime); // Get the instrument sample clock time
 
+CBSDKAPI    cbSdkResult cbSdkGetRecvTime(UINT32 nInstance, INT64 * recvtime, INT64 * hosttime = NULL); // Get host time the packet in callback was received
+
 CBSDKAPI    cbSdkResult cbSdkGetSpkCache(UINT32 nInstance, UINT16 channel, cbSPKCACHE **cache); // Get direct access to internal spike cache shared memory
 // Note that spike cache is volatile, thus should not be used for critical operations such as recording
+//  a line may change while it is read, use cbSdkGetSpkCacheSince to get a consistent copy
+
+CBSDKAPI    cbSdkResult cbSdkGetSpkCacheSince(UINT32 nInstance, UINT16 channel, UINT32 * cursor, cbPKT_SPK * spikes, UINT32 * count); // Copy cached spikes newer than cursor
+// cursor is the number of spikes of the channel already seen (0 to start) and is advanced past the copied spikes,
+//  count is the room in spikes and is set to the number of spikes copied (oldest first).
+//  CBSDKRESULT_WARNDATALOST is returned if spikes after cursor were overwritten before they could be copied,
+//  CBSDKRESULT_BUSY if the cache line kept changing during the copy (try again)
 
 // Get trial setup configuration
 CBSDKAPI    cbSdkResult cbSdkGetTrialConfig(UINT32 nInstance,
                                          UINT32 * pbActive, UINT16 * pBegchan = NULL, UINT32 * pBegmask = NULL, UINT32 * pBegval = NULL,
                                          UINT16 * pEndchan = NULL, UINT32 * pEndmask = NULL, UINT32 * pEndval = NULL, bool * pbDouble = NULL,
                                          UINT32 * puWaveforms = NULL, UINT32 * puConts = NULL, UINT32 * puEvents = NULL,
-                                         UINT32 * puComments = NULL, UINT32 * puTrackings = NULL, bool * pbAbsolute = NULL);
+                                         UINT32 * puComments = NULL, UINT32 * puTrackings = NULL, bool * pbAbsolute = NULL,
+                                         UINT32 * puRaws = NULL, bool * pbScaled = NULL, bool * pbInterleaved = NULL);
 // Setup a trial
 CBSDKAPI    cbSdkResult cbSdkSetTrialConfig(UINT32 nInstance,
                                          UINT32 bActive, UINT16 begchan = 0, UINT32 begmask = 0, UINT32 begval = 0,
                                          UINT16 endchan = 0, UINT32 endmask = 0, UINT32 endval = 0, bool bDouble = false,
                                          UINT32 uWaveforms = 0, UINT32 uConts = cbSdk_CONTINUOUS_DATA_SAMPLES, UINT32 uEvents = cbSdk_EVENT_DATA_SAMPLES,
-                                         UINT32 uComments = 0, UINT32 uTrackings = 0, bool bAbsolute = false); // Configure a data collection trial
+                                         UINT32 uComments = 0, UINT32 uTrackings = 0, bool bAbsolute = false,
+                                         UINT32 uRaws = 0, bool bScaled = false, bool bInterleaved = false); // Configure a data collection trial
 // begchan - first channel number (1-based), zero means all
 // endchan - last channel number (1-based), zero means all
+// uRaws - number of raw (30 kHz) samples to buffer per channel, zero means no raw data is buffered
+//          raw data is kept apart from continuous data, see cbSdk_RAW_DATA_SAMPLES
+// bScaled - return continuous and raw data in the physical units of each channel (cbSCALING anaunit),
+//           needs bDouble (CBSDKRESULT_INVALIDPARAM otherwise), samples cached before the scaling
+//           of their channel changes are dropped
+// bInterleaved - cache continuous and raw data in rows of each sample group (one sample of each channel
+//                of the group a row, all at the group rate), rows are read whole: the channels of a group
+//                all return as many samples, the least asked for. Rows are as wide as the groups when the
+//                trial is configured, a group given more channels later is not cached until it is
+//                configured again (unset and set)
 
 // Close given trial if configured
 CBSDKAPI    cbSdkResult cbSdkUnsetTrialConfig(UINT32 nInstance, cbSdkTrialType type);
@@ -417,12 +564,15 @@ CBSDKAPI    cbSdkResult cbSdkSetChannelLabel(UINT32 nInstance, UINT16 channel, c
 // Retrieve data of a trial (NULL means ignore), user should allocate enough buffers beforehand, and trial should not be closed during this call
 CBSDKAPI    cbSdkResult cbSdkGetTrialData(UINT32 nInstance,
                                           UINT32 bActive, cbSdkTrialEvent * trialevent, cbSdkTrialCont * trialcont,
-                                          cbSdkTrialComment * trialcomment, cbSdkTrialTracking * trialtracking);
+                                          cbSdkTrialComment * trialcomment, cbSdkTrialTracking * trialtracking,
+                                          cbSdkTrialCont * trialraw = NULL);
 
 // Initialize the structures (and fill with information about active channels, comment pointers and samples in the buffer)
 CBSDKAPI    cbSdkResult cbSdkInitTrialData(UINT32 nInstance,
                                            cbSdkTrialEvent * trialevent, cbSdkTrialCont * trialcont,
-                                           cbSdkTrialComment * trialcomment, cbSdkTrialTracking * trialtracking);
+                                           cbSdkTrialComment * trialcomment, cbSdkTrialTracking * trialtracking,
+                                           cbSdkTrialCont * trialraw = NULL);
+// trialraw is filled like trialcont, but with the raw stream of the channels
 
 // Start/stop/open/close file recording
 CBSDKAPI    cbSdkResult cbSdkSetFileConfig(UINT32 nInstance, const char * filename, const char * comment, UINT32 bStart, UINT32 options = cbFILECFG_OPT_NONE);
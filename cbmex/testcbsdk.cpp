@@ -21,12 +21,65 @@
 #include <string>
 #include <vector>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef WIN32
+#include <time.h>
+#include <unistd.h>
+#endif
 #include "debugmacs.h"
 
 #include "cbsdk.h"
 
 #define INST 0
 
+// Purpose: Monotonic time in seconds, for the measurements
+static double testNow(void)
+{
+#ifdef WIN32
+    LARGE_INTEGER freq, count;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&count);
+    return (double)count.QuadPart / freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+// Purpose: Wait for the given number of milliseconds
+static void testSleep(UINT32 ms)
+{
+#ifdef WIN32
+    Sleep(ms);
+#else
+    usleep(ms * 1000);
+#endif
+}
+
+// Purpose: Number of CPUs online, to spread the network threads over
+static UINT32 testCpuCount(void)
+{
+#ifdef WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors;
+#else
+    const long nCpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return nCpus > 0 ? (UINT32)nCpus : 1;
+#endif
+}
+
+// Packets counted for each instance
+static volatile UINT32 g_nPackets[cbMAXOPEN];
+
+// Purpose: Count the packets of an instance
+static void testCountPackets(UINT32 nInstance, const cbSdkPktType /*type*/, const void* /*pEventData*/, void* /*pCallbackData*/)
+{
+    ++g_nPackets[nInstance];
+}
+
 // Author & Date:   Ehsan Azar    24 Oct 2012
 // Purpose: Test openning the library
 cbSdkResult testOpen(void)
@@ -99,6 +152,9 @@ cbSdkResult testOpen(void)
     case CBSDKRESULT_ERROFFLINE:
         printf("Instrument is offline\n");
         break;
+    case CBSDKRESULT_ERRCENTRALVERSION:
+        printf("Central is running with another library version\n");
+        break;
     default:
         printf("Unexpected error\n");
         break;
@@ -148,8 +204,163 @@ cbSdkResult testClose(void)
     return res;
 }
 
+// Purpose: Measure how fast the continuous trial cache is written by the network thread
+//           and how fast cbSdkGetTrialData copies it out
+//  Needs an instrument (or nPlay) sending sample groups
+// Inputs:
+//   nSeconds - how long to measure
+//   bDouble  - if the samples are read as double precision (converted while copied)
+cbSdkResult testTrial(UINT32 nSeconds, bool bDouble)
+{
+    cbSdkResult res = cbSdkSetTrialConfig(INST, 1, 0, 0, 0, 0, 0, 0, bDouble);
+    if (res != CBSDKRESULT_SUCCESS)
+    {
+        printf("Unable to configure the trial\n");
+        return res;
+    }
+    const size_t elemsize = bDouble ? sizeof(double) : sizeof(INT16);
+    std::vector<double> buffers[cbNUM_ANALOG_CHANS];
+    cbSdkTrialCont trialcont;
+    double samples = 0, readTime = 0;
+    const double start = testNow();
+    while (testNow() - start < nSeconds)
+    {
+        testSleep(100);
+        res = cbSdkInitTrialData(INST, NULL, &trialcont, NULL, NULL);
+        if (res != CBSDKRESULT_SUCCESS)
+            break;
+        for (UINT32 i = 0; i < trialcont.count; ++i)
+        {
+            // Room for either precision
+            buffers[i].resize(trialcont.num_samples[i] + 1);
+            trialcont.samples[i] = &buffers[i][0];
+        }
+        const double t0 = testNow();
+        res = cbSdkGetTrialData(INST, 1, NULL, &trialcont, NULL, NULL);
+        readTime += testNow() - t0;
+        if (res != CBSDKRESULT_SUCCESS)
+            break;
+        for (UINT32 i = 0; i < trialcont.count; ++i)
+            samples += trialcont.num_samples[i];
+    }
+    const double elapsed = testNow() - start;
+    if (res == CBSDKRESULT_SUCCESS)
+    {
+        printf("Trial cache (%s): %.0f samples/s written, %.1f MB/s read, %.2f%% of the time spent reading\n",
+            bDouble ? "double" : "int16", samples / elapsed,
+            readTime > 0 ? samples * elemsize / readTime / 1e6 : 0.0, 100.0 * readTime / elapsed);
+    } else {
+        printf("Unable to read the trial\n");
+    }
+    cbSdkSetTrialConfig(INST, 0);
+
+    return res;
+}
+
+// Purpose: Measure the aggregate packet throughput as instances are added
+//  Needs an instrument (or nPlay) for each instance, against a single instrument
+//  the broadcast stream is received by every instance
+// Inputs:
+//   nSeconds - how long to measure each number of instances
+//   nCount   - maximum number of instances open at once (the first is INST)
+cbSdkResult testInstances(UINT32 nSeconds, UINT32 nCount)
+{
+    if (nCount < 1 || INST + nCount > cbMAXOPEN)
+    {
+        printf("Between 1 and %d instances can be open\n", cbMAXOPEN - INST);
+        return CBSDKRESULT_INVALIDPARAM;
+    }
+    // Each added instance gets a CPU of its own where there are enough
+    const UINT32 nCpus = testCpuCount();
+    cbSdkResult res = cbSdkRegisterCallback(INST, CBSDKCALLBACK_ALL, testCountPackets, NULL);
+    UINT32 nOpen = 1;
+    while (res == CBSDKRESULT_SUCCESS)
+    {
+        for (UINT32 i = 0; i < nOpen; ++i)
+            g_nPackets[INST + i] = 0;
+        const double start = testNow();
+        testSleep(nSeconds * 1000);
+        const double elapsed = testNow() - start;
+        double total = 0;
+        for (UINT32 i = 0; i < nOpen; ++i)
+            total += g_nPackets[INST + i];
+        printf("%u instance(s): %.0f packets/s in total, %.0f packets/s per instance\n",
+            nOpen, total / elapsed, total / elapsed / nOpen);
+        if (nOpen == nCount)
+            break;
+        cbSdkConnection con;
+        if (nCpus > nCount)
+            con.nNetAffinity = (UINT64)1 << (nOpen % nCpus);
+        res = cbSdkOpen(INST + nOpen, CBSDKCONNECTION_UDP, con);
+        if (res != CBSDKRESULT_SUCCESS)
+        {
+            printf("Unable to open instance %u (%d)\n", INST + nOpen, res);
+            break;
+        }
+        ++nOpen;
+        res = cbSdkRegisterCallback(INST + nOpen - 1, CBSDKCALLBACK_ALL, testCountPackets, NULL);
+    }
+    for (UINT32 i = 0; i < nOpen; ++i)
+        cbSdkUnRegisterCallback(INST + i, CBSDKCALLBACK_ALL);
+    for (UINT32 i = 1; i < nOpen; ++i)
+        cbSdkClose(INST + i);
+
+    return res;
+}
+
+// Purpose: Report the receive to process latency percentiles of each stand-alone network loop side by side
+//  Needs an instrument (or nPlay), each loop is measured on an instance next to INST
+// Inputs:
+//   nSeconds - how long to measure each loop
+cbSdkResult testLatency(UINT32 nSeconds)
+{
+    const cbSdkNetLoopType loops[] = {CBSDKNETLOOP_TIMER, CBSDKNETLOOP_EVENT, CBSDKNETLOOP_SPIN};
+    const char * szLoops[] = {"timer", "event", "spin"};
+    const UINT32 nCpus = testCpuCount();
+    cbSdkResult res = CBSDKRESULT_SUCCESS;
+    printf("Loop    datagrams    p50    p90    p99  p99.9    max (us)\n");
+    for (UINT32 i = 0; i < sizeof(loops) / sizeof(loops[0]); ++i)
+    {
+        cbSdkConnection con;
+        con.nNetLoop = loops[i];
+        // Spinning takes a whole CPU, keep it off the others
+        if (loops[i] == CBSDKNETLOOP_SPIN && nCpus > 1)
+            con.nNetAffinity = (UINT64)1 << (nCpus - 1);
+        res = cbSdkOpen(INST + 1, CBSDKCONNECTION_UDP, con);
+        if (res != CBSDKRESULT_SUCCESS)
+        {
+            printf("Unable to open the %s loop (%d)\n", szLoops[i], res);
+            break;
+        }
+        cbSdkRecvLatency latency;
+        // Leave out the connection startup
+        testSleep(1000);
+        res = cbSdkGetRecvLatency(INST + 1, &latency, true);
+        if (res == CBSDKRESULT_SUCCESS)
+        {
+            testSleep(nSeconds * 1000);
+            res = cbSdkGetRecvLatency(INST + 1, &latency);
+        }
+        cbSdkClose(INST + 1);
+        if (res != CBSDKRESULT_SUCCESS)
+        {
+            printf("Unable to measure the %s loop (%d)\n", szLoops[i], res);
+            break;
+        }
+        printf("%-6s %10u %6u %6u %6u %6u %6u\n", szLoops[i],
+            latency.count, latency.p50, latency.p90, latency.p99, latency.p999, latency.max);
+    }
+
+    return res;
+}
+
 /////////////////////////////////////////////////////////////////////////////
 // The test suit main entry
+//  testcbsdk                       open and close the library
+//  testcbsdk trial [seconds]       measure the continuous trial cache, both as int16 and double
+//  testcbsdk instances [seconds] [count]
+//                                  measure the packet throughput of 1 to count (default 2) instances
+//  testcbsdk latency [seconds]     measure the receive latency of each stand-alone network loop
 int main(int argc, char *argv[])
 {
     cbSdkResult res = testOpen();
@@ -157,6 +368,22 @@ int main(int argc, char *argv[])
         printf("testOpen failed (%d)!\n", res);
     else
         printf("testOpen succeeded\n");
+    if (res >= 0 && argc > 1)
+    {
+        const UINT32 nSeconds = argc > 2 ? atoi(argv[2]) : 10;
+        if (strcmp(argv[1], "trial") == 0)
+        {
+            res = testTrial(nSeconds, false);
+            if (res >= 0)
+                res = testTrial(nSeconds, true);
+        } else if (strcmp(argv[1], "instances") == 0) {
+            res = testInstances(nSeconds, argc > 3 ? atoi(argv[3]) : 2);
+        } else if (strcmp(argv[1], "latency") == 0) {
+            res = testLatency(nSeconds);
+        } else {
+            printf("Unknown test %s\n", argv[1]);
+        }
+    }
     res = testClose();
     if (res < 0)
         printf("testClose failed (%d)!\n", res);
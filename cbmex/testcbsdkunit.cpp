@@ -0,0 +1,1005 @@
+///////////////////////////////////////////////////////////////////////
+//
+// Unit test SDK
+//
+// $Workfile: testcbsdkunit.cpp $
+// $Archive: /Cerebus/Human/LinuxApps/cbmex/testcbsdkunit.cpp $
+//
+// Purpose:
+//  This is the test suite to check the SDK internals that need no instrument
+//   each test returns true if it passed, and main returns non-zero if any failed
+//   "testcbsdkunit bench" runs the measurements instead
+//
+//  Note:
+//   Unlike testcbsdk this is linked to the static library and may use its internals,
+//    the library is opened stand-alone (without the network) for an instance of its own
+//   Do not throw exceptions, catch possible exceptions and handle them the earliest possible in this library
+//
+
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#ifndef WIN32
+#include <time.h>
+#endif
+
+#include "SdkApp.h"
+#include "SdkConvert.h"
+
+#define INST (cbMAXOPEN - 1) // Instance of the tests, apart from the ones usually open
+
+// Purpose: Monotonic time in seconds, for the measurements
+static double testNow(void)
+{
+#ifdef WIN32
+    LARGE_INTEGER freq, count;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&count);
+    return (double)count.QuadPart / freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+// Purpose: Repeatable pseudo-random numbers, so that a failure can be reproduced
+static UINT32 testRandom(void)
+{
+    static UINT32 state = 2463534242u;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+// Purpose: Random samples, starting with the extremes
+static void testFillSamples(std::vector<INT16> & samples)
+{
+    for (size_t i = 0; i < samples.size(); ++i)
+        samples[i] = (INT16)testRandom();
+    const INT16 extremes[] = {-32768, 32767, 0, -1, 1};
+    for (size_t i = 0; i < sizeof(extremes) / sizeof(extremes[0]) && i < samples.size(); ++i)
+        samples[i] = extremes[i];
+}
+
+// Purpose: Check that the vector conversion kernels give the scalar results
+//  for every length (so that each tail is covered) and for unaligned samples
+bool testConvert(void)
+{
+    printf("Checking the %s conversion kernels\n", CBSDK_CONVERT_PATH);
+    std::vector<INT16> src(30000 + 8);
+    testFillSamples(src);
+    std::vector<double> dst(src.size() + 1);
+    std::vector<float> dstf(src.size() + 1), gain(src.size()), offset(src.size());
+    for (size_t i = 0; i < src.size(); ++i)
+    {
+        gain[i] = (testRandom() % 2000) / 1000.0f - 1.0f;
+        offset[i] = (testRandom() % 2000) - 1000.0f;
+    }
+    const double gains[] = {1.0, 0.25, 8.5e-3, -1.5};
+    const double offsets[] = {0.0, -3.5, 1000.0, 0.125};
+    const UINT32 counts[] = {1001, 4096, 30000};
+    for (UINT32 k = 0; k < 40 + sizeof(counts) / sizeof(counts[0]); ++k)
+    {
+        const UINT32 count = k < 40 ? k : counts[k - 40];
+        for (UINT32 start = 0; start < 4; ++start)
+        {
+            for (UINT32 g = 0; g < sizeof(gains) / sizeof(gains[0]); ++g)
+            {
+                // Nothing past the end is written
+                dst[count] = 12345.0;
+                ConvertSamples(&dst[0], &src[start], count, gains[g], offsets[g]);
+                if (dst[count] != 12345.0)
+                {
+                    printf("ConvertSamples wrote past %u samples\n", count);
+                    return false;
+                }
+                for (UINT32 i = 0; i < count; ++i)
+                {
+                    const double expected = src[start + i] * gains[g] + offsets[g];
+                    if (fabs(dst[i] - expected) > 1e-12 * (fabs(expected) + 1))
+                    {
+                        printf("ConvertSamples(%u samples) gave %.17g instead of %.17g at %u\n", count, dst[i], expected, i);
+                        return false;
+                    }
+                }
+            }
+            dstf[count] = 12345.0f;
+            ScaleSamples(&dstf[0], &src[start], &gain[start], &offset[start], count);
+            if (dstf[count] != 12345.0f)
+            {
+                printf("ScaleSamples wrote past %u samples\n", count);
+                return false;
+            }
+            for (UINT32 i = 0; i < count; ++i)
+            {
+                const float expected = src[start + i] * gain[start + i] + offset[start + i];
+                if (fabs(dstf[i] - expected) > 1e-6 * (fabs(expected) + 1))
+                {
+                    printf("ScaleSamples(%u samples) gave %.9g instead of %.9g at %u\n", count, dstf[i], expected, i);
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// Purpose: Measure the conversion of a second of 30 kHz samples of 144 channels
+//           laid out as in the trial cache, against a plain loop and a copy
+void benchConvert(void)
+{
+    const UINT32 nChans = 144, nSamples = 30000, nRepeat = 20;
+    // Channel rows padded to a cache line, as in the trial cache
+    const UINT32 chan_step = (nSamples + 31) & ~31;
+    std::vector<INT16> src((size_t)chan_step * nChans);
+    testFillSamples(src);
+    std::vector<INT16> dst16(nSamples);
+    std::vector<double> dst(nSamples);
+    std::vector<float> dstf(nChans), gain(nChans, 0.25f), offset(nChans, -3.5f);
+    const double total = (double)nChans * nSamples * nRepeat;
+    double check = 0;
+
+    printf("Converting %u channels x %u samples (%s)\n", nChans, nSamples, CBSDK_CONVERT_PATH);
+    double t0 = testNow();
+    for (UINT32 r = 0; r < nRepeat; ++r)
+    {
+        for (UINT32 ch = 0; ch < nChans; ++ch)
+        {
+            memcpy(&dst16[0], &src[(size_t)ch * chan_step], nSamples * sizeof(INT16));
+            check += dst16[r];
+        }
+    }
+    double t = testNow() - t0;
+    printf("  int16 copy:             %8.1f Msamples/s %8.1f MB/s written\n", total / t / 1e6, total * sizeof(INT16) / t / 1e6);
+
+    t0 = testNow();
+    for (UINT32 r = 0; r < nRepeat; ++r)
+    {
+        for (UINT32 ch = 0; ch < nChans; ++ch)
+        {
+            const INT16 * in = &src[(size_t)ch * chan_step];
+            for (UINT32 i = 0; i < nSamples; ++i)
+                dst[i] = in[i] * 0.25 - 3.5;
+            check += dst[r];
+        }
+    }
+    t = testNow() - t0;
+    printf("  double loop:            %8.1f Msamples/s %8.1f MB/s written\n", total / t / 1e6, total * sizeof(double) / t / 1e6);
+
+    t0 = testNow();
+    for (UINT32 r = 0; r < nRepeat; ++r)
+    {
+        for (UINT32 ch = 0; ch < nChans; ++ch)
+        {
+            ConvertSamples(&dst[0], &src[(size_t)ch * chan_step], nSamples, 0.25, -3.5);
+            check += dst[r];
+        }
+    }
+    t = testNow() - t0;
+    printf("  ConvertSamples:         %8.1f Msamples/s %8.1f MB/s written\n", total / t / 1e6, total * sizeof(double) / t / 1e6);
+
+    // One sample group packet of every channel at a time, as for the scaled callback
+    t0 = testNow();
+    for (UINT32 r = 0; r < nRepeat; ++r)
+    {
+        for (UINT32 i = 0; i < nSamples; ++i)
+        {
+            ScaleSamples(&dstf[0], &src[(size_t)i * nChans % (src.size() - nChans)], &gain[0], &offset[0], nChans);
+            check += dstf[r];
+        }
+    }
+    t = testNow() - t0;
+    printf("  ScaleSamples (packets): %8.1f Msamples/s %8.1f MB/s written\n", total / t / 1e6, total * sizeof(float) / t / 1e6);
+    // Keep the results alive
+    printf("  (check %g)\n", check);
+}
+
+// Purpose: SDK application without the network, the tests feed it the packets
+//           the instrument would send (the library must be open stand-alone for INST)
+class TestSdkApp : public SdkApp
+{
+public:
+    TestSdkApp()
+    {
+        m_nInstance = INST;
+        m_nIdx = cb_library_index[INST];
+        m_instInfo = cbINSTINFO_READY;
+        m_bStandAlone = true;
+    }
+    // Receive a packet the way the network does, before it reaches the application
+    void Receive(const cbPKT_GENERIC * const pPkt) {InstNetwork::ProcessIncomingPacket(pPkt);}
+    // Receive a datagram at the head of the receive buffer, as from the loopback
+    void ReceiveDatagram(const void * pData, UINT32 nBytes)
+    {
+        memcpy(&cb_rec_buffer_ptr[m_nIdx]->buffer[cb_rec_buffer_ptr[m_nIdx]->headindex], pData, nBytes);
+        ProcessDatagram(nBytes, true, 0);
+    }
+};
+
+// Purpose: Configure a sample group of the first processor, as the instrument would
+// Inputs:
+//   group  - the sample group
+//   period - the sampling period, in 30 kHz ticks
+//   length - number of channels in the group
+//   list   - the channels (1-based)
+static void testSetGroup(UINT32 group, UINT32 period, UINT32 length, const UINT32 * list)
+{
+    cbPKT_GROUPINFO & info = cb_cfg_buffer_ptr[cb_library_index[INST]]->groupinfo[0][group - 1];
+    memset(&info, 0, sizeof(info));
+    info.chid = cbPKTCHAN_CONFIGURATION;
+    info.type = cbPKTTYPE_GROUPREP;
+    info.proc = 1;
+    info.group = group;
+    info.period = period;
+    info.length = length;
+    memcpy(info.list, list, length * sizeof(UINT32));
+}
+
+// Purpose: Configure the scaling of an analog input, and report it to the application as the instrument would
+// Inputs:
+//   app     - the application
+//   chan    - the channel (1-based)
+//   anamax  - the analog value of the largest sample, the range is symmetric
+//   anagain - the gain the analog range includes
+static void testSetScaling(SdkApp & app, UINT32 chan, INT32 anamax, INT32 anagain)
+{
+    cbPKT_CHANINFO & info = cb_cfg_buffer_ptr[cb_library_index[INST]]->chaninfo[chan - 1];
+    memset(&info, 0, sizeof(info));
+    info.chid = cbPKTCHAN_CONFIGURATION;
+    info.type = cbPKTTYPE_CHANREP;
+    info.chan = chan;
+    info.chancaps = cbCHAN_AINP;
+    info.scalin.digmin = -32764;
+    info.scalin.digmax = 32764;
+    info.scalin.anamin = -anamax;
+    info.scalin.anamax = anamax;
+    info.scalin.anagain = anagain;
+    strcpy(info.scalin.anaunit, "uV");
+    app.ProcessIncomingPacket((const cbPKT_GENERIC *)&info);
+}
+
+// Purpose: Send a sample group packet to the application
+// Inputs:
+//   app     - the application
+//   group   - the sample group
+//   time    - the packet time
+//   samples - a sample of each channel of the group
+//   count   - number of samples
+static void testSendGroup(SdkApp & app, UINT32 group, UINT32 time, const INT16 * samples, UINT32 count)
+{
+    cbPKT_GROUP pkt;
+    memset(&pkt, 0, sizeof(pkt));
+    pkt.time = time;
+    pkt.type = (UINT8)group;
+    pkt.dlen = (UINT8)((count + 1) / 2);
+    memcpy(pkt.data, samples, count * sizeof(INT16));
+    app.ProcessIncomingPacket((const cbPKT_GENERIC *)&pkt);
+}
+
+// Purpose: Read (and free) the continuous trial samples of all channels, as double precision
+// Inputs:
+//   app - the application
+// Outputs:
+//   data - the samples of each channel (0-based)
+//   Returns false if the samples could not be read
+static bool testReadTrial(SdkApp & app, std::vector<double> data[cbNUM_ANALOG_CHANS])
+{
+    for (UINT32 ch = 0; ch < cbNUM_ANALOG_CHANS; ++ch)
+        data[ch].clear();
+    cbSdkTrialCont trialcont;
+    if (app.SdkInitTrialData(NULL, &trialcont, NULL, NULL, NULL) != CBSDKRESULT_SUCCESS)
+        return false;
+    for (UINT32 i = 0; i < trialcont.count; ++i)
+    {
+        std::vector<double> & rData = data[trialcont.chan[i] - 1];
+        rData.resize(trialcont.num_samples[i] + 1);
+        trialcont.samples[i] = &rData[0];
+    }
+    if (app.SdkGetTrialData(1, NULL, &trialcont, NULL, NULL, NULL) != CBSDKRESULT_SUCCESS)
+        return false;
+    for (UINT32 i = 0; i < trialcont.count; ++i)
+        data[trialcont.chan[i] - 1].resize(trialcont.num_samples[i]);
+    return true;
+}
+
+// Purpose: Check the samples read of a channel
+// Inputs:
+//   szName - what is checked
+//   data   - the samples read
+//   count  - number of samples expected
+//   first  - the expected first sample
+//   step   - the expected difference from a sample to the next
+// Outputs:
+//   Returns true if the samples are as expected
+static bool testCheckSamples(const char * szName, const std::vector<double> & data, UINT32 count, double first, double step)
+{
+    if (data.size() != count)
+    {
+        printf("%s: %u samples instead of %u\n", szName, (UINT32)data.size(), count);
+        return false;
+    }
+    for (UINT32 i = 0; i < count; ++i)
+    {
+        const double expected = first + i * step;
+        if (fabs(data[i] - expected) > 1e-9)
+        {
+            printf("%s: sample %u is %g instead of %g\n", szName, i, data[i], expected);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Purpose: Check that trial samples are returned in physical units, and never in a scaling
+//           they were not sampled in
+bool testScaling(void)
+{
+    // Physical units are only returned as double
+    if (cbSdkSetTrialConfig(INST, 1, 0, 0, 0, 0, 0, 0, false, 0, 64, 0, 0, 0, false, 0, true) != CBSDKRESULT_INVALIDPARAM)
+    {
+        printf("Scaled samples accepted without double precision\n");
+        return false;
+    }
+    const UINT32 list[] = {1, 2};
+    testSetGroup(2, 30, 2, list);
+    TestSdkApp app;
+    app.SdkSetChannelMask(0, TRUE);
+    // Both are 0.25 uV a count, the analog range of channel 2 includes a gain of 2
+    testSetScaling(app, 1, 8191, 1);
+    testSetScaling(app, 2, 16382, 2);
+    if (app.SdkSetTrialConfig(1, 0, 0, 0, 0, 0, 0, true, 0, 64, 0, 0, 0, false, 0, true, false) != CBSDKRESULT_SUCCESS)
+    {
+        printf("Unable to configure the trial\n");
+        return false;
+    }
+    bool bPassed = true;
+    std::vector<double> data[cbNUM_ANALOG_CHANS];
+    INT16 samples[2];
+    for (INT16 i = 0; i < 10; ++i)
+    {
+        samples[0] = i * 4;
+        samples[1] = -i * 4;
+        testSendGroup(app, 2, i, samples, 2);
+    }
+    // Channel 1 changes to 0.5 uV a count, the samples it has cached are in the older scaling
+    testSetScaling(app, 1, 16382, 1);
+    for (INT16 i = 10; i < 15; ++i)
+    {
+        samples[0] = i * 4;
+        samples[1] = -i * 4;
+        testSendGroup(app, 2, i, samples, 2);
+    }
+    if (!testReadTrial(app, data))
+    {
+        printf("Unable to read the trial\n");
+        bPassed = false;
+    } else {
+        bPassed &= testCheckSamples("Rescaled channel", data[0], 5, 20.0, 2.0);
+        bPassed &= testCheckSamples("Channel with gain", data[1], 15, 0.0, -1.0);
+    }
+    // Nothing is dropped once the older samples are gone
+    samples[0] = 60;
+    samples[1] = -60;
+    testSendGroup(app, 2, 15, samples, 2);
+    if (!testReadTrial(app, data))
+    {
+        printf("Unable to read the trial\n");
+        bPassed = false;
+    } else {
+        bPassed &= testCheckSamples("Rescaled channel", data[0], 1, 30.0, 0.0);
+        bPassed &= testCheckSamples("Channel with gain", data[1], 1, -15.0, 0.0);
+    }
+    app.SdkUnsetTrialConfig(CBSDKTRIAL_CONTINUOUS);
+    return bPassed;
+}
+
+// Purpose: Send sample group packets of two channels, the first channel counts up from a value
+//           and the second one counts down from its negative
+// Inputs:
+//   app   - the application
+//   first - the value of the first packet
+//   count - number of packets
+static void testSendCounting(SdkApp & app, INT16 first, INT16 count)
+{
+    INT16 samples[2];
+    for (INT16 i = first; i < first + count; ++i)
+    {
+        samples[0] = i;
+        samples[1] = -i;
+        testSendGroup(app, 2, i, samples, 2);
+    }
+}
+
+// Purpose: Check that continuous trial samples are copied out in order across the end of the ring,
+//           and that a full ring keeps its samples until they are read
+// Inputs:
+//   bInterleaved - if the samples are cached in rows of each sample group
+bool testTrialWrap(bool bInterleaved)
+{
+    const UINT32 list[] = {1, 2};
+    testSetGroup(2, 30, 2, list);
+    TestSdkApp app;
+    app.SdkSetChannelMask(0, TRUE);
+    // 16 samples each, all of them can be waiting to be read
+    if (app.SdkSetTrialConfig(1, 0, 0, 0, 0, 0, 0, true, 0, 16, 0, 0, 0, false, 0, false, bInterleaved) != CBSDKRESULT_SUCCESS)
+    {
+        printf("Unable to configure the trial\n");
+        return false;
+    }
+    // Reads of 10 samples, 12 that wrap around, 16 of 20 sent (ring full) and 3 more after that
+    const INT16 sent[] = {10, 12, 20, 3};
+    const UINT32 kept[] = {10, 12, 16, 3};
+    bool bPassed = true;
+    std::vector<double> data[cbNUM_ANALOG_CHANS];
+    INT16 first = 0;
+    for (UINT32 i = 0; i < sizeof(sent) / sizeof(sent[0]) && bPassed; ++i)
+    {
+        testSendCounting(app, first, sent[i]);
+        if (!testReadTrial(app, data))
+        {
+            printf("Unable to read the trial\n");
+            bPassed = false;
+            break;
+        }
+        bPassed &= testCheckSamples("First channel", data[0], kept[i], first, 1.0);
+        bPassed &= testCheckSamples("Second channel", data[1], kept[i], -first, -1.0);
+        first += sent[i];
+    }
+    app.SdkUnsetTrialConfig(CBSDKTRIAL_CONTINUOUS);
+    return bPassed;
+}
+
+// Purpose: Measure writing a second of 30 kHz samples of 128 channels to the trial cache, and
+//           reading them out, with the samples of each channel apart and with them interleaved in rows
+void benchTrialLayout(void)
+{
+    const UINT32 nChans = 128, nSamples = 30000, nRepeat = 5, group = 5;
+    UINT32 list[nChans];
+    for (UINT32 ch = 0; ch < nChans; ++ch)
+        list[ch] = ch + 1;
+    testSetGroup(group, 1, nChans, list);
+    std::vector<INT16> src((size_t)nSamples * nChans);
+    testFillSamples(src);
+    std::vector<INT16> dst16((size_t)nSamples * nChans);
+    std::vector<double> dst((size_t)nSamples * nChans);
+    const double total = (double)nChans * nSamples * nRepeat;
+    double check = 0;
+
+    printf("Trial cache of %u channels x %u samples\n", nChans, nSamples);
+    for (int layout = 0; layout < 2; ++layout)
+    {
+        const bool bInterleaved = (layout == 1);
+        for (int type = 0; type < 2; ++type)
+        {
+            const bool bDouble = (type == 1);
+            TestSdkApp app;
+            app.SdkSetChannelMask(0, TRUE);
+            if (app.SdkSetTrialConfig(1, 0, 0, 0, 0, 0, 0, bDouble, 0, nSamples, 0, 0, 0, false, 0, false, bInterleaved) != CBSDKRESULT_SUCCESS)
+            {
+                printf("Unable to configure the trial\n");
+                return;
+            }
+            double tWrite = 0, tRead = 0;
+            UINT32 nRead = 0;
+            for (UINT32 r = 0; r < nRepeat; ++r)
+            {
+                double t0 = testNow();
+                for (UINT32 i = 0; i < nSamples; ++i)
+                    testSendGroup(app, group, i, &src[(size_t)i * nChans], nChans);
+                tWrite += testNow() - t0;
+
+                cbSdkTrialCont trialcont;
+                t0 = testNow();
+                app.SdkInitTrialData(NULL, &trialcont, NULL, NULL, NULL);
+                for (UINT32 i = 0; i < trialcont.count; ++i)
+                {
+                    if (bDouble)
+                        trialcont.samples[i] = &dst[(size_t)i * nSamples];
+                    else
+                        trialcont.samples[i] = &dst16[(size_t)i * nSamples];
+                }
+                app.SdkGetTrialData(1, NULL, &trialcont, NULL, NULL, NULL);
+                tRead += testNow() - t0;
+                for (UINT32 i = 0; i < trialcont.count; ++i)
+                    nRead += trialcont.num_samples[i];
+                check += bDouble ? dst[r] : dst16[r];
+            }
+            app.SdkUnsetTrialConfig(CBSDKTRIAL_CONTINUOUS);
+            const size_t elemsize = bDouble ? sizeof(double) : sizeof(INT16);
+            printf("  %-11s %-6s: write %8.1f Msamples/s, read %8.1f MB/s%s\n",
+                bInterleaved ? "interleaved" : "by channel", bDouble ? "double" : "int16",
+                total / tWrite / 1e6, total * elemsize / tRead / 1e6,
+                nRead == total ? "" : " (samples missing)");
+        }
+    }
+    // Keep the results alive
+    printf("  (check %g)\n", check);
+}
+
+// Purpose: Receive spikes of a channel, the time of each is its sequence number
+// Inputs:
+//   app   - the application
+//   chan  - the channel (1-based)
+//   first - the time of the first spike
+//   count - number of spikes
+static void testSendSpikes(TestSdkApp & app, UINT16 chan, UINT32 first, UINT32 count)
+{
+    cbPKT_SPK pkt;
+    memset(&pkt, 0, sizeof(pkt));
+    pkt.chid = chan;
+    pkt.dlen = cbPKTDLEN_SPK;
+    for (UINT32 i = 0; i < count; ++i)
+    {
+        pkt.time = first + i;
+        pkt.nPeak = (INT16)pkt.time;
+        app.Receive((const cbPKT_GENERIC *)&pkt);
+    }
+}
+
+// Purpose: Check the spikes of a channel copied since a cursor
+// Inputs:
+//   szName   - what is checked
+//   app      - the application
+//   chan     - the channel (1-based)
+//   cursor   - number of spikes already seen
+//   expected - the expected result
+//   count    - number of spikes expected
+//   first    - the expected time of the first spike
+// Outputs:
+//   cursor   - number of spikes seen after the copy
+//   Returns true if the spikes are as expected
+static bool testCheckSpikes(const char * szName, SdkApp & app, UINT16 chan, UINT32 & cursor,
+                            cbSdkResult expected, UINT32 count, UINT32 first)
+{
+    // Room for more than expected
+    std::vector<cbPKT_SPK> spikes(count + 10);
+    UINT32 nCopied = (UINT32)spikes.size();
+    cbSdkResult res = app.SdkGetSpkCacheSince(chan, &cursor, &spikes[0], &nCopied);
+    if (res != expected || nCopied != count)
+    {
+        printf("%s: %u spikes (%d) instead of %u (%d)\n", szName, nCopied, res, count, expected);
+        return false;
+    }
+    for (UINT32 i = 0; i < count; ++i)
+    {
+        if (spikes[i].chid != chan || spikes[i].time != first + i || spikes[i].nPeak != (INT16)(first + i))
+        {
+            printf("%s: spike %u is of channel %u at %u instead of %u\n", szName, i, spikes[i].chid, spikes[i].time, first + i);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Purpose: Check that the spike cache is read from a cursor, oldest first, that spikes written over
+//           are reported, and that a cache line is not read while it changes
+bool testSpkCache(void)
+{
+    TestSdkApp app;
+    const UINT16 chan = 3;
+    cbSPKCACHE * pCache;
+    cbGetSpkCache(chan, &pCache, INST);
+    const UINT32 depth = pCache->pktcnt;
+    UINT32 cursor = 0;
+    bool bPassed = true;
+    testSendSpikes(app, chan, 0, 5);
+    bPassed &= testCheckSpikes("First spikes", app, chan, cursor, CBSDKRESULT_SUCCESS, 5, 0);
+    bPassed &= testCheckSpikes("No new spikes", app, chan, cursor, CBSDKRESULT_SUCCESS, 0, 0);
+    testSendSpikes(app, chan, 5, 3);
+    bPassed &= testCheckSpikes("Spikes since cursor", app, chan, cursor, CBSDKRESULT_SUCCESS, 3, 5);
+    // The cache wraps around and writes over 10 spikes not read yet
+    testSendSpikes(app, chan, 8, depth + 10);
+    bPassed &= testCheckSpikes("Spikes written over", app, chan, cursor, CBSDKRESULT_WARNDATALOST, depth, 18);
+    // The line is in the middle of a change (sequence is odd)
+    testSendSpikes(app, chan, depth + 18, 2);
+    pCache->seq++;
+    bPassed &= testCheckSpikes("Line changing", app, chan, cursor, CBSDKRESULT_BUSY, 0, 0);
+    pCache->seq++;
+    bPassed &= testCheckSpikes("Line changed", app, chan, cursor, CBSDKRESULT_SUCCESS, 2, depth + 18);
+    // Configuring the channel empties its cache, the cursor starts over
+    cbPKT_CHANINFO info = cb_cfg_buffer_ptr[cb_library_index[INST]]->chaninfo[chan - 1];
+    info.chid = cbPKTCHAN_CONFIGURATION;
+    info.type = cbPKTTYPE_CHANREP;
+    info.chan = chan;
+    app.Receive((const cbPKT_GENERIC *)&info);
+    testSendSpikes(app, chan, 1000, 2);
+    bPassed &= testCheckSpikes("Channel configured", app, chan, cursor, CBSDKRESULT_SUCCESS, 2, 1000);
+    return bPassed;
+}
+
+// Purpose: Make sure the shared queue is read after the sequence number that publishes it,
+//           and freed after it is read
+static inline void testFence()
+{
+#ifdef WIN32
+    MemoryBarrier();
+#else
+    __sync_synchronize();
+#endif
+}
+
+// Purpose: Take the packets queued for transmission in order, as the network thread does
+// Inputs:
+//   nMax  - most packets to take
+// Outputs:
+//   marks - the first data word of each packet taken is added
+//   Returns the number of packets taken
+static UINT32 testTakeXmt(UINT32 nMax, std::vector<UINT32> & marks)
+{
+    cbXMTQUEUE * pXmt = cb_xmt_global_buffer_ptr[cb_library_index[INST]];
+    const UINT32 nSlotMask = pXmt->slotcount - 1;
+    UINT32 nTaken = 0;
+    for (; nTaken < nMax; ++nTaken)
+    {
+        const UINT32 nPos = pXmt->tailindex;
+        cbXMTSLOT * pSlot = &pXmt->slot[nPos & nSlotMask];
+        if (*(volatile UINT32 *)&pSlot->seq != nPos + 1)
+            break;
+        testFence();
+        marks.push_back(((const cbPKT_GENERIC *)pSlot->packet)->data[0]);
+        pSlot->seq = nPos + pXmt->slotcount;
+        testFence();
+        *(volatile UINT32 *)&pXmt->tailindex = nPos + 1;
+    }
+    return nTaken;
+}
+
+// Purpose: Make a packet to queue, marked by its first data word
+static void testXmtPacket(cbPKT_GENERIC & pkt, UINT32 mark)
+{
+    memset(&pkt, 0, sizeof(pkt));
+    pkt.chid = cbPKTCHAN_CONFIGURATION;
+    pkt.type = cbPKTTYPE_CHANSET;
+    pkt.dlen = 2;
+    pkt.data[0] = mark;
+}
+
+// Purpose: One of several processes (here threads) sending packets at once
+class TestXmtWriter : public QThread
+{
+public:
+    TestXmtWriter(UINT32 nWriter, UINT32 nCount) : m_nWriter(nWriter), m_nCount(nCount), m_nFailed(0) {}
+    UINT32 failed() const {return m_nFailed;}
+protected:
+    void run()
+    {
+        // Batches of one to four packets, each packet marked by writer and order
+        cbPKT_GENERIC pkts[4];
+        void * ppPkts[4] = {&pkts[0], &pkts[1], &pkts[2], &pkts[3]};
+        for (UINT32 i = 0; i < m_nCount; )
+        {
+            UINT32 nBatch = 1 + i % 4;
+            if (nBatch > m_nCount - i)
+                nBatch = m_nCount - i;
+            for (UINT32 j = 0; j < nBatch; ++j)
+                testXmtPacket(pkts[j], (m_nWriter << 24) | (i + j));
+            cbRESULT res = cbSendPackets(ppPkts, nBatch, INST);
+            if (res == cbRESULT_MEMORYUNAVAIL)
+                res = cbWaitforXmtSpace(nBatch, 1000, INST);
+            else if (res == cbRESULT_OK)
+                i += nBatch;
+            if (res != cbRESULT_OK)
+            {
+                ++m_nFailed;
+                return;
+            }
+        }
+    }
+private:
+    UINT32 m_nWriter;
+    UINT32 m_nCount;
+    UINT32 m_nFailed;
+};
+
+// Purpose: Check the transmit slot queue: batches go in whole or not at all, packets come out
+//           in order across the end of the slots, and writers sending at once lose nothing
+bool testXmtQueue(void)
+{
+    cbXMTQUEUE * pXmt = cb_xmt_global_buffer_ptr[cb_library_index[INST]];
+    const UINT32 nSlots = pXmt->slotcount;
+    std::vector<UINT32> marks;
+    bool bPassed = true;
+    // Start with the queue empty
+    testTakeXmt(nSlots, marks);
+    marks.clear();
+
+    cbPKT_GENERIC pkts[3];
+    void * ppPkts[3] = {&pkts[0], &pkts[1], &pkts[2]};
+    // Fill the queue one packet at a time, starting half way so the slots wrap around
+    UINT32 nMark = 0;
+    for (UINT32 i = 0; i < nSlots / 2; ++i)
+    {
+        testXmtPacket(pkts[0], nMark++);
+        cbSendPackets(ppPkts, 1, INST);
+    }
+    testTakeXmt(nSlots, marks);
+    marks.clear();
+    UINT32 nFirst = nMark;
+    for (UINT32 i = 0; i < nSlots; ++i)
+    {
+        testXmtPacket(pkts[0], nMark++);
+        if (cbSendPackets(ppPkts, 1, INST) != cbRESULT_OK)
+        {
+            printf("Queue full after %u of %u packets\n", i, nSlots);
+            bPassed = false;
+            break;
+        }
+    }
+    // A full queue takes nothing more, nor does it have room to wait for
+    testXmtPacket(pkts[0], 0xFFFFFF);
+    if (cbSendPackets(ppPkts, 1, INST) != cbRESULT_MEMORYUNAVAIL || cbWaitforXmtSpace(1, 0, INST) != cbRESULT_MEMORYUNAVAIL)
+    {
+        printf("Full queue reports room\n");
+        bPassed = false;
+    }
+    // Two slots freed leave no room for a batch of three, and the batch takes none of them
+    testTakeXmt(2, marks);
+    for (UINT32 j = 0; j < 3; ++j)
+        testXmtPacket(pkts[j], 0xFFFFFF);
+    if (cbSendPackets(ppPkts, 3, INST) != cbRESULT_MEMORYUNAVAIL || pXmt->headindex - pXmt->tailindex != nSlots - 2)
+    {
+        printf("Batch partly queued without room for all of it\n");
+        bPassed = false;
+    }
+    for (UINT32 j = 0; j < 2; ++j)
+        testXmtPacket(pkts[j], nMark++);
+    if (cbSendPackets(ppPkts, 2, INST) != cbRESULT_OK)
+    {
+        printf("Batch not queued with room for it\n");
+        bPassed = false;
+    }
+    // Packets larger than a slot are refused
+    testXmtPacket(pkts[0], 0xFFFFFF);
+    pkts[0].dlen = 0xFF;
+    if (cbSendPackets(ppPkts, 1, INST) != cbRESULT_INVALIDFUNCTION)
+    {
+        printf("Packet larger than a slot accepted\n");
+        bPassed = false;
+    }
+    testTakeXmt(nSlots, marks);
+    if (marks.size() != nMark - nFirst)
+    {
+        printf("%u packets sent instead of %u\n", (UINT32)marks.size(), nMark - nFirst);
+        bPassed = false;
+    }
+    for (UINT32 i = 0; i < marks.size() && bPassed; ++i)
+    {
+        if (marks[i] != nFirst + i)
+        {
+            printf("Packet %u is %u instead of %u\n", i, marks[i], nFirst + i);
+            bPassed = false;
+        }
+    }
+
+    // Writers at once, while the queue is emptied as it fills
+    const UINT32 nWriters = 4, nCount = 20000;
+    TestXmtWriter * writers[nWriters];
+    for (UINT32 w = 0; w < nWriters; ++w)
+    {
+        writers[w] = new TestXmtWriter(w, nCount);
+        writers[w]->start();
+    }
+    marks.clear();
+    const double start = testNow();
+    while (marks.size() < nWriters * nCount && testNow() - start < 10.0)
+    {
+        if (testTakeXmt(nSlots, marks) == 0)
+            QThread::yieldCurrentThread();
+    }
+    for (UINT32 w = 0; w < nWriters; ++w)
+    {
+        writers[w]->wait();
+        if (writers[w]->failed())
+        {
+            printf("Writer %u could not queue its packets\n", w);
+            bPassed = false;
+        }
+        delete writers[w];
+    }
+    testTakeXmt(nSlots, marks);
+    // Each writer's packets come out once each and in its order
+    UINT32 next[nWriters] = {0};
+    for (UINT32 i = 0; i < marks.size(); ++i)
+    {
+        const UINT32 w = marks[i] >> 24;
+        if (w >= nWriters || (marks[i] & 0xFFFFFF) != next[w])
+        {
+            printf("Packet %u (%08X) out of order\n", i, marks[i]);
+            bPassed = false;
+            break;
+        }
+        ++next[w];
+    }
+    if (marks.size() != nWriters * nCount)
+    {
+        printf("%u packets sent by the writers instead of %u\n", (UINT32)marks.size(), nWriters * nCount);
+        bPassed = false;
+    }
+    return bPassed;
+}
+
+// Purpose: Receive datagrams of packets of different lengths, each packet marked by its sequence number
+//           (packets of a channel nothing processes)
+// Inputs:
+//   app   - the application
+//   mark  - the sequence number of the first packet
+//   count - number of datagrams
+// Outputs:
+//   mark  - the sequence number of the packet after the last one
+static void testSendDatagrams(TestSdkApp & app, UINT32 & mark, UINT32 count)
+{
+    UINT32 datagram[cbCER_UDP_SIZE_MAX / 4];
+    for (UINT32 i = 0; i < count; ++i)
+    {
+        UINT32 nQuadlets = 0;
+        for (;;)
+        {
+            const UINT32 dlen = 1 + mark % 48;
+            if ((nQuadlets + cbPKT_HEADER_32SIZE + dlen) * 4 > cbCER_UDP_SIZE_MAX)
+                break;
+            cbPKT_GENERIC * pPkt = (cbPKT_GENERIC *)&datagram[nQuadlets];
+            pPkt->time = 0;
+            pPkt->chid = cbMAXCHANS + 1;
+            pPkt->type = 0;
+            pPkt->dlen = (UINT8)dlen;
+            for (UINT32 k = 0; k < dlen; ++k)
+                pPkt->data[k] = mark + k;
+            nQuadlets += cbPKT_HEADER_32SIZE + dlen;
+            ++mark;
+        }
+        app.ReceiveDatagram(datagram, nQuadlets * 4);
+    }
+}
+
+// Purpose: Check a packet read from the receive buffer
+// Inputs:
+//   pPkt - the packet
+//   mark - the expected sequence number
+// Outputs:
+//   Returns true if the packet is as sent
+static bool testCheckPacket(const cbPKT_GENERIC * pPkt, UINT32 mark)
+{
+    bool bPassed = (pPkt->chid == cbMAXCHANS + 1 && pPkt->dlen == 1 + mark % 48);
+    for (UINT32 k = 0; bPassed && k < pPkt->dlen; ++k)
+        bPassed = (pPkt->data[k] == mark + k);
+    if (!bPassed)
+        printf("Packet %u read as channel %u length %u (%u)\n", mark, pPkt->chid, pPkt->dlen, pPkt->data[0]);
+    return bPassed;
+}
+
+// Purpose: Check that packets are read back in order and whole across the end of the receive buffer,
+//           one at a time and as spans, and that a reader the buffer wraps past is told so
+bool testRecRing(void)
+{
+    TestSdkApp app;
+    cbRECBUFF * pRec = cb_rec_buffer_ptr[cb_library_index[INST]];
+    const UINT32 nFirstWrap = pRec->headwrap;
+    cbMakePacketReadingBeginNow(INST);
+    UINT32 mark = 0, next = 0;
+    bool bPassed = true;
+    cbLevelOfConcern loc;
+    // A third of the buffer at a time, until the buffer wrapped a few times
+    const UINT32 nDatagrams = pRec->bufferlen / 3 / (cbCER_UDP_SIZE_MAX / 4);
+    for (UINT32 nRound = 0; pRec->headwrap - nFirstWrap < 4 && bPassed; ++nRound)
+    {
+        testSendDatagrams(app, mark, nDatagrams);
+        if (cbCheckforData(loc, NULL, INST) != cbRESULT_OK)
+        {
+            printf("Data lost in round %u\n", nRound);
+            bPassed = false;
+            break;
+        }
+        if (nRound % 2)
+        {
+            // Half a span, then the rest of it in the next one
+            for (int nSpan = 0; nSpan < 2 && bPassed; ++nSpan)
+            {
+                cbPacketSpan span;
+                cbGetPacketSpan(&span, INST);
+                const UINT32 nRead = nSpan ? span.count() : span.count() / 2;
+                for (UINT32 i = 0; i < nRead && bPassed; ++i)
+                    bPassed = testCheckPacket(span.next(), next++);
+                cbCommitPacketSpan(&span, INST);
+            }
+        } else {
+            cbPKT_GENERIC * pPkt;
+            while (bPassed && (pPkt = cbGetNextPacketPtr(INST)) != NULL)
+                bPassed = testCheckPacket(pPkt, next++);
+        }
+        if (bPassed && next != mark)
+        {
+            printf("%u packets read instead of %u in round %u\n", next, mark, nRound);
+            bPassed = false;
+        }
+    }
+    // Twice the buffer written over the reader
+    testSendDatagrams(app, mark, nDatagrams * 6);
+    if (cbCheckforData(loc, NULL, INST) != cbRESULT_DATALOST)
+    {
+        printf("Reader overrun not reported\n");
+        bPassed = false;
+    }
+    // Reading starts over with what comes next
+    next = mark;
+    testSendDatagrams(app, mark, 10);
+    if (cbCheckforData(loc, NULL, INST) != cbRESULT_OK)
+    {
+        printf("Data lost after starting over\n");
+        bPassed = false;
+    }
+    cbPKT_GENERIC * pPkt;
+    while (bPassed && (pPkt = cbGetNextPacketPtr(INST)) != NULL)
+        bPassed = testCheckPacket(pPkt, next++);
+    if (bPassed && next != mark)
+    {
+        printf("%u packets read instead of %u after starting over\n", next, mark);
+        bPassed = false;
+    }
+    return bPassed;
+}
+
+// Purpose: Report a test result
+// Inputs:
+//   szName  - the test name
+//   bPassed - if the test passed
+// Outputs:
+//   Returns 1 if the test failed, 0 otherwise
+static int testReport(const char * szName, bool bPassed)
+{
+    if (bPassed)
+        printf("%s succeeded\n", szName);
+    else
+        printf("%s failed!\n", szName);
+    return bPassed ? 0 : 1;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// The unit test main entry
+//  testcbsdkunit           run the checks
+//  testcbsdkunit bench     run the measurements
+int main(int argc, char *argv[])
+{
+    if (argc > 1)
+    {
+        if (strcmp(argv[1], "bench") == 0)
+        {
+            benchConvert();
+            // The trial cache is fed as in the application tests
+            cbRESULT cbres = cbOpen(TRUE, INST, cbRECBUFFLEN_MIN);
+            if (cbres != cbRESULT_OK)
+            {
+                printf("Unable to open the library for instance %d (%d)\n", INST, cbres);
+                return 1;
+            }
+            benchTrialLayout();
+            cbClose(TRUE, INST);
+            return 0;
+        }
+        printf("Unknown option %s\n", argv[1]);
+        return 1;
+    }
+    int nFailed = 0;
+    nFailed += testReport("testConvert", testConvert());
+
+    // The application tests need the library buffers, as a stand-alone application has them
+    //  (the smallest receive buffer wraps around soonest)
+    cbRESULT cbres = cbOpen(TRUE, INST, cbRECBUFFLEN_MIN);
+    if (cbres != cbRESULT_OK)
+    {
+        printf("Unable to open the library for instance %d (%d)\n", INST, cbres);
+        return 1;
+    }
+    nFailed += testReport("testTrialWrap", testTrialWrap(false));
+    nFailed += testReport("testTrialWrap interleaved", testTrialWrap(true));
+    nFailed += testReport("testScaling", testScaling());
+    nFailed += testReport("testSpkCache", testSpkCache());
+    nFailed += testReport("testXmtQueue", testXmtQueue());
+    nFailed += testReport("testRecRing", testRecRing());
+    cbClose(TRUE, INST);
+
+    return nFailed ? 1 : 0;
+}
@@ -46,7 +46,8 @@ int cbpy_get_trial_config(int nInstance, cbSdkConfigParam * pcfg_param)
             &pcfg_param->bDouble, &pcfg_param->uWaveforms,
             &pcfg_param->uConts, &pcfg_param->uEvents, &pcfg_param->uComments,
             &pcfg_param->uTrackings,
-            &pcfg_param->bAbsolute);
+            &pcfg_param->bAbsolute,
+            &pcfg_param->uRaws, &pcfg_param->bScaled);
 
     return sdkres;
 }
@@ -59,7 +60,8 @@ int cbpy_set_trial_config(int nInstance, const cbSdkConfigParam * pcfg_param)
             pcfg_param->bDouble, pcfg_param->uWaveforms,
             pcfg_param->uConts, pcfg_param->uEvents, pcfg_param->uComments,
             pcfg_param->uTrackings,
-            pcfg_param->bAbsolute);
+            pcfg_param->bAbsolute,
+            pcfg_param->uRaws, pcfg_param->bScaled);
 
     return sdkres;
 }
@@ -94,6 +96,21 @@ int cbpy_get_trial_cont(int nInstance, int reset, cbSdkTrialCont * trialcont)
     return sdkres;
 }
 
+int cbpy_init_trial_raw(int nInstance, cbSdkTrialCont * trialraw)
+{
+    memset(trialraw, 0, sizeof(*trialraw));
+    cbSdkResult sdkres = cbSdkInitTrialData(nInstance, 0, 0, 0, 0, trialraw);
+
+    return sdkres;
+}
+
+int cbpy_get_trial_raw(int nInstance, int reset, cbSdkTrialCont * trialraw)
+{
+    cbSdkResult sdkres = cbSdkGetTrialData(nInstance, reset, 0, 0, 0, 0, trialraw);
+
+    return sdkres;
+}
+
 int cbpy_get_file_config(int instance,  char * filename, char * username, int * pbRecording)
 {
     bool bRecording;
@@ -117,3 +134,41 @@ int cbpy_get_time(int instance, int * pcbtime) {
 
     return sdkres;
 }
+
+// Copy the cached spikes newer than cursor into flat arrays, waveforms has cbMAX_PNTS room per spike
+int cbpy_get_spk_cache_since(int instance, int channel, unsigned int * cursor, unsigned int * count,
+                             UINT32 * timestamps, UINT16 * units, INT16 * waveforms)
+{
+    cbSdkResult sdkres = CBSDKRESULT_SUCCESS;
+    cbPKT_SPK spikes[32];
+    UINT32 nCopied = 0;
+    while (nCopied < *count)
+    {
+        UINT32 nRoom = *count - nCopied;
+        if (nRoom > 32)
+            nRoom = 32;
+        UINT32 nChunk = nRoom;
+        UINT32 nCursor = *cursor;
+        cbSdkResult res = cbSdkGetSpkCacheSince(instance, channel, &nCursor, spikes, &nChunk);
+        if (res < CBSDKRESULT_SUCCESS)
+        {
+            sdkres = res;
+            break;
+        }
+        if (res != CBSDKRESULT_SUCCESS)
+            sdkres = res;
+        *cursor = nCursor;
+        for (UINT32 i = 0; i < nChunk; ++i)
+        {
+            timestamps[nCopied + i] = spikes[i].time;
+            units[nCopied + i] = spikes[i].unit;
+            memcpy(&waveforms[(nCopied + i) * cbMAX_PNTS], spikes[i].wave, sizeof(spikes[i].wave));
+        }
+        nCopied += nChunk;
+        if (nChunk < nRoom)
+            break;
+    }
+    *count = nCopied;
+
+    return sdkres;
+}
@@ -32,6 +32,8 @@ typedef struct _cbSdkConfigParam {
     UINT32 uComments;
     UINT32 uTrackings;
     bool bAbsolute;
+    UINT32 uRaws;
+    bool bScaled;
 } cbSdkConfigParam;
 
 #define cbSdk_CONTINUOUS_DATA_SAMPLES 102400 // multiple of 4096
@@ -47,9 +49,15 @@ int cbpy_get_trial_event(int nInstance, bool reset, cbSdkTrialEvent * trialevent
 int cbpy_init_trial_cont(int nInstance, cbSdkTrialCont * trialcont);
 int cbpy_get_trial_cont(int nInstance, int reset, cbSdkTrialCont * trialcont);
 
+int cbpy_init_trial_raw(int nInstance, cbSdkTrialCont * trialraw);
+int cbpy_get_trial_raw(int nInstance, int reset, cbSdkTrialCont * trialraw);
+
 int cbpy_get_file_config(int instance,  char * filename, char * username, int * pbRecording);
 int cbpy_file_config(int instance,  const char * filename, const char * comment, int start, unsigned int options);
 
 int cbpy_get_time(int instance, int * pcbtime);
 
+int cbpy_get_spk_cache_since(int instance, int channel, unsigned int * cursor, unsigned int * count,
+                             UINT32 * timestamps, UINT16 * units, INT16 * waveforms);
+
 #endif // include guard
@@ -7,7 +7,7 @@ Purpose: C interface for cbpy wrapper
 
 '''
 
-from libc.stdint cimport uint32_t, uint16_t
+from libc.stdint cimport uint32_t, uint16_t, int16_t
 
 cdef extern from "cbpy.h":
     
@@ -35,10 +35,33 @@ cdef extern from "cbpy.h":
         CBSDKCONNECTION_UDP = 2      # Use UDP
         CBSDKCONNECTION_CLOSED = 3   # Closed
     
+    ctypedef enum cbSdkNetLoopType:
+        CBSDKNETLOOP_TIMER = 0       # Process network every 10ms
+        CBSDKNETLOOP_EVENT = 1       # Process network as soon as data arrives
+        CBSDKNETLOOP_SPIN = 2        # Spin on the network without sleeping
+
+    ctypedef enum cbSdkThreadPriority:
+        CBSDKPRIORITY_HIGH = 0          # High priority (default)
+        CBSDKPRIORITY_NORMAL = 1        # Normal priority
+        CBSDKPRIORITY_HIGHEST = 2       # Highest priority
+        CBSDKPRIORITY_TIMECRITICAL = 3  # Time critical priority (may need privileges)
+
     ctypedef struct cbSdkConnection:
         int nInPort          # Client port number
         int nOutPort         # Instrument port number
         int nRecBufSize      # Receive buffer size (0 to ignore altogether)
+        int nRecBatchSize    # Maximum number of datagrams to receive in one call
+        cbSdkNetLoopType nNetLoop  # Stand-alone network loop
+        bint bRecvThread     # Process packets in a thread separate from the one receiving them
+        cbSdkThreadPriority nNetPriority  # Network threads priority
+        unsigned long long nNetAffinity   # Network threads CPU affinity mask (0 for any CPU)
+        int nBusyPoll        # Microseconds to busy poll the network device on receive
+        int nXmtRate         # Packets per second sent to the instrument
+        int nXmtBurst        # Maximum number of packets sent to the instrument back to back
+        int nXmtWindow       # Maximum number of packets waiting for a response from the instrument at once
+        unsigned int nRecRingLen  # Receive buffer length in 32-bit words if stand-alone (0 for the default)
+        unsigned int nShmFlags    # Shared memory options (1 huge pages, 2 prefault, 4 lock)
+        unsigned int nSpkCacheDepth  # Spikes cached per channel if stand-alone (0 for the default)
         char * szInIP        # Client IPv4 address
         char * szOutIP       # Instrument IPv4 address
         
@@ -69,10 +92,13 @@ cdef extern from "cbpy.h":
         uint32_t uComments
         uint32_t uTrackings
         int bAbsolute
+        uint32_t uRaws
+        int bScaled
     
     cdef enum sdk_bufer_range:
         cbSdk_CONTINUOUS_DATA_SAMPLES = 102400
         cbSdk_EVENT_DATA_SAMPLES = (2 * 8192)
+        cbSdk_RAW_DATA_SAMPLES = (75 * 4096)
                     
     int cbpy_get_trial_config(int nInstance, cbSdkConfigParam * pcfg_param)
     int cbpy_set_trial_config(int nInstance, const cbSdkConfigParam * pcfg_param)
@@ -83,6 +109,8 @@ cdef extern from "cbpy.h":
         cbNUM_ANAIN_CHANS = 16
         cbNUM_ANALOG_CHANS =  (cbNUM_FE_CHANS+cbNUM_ANAIN_CHANS)
         cbMAXUNITS = 5
+        cbMAX_PNTS = 128
+        cbPKT_SPKCACHEPKTCNT = 400
         MAX_CHANS_DIGITAL_IN = (cbNUM_FE_CHANS+cbNUM_ANAIN_CHANS+4+2+1)
         MAX_CHANS_SERIAL = (MAX_CHANS_DIGITAL_IN+1)
     
@@ -106,6 +134,8 @@ cdef extern from "cbpy.h":
         
     int cbpy_init_trial_cont(int nInstance, cbSdkTrialCont * trialcont)
     int cbpy_get_trial_cont(int nInstance, int reset, cbSdkTrialCont * trialcont)
+    int cbpy_init_trial_raw(int nInstance, cbSdkTrialCont * trialraw)
+    int cbpy_get_trial_raw(int nInstance, int reset, cbSdkTrialCont * trialraw)
 
     cdef enum cbhwlib_cbFILECFG:
         cbFILECFG_OPT_NONE =         0x00000000  
@@ -121,4 +151,7 @@ cdef extern from "cbpy.h":
     int cbpy_file_config(int instance, const char * filename, const char * comment, int start, unsigned int options)
 
     int cbpy_get_time(int instance, int * pcbtime)
+
+    int cbpy_get_spk_cache_since(int instance, int channel, unsigned int * cursor, unsigned int * count,
+                                 uint32_t * timestamps, uint16_t * units, int16_t * waveforms)
             
\ No newline at end of file
@@ -59,6 +59,18 @@ def open(instance=0, connection='default', parameter={}):
                'client-addr': client IPv4 address.
                'client-port': client port number.
                'receive-buffer-size': override default network buffer size (low value may result in drops).
+               'receive-batch-size': maximum number of datagrams to receive at once (1 to disable batching).
+               'network-loop': 'timer' to process network every 10ms (default), 'event' to process as soon as data arrives, 'spin' to never sleep.
+               'receive-thread': 1 to process packets in a thread separate from the receive thread, 0 otherwise (default).
+               'network-priority': network thread priority 'normal', 'high' (default), 'highest' or 'time-critical'.
+               'network-affinity': mask of CPUs to run network threads on, 0 for any CPU (default).
+               'busy-poll': microseconds to busy poll the network device on receive, 0 to disable (default).
+               'transmit-rate': packets per second sent to the instrument, 400 by default.
+               'transmit-burst': maximum number of packets sent to the instrument back to back, 4 by default.
+               'transmit-window': maximum number of packets waiting for a response from the instrument at once (up to 64), 6 by default.
+               'receive-ring': receive buffer length in 32-bit words if stand-alone, 0 for the default of 4M words.
+               'shared-memory': shared memory options, sum of 1 for huge pages, 2 to prefault and 4 to lock in memory, 0 by default.
+               'spike-cache': spikes cached per channel if stand-alone (up to 10000), 0 for the default of 400.
        instance - (optional) library instance number
     Outputs:
         Same as "get_connection_type" command output
@@ -81,6 +93,27 @@ def open(instance=0, connection='default', parameter={}):
     con.szInIP = szInIP
     con.nInPort = parameter.get('client-port', 51002)
     con.nRecBufSize = parameter.get('receive-buffer-size', 0)
+    con.nRecBatchSize = parameter.get('receive-batch-size', 16)
+    wnetLoop = {'timer': CBSDKNETLOOP_TIMER, 'event': CBSDKNETLOOP_EVENT, 'spin': CBSDKNETLOOP_SPIN}
+    netLoop = parameter.get('network-loop', 'timer')
+    if not netLoop in wnetLoop.keys():
+        raise RuntimeError("invalid network loop %s" % netLoop)
+    con.nNetLoop = wnetLoop[netLoop]
+    con.bRecvThread = parameter.get('receive-thread', 0)
+    wnetPriority = {'normal': CBSDKPRIORITY_NORMAL, 'high': CBSDKPRIORITY_HIGH,
+                    'highest': CBSDKPRIORITY_HIGHEST, 'time-critical': CBSDKPRIORITY_TIMECRITICAL}
+    netPriority = parameter.get('network-priority', 'high')
+    if not netPriority in wnetPriority.keys():
+        raise RuntimeError("invalid network priority %s" % netPriority)
+    con.nNetPriority = wnetPriority[netPriority]
+    con.nNetAffinity = parameter.get('network-affinity', 0)
+    con.nBusyPoll = parameter.get('busy-poll', 0)
+    con.nXmtRate = parameter.get('transmit-rate', 400)
+    con.nXmtBurst = parameter.get('transmit-burst', 4)
+    con.nXmtWindow = parameter.get('transmit-window', 6)
+    con.nRecRingLen = parameter.get('receive-ring', 0)
+    con.nShmFlags = parameter.get('shared-memory', 0)
+    con.nSpkCacheDepth = parameter.get('spike-cache', 0)
     
     res = cbpy_open(<int>instance, conType, con)
 
@@ -156,6 +189,8 @@ def trial_config(instance=0, reset=True,
                'event_length': set the number of events to be cached
                'comment_length': set number of comments to be cached
                'tracking_length': set the number of video tracking events to be cached
+               'raw_length': set the number of raw (30 kHz) data to be cached, raw data is not cached by default
+               'scaled': boolean, if specified, continuous and raw data is in the physical units of each channel (implies 'double')
        range_parameter - (optional) dictionary with following keys (all optional)
                'begin_channel': integer, channel to start polling if certain value seen
                'begin_mask': integer, channel mask to start polling if certain value seen
@@ -188,6 +223,11 @@ def trial_config(instance=0, reset=True,
     cfg_param.uEvents = 0 if noevent else buffer_parameter.get('event_length', cbSdk_EVENT_DATA_SAMPLES)
     cfg_param.uComments = buffer_parameter.get('comment_length', 0)
     cfg_param.uTrackings = buffer_parameter.get('tracking_length', 0)
+    cfg_param.uRaws = buffer_parameter.get('raw_length', 0)
+    cfg_param.bScaled = buffer_parameter.get('scaled', 0)
+    if cfg_param.bScaled:
+        # Physical units are only returned in double precision
+        cfg_param.bDouble = 1
     cfg_param.bAbsolute = buffer_parameter.get('absolute', 0)
     
     
@@ -288,12 +328,14 @@ def trial_event(instance=0, reset=False):
 
     return res, trial
 
-def trial_continuous(instance=0, reset=False):
+def trial_continuous(instance=0, reset=False, raw=False):
     ''' Trial continuous data.
     Inputs:
        reset - (optional) boolean 
                set False (default) to leave buffer intact.
                set True to clear all the data and reset the trial time to the current time.
+       raw - (optional) boolean
+               set True to get the raw data cached with the 'raw_length' buffer parameter.
        instance - (optional) library instance number
     Outputs:
        list of the form [channel, continuous_array]
@@ -314,7 +356,10 @@ def trial_continuous(instance=0, reset=False):
         raise RuntimeError("error %d" % res)
     
     # get how many samples are avaialble
-    res = cbpy_init_trial_cont(<int>instance, &trialcont)
+    if raw:
+        res = cbpy_init_trial_raw(<int>instance, &trialcont)
+    else:
+        res = cbpy_init_trial_cont(<int>instance, &trialcont)
     if res < 0:
         # Make this raise error classes
         raise RuntimeError("error %d" % res)
@@ -348,7 +393,10 @@ def trial_continuous(instance=0, reset=False):
         trial.append(row)
         
     # get the trial
-    res = cbpy_get_trial_cont(<int>instance, <int>reset, &trialcont) 
+    if raw:
+        res = cbpy_get_trial_raw(<int>instance, <int>reset, &trialcont)
+    else:
+        res = cbpy_get_trial_cont(<int>instance, <int>reset, &trialcont)
 
     return res, trial
     
@@ -444,3 +492,41 @@ def time(instance=0, unit='samples'):
     time = float(cbtime) / factor
     
     return res, time
+
+
+def spike_cache(channel, cursor=0, count=cbPKT_SPKCACHEPKTCNT, instance=0):
+    '''Cached spikes of a channel newer than a cursor.
+    Inputs:
+       channel - electrode channel number (1-based)
+       cursor - (optional) number of spikes of the channel already seen, 0 (default) to start
+       count - (optional) maximum number of spikes to return
+       instance - (optional) library instance number
+    Outputs:
+       dictionary with the following keys
+           'cursor': integer, pass to the next call to get only newer spikes
+           'timestamps': array, spike timestamps (oldest first)
+           'units': array, spike units
+           'waveforms': array, one spike waveform per row
+    '''
+
+    cdef int res
+    cdef unsigned int ucursor = cursor
+    cdef unsigned int ucount = count
+
+    if count <= 0:
+        raise RuntimeError("invalid count %d" % count)
+
+    cdef np.uint32_t[:] mxa_u32 = np.zeros(count, dtype=np.uint32)
+    cdef np.uint16_t[:] mxa_u16 = np.zeros(count, dtype=np.uint16)
+    cdef np.int16_t[:, :] mxa_i16 = np.zeros((count, cbMAX_PNTS), dtype=np.int16)
+
+    res = cbpy_get_spk_cache_since(<int>instance, <int>channel, &ucursor, &ucount, &mxa_u32[0], &mxa_u16[0], &mxa_i16[0, 0])
+    if res < 0:
+        # Make this raise error classes
+        raise RuntimeError("error %d" % res)
+
+    spikes = {'cursor':ucursor,
+              'timestamps':np.asarray(mxa_u32)[:ucount],
+              'units':np.asarray(mxa_u16)[:ucount],
+              'waveforms':np.asarray(mxa_i16)[:ucount]}
+    return res, spikes